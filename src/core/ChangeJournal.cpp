@@ -0,0 +1,433 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+/// \file ChangeJournal.cpp
+//-----------------------------------------------------------------------------
+
+#include "ChangeJournal.h"
+#include "PWSfileV3.h"
+#include "PWSrand.h"
+#include "UTF8Conv.h"
+#include "Util.h"
+#include "crypto/hmac.h"
+
+#include "os/debug.h"
+#include "os/file.h"
+
+static const char JTAG[4] = {'P','W','S','J'}; // ASCII chars, not wchar
+
+// Header: tag, salt, H(P''), K and L encrypted with P'',
+// the database's binding, and the HMAC of all these
+enum {
+  SaltOffset = sizeof(JTAG),
+  HPtagOffset = SaltOffset + 32,
+  KOffset = HPtagOffset + SHA256::HASHLEN,
+  LOffset = KOffset + 32,
+  BindingOffset = LOffset + 32,
+  HeaderTagOffset = BindingOffset + SHA256::HASHLEN,
+  HeaderLength = HeaderTagOffset + SHA256::HASHLEN
+};
+
+// Batch: ciphertext length, IV, ciphertext, HMAC
+enum {BatchPreamble = 4 + TwoFish::BLOCKSIZE};
+
+// Changes within a batch's plaintext: op, uuid, data length, data
+enum {PUT = 1, DELETE = 2, END = 0xff};
+enum {ChangePreamble = 1 + sizeof(uuid_array_t) + 4};
+
+namespace {
+// Collects what CItemData::Write() would write to a V3 file, in the
+// clear, as (type, length, data) fields, ready for CItemData::Read()
+class FieldRecorder : public PWSfile
+{
+public:
+  typedef std::vector<unsigned char, S_Alloc::SecureAlloc<unsigned char>> Data;
+  explicit FieldRecorder(Data &out) : PWSfile(_T(""), Write, V30), m_out(out) {}
+
+  virtual int Open(const StringX &) {return SUCCESS;}
+  virtual int WriteRecord(const CItemData &item) {return item.Write(this);}
+  virtual int ReadRecord(CItemData &) {return FAILURE;}
+
+private:
+  virtual size_t WriteCBC(unsigned char type, const StringX &data)
+  {
+    const unsigned char *utf8(nullptr);
+    size_t utf8Len(0);
+    if (!m_utf8conv.ToUTF8(data, utf8, utf8Len))
+      pws_os::Trace(_T("ToUTF8(%ls) failed\n"), data.c_str());
+    return WriteCBC(type, utf8, utf8Len);
+  }
+
+  virtual size_t WriteCBC(unsigned char type, const unsigned char *data,
+                          size_t length)
+  {
+    unsigned char preamble[5];
+    preamble[0] = type;
+    putInt32(preamble + 1, static_cast<int32>(length));
+    m_out.insert(m_out.end(), preamble, preamble + sizeof(preamble));
+    if (length > 0)
+      m_out.insert(m_out.end(), data, data + length);
+    return sizeof(preamble) + length;
+  }
+
+  Data &m_out;
+  CUTF8Conv m_utf8conv;
+};
+} // anonymous namespace
+
+static void PutChange(std::vector<unsigned char, S_Alloc::SecureAlloc<unsigned char>> &v,
+                      unsigned char op, const pws_os::CUUID &uuid)
+{
+  uuid_array_t ua;
+  uuid.GetARep(ua);
+  v.push_back(op);
+  v.insert(v.end(), ua, ua + sizeof(ua));
+  v.insert(v.end(), 4, 0); // data length, filled in by caller
+}
+
+void ChangeJournal::Batch::Put(const CItemData &ci)
+{
+  PutChange(m_data, PUT, ci.GetUUID());
+  const size_t start = m_data.size();
+  FieldRecorder recorder(m_data);
+  recorder.WriteRecord(ci);
+  putInt32(&m_data[start - 4], static_cast<int32>(m_data.size() - start));
+  m_numChanges++;
+}
+
+void ChangeJournal::Batch::Delete(const pws_os::CUUID &uuid)
+{
+  PutChange(m_data, DELETE, uuid);
+  m_numChanges++;
+}
+
+ChangeJournal::ChangeJournal(const StringX &dbFilename, const unsigned char dbKey[32])
+  : m_dbFilename(dbFilename), m_filename(GetJournalName(dbFilename)),
+    m_end(0), m_numBatches(0)
+{
+  memcpy(m_dbKey, dbKey, sizeof(m_dbKey));
+  memset(m_L, 0, sizeof(m_L));
+  memset(m_lastTag, 0, sizeof(m_lastTag));
+  memset(m_binding, 0, sizeof(m_binding));
+}
+
+ChangeJournal::~ChangeJournal()
+{
+  Close();
+  trashMemory(m_dbKey, sizeof(m_dbKey));
+}
+
+stringT ChangeJournal::GetJournalName(const StringX &dbFilename)
+{
+  return stringT(dbFilename.c_str()) + _T(".pwsj");
+}
+
+void ChangeJournal::Close()
+{
+  m_fish.reset();
+  trashMemory(m_L, sizeof(m_L));
+  memset(m_lastTag, 0, sizeof(m_lastTag));
+  memset(m_binding, 0, sizeof(m_binding));
+  m_end = 0;
+  m_numBatches = 0;
+}
+
+void ChangeJournal::Remove()
+{
+  Close();
+  if (pws_os::FileExists(m_filename))
+    pws_os::DeleteAFile(m_filename);
+}
+
+bool ChangeJournal::GetBinding(const StringX &dbFilename,
+                               unsigned char binding[TagLength])
+{
+  // A V3 file ends with the HMAC of its contents, which is different
+  // each time it's written (new K, L and IV), and is checked on read.
+  FILE *fd = pws_os::FOpen(dbFilename.c_str(), _T("rb"));
+  if (fd == nullptr)
+    return false;
+
+  const ulong64 length = pws_os::fileLength(fd);
+  unsigned char tail[SHA256::HASHLEN];
+  const bool ok = length >= sizeof(tail) &&
+    fseek(fd, -long(sizeof(tail)), SEEK_END) == 0 &&
+    fread(tail, 1, sizeof(tail), fd) == sizeof(tail);
+  fclose(fd);
+  if (!ok)
+    return false;
+
+  unsigned char lengthb[8];
+  for (size_t i = 0; i < sizeof(lengthb); i++)
+    lengthb[i] = static_cast<unsigned char>(length >> (8 * i));
+  SHA256 H;
+  H.Update(lengthb, sizeof(lengthb));
+  H.Update(tail, sizeof(tail));
+  H.Final(binding);
+  return true;
+}
+
+void ChangeJournal::GetPtag(const unsigned char *salt, unsigned char Ptag[32]) const
+{
+  HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> hmac(m_dbKey, sizeof(m_dbKey));
+  hmac.Update(salt, 32);
+  hmac.Final(Ptag);
+}
+
+void ChangeJournal::Tag(const unsigned char *data, size_t length,
+                        unsigned char tag[TagLength]) const
+{
+  HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> hmac(m_L, sizeof(m_L));
+  hmac.Update(m_lastTag, sizeof(m_lastTag));
+  hmac.Update(data, static_cast<unsigned long>(length));
+  hmac.Final(tag);
+}
+
+int ChangeJournal::Create()
+{
+  Close();
+
+  unsigned char header[HeaderLength];
+  memcpy(header, JTAG, sizeof(JTAG));
+  PWSfileV3::HashRandom256(header + SaltOffset);
+
+  unsigned char Ptag[SHA256::HASHLEN];
+  GetPtag(header + SaltOffset, Ptag);
+  {
+    SHA256 H;
+    H.Update(Ptag, sizeof(Ptag));
+    H.Final(header + HPtagOffset);
+  }
+
+  unsigned char K[32];
+  PWSrand::GetInstance()->GetRandomData(K, sizeof(K));
+  PWSrand::GetInstance()->GetRandomData(m_L, sizeof(m_L));
+  {
+    TwoFish TF(Ptag, sizeof(Ptag));
+    TF.Encrypt(K, header + KOffset);
+    TF.Encrypt(K + 16, header + KOffset + 16);
+    TF.Encrypt(m_L, header + LOffset);
+    TF.Encrypt(m_L + 16, header + LOffset + 16);
+  }
+  trashMemory(Ptag, sizeof(Ptag));
+  m_fish.reset(new TwoFish(K, sizeof(K)));
+  trashMemory(K, sizeof(K));
+
+  if (!GetBinding(m_dbFilename, header + BindingOffset)) {
+    Close();
+    return PWSfile::CANT_OPEN_FILE;
+  }
+  memcpy(m_binding, header + BindingOffset, sizeof(m_binding));
+  Tag(header, HeaderTagOffset, header + HeaderTagOffset);
+
+  FILE *fd = pws_os::FOpen(m_filename, _T("wb"));
+  if (fd == nullptr) {
+    Close();
+    return PWSfile::CANT_OPEN_FILE;
+  }
+  const bool ok = fwrite(header, 1, sizeof(header), fd) == sizeof(header) &&
+    pws_os::FSync(fd);
+  if (fclose(fd) != 0 || !ok) {
+    Close();
+    return PWSfile::WRITE_FAIL;
+  }
+
+  memcpy(m_lastTag, header + HeaderTagOffset, sizeof(m_lastTag));
+  m_end = HeaderLength;
+  return PWSfile::SUCCESS;
+}
+
+// Applies the changes in a batch's plaintext, returning false if
+// they're malformed (which the HMAC should make impossible)
+static bool ApplyChanges(const unsigned char *in, const unsigned char *end,
+                         CItemData &ci, const ChangeJournal::Applier &apply)
+{
+  while (in < end && *in != END) {
+    if (end - in < ChangePreamble)
+      return false;
+    const unsigned char op = in[0];
+    const pws_os::CUUID uuid(*reinterpret_cast<const uuid_array_t *>(in + 1));
+    const size_t length = static_cast<uint32>(getInt32(in + 1 + sizeof(uuid_array_t)));
+    in += ChangePreamble;
+    if (length > size_t(end - in))
+      return false;
+    const unsigned char *data_end = in + length;
+
+    if (op == PUT) {
+      const CItemData::FieldReader next =
+        [&in, data_end](unsigned char &type, const unsigned char* &data, size_t &flength) {
+          if (data_end - in < 5)
+            return size_t(0);
+          type = in[0];
+          flength = static_cast<uint32>(getInt32(in + 1));
+          if (flength > size_t(data_end - in - 5))
+            return size_t(0);
+          data = in + 5;
+          in += 5 + flength;
+          return 5 + flength;
+        };
+      const int status = ci.Read(next);
+      if (status != PWSfile::SUCCESS && status != PWSfile::FAILURE)
+        return false;
+      apply(uuid, &ci);
+    } else if (op == DELETE) {
+      apply(uuid, nullptr);
+    } else
+      return false;
+    in = data_end;
+  }
+  return in < end; // must have seen END
+}
+
+int ChangeJournal::Replay(const std::shared_ptr<const CItemKeyring> &keyring,
+                          const Applier &apply)
+{
+  Close();
+
+  FILE *fd = pws_os::FOpen(m_filename, _T("rb"));
+  if (fd == nullptr)
+    return PWSfile::SUCCESS; // nothing to replay
+  const size_t length = pws_os::fileLength(fd);
+  std::vector<unsigned char> journal(length);
+  const bool read = length == 0 || fread(&journal[0], 1, length, fd) == length;
+  fclose(fd);
+  if (!read)
+    return PWSfile::READ_FAIL;
+
+  unsigned char binding[TagLength];
+  if (length < HeaderLength || memcmp(&journal[0], JTAG, sizeof(JTAG)) != 0 ||
+      !GetBinding(m_dbFilename, binding) ||
+      memcmp(binding, &journal[BindingOffset], sizeof(binding)) != 0) {
+    pws_os::Trace(_T("Stale or foreign journal %ls\n"), m_filename.c_str());
+    return PWSfile::WRONG_VERSION;
+  }
+
+  const unsigned char *header = &journal[0];
+  unsigned char Ptag[SHA256::HASHLEN];
+  GetPtag(header + SaltOffset, Ptag);
+  {
+    unsigned char HPtag[SHA256::HASHLEN];
+    SHA256 H;
+    H.Update(Ptag, sizeof(Ptag));
+    H.Final(HPtag);
+    if (memcmp(HPtag, header + HPtagOffset, sizeof(HPtag)) != 0) {
+      trashMemory(Ptag, sizeof(Ptag));
+      return PWSfile::WRONG_PASSWORD;
+    }
+  }
+
+  unsigned char K[32];
+  {
+    TwoFish TF(Ptag, sizeof(Ptag));
+    TF.Decrypt(header + KOffset, K);
+    TF.Decrypt(header + KOffset + 16, K + 16);
+    TF.Decrypt(header + LOffset, m_L);
+    TF.Decrypt(header + LOffset + 16, m_L + 16);
+  }
+  trashMemory(Ptag, sizeof(Ptag));
+  m_fish.reset(new TwoFish(K, sizeof(K)));
+  trashMemory(K, sizeof(K));
+
+  unsigned char tag[TagLength];
+  Tag(header, HeaderTagOffset, tag);
+  if (memcmp(tag, header + HeaderTagOffset, sizeof(tag)) != 0) {
+    Close();
+    return PWSfile::READ_FAIL;
+  }
+  memcpy(m_lastTag, tag, sizeof(m_lastTag));
+  memcpy(m_binding, binding, sizeof(m_binding));
+  m_end = HeaderLength;
+
+  CItemData ci;
+  ci.SetKeyring(keyring);
+  std::vector<unsigned char, S_Alloc::SecureAlloc<unsigned char>> plaintext;
+
+  // Batches that don't check out, and anything after them, are
+  // what a crash left behind: ignored, and overwritten by Append()
+  for (size_t pos = HeaderLength; pos + BatchPreamble + TagLength <= length; ) {
+    const unsigned char *batch = &journal[pos];
+    const size_t clength = static_cast<uint32>(getInt32(batch));
+    if (clength == 0 || clength % TwoFish::BLOCKSIZE != 0 ||
+        clength > length - pos - BatchPreamble - TagLength)
+      break;
+    Tag(batch, BatchPreamble + clength, tag);
+    if (memcmp(tag, batch + BatchPreamble + clength, sizeof(tag)) != 0)
+      break;
+
+    unsigned char cbc[TwoFish::BLOCKSIZE];
+    memcpy(cbc, batch + 4, sizeof(cbc));
+    plaintext.resize(clength);
+    const unsigned char *in = batch + BatchPreamble;
+    _readcbc(in, in + clength, plaintext.data(), clength, m_fish.get(), cbc);
+    const bool ok = ApplyChanges(plaintext.data(), plaintext.data() + clength,
+                                 ci, apply);
+    trashMemory(plaintext.data(), plaintext.size());
+    if (!ok) {
+      ASSERT(0);
+      break;
+    }
+
+    memcpy(m_lastTag, tag, sizeof(m_lastTag));
+    pos += BatchPreamble + clength + TagLength;
+    m_end = static_cast<long>(pos);
+    m_numBatches++;
+  }
+  return PWSfile::SUCCESS;
+}
+
+int ChangeJournal::Append(const Batch &batch)
+{
+  ASSERT(IsOpen());
+  if (batch.IsEmpty())
+    return PWSfile::SUCCESS;
+
+  // Changes against a database that's since been replaced would be
+  // ignored as stale on the next Replay()
+  unsigned char binding[TagLength];
+  if (!GetBinding(m_dbFilename, binding) ||
+      memcmp(binding, m_binding, sizeof(binding)) != 0)
+    return PWSfile::WRONG_VERSION;
+
+  const size_t plength = batch.m_data.size() + 1; // with END
+  const size_t BS = TwoFish::BLOCKSIZE;
+  const size_t clength = ((plength + BS - 1) / BS) * BS;
+  std::vector<unsigned char> out(BatchPreamble + clength + TagLength);
+
+  std::vector<unsigned char, S_Alloc::SecureAlloc<unsigned char>> plaintext;
+  plaintext.reserve(plength);
+  plaintext.assign(batch.m_data.begin(), batch.m_data.end());
+  plaintext.push_back(END);
+
+  putInt32(&out[0], static_cast<int32>(clength));
+  unsigned char iv[SHA256::HASHLEN];
+  PWSfileV3::HashRandom256(iv);
+  memcpy(&out[4], iv, BS);
+  unsigned char cbc[TwoFish::BLOCKSIZE];
+  memcpy(cbc, iv, sizeof(cbc));
+  const size_t written = _writecbcRest(&out[BatchPreamble], plaintext.data(),
+                                       plength, m_fish.get(), cbc);
+  ASSERT(written == clength); (void)written;
+  trashMemory(plaintext.data(), plaintext.size());
+
+  unsigned char tag[TagLength];
+  Tag(&out[0], BatchPreamble + clength, tag);
+  memcpy(&out[BatchPreamble + clength], tag, sizeof(tag));
+
+  FILE *fd = pws_os::FOpen(m_filename, _T("r+b"));
+  if (fd == nullptr)
+    return PWSfile::CANT_OPEN_FILE;
+  const bool ok = fseek(fd, m_end, SEEK_SET) == 0 &&
+    fwrite(&out[0], 1, out.size(), fd) == out.size() &&
+    pws_os::FSync(fd);
+  if (fclose(fd) != 0 || !ok)
+    return PWSfile::WRITE_FAIL;
+
+  memcpy(m_lastTag, tag, sizeof(m_lastTag));
+  m_end += static_cast<long>(out.size());
+  m_numBatches++;
+  return PWSfile::SUCCESS;
+}
@@ -0,0 +1,138 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// ChangeJournal.h
+//-----------------------------------------------------------------------------
+
+#ifndef __CHANGEJOURNAL_H
+#define __CHANGEJOURNAL_H
+
+#include "ItemData.h"
+#include "ItemKeyring.h"
+#include "StringX.h"
+#include "crypto/TwoFish.h"
+#include "crypto/sha256.h"
+#include "os/UUID.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+
+/**
+ * ChangeJournal is a sidecar to a V3 database ("foo.psafe3.pwsj" for
+ * "foo.psafe3") holding the entries added, changed or deleted since the
+ * database was last written in full. Saving a few changes then costs an
+ * append of those few entries, rather than a rewrite of them all.
+ *
+ * The journal starts with a header like the database's own: a salt,
+ * H(P'') and the journal's own K and L, encrypted with P''. Rather than
+ * stretching the passkey again, P'' is HMAC(key, salt), where key is the
+ * database's PWSfileV3::GetJournalKey(), itself derived from the
+ * database's P'. It is bound to one version of the database (by its
+ * length and trailing HMAC), so a journal left over from before the
+ * database was last written is recognised as stale and ignored.
+ *
+ * Each Append() adds one batch: its length, an IV, the changes
+ * (TwoFish-CBC with K), and an HMAC (with L) of all that and of the
+ * previous batch's HMAC (or the header's, for the first), and then
+ * waits for the disk. So batches can't be altered, reordered or
+ * replayed against another database, and a batch cut short by a
+ * crash is simply not there: Replay() stops at the first batch that
+ * doesn't check out, and the next Append() overwrites it.
+ * The flip side is that the last batches can be dropped unnoticed:
+ * a journal cut short at a batch boundary looks just like one whose
+ * later appends never happened. Nothing outside the journal counts
+ * its batches, as the database isn't rewritten on each append.
+ *
+ * Typical use, by PWScore: Replay() after reading the database (and
+ * checking its HMAC), Append() on each save, and Remove() once the
+ * database has been written in full.
+ */
+
+class ChangeJournal
+{
+public:
+  // Changes to be appended as one batch
+  class Batch
+  {
+  public:
+    void Put(const CItemData &ci); // added or changed
+    void Delete(const pws_os::CUUID &uuid);
+    bool IsEmpty() const {return m_data.empty();}
+    size_t GetNumChanges() const {return m_numChanges;}
+
+  private:
+    friend class ChangeJournal;
+    std::vector<unsigned char, S_Alloc::SecureAlloc<unsigned char>> m_data;
+    size_t m_numChanges = 0;
+  };
+
+  // Called for each change replayed: ci is the entry as put, to be moved
+  // from, or nullptr if it was deleted
+  typedef std::function<void(const pws_os::CUUID &uuid, CItemData *ci)> Applier;
+
+  // dbKey is PWSfileV3::GetJournalKey() of the database as it is on disk
+  ChangeJournal(const StringX &dbFilename, const unsigned char dbKey[32]);
+  ~ChangeJournal(); // forgets the keys
+
+  ChangeJournal(const ChangeJournal &) = delete;
+  ChangeJournal &operator=(const ChangeJournal &) = delete;
+
+  static stringT GetJournalName(const StringX &dbFilename);
+
+  // Starts an empty journal for the database as it is on disk now,
+  // replacing whatever journal there was
+  int Create();
+
+  // Applies the changes in the journal, if there's one for the database
+  // as it is on disk now. Returns SUCCESS even if there's nothing to
+  // replay (no journal, or one corrupt from the first batch);
+  // WRONG_VERSION if the journal's stale (for another version of the
+  // database) or isn't one at all, and WRONG_PASSWORD or READ_FAIL if
+  // it's unusable. Only SUCCESS leaves it for Create() to replace.
+  // Once this succeeds, IsOpen() tells if Append() can carry on from there.
+  int Replay(const std::shared_ptr<const CItemKeyring> &keyring,
+             const Applier &apply);
+
+  bool IsOpen() const {return m_fish != nullptr;}
+  // Durably appends batch, or returns WRITE_FAIL leaving the journal as was,
+  // or WRONG_VERSION if the database has been written since the journal
+  // was started (which a check of its length and tail tells)
+  int Append(const Batch &batch);
+
+  // Batches in the journal, whether replayed or appended
+  size_t GetNumBatches() const {return m_numBatches;}
+
+  void Remove(); // deletes the journal file and closes it
+  void Close();  // just forgets its K and L; dbKey's kept, for Create()
+
+private:
+  enum {TagLength = SHA256::HASHLEN};
+
+  static bool GetBinding(const StringX &dbFilename, unsigned char binding[TagLength]);
+  void GetPtag(const unsigned char *salt, unsigned char Ptag[32]) const;
+  void Tag(const unsigned char *data, size_t length,
+           unsigned char tag[TagLength]) const; // chained HMAC
+
+  const StringX m_dbFilename;
+  const stringT m_filename;
+  unsigned char m_dbKey[32];
+  std::unique_ptr<TwoFish> m_fish; // K
+  unsigned char m_L[32];           // HMAC key
+  unsigned char m_lastTag[TagLength];
+  unsigned char m_binding[TagLength]; // of the database, see GetBinding()
+  long m_end;                      // of the last good batch
+  size_t m_numBatches;
+};
+
+#endif /* __CHANGEJOURNAL_H */
+//-----------------------------------------------------------------------------
+// Local variables:
+// mode: c++
+// End:
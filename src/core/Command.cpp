@@ -910,7 +910,12 @@ void UpdateEntryCommand::Doit(const CUUID &entry_uuid,
 {
   ItemListIter pos = m_pcomInt->Find(entry_uuid);
   if (pos != m_pcomInt->GetEntryEndIter()) {
-    if (ftype != CItemData::PASSWORD)
+    if (ftype == CItemData::GROUP || ftype == CItemData::TITLE ||
+        ftype == CItemData::USER) {
+      m_pcomInt->UnindexEntry(pos->second);
+      pos->second.SetFieldValue(ftype, value);
+      m_pcomInt->IndexEntry(pos->second);
+    } else if (ftype != CItemData::PASSWORD)
       pos->second.SetFieldValue(ftype, value);
     else {
       time_t tttoldXtime;
@@ -932,6 +937,7 @@ void UpdateEntryCommand::Doit(const CUUID &entry_uuid,
 
     pos->second.SetStatus(es);
     m_pcomInt->AddChangedNodes(pos->second.GetGroup());
+    m_pcomInt->AddChangedEntry(entry_uuid);
   }
 }
 
@@ -1002,6 +1008,7 @@ int UpdatePasswordCommand::Execute()
       }
       pos->second.SetStatus(CItemData::ES_MODIFIED);
       m_pcomInt->AddChangedNodes(pos->second.GetGroup());
+      m_pcomInt->AddChangedEntry(pos->first);
     }
 
     m_CommandDBChange = DB;
@@ -1024,6 +1031,7 @@ void UpdatePasswordCommand::Undo()
       pos->second.SetPWHistory(m_old_ci.GetPWHistory());
       pos->second.SetStatus(m_old_ci.GetStatus());
       pos->second.SetXTime(tttOldXTime);
+      m_pcomInt->AddChangedEntry(pos->first);
     }
 
     if (m_bNotifyGUI)
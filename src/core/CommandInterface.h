@@ -75,6 +75,7 @@ class CommandInterface {
 
   virtual void AddChangedNodes(const StringX &path) = 0;
   virtual void AddChangedEmptyGroups(const StringX &path) = 0;
+  virtual void AddChangedEntry(const pws_os::CUUID &uuid) = 0;
   
   virtual const CItemData *GetBaseEntry(const CItemData *pAliasOrSC) const = 0;
   virtual const ItemMMap &GetBase2AliasesMmap() const = 0;
@@ -96,6 +97,10 @@ class CommandInterface {
                                  const StringX &value) = 0;
   virtual void RemoveExpiryEntry(const CItemData &ci) = 0;
 
+  // Call around any in-place change to an entry's group, title or user
+  virtual void IndexEntry(const CItemData &ci) = 0;
+  virtual void UnindexEntry(const CItemData &ci) = 0;
+
   virtual const PSWDPolicyMap &GetPasswordPolicies() = 0;
   virtual bool SetPasswordPolicies(const PSWDPolicyMap &MapPSWDPLC) = 0;
   virtual bool AddPolicy(const StringX &sxPolicyName, const PWPolicy &st_pp,
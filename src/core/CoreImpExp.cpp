@@ -545,9 +545,7 @@ int PWScore::WriteXMLFile(const StringX &filename,
     ofs << "\"" << endl;
   }
 
-  CUUID huuid(*m_hdr.m_file_uuid.GetARep(), true); // true to print canonically
-
-  ofs << "Database_uuid=\"" << huuid << "\"" << endl;
+  ofs << "Database_uuid=\"" << m_hdr.m_file_uuid.Canonic() << "\"" << endl;
   ofs << "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\"" << endl;
   ofs << "xsi:noNamespaceSchemaLocation=\"pwsafe.xsd\">" << endl;
   ofs << endl;
@@ -1065,8 +1063,9 @@ int PWScore::ImportPlaintextFile(const StringX &ImportedPrefix,
   // -------------------------------------------------------------
 
   // Initialize set
+  // (MakeEntryUnique() checks against existing entries itself,
+  // so the set only needs to track the entries we import)
   GTUSet setGTU;
-  InitialiseGTU(setGTU);
   StringX sxImportedEntry;
 
   for (;;) {
@@ -1632,8 +1631,9 @@ int PWScore::ImportKeePassV1TXTFile(const StringX &filename,
   bool bFirst(true);
 
   // Initialize set
+  // (MakeEntryUnique() checks against existing entries itself,
+  // so the set only needs to track the entries we import)
   GTUSet setGTU;
-  InitialiseGTU(setGTU);
   UUIDSet setUUID;
   InitialiseUUID(setUUID);
 
@@ -2130,8 +2130,9 @@ int PWScore::ImportKeePassV1CSVFile(const StringX &filename,
 
   // Finished parsing header, go get the data!
   // Initialize set
+  // (MakeEntryUnique() checks against existing entries itself,
+  // so the set only needs to track the entries we import)
   GTUSet setGTU;
-  InitialiseGTU(setGTU);
   UUIDSet setUUID;
   InitialiseUUID(setUUID);
 
@@ -0,0 +1,155 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+/// \file DisplayFieldCache.cpp
+//-----------------------------------------------------------------------------
+
+#include "DisplayFieldCache.h"
+
+static StringX Decrypt(const CItemData &ci, CItemData::FieldType ft)
+{
+  switch (ft) {
+  case CItemData::GROUP: return ci.GetGroup();
+  case CItemData::TITLE: return ci.GetTitle();
+  case CItemData::USER:  return ci.GetUser();
+  default:               return ci.GetFieldValue(ft);
+  }
+}
+
+DisplayFieldCache::DisplayFieldCache(size_t maxEntries, unsigned ttlSeconds)
+  : m_maxEntries(maxEntries), m_ttl(std::chrono::seconds(ttlSeconds)),
+    m_newest(nullptr), m_oldest(nullptr)
+{
+}
+
+void DisplayFieldCache::Configure(size_t maxEntries, unsigned ttlSeconds)
+{
+  const Clock::duration ttl = std::chrono::seconds(ttlSeconds);
+  if (ttl < m_ttl) // can't tell what was cached when, so start afresh
+    Clear();
+  m_maxEntries = maxEntries;
+  m_ttl = ttl;
+  Trim();
+}
+
+StringX DisplayFieldCache::Get(const pws_os::CUUID &uuid, const CItemData &ci,
+                               CItemData::FieldType ft) const
+{
+  if (m_maxEntries == 0 || !IsCached(ft))
+    return Decrypt(ci, ft);
+
+  const Clock::time_point now = Clock::now();
+  const Key key = {uuid, ft};
+
+  auto iter = m_map.find(key);
+  if (iter != m_map.end()) {
+    Entry &e = iter->second;
+    if (now < e.expires) {
+      m_stats.hits++;
+      e.used = true;
+      return e.value;
+    }
+    // Stale: refresh in place, as if newly cached
+    m_stats.expirations++;
+    m_stats.misses++;
+    e.value = Decrypt(ci, ft);
+    e.expires = now + m_ttl;
+    e.used = false;
+    Unlink(&e);
+    Enqueue(&e);
+    return e.value;
+  }
+
+  m_stats.misses++;
+  iter = m_map.emplace(key, Entry()).first;
+  Entry &e = iter->second;
+  e.key = &iter->first;
+  e.value = Decrypt(ci, ft);
+  e.expires = now + m_ttl;
+  Enqueue(&e);
+  const StringX retval = e.value; // Trim() won't evict e, but may rehash
+  Trim();
+  return retval;
+}
+
+void DisplayFieldCache::Remove(const pws_os::CUUID &uuid)
+{
+  for (auto ft : {CItemData::GROUP, CItemData::TITLE, CItemData::USER}) {
+    auto iter = m_map.find(Key{uuid, ft});
+    if (iter != m_map.end())
+      Evict(&iter->second);
+  }
+}
+
+void DisplayFieldCache::Clear()
+{
+  // StringX and map nodes are wiped by SecurePool as they're freed
+  m_map.clear();
+  m_newest = m_oldest = nullptr;
+}
+
+void DisplayFieldCache::PurgeExpired()
+{
+  // Second chances requeue values without renewing them, so the
+  // queue isn't quite in expiry order: look at every value
+  const Clock::time_point now = Clock::now();
+  for (Entry *e = m_oldest; e != nullptr;) {
+    Entry *newer = e->newer;
+    if (!(now < e->expires)) {
+      m_stats.expirations++;
+      Evict(e);
+    }
+    e = newer;
+  }
+}
+
+DisplayFieldCache::Stats DisplayFieldCache::GetStats() const
+{
+  Stats stats = m_stats;
+  stats.size = m_map.size();
+  return stats;
+}
+
+void DisplayFieldCache::Unlink(Entry *e) const
+{
+  (e->newer != nullptr ? e->newer->older : m_newest) = e->older;
+  (e->older != nullptr ? e->older->newer : m_oldest) = e->newer;
+  e->newer = e->older = nullptr;
+}
+
+void DisplayFieldCache::Enqueue(Entry *e) const
+{
+  e->older = m_newest;
+  e->newer = nullptr;
+  if (m_newest != nullptr)
+    m_newest->newer = e;
+  else
+    m_oldest = e;
+  m_newest = e;
+}
+
+void DisplayFieldCache::Evict(Entry *e) const
+{
+  Unlink(e);
+  m_map.erase(*e->key);
+}
+
+void DisplayFieldCache::Trim() const
+{
+  // Each second chance clears a 'used' flag, so this terminates
+  while (m_map.size() > m_maxEntries) {
+    Entry *e = m_oldest;
+    if (e->used && e != m_newest) {
+      e->used = false;
+      Unlink(e);
+      Enqueue(e);
+    } else {
+      m_stats.evictions++;
+      Evict(e);
+    }
+  }
+}
@@ -0,0 +1,128 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// DisplayFieldCache.h
+//-----------------------------------------------------------------------------
+
+#ifndef __DISPLAYFIELDCACHE_H
+#define __DISPLAYFIELDCACHE_H
+
+#include "ItemData.h"
+#include "StringX.h"
+#include "os/UUID.h"
+
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+
+//-----------------------------------------------------------------------------
+
+/**
+ * DisplayFieldCache keeps the decrypted group, title and user of recently
+ * displayed entries, so that a grid or tree that redraws or sorts
+ * thousands of rows doesn't decrypt the same fields over and over.
+ *
+ * It is bounded: beyond MaxEntries, the oldest value is evicted, unless
+ * it has been used since it was cached, in which case it gets a second
+ * chance. This approximates LRU without relinking on every hit, which
+ * matters once the cache outgrows the CPU's.
+ * Values older than TTL are treated as misses, and dropped by
+ * PurgeExpired(), which the UIs call on a timer so that fields don't
+ * linger in memory after they're no longer shown. The UIs also Clear()
+ * it on locking and minimising.
+ *
+ * Values are StringX, and so live in SecurePool's locked memory,
+ * as do the map's nodes; all are wiped when evicted or cleared.
+ *
+ * A MaxEntries of 0 disables the cache: Get() always decrypts.
+ *
+ * Like PWScore, which owns one, this class is not thread-safe.
+ */
+
+class DisplayFieldCache
+{
+public:
+  struct Stats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;   // dropped to stay within MaxEntries
+    size_t expirations = 0; // found, but older than TTL
+    size_t size = 0;        // values currently cached
+  };
+
+  DisplayFieldCache(size_t maxEntries = 0, unsigned ttlSeconds = 300);
+  ~DisplayFieldCache() {Clear();}
+
+  DisplayFieldCache(const DisplayFieldCache &) = delete;
+  DisplayFieldCache &operator=(const DisplayFieldCache &) = delete;
+
+  // Changing either limit drops whatever no longer fits
+  void Configure(size_t maxEntries, unsigned ttlSeconds);
+  bool IsEnabled() const {return m_maxEntries != 0;}
+
+  static bool IsCached(CItemData::FieldType ft)
+  {return ft == CItemData::GROUP || ft == CItemData::TITLE || ft == CItemData::USER;}
+
+  // Returns ci's value for ft, from the cache if possible.
+  // uuid must be ci's, and is passed in as the caller usually has it
+  // to hand, whereas ci.GetUUID() costs as much as a decryption.
+  // ci should be the owning PWScore's copy of the entry:
+  // an edited copy would poison the cache.
+  StringX Get(const pws_os::CUUID &uuid, const CItemData &ci,
+              CItemData::FieldType ft) const;
+
+  void Remove(const pws_os::CUUID &uuid); // after the entry changes or goes
+  void Clear(); // on lock, minimise, close...
+  void PurgeExpired(); // drops values older than TTL
+
+  Stats GetStats() const;
+  void ResetStats() const {m_stats = Stats();}
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Key {
+    pws_os::CUUID uuid;
+    CItemData::FieldType ft;
+    bool operator==(const Key &that) const
+    {return uuid == that.uuid && ft == that.ft;}
+  };
+  struct KeyHash {
+    size_t operator()(const Key &k) const
+    {return k.uuid.Hash() ^ (size_t(k.ft) * 0x9e3779b9u);}
+  };
+  struct Entry {
+    const Key *key = nullptr; // the map's
+    StringX value;
+    Clock::time_point expires;
+    Entry *newer = nullptr, *older = nullptr; // eviction queue
+    bool used = false; // hit since queued?
+  };
+
+  // Values are held in the map's nodes, so those come from SecurePool too
+  typedef std::unordered_map<Key, Entry, KeyHash, std::equal_to<Key>,
+                             S_Alloc::SecureAlloc<std::pair<const Key, Entry>>> EntryMap;
+
+  void Unlink(Entry *e) const;
+  void Enqueue(Entry *e) const; // as newest
+  void Evict(Entry *e) const;
+  void Trim() const;
+
+  size_t m_maxEntries;
+  Clock::duration m_ttl;
+
+  // Lookups are logically const
+  mutable EntryMap m_map;
+  mutable Entry *m_newest, *m_oldest;
+  mutable Stats m_stats;
+};
+
+#endif /* __DISPLAYFIELDCACHE_H */
+//-----------------------------------------------------------------------------
+// Local variables:
+// mode: c++
+// End:
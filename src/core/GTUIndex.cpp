@@ -0,0 +1,80 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+/// \file GTUIndex.cpp
+//-----------------------------------------------------------------------------
+
+#include "GTUIndex.h"
+#include "PWSrand.h"
+#include "Util.h"
+#include "crypto/hmac.h"
+
+GTUIndex::GTUIndex()
+{
+  PWSrand::GetInstance()->GetRandomData(m_key, sizeof(m_key));
+}
+
+GTUIndex::~GTUIndex()
+{
+  trashMemory(m_key, sizeof(m_key));
+}
+
+uint64 GTUIndex::Hash(const StringX &group, const StringX &title,
+                      const StringX &user) const
+{
+  HMAC_SHA256 hmac(m_key, sizeof(m_key));
+
+  // Length-prefix each field, so that, e.g., ("ab", "c") and
+  // ("a", "bc") hash differently
+  for (const StringX *field : {&group, &title, &user}) {
+    unsigned char len[4];
+    putInt32(len, static_cast<int32>(field->length()));
+    hmac.Update(len, sizeof(len));
+    hmac.Update(reinterpret_cast<const unsigned char *>(field->c_str()),
+                static_cast<unsigned long>(field->length() * sizeof(TCHAR)));
+  }
+
+  unsigned char digest[HMAC_SHA256::HASH_LENGTH];
+  hmac.Final(digest);
+  const uint64 retval = static_cast<uint64>(getInt64(digest));
+  trashMemory(digest, sizeof(digest));
+  return retval;
+}
+
+void GTUIndex::Add(const CItemData &ci)
+{
+  m_index.insert(std::make_pair(Hash(ci.GetGroup(), ci.GetTitle(), ci.GetUser()),
+                                ci.GetUUID()));
+}
+
+void GTUIndex::Remove(const CItemData &ci)
+{
+  const pws_os::CUUID uuid = ci.GetUUID();
+  auto range = m_index.equal_range(Hash(ci.GetGroup(), ci.GetTitle(), ci.GetUser()));
+  for (auto iter = range.first; iter != range.second; iter++) {
+    if (iter->second == uuid) {
+      m_index.erase(iter);
+      return;
+    }
+  }
+}
+
+void GTUIndex::Clear()
+{
+  m_index.clear();
+  PWSrand::GetInstance()->GetRandomData(m_key, sizeof(m_key));
+}
+
+UUIDVector GTUIndex::Find(const StringX &group, const StringX &title,
+                          const StringX &user) const
+{
+  UUIDVector retval;
+  auto range = m_index.equal_range(Hash(group, title, user));
+  for (auto iter = range.first; iter != range.second; iter++)
+    retval.push_back(iter->second);
+  return retval;
+}
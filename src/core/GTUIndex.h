@@ -0,0 +1,64 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// GTUIndex.h
+//-----------------------------------------------------------------------------
+
+#ifndef __GTUINDEX_H
+#define __GTUINDEX_H
+
+#include "StringX.h"
+#include "os/UUID.h"
+#include "os/typedefs.h"
+#include "ItemData.h"
+
+#include <unordered_map>
+
+//-----------------------------------------------------------------------------
+
+/**
+ * GTUIndex maps an entry's group/title/user combination to its UUID,
+ * so that PWScore can find entries by GTU, and check for duplicates,
+ * without decrypting the GTU of every entry.
+ *
+ * Only a keyed hash (HMAC-SHA256, truncated to 64 bits) of each GTU is
+ * kept, under a random key that's replaced by Clear(), so the index
+ * holds no plaintext. Different GTUs may collide, so Find() returns
+ * candidates that the caller must check against the actual entries.
+ *
+ * GTUs are hashed exactly as stored, matching the comparisons done by
+ * PWScore::Find() and st_GroupTitleUser.
+ */
+
+class GTUIndex
+{
+public:
+  GTUIndex();
+  ~GTUIndex();
+
+  void Add(const CItemData &ci);
+  void Remove(const CItemData &ci); // ci's GTU must be the one it was Add()ed with
+  void Clear(); // also changes the key
+
+  // UUIDs of entries that may have the given GTU
+  UUIDVector Find(const StringX &group, const StringX &title,
+                  const StringX &user) const;
+
+  size_t size() const {return m_index.size();}
+
+private:
+  uint64 Hash(const StringX &group, const StringX &title, const StringX &user) const;
+
+  unsigned char m_key[32];
+  std::unordered_multimap<uint64, pws_os::CUUID> m_index;
+};
+
+#endif /* __GTUINDEX_H */
+//-----------------------------------------------------------------------------
+// Local variables:
+// mode: c++
+// End:
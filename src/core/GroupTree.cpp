@@ -0,0 +1,161 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+/// \file GroupTree.cpp
+//-----------------------------------------------------------------------------
+
+#include "GroupTree.h"
+#include "PWSrand.h"
+#include "Util.h"
+#include "crypto/hmac.h"
+
+GroupTree::GroupTree()
+{
+  PWSrand::GetInstance()->GetRandomData(m_key, sizeof(m_key));
+}
+
+GroupTree::~GroupTree()
+{
+  trashMemory(m_key, sizeof(m_key));
+}
+
+std::vector<GroupTree::Key> GroupTree::Keys(const StringX &path) const
+{
+  std::vector<GroupTree::Key> vKeys;
+  if (path.empty())
+    return vKeys;
+
+  // Each subgroup's key is HMAC(parent's key | name), the root's being 0
+  Key key = {};
+  size_t start = 0;
+  for (;;) {
+    size_t pos = path.find(_T('.'), start);
+    const size_t len = ((pos == StringX::npos) ? path.length() : pos) - start;
+
+    HMAC_SHA256 hmac(m_key, sizeof(m_key));
+    hmac.Update(key.data(), static_cast<unsigned long>(key.size()));
+    hmac.Update(reinterpret_cast<const unsigned char *>(path.c_str() + start),
+                static_cast<unsigned long>(len * sizeof(TCHAR)));
+    hmac.Final(key.data());
+    vKeys.push_back(key);
+
+    if (pos == StringX::npos) // rightmost subgroup, e.g., "b" in "a.b"
+      break;
+    start = pos + 1;
+  }
+  trashMemory(key.data(), key.size());
+  return vKeys;
+}
+
+void GroupTree::Add(const StringX &group, const pws_os::CUUID &uuid)
+{
+  Node *node = &m_root;
+  node->count++;
+  for (const auto &key : Keys(group)) {
+    auto &child = node->children[key];
+    if (!child)
+      child.reset(new Node);
+    node = child.get();
+    node->count++;
+  }
+  node->entries.insert(uuid);
+}
+
+void GroupTree::Remove(const StringX &group, const pws_os::CUUID &uuid)
+{
+  // Find the path down to the entry's node first, so as not to
+  // change any counts if it's not there
+  const std::vector<Key> vKeys = Keys(group);
+  std::vector<Node *> vPath(1, &m_root);
+  for (const auto &key : vKeys) {
+    auto iter = vPath.back()->children.find(key);
+    if (iter == vPath.back()->children.end()) {
+      ASSERT(0);
+      return;
+    }
+    vPath.push_back(iter->second.get());
+  }
+
+  if (vPath.back()->entries.erase(uuid) == 0) {
+    ASSERT(0);
+    return;
+  }
+
+  for (auto node : vPath)
+    node->count--;
+
+  // Prune subgroups left with no entries, bottom up
+  for (size_t i = vKeys.size(); i > 0; i--) {
+    if (vPath[i]->count != 0)
+      break;
+    vPath[i - 1]->children.erase(vKeys[i - 1]);
+  }
+}
+
+void GroupTree::Clear()
+{
+  m_root.children.clear();
+  m_root.entries.clear();
+  m_root.count = 0;
+  PWSrand::GetInstance()->GetRandomData(m_key, sizeof(m_key));
+}
+
+const GroupTree::Node *GroupTree::FindNode(const StringX &path) const
+{
+  const Node *node = &m_root;
+  for (const auto &key : Keys(path)) {
+    auto iter = node->children.find(key);
+    if (iter == node->children.end())
+      return nullptr;
+    node = iter->second.get();
+  }
+  return node;
+}
+
+size_t GroupTree::NumEntries(const StringX &path) const
+{
+  const Node *node = FindNode(path);
+  return (node == nullptr) ? 0 : node->count;
+}
+
+void GroupTree::CollectGroups(const Node &node, const GroupOf &groupOf,
+                              std::set<stringT> &setGroups)
+{
+  // Every group with no entries of its own is a prefix of one that
+  // has some, further down, as it would have been pruned otherwise
+  for (const auto &child : node.children) {
+    const Node &sub = *child.second;
+    if (!sub.entries.empty()) {
+      const StringX sxPath = groupOf(*sub.entries.begin());
+      size_t pos = 0;
+      while ((pos = sxPath.find(_T('.'), pos)) != StringX::npos)
+        setGroups.insert(sxPath.substr(0, pos++).c_str());
+      setGroups.insert(sxPath.c_str());
+    }
+    CollectGroups(sub, groupOf, setGroups);
+  }
+}
+
+void GroupTree::GetAllGroups(std::set<stringT> &setGroups,
+                             const GroupOf &groupOf) const
+{
+  CollectGroups(m_root, groupOf, setGroups);
+}
+
+void GroupTree::CollectEntries(const Node &node, UUIDVector &vuuids)
+{
+  vuuids.insert(vuuids.end(), node.entries.begin(), node.entries.end());
+  for (const auto &child : node.children)
+    CollectEntries(*child.second, vuuids);
+}
+
+void GroupTree::GetEntries(const StringX &path, UUIDVector &vuuids) const
+{
+  const Node *node = FindNode(path);
+  if (node != nullptr)
+    CollectEntries(*node, vuuids);
+}
@@ -0,0 +1,94 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// GroupTree.h
+//-----------------------------------------------------------------------------
+
+#ifndef __GROUPTREE_H
+#define __GROUPTREE_H
+
+#include "StringX.h"
+#include "os/UUID.h"
+
+#include <array>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <unordered_set>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+
+/**
+ * GroupTree is a trie of the database's group paths ("a.b.c" is "c" under
+ * "b" under "a"), maintained by PWScore as entries are added, removed or
+ * moved, so that group operations needn't scan (and decrypt) every entry.
+ *
+ * Each node knows its child groups, the entries whose group is exactly
+ * that node's path, and the number of entries in its subtree. Nodes
+ * are removed once their subtree has no entries; empty groups are
+ * kept by PWScore separately, as before.
+ *
+ * Paths are split at every '.', the same way collectGroups() did,
+ * so "a..b" is "b" under "" under "a".
+ *
+ * Like GTUIndex, the tree holds no plaintext: a node is keyed by a keyed
+ * hash (HMAC-SHA256) of its name and its parent's key, under a random key
+ * that's replaced by Clear(), so equal names under different parents
+ * don't show either. Where names are wanted, as by GetAllGroups(), they
+ * come from the caller, decrypting one entry's group per group that has
+ * entries of its own, rather than every entry's.
+ */
+
+class GroupTree
+{
+public:
+  GroupTree();
+  ~GroupTree();
+
+  void Add(const StringX &group, const pws_os::CUUID &uuid);
+  void Remove(const StringX &group, const pws_os::CUUID &uuid);
+  void Clear();
+
+  // Does any entry have group path, or a subgroup of it?
+  bool HasGroup(const StringX &path) const {return NumEntries(path) != 0;}
+  // Number of entries in path and its subgroups
+  size_t NumEntries(const StringX &path) const;
+
+  // Adds all non-empty groups and their prefixes, e.g., "a", "a.b", "a.b.c",
+  // given the group of an entry by its UUID
+  typedef std::function<StringX(const pws_os::CUUID &)> GroupOf;
+  void GetAllGroups(std::set<stringT> &setGroups, const GroupOf &groupOf) const;
+  // Entries in path and its subgroups
+  void GetEntries(const StringX &path, UUIDVector &vuuids) const;
+
+private:
+  typedef std::array<unsigned char, 32> Key; // HMAC-SHA256 digest
+
+  struct Node {
+    std::map<Key, std::unique_ptr<Node>> children;
+    std::unordered_set<pws_os::CUUID> entries; // group == this node's path
+    size_t count = 0; // entries in this node's subtree
+  };
+
+  // Keys of the nodes along path, from the root's child down
+  std::vector<Key> Keys(const StringX &path) const;
+  const Node *FindNode(const StringX &path) const;
+  static void CollectGroups(const Node &node, const GroupOf &groupOf,
+                            std::set<stringT> &setGroups);
+  static void CollectEntries(const Node &node, UUIDVector &vuuids);
+
+  unsigned char m_key[32];
+  Node m_root; // the root "group", i.e., entries with no group set
+};
+
+#endif /* __GROUPTREE_H */
+//-----------------------------------------------------------------------------
+// Local variables:
+// mode: c++
+// End:
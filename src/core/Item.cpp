@@ -9,6 +9,7 @@
 //-----------------------------------------------------------------------------
 
 #include "Item.h"
+#include "ItemKeyring.h"
 #include "crypto/BlowFish.h"
 #include "crypto/TwoFish.h"
 #include "PWSrand.h"
@@ -16,6 +17,7 @@
 #include "Util.h"
 #include "os/env.h"
 
+#include <utility>
 #include <vector>
 
 CItem::CItem()
@@ -25,11 +27,23 @@ CItem::CItem()
 
 CItem::CItem(const CItem &that) :
   m_fields(that.m_fields),
-  m_URFL(that.m_URFL)
+  m_URFL(that.m_URFL),
+  m_keyring(that.m_keyring)
 {
   memcpy(m_key, that.m_key, sizeof(m_key));
 }
 
+CItem::CItem(CItem &&that) noexcept :
+  m_fields(std::move(that.m_fields)),
+  m_URFL(std::move(that.m_URFL)),
+  m_keyring(that.m_keyring)
+{
+  // The fields are encrypted with that's key, so we need it too.
+  // that keeps its key, keyring and BlowFish, so that it can be
+  // refilled without paying for a new BlowFish (see ReadFile)
+  memcpy(m_key, that.m_key, sizeof(m_key));
+}
+
 CItem::~CItem()
 {
   delete m_blowfish;
@@ -48,6 +62,25 @@ CItem& CItem::operator=(const CItem &that)
     memcpy(m_key, that.m_key, sizeof(m_key));
     delete m_blowfish;
     m_blowfish = nullptr;
+    m_keyring = that.m_keyring;
+  }
+  return *this;
+}
+
+CItem& CItem::operator=(CItem &&that) noexcept
+{
+  if (this != &that) {
+    m_fields = std::move(that.m_fields);
+    m_URFL = std::move(that.m_URFL);
+
+    // Entries read together share a key (see ReadFile), in which
+    // case our BlowFish is still good
+    if (memcmp(m_key, that.m_key, sizeof(m_key)) != 0) {
+      memcpy(m_key, that.m_key, sizeof(m_key));
+      delete m_blowfish;
+      m_blowfish = nullptr;
+    }
+    m_keyring = that.m_keyring;
   }
   return *this;
 }
@@ -133,6 +166,67 @@ BlowFish *CItem::MakeBlowFish() const
   return m_blowfish;
 }
 
+void CItem::EncryptField(CItemField &field, const unsigned char *value, size_t length,
+                         unsigned char type) const
+{
+  if (m_keyring)
+    field.Set(value, length, m_keyring.get(), type);
+  else
+    field.Set(value, length, MakeBlowFish(), type);
+}
+
+void CItem::EncryptField(CItemField &field, const StringX &value, unsigned char type) const
+{
+  if (m_keyring)
+    field.Set(value, m_keyring.get(), type);
+  else
+    field.Set(value, MakeBlowFish(), type);
+}
+
+void CItem::DecryptField(const CItemField &field, unsigned char *value, size_t &length) const
+{
+  if (m_keyring)
+    field.Get(value, length, m_keyring.get());
+  else
+    field.Get(value, length, MakeBlowFish());
+}
+
+void CItem::DecryptField(const CItemField &field, StringX &value) const
+{
+  if (m_keyring)
+    field.Get(value, m_keyring.get());
+  else
+    field.Get(value, MakeBlowFish());
+}
+
+void CItem::SetKeyring(const std::shared_ptr<const CItemKeyring> &keyring)
+{
+  if (keyring == m_keyring)
+    return;
+
+  // Decrypt each field with the current scheme, re-encrypt with the new one
+  for (auto &field : m_fields)
+    RekeyField(field.second, keyring);
+  for (auto &field : m_URFL)
+    RekeyField(field, keyring);
+
+  m_keyring = keyring;
+}
+
+void CItem::RekeyField(CItemField &field,
+                       const std::shared_ptr<const CItemKeyring> &keyring) const
+{
+  std::vector<unsigned char> v;
+  GetField(field, v);
+  const unsigned char *value = v.empty() ? nullptr : v.data();
+  if (keyring)
+    field.Set(value, v.size(), keyring.get());
+  else
+    field.Set(value, v.size(), MakeBlowFish());
+  if (!v.empty())
+    trashMemory(v.data(), v.size());
+}
+
 void CItem::SetUnknownField(unsigned char type,
                             size_t length,
                             const unsigned char *ufield)
@@ -143,7 +237,7 @@ void CItem::SetUnknownField(unsigned char type,
   **/
 
   CItemField unkrfe(type);
-  unkrfe.Set(ufield, length, MakeBlowFish());
+  EncryptField(unkrfe, ufield, length);
   m_URFL.push_back(unkrfe);
 }
 
@@ -170,9 +264,7 @@ void CItem::Clear()
 void CItem::SetField(int ft, const unsigned char *value, size_t length)
 {
   if (length != 0) {
-    m_fields[ft].Set(value, length,
-                     MakeBlowFish(),
-                     static_cast<unsigned char>(ft));
+    EncryptField(m_fields[ft], value, length, static_cast<unsigned char>(ft));
   } else
     m_fields.erase(ft);
 }
@@ -180,9 +272,7 @@ void CItem::SetField(int ft, const unsigned char *value, size_t length)
 void CItem::SetField(int ft, const StringX &value)
 {
   if (!value.empty()) {
-    m_fields[ft].Set(value,
-                     MakeBlowFish(),
-                     static_cast<unsigned char>(ft));
+    EncryptField(m_fields[ft], value, static_cast<unsigned char>(ft));
   } else
     m_fields.erase(ft);
 }
@@ -196,13 +286,11 @@ static bool pull_string(StringX &str,
    * PWS_CP_ACP is either set externally or via the --CP_ACP argv
    *
    * We use a static variable purely for efficiency, as this won't change
-   * over the course of the program.
+   * over the course of the program. Initialized once, even if entries
+   * are read on several threads.
    */
 
-  static int cp_acp = -1;
-  if (cp_acp == -1) {
-    cp_acp = pws_os::getenv("PWS_CP_ACP", false).empty() ? 0 : 1;
-  }
+  static const int cp_acp = pws_os::getenv("PWS_CP_ACP", false).empty() ? 0 : 1;
   CUTF8Conv utf8conv(cp_acp != 0);
   std::vector<unsigned char> v(data, (data + len));
   v.push_back(0); // null terminate for FromUTF8.
@@ -246,17 +334,17 @@ bool CItem::SetTimeField(int ft, const unsigned char *value,
 void CItem::GetField(const CItemField &field,
                      unsigned char *value, size_t &length) const
 {
-  field.Get(value, length, MakeBlowFish());
+  DecryptField(field, value, length);
 }
 
 void CItem::GetField(const CItemField &field, std::vector<unsigned char> &v) const
 {
-  size_t length = field.GetLength();
+  size_t length = field.GetSize(); // CItemField::Get() fills whole blocks
   if (length < TwoFish::BLOCKSIZE)
     length = TwoFish::BLOCKSIZE;
   v.resize(length);
   length = v.size();
-  field.Get(& v[0], length, MakeBlowFish());
+  DecryptField(field, & v[0], length);
   v.resize(length);
 }
 
@@ -294,7 +382,7 @@ StringX CItem::GetField(const int ft) const
 StringX CItem::GetField(const CItemField &field) const
 {
   StringX retval;
-  field.Get(retval, MakeBlowFish());
+  DecryptField(field, retval);
   return retval;
 }
 
@@ -12,11 +12,13 @@
 #define __ITEM_H
 
 #include "ItemField.h"
+#include "ItemFieldMap.h"
 #include "StringX.h"
 
 #include <vector>
 #include <string>
 #include <map>
+#include <memory>
 
 //-----------------------------------------------------------------------------
 
@@ -38,9 +40,14 @@
  * UnknownFields are used from forward compatibility. If there's a field type
  * we don't recognize, we just store it as-is, so that we can write it when saving.
  *
+ * By default, each item has its own random key and BlowFish schedule.
+ * Alternately, an item can be given a CItemKeyring shared with other items
+ * (typically all those of a PWScore), which saves the per-item key schedule.
+ *
 */
 
 class BlowFish;
+class CItemKeyring;
 
 class CItem
 {
@@ -140,6 +147,7 @@ public:
   //Construction
   CItem();
   CItem(const CItem& stuffhere);
+  CItem(CItem &&that) noexcept; // leaves that with no fields, ready for reuse
 
   virtual ~CItem();
 
@@ -148,11 +156,17 @@ public:
   size_t NumberUnknownFields() const {return m_URFL.size();}
 
   CItem& operator=(const CItem& second);
+  CItem& operator=(CItem &&that) noexcept;
   virtual void Clear();
   void ClearField(int ft) {m_fields.erase(ft);}
 
   bool operator==(const CItem &that) const;
 
+  // Switch field encryption to keyring (nullptr: back to private BlowFish key),
+  // re-encrypting any fields already set.
+  virtual void SetKeyring(const std::shared_ptr<const CItemKeyring> &keyring);
+  const std::shared_ptr<const CItemKeyring> &GetKeyring() const {return m_keyring;}
+
   size_t GetSize() const;
   void GetSize(size_t &isize) const {isize = GetSize();}
     
@@ -168,7 +182,7 @@ public:
   void push(std::vector<char> &v, char type, const StringX &str) const;
     
 protected:
-  typedef std::map<int, CItemField> FieldMap;
+  typedef CItemFieldMap FieldMap;
   typedef FieldMap::const_iterator FieldConstIter;
   typedef FieldMap::iterator FieldIter;
 
@@ -202,6 +216,18 @@ protected:
   bool IsItemAttField(unsigned char type) const
   {return type >= START_ATT && type < LAST_ATT;}
 
+  // Encrypt/decrypt a field with the keyring if we have one,
+  // else with our own BlowFish
+  void EncryptField(CItemField &field, const unsigned char *value, size_t length,
+                    unsigned char type = 0xff) const;
+  void EncryptField(CItemField &field, const StringX &value, unsigned char type = 0xff) const;
+  void DecryptField(const CItemField &field, unsigned char *value, size_t &length) const;
+  void DecryptField(const CItemField &field, StringX &value) const;
+  // Re-encrypts field, currently encrypted as above, with keyring
+  // (or our own BlowFish if nullptr), for SetKeyring()
+  void RekeyField(CItemField &field,
+                  const std::shared_ptr<const CItemKeyring> &keyring) const;
+
 private:
   // Helper function for operator==
   bool CompareFields(const CItemField &fthis,
@@ -215,6 +241,9 @@ private:
   // than the BlowFish object for copy c'tor and assignment
   unsigned char m_key[32];
   mutable BlowFish *m_blowfish = nullptr;
+
+  // If set, used instead of m_key/m_blowfish
+  std::shared_ptr<const CItemKeyring> m_keyring;
 };
 
 #endif /* __ITEM_H */
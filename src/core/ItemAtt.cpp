@@ -29,20 +29,38 @@
 using namespace std;
 using pws_os::CUUID;
 
+struct CItemAtt::ContentSource {
+  stringT filename;
+  long offset;             // of the content's first block
+  unsigned char IV[TwoFish::BLOCKSIZE];
+  unsigned char digest[SHA256::HASHLEN]; // content's HMAC, as read
+  CItemField keys;         // EK and AK, encrypted as our fields are
+};
+
 //-----------------------------------------------------------------------------
 // Constructors
 
 CItemAtt::CItemAtt()
-  : m_entrystatus(ES_CLEAN), m_offset(-1L), m_refcount(0)
+  : m_contentLength(0), m_entrystatus(ES_CLEAN), m_offset(-1L), m_refcount(0)
 {
 }
 
 CItemAtt::CItemAtt(const CItemAtt &that) :
-  CItem(that), m_entrystatus(that.m_entrystatus),
+  CItem(that), m_content(that.m_content),
+  m_source(that.m_source ? new ContentSource(*that.m_source) : nullptr),
+  m_contentLength(that.m_contentLength), m_entrystatus(that.m_entrystatus),
   m_offset(that.m_offset), m_refcount(that.m_refcount)
 {
 }
 
+CItemAtt::CItemAtt(CItemAtt &&that) noexcept :
+  CItem(std::move(that)), m_content(std::move(that.m_content)),
+  m_source(std::move(that.m_source)), m_contentLength(that.m_contentLength), m_entrystatus(that.m_entrystatus),
+  m_offset(that.m_offset), m_refcount(that.m_refcount)
+{
+  that.ClearContent();
+}
+
 CItemAtt::~CItemAtt()
 {
 }
@@ -51,6 +69,24 @@ CItemAtt& CItemAtt::operator=(const CItemAtt &that)
 {
   if (this != &that) { // Check for self-assignment
     CItem::operator=(that);
+    m_content = that.m_content;
+    m_source.reset(that.m_source ? new ContentSource(*that.m_source) : nullptr);
+    m_contentLength = that.m_contentLength;
+    m_entrystatus = that.m_entrystatus;
+    m_offset = that.m_offset;
+    m_refcount = that.m_refcount;
+  }
+  return *this;
+}
+
+CItemAtt& CItemAtt::operator=(CItemAtt &&that) noexcept
+{
+  if (this != &that) {
+    CItem::operator=(std::move(that));
+    m_content = std::move(that.m_content);
+    m_source = std::move(that.m_source);
+    m_contentLength = that.m_contentLength;
+    that.ClearContent();
     m_entrystatus = that.m_entrystatus;
     m_offset = that.m_offset;
     m_refcount = that.m_refcount;
@@ -60,10 +96,46 @@ CItemAtt& CItemAtt::operator=(const CItemAtt &that)
 
 bool CItemAtt::operator==(const CItemAtt &that) const
 {
-  return (m_entrystatus == that.m_entrystatus &&
-          m_offset == that.m_offset &&
-          m_refcount == that.m_refcount &&
-          CItem::operator==(that));
+  if (!(m_entrystatus == that.m_entrystatus &&
+        m_offset == that.m_offset &&
+        m_refcount == that.m_refcount &&
+        m_contentLength == that.m_contentLength &&
+        CItem::operator==(that)))
+    return false;
+
+  if (!LoadContent() || !that.LoadContent())
+    return false;
+
+  // As with the fields, the pieces of content are encrypted
+  // with different keys, so they're compared decrypted
+  vector<unsigned char> dthis(CONTENT_CHUNK), dthat(CONTENT_CHUNK);
+  bool retval = true;
+  for (size_t offset = 0; retval && offset < m_contentLength; offset += CONTENT_CHUNK) {
+    const size_t n = ReadContent(offset, dthis.data(), dthis.size());
+    that.ReadContent(offset, dthat.data(), dthat.size());
+    retval = (memcmp(dthis.data(), dthat.data(), n) == 0);
+  }
+  trashMemory(dthis.data(), dthis.size());
+  trashMemory(dthat.data(), dthat.size());
+  return retval;
+}
+
+void CItemAtt::Clear()
+{
+  CItem::Clear();
+  ClearContent();
+}
+
+void CItemAtt::SetKeyring(const std::shared_ptr<const CItemKeyring> &keyring)
+{
+  if (keyring == GetKeyring())
+    return;
+
+  for (auto &chunk : m_content)
+    RekeyField(chunk, keyring);
+  if (m_source)
+    RekeyField(m_source->keys, keyring);
+  CItem::SetKeyring(keyring);
 }
 
 void CItemAtt::SetTitle(const StringX &title)
@@ -79,7 +151,9 @@ void CItemAtt::CreateUUID()
 
 void CItemAtt::SetUUID(const CUUID &uuid)
 {
-  CItem::SetField(ATTUUID, static_cast<const unsigned char *>(*uuid.GetARep()), sizeof(uuid_array_t));
+  uuid_array_t uuid_array;
+  uuid.GetARep(uuid_array);
+  CItem::SetField(ATTUUID, uuid_array, sizeof(uuid_array_t));
 }
 
 void CItemAtt::GetUUID(uuid_array_t &uuid_array) const
@@ -112,48 +186,170 @@ void CItemAtt::SetCTime(time_t t)
 
 void CItemAtt::SetContent(const unsigned char *content, size_t clen)
 {
-  SetField(CONTENT, content, clen);
+  ClearContent();
+  AppendContent(content, clen);
 }
 
-StringX CItemAtt::GetTime(int whichtime, PWSUtil::TMC result_format) const
+void CItemAtt::AppendContent(const unsigned char *content, size_t clen)
 {
-  time_t t;
+  ASSERT(content != nullptr || clen == 0);
+  size_t offset = 0;
+
+  // Appending to content that can't be loaded replaces it
+  if (!LoadContent())
+    ClearContent();
+
+  // Top up the last piece first, if it's short
+  const size_t last = m_contentLength % CONTENT_CHUNK;
+  if (last != 0 && clen != 0) {
+    vector<unsigned char> v(CONTENT_CHUNK);
+    size_t length = v.size();
+    DecryptField(m_content.back(), v.data(), length);
+    const size_t room = CONTENT_CHUNK - last;
+    offset = (clen < room) ? clen : room;
+    memcpy(v.data() + last, content, offset);
+    EncryptField(m_content.back(), v.data(), last + offset);
+    trashMemory(v.data(), v.size());
+  }
 
-  CItem::GetTime(whichtime, t);
-  return PWSUtil::ConvertToDateTimeString(t, result_format);
+  while (offset < clen) {
+    const size_t n = (clen - offset < CONTENT_CHUNK) ? clen - offset : CONTENT_CHUNK;
+    m_content.emplace_back(static_cast<unsigned char>(CONTENT));
+    EncryptField(m_content.back(), content + offset, n);
+    offset += n;
+  }
+  m_contentLength += clen;
 }
 
-size_t CItemAtt::GetContentLength() const
+void CItemAtt::ClearContent()
 {
-  auto fiter = m_fields.find(CONTENT);
+  m_content.clear();
+  m_source.reset();
+  m_contentLength = 0;
+}
 
-  if (fiter != m_fields.end())
-    return fiter->second.GetLength();
-  else
-    return 0;
+bool CItemAtt::LoadContent() const
+{
+  if (m_source == nullptr)
+    return true;
+
+  // The file may have changed since it was read (touched, or copied
+  // back by a sync tool, say); the content's HMAC tells whether it's
+  // still there as it was.
+  const ContentSource &src = *m_source;
+  std::FILE *fhandle = pws_os::FOpen(src.filename, L"rb");
+  if (!fhandle)
+    return false;
+  if (fseek(fhandle, src.offset, SEEK_SET) != 0) {
+    fclose(fhandle);
+    return false;
+  }
+
+  unsigned char keys[2 * PWSfileV4::KLEN + BlowFish::BLOCKSIZE];
+  size_t klen = sizeof(keys);
+  DecryptField(src.keys, keys, klen);
+  ASSERT(klen == 2 * PWSfileV4::KLEN);
+  TwoFish fish(keys, PWSfileV4::KLEN);
+  HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> hmac(keys + PWSfileV4::KLEN,
+                                                         PWSfileV4::KLEN);
+  trashMemory(keys, sizeof(keys));
+  unsigned char cbc[TwoFish::BLOCKSIZE];
+  memcpy(cbc, src.IV, sizeof(cbc));
+  const unsigned int BS = fish.GetBlockSize();
+
+  // As Read() would have, a piece at a time
+  vector<CItemField> content;
+  vector<unsigned char> ct(CONTENT_CHUNK), buf(CONTENT_CHUNK);
+  bool ok = true;
+  for (size_t offset = 0; ok && offset < m_contentLength; offset += CONTENT_CHUNK) {
+    const size_t n = (m_contentLength - offset < CONTENT_CHUNK) ?
+      m_contentLength - offset : CONTENT_CHUNK;
+    const size_t blen = ((n + BS - 1)/BS)*BS;
+    const unsigned char *in = ct.data();
+    ok = (fread(ct.data(), 1, blen, fhandle) == blen &&
+          _readcbc(in, in + blen, buf.data(), blen, &fish, cbc) == blen);
+    if (ok) {
+      hmac.Update(buf.data(), static_cast<unsigned long>(n));
+      content.emplace_back(static_cast<unsigned char>(CONTENT));
+      EncryptField(content.back(), buf.data(), n);
+    }
+  }
+  fclose(fhandle);
+  trashMemory(buf.data(), buf.size());
+  trashMemory(cbc, sizeof(cbc));
+
+  unsigned char digest[SHA256::HASHLEN];
+  hmac.Final(digest);
+  if (!ok || memcmp(digest, src.digest, sizeof(digest)) != 0)
+    return false;
+
+  m_content = std::move(content);
+  m_source.reset();
+  return true;
 }
 
-size_t CItemAtt::GetContentSize() const
+StringX CItemAtt::GetTime(int whichtime, PWSUtil::TMC result_format) const
 {
-  auto fiter = m_fields.find(CONTENT);
+  time_t t;
 
-  if (fiter != m_fields.end())
-    return fiter->second.GetSize();
-  else
-    return 0;
+  CItem::GetTime(whichtime, t);
+  return PWSUtil::ConvertToDateTimeString(t, result_format);
+}
+
+size_t CItemAtt::GetContentSize() const
+{
+  // As if in a single field
+  const size_t BS = BlowFish::BLOCKSIZE;
+  return ((m_contentLength + BS - 1) / BS) * BS;
 }
 
 bool CItemAtt::GetContent(unsigned char *content, size_t csize) const
 {
   ASSERT(content != nullptr);
 
-  if (!HasContent() || csize < GetContentSize())
+  if (!HasContent() || csize < GetContentSize() || !LoadContent())
     return false;
 
-  GetField(m_fields.find(CONTENT)->second, content, csize);
+  ReadContent(0, content, m_contentLength);
   return true;
 }
 
+size_t CItemAtt::ReadContent(size_t offset, unsigned char *buf, size_t n) const
+{
+  ASSERT(buf != nullptr || n == 0);
+  if (offset >= m_contentLength || !LoadContent())
+    return 0;
+  if (n > m_contentLength - offset)
+    n = m_contentLength - offset;
+
+  vector<unsigned char> v;
+  size_t done = 0;
+  while (done < n) {
+    const size_t pos = offset + done;
+    const CItemField &chunk = m_content[pos / CONTENT_CHUNK];
+    const size_t skip = pos % CONTENT_CHUNK;
+    size_t length;
+
+    if (skip == 0 && chunk.GetSize() <= n - done) {
+      // Whole piece wanted, and there's room for its padding too
+      length = n - done;
+      DecryptField(chunk, buf + done, length);
+      done += length;
+    } else {
+      v.resize(CONTENT_CHUNK);
+      length = v.size();
+      DecryptField(chunk, v.data(), length);
+      const size_t m = (length - skip < n - done) ? length - skip : n - done;
+      memcpy(buf + done, v.data() + skip, m);
+      done += m;
+    }
+  }
+
+  if (!v.empty())
+    trashMemory(v.data(), v.size());
+  return n;
+}
+
 int CItemAtt::Import(const stringT &fname)
 {
   stringT spath, sdrive, sdir, sfname, sextn;
@@ -174,12 +370,19 @@ int CItemAtt::Import(const stringT &fname)
     return PWScore::MAX_SIZE_EXCEEDED;
   }
 
-  auto *data = new unsigned char[flen];
-  if (data == nullptr)
-    return PWScore::FAILURE;
+  // Read a piece at a time, keeping what we had until done
+  vector<CItemField> oldContent(std::move(m_content));
+  const size_t oldLength = m_contentLength;
+  vector<unsigned char> data(CONTENT_CHUNK);
+  size_t nread;
 
-  size_t nread = fread(data, flen, 1, fhandle);
-  if (nread != 1) {
+  ClearContent();
+  do {
+    nread = fread(data.data(), 1, data.size(), fhandle);
+    AppendContent(data.data(), nread);
+  } while (nread == data.size() && m_contentLength <= flen);
+
+  if (ferror(fhandle) || m_contentLength != flen) {
     pws_os::FClose(fhandle, false);
     status = PWScore::READ_FAIL;
     goto done;
@@ -190,8 +393,6 @@ int CItemAtt::Import(const stringT &fname)
     goto done;
   }
 
-  SetField(CONTENT, data, flen);
-
   // derive the file's path and name
   pws_os::splitpath(fname, sdrive, sdir, sfname, sextn);
   spath = pws_os::makepath(sdrive, sdir, _T(""), _T(""));
@@ -214,8 +415,11 @@ int CItemAtt::Import(const stringT &fname)
   }
 
  done:
-  trashMemory(data, flen);
-  delete[] data;
+  if (status != PWScore::SUCCESS) {
+    m_content = std::move(oldContent);
+    m_contentLength = oldLength;
+  }
+  trashMemory(data.data(), data.size());
   return status;
 }
 
@@ -224,28 +428,26 @@ int CItemAtt::Export(const stringT &fname) const
   int status = PWScore::SUCCESS;
 
   ASSERT(!fname.empty());
-  ASSERT(IsFieldSet(CONTENT));
+  ASSERT(HasContent());
   // fail safely @runtime:
-  if (!IsFieldSet(CONTENT))
+  if (!HasContent())
     return PWScore::FAILURE;
+  if (!LoadContent())
+    return PWScore::READ_FAIL;
 
-  const CItemField &field = m_fields.find(CONTENT)->second;
   std::FILE *fhandle = pws_os::FOpen(fname, L"wb");
   if (!fhandle)
     return PWScore::CANT_OPEN_FILE;
 
-  size_t flen = field.GetLength() + 8; // Add 8 for block size
-  auto *value = new unsigned char[flen];
-  if (value == nullptr) {
-    fclose(fhandle);
-    return PWScore::FAILURE;
-  }
-
-  CItem::GetField(field, value, flen); // flen adjusted to real value
-  size_t nwritten = fwrite(value, flen, 1, fhandle);
-  if (nwritten != 1) {
-    status = PWScore::WRITE_FAIL;
-    goto done;
+  // Write a piece at a time
+  vector<unsigned char> value(CONTENT_CHUNK);
+  for (size_t offset = 0; offset < m_contentLength; offset += CONTENT_CHUNK) {
+    const size_t n = ReadContent(offset, value.data(), value.size());
+    if (fwrite(value.data(), 1, n, fhandle) != n) {
+      fclose(fhandle);
+      status = PWScore::WRITE_FAIL;
+      goto done;
+    }
   }
 
   if (fclose(fhandle) != 0) {
@@ -254,8 +456,7 @@ int CItemAtt::Export(const stringT &fname) const
   }
 
  done:
-  trashMemory(value, flen);
-  delete[] value;
+  trashMemory(value.data(), value.size());
   return status;
 }
 
@@ -286,7 +487,7 @@ bool CItemAtt::SetField(unsigned char type, const unsigned char *data,
     if (!SetTimeField(ft, data, len)) return false;
     break;
   case CONTENT:
-    CItem::SetField(type, data, len);
+    SetContent(data, len);
     break;
   case ATTIV:
   case ATTEK:
@@ -321,18 +522,18 @@ int CItemAtt::Read(PWSfile *in)
   unsigned char EK[PWSfileV4::KLEN] = {0};
   unsigned char AK[PWSfileV4::KLEN] = {0};
 
-  unsigned char *content = nullptr;
   size_t content_len = 0;
   unsigned char expected_digest[SHA256::HASHLEN] = {0};
+  HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> hmac;
 
-  unsigned char *utf8 = nullptr;
+  const unsigned char *utf8 = nullptr; // owned & wiped by in
   size_t utf8Len = 0;
 
   Clear();
 
   do {
-    fieldLen = static_cast<signed long>(in->ReadField(type, utf8,
-                                                      utf8Len));
+    fieldLen = static_cast<signed long>(in->ReadFieldInPlace(type, utf8,
+                                                             utf8Len));
 
     if (fieldLen > 0) {
       numread += fieldLen;
@@ -379,19 +580,53 @@ int CItemAtt::Read(PWSfile *in)
           goto exit;
         content_len = static_cast<size_t>(getInt32(utf8));
 
+        auto *in4 = dynamic_cast<PWSfileV4 *>(in);
+        ASSERT(in4 != nullptr);
+        if (in4->IsLazyContent() && content_len > 0) {
+          // Just note where the content is, for LoadContent()
+          const long offset = in4->SkipContent(content_len);
+          if (offset < 0) {
+            status = PWSfile::READ_FAIL;
+            goto exit;
+          }
+          m_source.reset(new ContentSource);
+          m_source->filename = in4->GetFilename().c_str();
+          m_source->offset = offset;
+          memcpy(m_source->IV, IV, sizeof(IV));
+          m_contentLength = content_len;
+          gotContent = true;
+          break;
+        }
+
         TwoFish fish(EK, sizeof(EK));
         trashMemory(EK, sizeof(EK));
         const unsigned int BS = fish.GetBlockSize();
 
-        auto *in4 = dynamic_cast<PWSfileV4 *>(in);
-        ASSERT(in4 != nullptr);
-        size_t nread = in4->ReadContent(&fish, IV, content, content_len);
-        // nread should be content_len rounded up to nearest BS:
-        ASSERT(nread == (content_len/BS + 1)*BS);
-        if (nread != (content_len/BS + 1)*BS) {
-          status = PWSfile::READ_FAIL;
-          goto exit;
+        // If we've AK already, as we write it, the HMAC's
+        // calculated as the content's read, else afterwards
+        if (gotAK) {
+          hmac.Init(AK, sizeof(AK));
+          trashMemory(AK, sizeof(AK));
+        }
+
+        // Read the content a piece at a time, straight into our own pieces
+        vector<unsigned char> buf(CONTENT_CHUNK);
+        for (size_t offset = 0; offset < content_len; offset += CONTENT_CHUNK) {
+          const size_t n = (content_len - offset < CONTENT_CHUNK) ?
+            content_len - offset : CONTENT_CHUNK;
+          size_t nread = in4->ReadContent(&fish, IV, buf.data(), n);
+          // nread should be n rounded up to nearest BS:
+          ASSERT(nread == ((n + BS - 1)/BS)*BS);
+          if (nread != ((n + BS - 1)/BS)*BS) {
+            trashMemory(buf.data(), buf.size());
+            status = PWSfile::READ_FAIL;
+            goto exit;
+          }
+          AppendContent(buf.data(), n);
+          if (hmac.IsInited())
+            hmac.Update(buf.data(), static_cast<unsigned long>(n));
         }
+        trashMemory(buf.data(), buf.size());
         gotContent = true;
         break;
       }
@@ -409,11 +644,6 @@ int CItemAtt::Read(PWSfile *in)
           goto exit;
       } // switch {type)
     } // if (fieldLen > 0)
-
-    if (utf8 != nullptr) {
-      trashMemory(utf8, utf8Len * sizeof(utf8[0]));
-      delete[] utf8; utf8 = nullptr; utf8Len = 0;
-    }
   } while (type != END && fieldLen > 0 && --emergencyExit > 0);
 
   // Post-field read processing:
@@ -422,20 +652,33 @@ int CItemAtt::Read(PWSfile *in)
   // - Set Content field
   // - Clean-up
 
-  if (gotContent && gotAK && gotHMAC) {
+  if (gotContent && gotAK && gotHMAC && m_source) {
+    // Read lazily: keep what's needed to load and verify it later
+    unsigned char keys[2 * PWSfileV4::KLEN];
+    memcpy(keys, EK, PWSfileV4::KLEN);
+    memcpy(keys + PWSfileV4::KLEN, AK, PWSfileV4::KLEN);
+    EncryptField(m_source->keys, keys, sizeof(keys));
+    trashMemory(keys, sizeof(keys));
+    memcpy(m_source->digest, expected_digest, sizeof(expected_digest));
+    status = PWSfile::SUCCESS;
+  } else if (gotContent && gotAK && gotHMAC) {
     unsigned char calculated_digest[SHA256::HASHLEN] = {0};
-    HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> hmac;
 
-    hmac.Init(AK, sizeof(AK));
-    trashMemory(AK, sizeof(AK));
-    
-    // calculate HMAC
-    hmac.Update(content, static_cast<unsigned long>(content_len));
+    if (!hmac.IsInited()) { // AK came after the content
+      hmac.Init(AK, sizeof(AK));
+      trashMemory(AK, sizeof(AK));
+
+      vector<unsigned char> buf(CONTENT_CHUNK);
+      for (size_t offset = 0; offset < m_contentLength; offset += CONTENT_CHUNK) {
+        const size_t n = ReadContent(offset, buf.data(), buf.size());
+        hmac.Update(buf.data(), static_cast<unsigned long>(n));
+      }
+      trashMemory(buf.data(), buf.size());
+    }
     hmac.Final(calculated_digest);
 
     if (memcmp(expected_digest, calculated_digest,
                sizeof(calculated_digest)) == 0) {
-      SetField(CONTENT, content, content_len);
       status = PWSfile::SUCCESS;
     } else {
       status = PWSfile::BAD_DIGEST;
@@ -445,9 +688,10 @@ int CItemAtt::Read(PWSfile *in)
   }
 
  exit:
-  trashMemory(content, content_len);
-  delete[] content;
-  delete[] utf8; // if here via goto exit
+  trashMemory(EK, sizeof(EK));
+  trashMemory(AK, sizeof(AK));
+  if (status != PWSfile::SUCCESS)
+    ClearContent(); // only content that checks out is kept
 
   if (numread > 0) {
     m_offset = in->GetOffset();
@@ -498,6 +742,10 @@ int CItemAtt::Write(PWSfile *out) const
   int status = PWSfile::SUCCESS;
   uuid_array_t att_uuid;
 
+  // Content read lazily is written as loaded, lest it be lost
+  if (!LoadContent())
+    return PWSfile::READ_FAIL;
+
   ASSERT(HasUUID());
   GetUUID(att_uuid);
 
@@ -513,21 +761,26 @@ int CItemAtt::Write(PWSfile *out) const
   WriteIfSet(FILEMTIME, out, false);
   WriteIfSet(FILEATIME, out, false);
 
-  auto fiter = m_fields.find(CONTENT);
   // XXX TBD - fail if no content, as this is a mandatory field
-  if (fiter != m_fields.end()) {
+  if (HasContent()) {
     auto *out4 = dynamic_cast<PWSfileV4 *>(out);
     ASSERT(out4 != nullptr);
 
-    size_t clength = fiter->second.GetLength() + BlowFish::BLOCKSIZE;
-    auto *content = new unsigned char[clength];
-    CItem::GetField(fiter->second, content, clength);
-    out4->WriteContentFields(content, clength);
-    trashMemory(content, clength);
-    delete[] content;
+    // Write a piece at a time
+    status = out4->BeginContent(m_contentLength);
+    if (status == PWSfile::SUCCESS) {
+      vector<unsigned char> content(CONTENT_CHUNK);
+      for (size_t offset = 0; offset < m_contentLength; offset += CONTENT_CHUNK) {
+        const size_t n = ReadContent(offset, content.data(), content.size());
+        if (out4->WriteContent(content.data(), n) != PWSfile::SUCCESS)
+          break;
+      }
+      trashMemory(content.data(), content.size());
+      status = out4->EndContent(); // fails unless all was written
+    }
   }
 
-  if (out->WriteField(END, _T("")) > 0) {
+  if (status == PWSfile::SUCCESS && out->WriteField(END, _T("")) > 0) {
     status = PWSfile::SUCCESS;
   } else {
     status = PWSfile::FAILURE;
@@ -632,19 +885,12 @@ void CItemAtt::SerializePlainText(vector<char> &v)  const
   if(IsFieldSet(FILEPATH))
     push(v, FILEPATH, GetFilePath());
     
-  if(HasContent()) {
-    size_t length = GetContentSize();
-    size_t realLen = GetContentLength();
-    if(length) {
-      auto *data = new unsigned char[length];
-      if(GetContent(data, length)) {
-        v.push_back(CONTENT);
-        push_length(v, static_cast<uint32>(realLen));
-        v.insert(v.end(), data, (data + realLen));
-        trashMemory(data, length);
-        delete[] data;
-      }
-    }
+  if(HasContent() && LoadContent()) {
+    v.push_back(CONTENT);
+    push_length(v, static_cast<uint32>(m_contentLength));
+    const size_t start = v.size();
+    v.resize(start + m_contentLength);
+    ReadContent(0, reinterpret_cast<unsigned char *>(v.data() + start), m_contentLength);
   }
     
   if(IsFieldSet(FILECTIME)) {
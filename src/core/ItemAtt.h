@@ -30,6 +30,14 @@
 *
 * All this is to protect the data in memory, and has nothing to do with
 * how the records are written to disk.
+*
+* The content is kept in pieces of CONTENT_CHUNK bytes (the last one
+* may be shorter), each encrypted like a field of its own, so that it
+* can be read, written, imported and exported a piece at a time, rather
+* than all at once.
+*
+* The content of an attachment read lazily (see PWSfileV4::SetLazyContent())
+* stays in the file until needed: any access to it loads it first.
 */
 
 class BlowFish;
@@ -41,6 +49,9 @@ public:
   // The maximum supported attachment size
   // according to section 3.4 of formatV4 specification.
   const static size_t MAX_SIZE = 4294967295U; // 2^32
+  // Size of the pieces content is kept, read and written in.
+  // A multiple of the block sizes of BlowFish and TwoFish.
+  const static size_t CONTENT_CHUNK = 64 * 1024;
 
   // a bitset for indicating a subset of an item's fields: 
   typedef std::bitset<LAST_SEARCHABLE - START + 1> AttFieldBits;
@@ -48,16 +59,20 @@ public:
   //Construction
   CItemAtt();
   CItemAtt(const CItemAtt& stuffhere);
+  CItemAtt(CItemAtt &&that) noexcept;
 
   ~CItemAtt();
 
+  void Clear() override;
+  void SetKeyring(const std::shared_ptr<const CItemKeyring> &keyring) override;
+
   int Read(PWSfile *in);
   int Write(PWSfile *out) const;
 
   int Import(const stringT &fname);
   int Export(const stringT &fname) const;
 
-  bool HasContent() const {return IsFieldSet(CONTENT);}
+  bool HasContent() const {return m_contentLength != 0;}
 
   // Convenience: Get the name associated with FieldType
   static stringT FieldName(FieldType ft);
@@ -70,6 +85,8 @@ public:
   void SetTitle(const StringX &title);
   void SetCTime(time_t t);
   void SetContent(const unsigned char *content, size_t clen);
+  void AppendContent(const unsigned char *content, size_t clen);
+  void ClearContent();
 
   StringX GetTitle() const {return GetField(ATTTITLE);}
   void GetUUID(uuid_array_t &) const;
@@ -77,9 +94,16 @@ public:
   StringX GetFileName() const {return GetField(FILENAME);}    // set via Import()
   StringX GetFilePath() const { return GetField(FILEPATH); }  // set via Import()
   StringX GetMediaType() const {return GetField(MEDIATYPE);}  // set via Import()
-  size_t GetContentLength() const; // Number of bytes stored
+  size_t GetContentLength() const {return m_contentLength;} // Number of bytes stored
   size_t GetContentSize() const; // size needed for GetContent (!= len due to block cipher)
   bool GetContent(unsigned char *content, size_t csize) const;
+  // Copies up to n bytes of content from offset on, returns number copied
+  size_t ReadContent(size_t offset, unsigned char *buf, size_t n) const;
+  // Loads (decrypts and verifies) content read lazily, if not done yet.
+  // Fails, leaving it unloaded, if the content's no longer in the file as
+  // it was read (rewritten since, say); the accessors above then find none.
+  bool LoadContent() const;
+  bool IsContentLoaded() const {return m_source == nullptr;}
 
   StringX GetCTime() const { return GetTime(ATTCTIME, PWSUtil::TMC_LOCALE); }
 
@@ -119,6 +143,7 @@ public:
   void DecRefcount() {ASSERT(m_refcount > 0); m_refcount--;}
 
   CItemAtt& operator=(const CItemAtt& second);
+  CItemAtt& operator=(CItemAtt &&that) noexcept;
 
   bool operator==(const CItemAtt &that) const;
   bool operator!=(const CItemAtt &that) const {return !operator==(that);}
@@ -140,6 +165,13 @@ private:
   bool SetField(unsigned char type, const unsigned char *data, size_t len);
   size_t WriteIfSet(FieldType ft, PWSfile *out, bool isUTF8) const;
 
+  // Where lazily read content is, until loaded
+  struct ContentSource;
+
+  // Both mutable for LoadContent(), as CItem::m_blowfish is for MakeBlowFish()
+  mutable std::vector<CItemField> m_content; // CONTENT, in CONTENT_CHUNK pieces
+  mutable std::unique_ptr<ContentSource> m_source;
+  size_t m_contentLength;
   EntryStatus m_entrystatus;
   long m_offset; // location on file, for lazy evaluation
   unsigned m_refcount; // how many CItemData objects refer to this?
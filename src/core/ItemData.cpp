@@ -76,6 +76,11 @@ CItemData::CItemData(const CItemData &that) :
 {
 }
 
+CItemData::CItemData(CItemData &&that) noexcept :
+  CItem(std::move(that)), m_entrytype(that.m_entrytype), m_entrystatus(that.m_entrystatus)
+{
+}
+
 CItemData::~CItemData()
 {
 }
@@ -90,6 +95,16 @@ CItemData& CItemData::operator=(const CItemData &that)
   return *this;
 }
 
+CItemData& CItemData::operator=(CItemData &&that) noexcept
+{
+  if (this != &that) {
+    CItem::operator=(std::move(that));
+    m_entrytype = that.m_entrytype;
+    m_entrystatus = that.m_entrystatus;
+  }
+  return *this;
+}
+
 void CItemData::Clear()
 {
   CItem::Clear();
@@ -175,6 +190,13 @@ void CItemData::SetSpecialPasswords()
 }
 
 int CItemData::Read(PWSfile *in)
+{
+  return Read([in](unsigned char &type, const unsigned char* &data, size_t &length) {
+      return in->ReadFieldInPlace(type, data, length);
+    });
+}
+
+int CItemData::Read(const FieldReader &next)
 {
   int status = PWSfile::SUCCESS;
 
@@ -186,10 +208,9 @@ int CItemData::Read(PWSfile *in)
 
   Clear();
   do {
-    unsigned char *utf8 = nullptr;
+    const unsigned char *utf8 = nullptr; // owned & wiped by the reader
     size_t utf8Len = 0;
-    fieldLen = static_cast<signed long>(in->ReadField(type, utf8,
-                                                      utf8Len));
+    fieldLen = static_cast<signed long>(next(type, utf8, utf8Len));
 
     if (fieldLen > 0) {
       numread += fieldLen;
@@ -200,20 +221,11 @@ int CItemData::Read(PWSfile *in)
         }
       } else if (IsItemAttField(type)) {
         // Allow rewind and retry
-        if (utf8 != nullptr) {
-          trashMemory(utf8, utf8Len * sizeof(utf8[0]));
-          delete[] utf8;
-        }
         return static_cast<int>(-numread);
       } else if (type != END) { // unknown field
         SetUnknownField(type, utf8Len, utf8);
       }
     } // if (fieldLen > 0)
-
-    if (utf8 != nullptr) {
-      trashMemory(utf8, utf8Len * sizeof(utf8[0]));
-      delete[] utf8; utf8 = nullptr; utf8Len = 0;
-    }
   } while (type != END && fieldLen > 0 && --emergencyExit > 0);
 
   if (numread > 0) {
@@ -458,7 +470,7 @@ StringX CItemData::GetFieldValue(FieldType ft) const
     {
       uuid_array_t uuid_array = {0};
       GetUUID(uuid_array);
-      str = CUUID(uuid_array, true);
+      str = CUUID(uuid_array);
       break;
     }
     case NOTES:        /* 0x05 */
@@ -508,7 +520,7 @@ StringX CItemData::GetFieldValue(FieldType ft) const
     {
       uuid_array_t uuid_array = { 0 };
       GetUUID(uuid_array, ft);
-      str = CUUID(uuid_array, true);
+      str = CUUID(uuid_array);
       break;
     }
     case TOTPCONFIG:
@@ -1423,7 +1435,9 @@ void CItemData::SetNotes(const StringX &notes, TCHAR delimiter)
 
 void CItemData::SetUUID(const CUUID &uuid, FieldType ft)
 {
-  CItem::SetField(ft, static_cast<const unsigned char *>(*uuid.GetARep()), sizeof(uuid_array_t));
+  uuid_array_t uuid_array;
+  uuid.GetARep(uuid_array);
+  CItem::SetField(ft, uuid_array, sizeof(uuid_array_t));
 }
 
 void CItemData::SetTime(int whichtime)
@@ -22,6 +22,7 @@
 
 #include <time.h> // for time_t
 #include <bitset>
+#include <functional>
 #include <vector>
 #include <string>
 #include <map>
@@ -72,10 +73,15 @@ public:
   //Construction
   CItemData();
   CItemData(const CItemData& stuffhere);
+  CItemData(CItemData &&that) noexcept;
 
   ~CItemData();
 
   int Read(PWSfile *in);
+  // As above, with fields from next(), which acts as PWSfile::ReadFieldInPlace()
+  typedef std::function<size_t(unsigned char &type, const unsigned char* &data,
+                               size_t &length)> FieldReader;
+  int Read(const FieldReader &next);
   int Write(PWSfile *out) const;
   int Write(PWSfileV4 *out) const;
   int WriteCommon(PWSfile *out) const;
@@ -255,6 +261,7 @@ public:
   void SetFieldValue(FieldType ft, const StringX &value);
 
   CItemData& operator=(const CItemData& second);
+  CItemData& operator=(CItemData &&that) noexcept;
 
   void Clear() override;
 
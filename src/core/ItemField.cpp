@@ -11,6 +11,8 @@
 
 #include "ItemField.h"
 #include "Util.h"
+#include "ItemKeyring.h"
+#include "SecureArena.h"
 #include "crypto/Fish.h"
 #include "PWSrand.h"
 #include "os/funcwrap.h"
@@ -21,42 +23,76 @@ size_t CItemField::GetBlockSize(size_t size) const
   return  ((size / 8) + ((size % 8 != 0) ? 1 : 0)) * 8;
 }
 
+SecureArena &CItemField::Arena()
+{
+  // Deliberately never deleted: static CItemFields may outlive any
+  // static object here. Freed blocks are wiped regardless.
+  static SecureArena *arena = new SecureArena;
+  return *arena;
+}
+
+void CItemField::AllocData()
+{
+  m_Data = (m_Length > 0) ?
+    static_cast<unsigned char *>(Arena().Allocate(GetBlockSize(m_Length))) : nullptr;
+}
+
+void CItemField::FreeData()
+{
+  // m_Length must still be what it was when m_Data was allocated
+  if (m_Data != nullptr)
+    Arena().Deallocate(m_Data, GetBlockSize(m_Length));
+  m_Data = nullptr;
+}
+
 CItemField::CItemField(const CItemField &that)
-  : m_Type(that.m_Type), m_Length(that.m_Length)
+  : m_Type(that.m_Type), m_Length(that.m_Length), m_Nonce(that.m_Nonce)
 {
-  if (m_Length > 0) {
-    size_t bs = GetBlockSize(m_Length);
-    m_Data = new unsigned char[bs];
-    memcpy(m_Data, that.m_Data, bs);
-  } else {
-    m_Data = nullptr;
-  }
+  AllocData();
+  if (m_Length > 0)
+    memcpy(m_Data, that.m_Data, GetBlockSize(m_Length));
 }
 
 CItemField &CItemField::operator=(const CItemField &that)
 {
   if (this != &that) {
+    FreeData();
     m_Type = that.m_Type;
     m_Length = that.m_Length;
-    delete[] m_Data;
-    if (m_Length > 0) {
-      size_t bs = GetBlockSize(m_Length);
-      m_Data = new unsigned char[bs];
-      memcpy(m_Data, that.m_Data, bs);
-    } else {
-      m_Data = nullptr;
-    }
+    m_Nonce = that.m_Nonce;
+    AllocData();
+    if (m_Length > 0)
+      memcpy(m_Data, that.m_Data, GetBlockSize(m_Length));
   }
   return *this;
 }
 
-void CItemField::Empty()
+CItemField::CItemField(CItemField &&that) noexcept
+  : m_Type(that.m_Type), m_Length(that.m_Length), m_Data(that.m_Data),
+    m_Nonce(that.m_Nonce)
+{
+  that.m_Length = 0;
+  that.m_Data = nullptr;
+}
+
+CItemField &CItemField::operator=(CItemField &&that) noexcept
 {
-  if (m_Data != nullptr) {
-    delete[] m_Data;
-    m_Data = nullptr;
-    m_Length = 0;
+  if (this != &that) {
+    FreeData();
+    m_Type = that.m_Type;
+    m_Length = that.m_Length;
+    m_Data = that.m_Data;
+    m_Nonce = that.m_Nonce;
+    that.m_Length = 0;
+    that.m_Data = nullptr;
   }
+  return *this;
+}
+
+void CItemField::Empty()
+{
+  FreeData();
+  m_Length = 0;
 }
 
 void CItemField::Set(const unsigned char* value, size_t length,
@@ -64,33 +100,30 @@ void CItemField::Set(const unsigned char* value, size_t length,
 {
   size_t BlockLength;
 
+  FreeData();
   m_Length = length;
   BlockLength = GetBlockSize(m_Length);
 
-  delete[] m_Data;
-
-  if (m_Length == 0) {
-    m_Data = nullptr;
-  } else {
-    m_Data = new unsigned char[BlockLength];
+  if (m_Length > 0) {
+    AllocData();
     if (m_Data == nullptr) { // out of memory - try to fail gracefully
       m_Length = 0; // at least keep structure consistent
       return;
     }
 
-    auto *tempmem = new unsigned char[BlockLength];
-    // invariant: BlockLength >= plainlength
-    memcpy_s(tempmem, BlockLength, value, m_Length);
-
-    //Fill the unused characters in with random stuff
-    PWSrand::GetInstance()->GetRandomData(tempmem + m_Length, static_cast<unsigned long>(BlockLength - m_Length));
-
-    //Do the actual encryption
-    for (size_t x = 0; x < BlockLength; x += 8)
-      bf->Encrypt(tempmem + x, m_Data + x);
-
-    trashMemory(tempmem, BlockLength);
-    delete[] tempmem;
+    // Encrypt whole blocks straight from value; only the last,
+    // partial, block needs a copy to fill with random stuff
+    const size_t WholeLength = m_Length - m_Length % 8;
+    bf->EncryptBlocks(value, m_Data, WholeLength / 8);
+
+    if (WholeLength < BlockLength) {
+      unsigned char last[8];
+      memcpy(last, value + WholeLength, m_Length - WholeLength);
+      PWSrand::GetInstance()->GetRandomData(last + (m_Length - WholeLength),
+                                            static_cast<unsigned long>(BlockLength - m_Length));
+      bf->Encrypt(last, m_Data + WholeLength);
+      trashMemory(last, sizeof(last));
+    }
   }
   if (type != 0xff)
     m_Type = type;
@@ -121,17 +154,13 @@ void CItemField::Get(unsigned char *value, size_t &length, const Fish *bf) const
   } else { // we have data to decrypt
     size_t BlockLength = GetBlockSize(m_Length);
     ASSERT(length >= BlockLength);
-    auto *tempmem = new unsigned char[BlockLength];
 
-    size_t x;
-    for (x = 0; x < BlockLength; x += 8)
-      bf->Decrypt(m_Data + x, tempmem + x);
+    // value has room for whole blocks, so decrypt straight into it
+    bf->DecryptBlocks(m_Data, value, BlockLength / 8);
 
-    for (x = 0; x < BlockLength; x++)
-      value[x] = (x < m_Length) ? tempmem[x] : 0;
+    memset(value + m_Length, 0, BlockLength - m_Length);
 
     length = m_Length;
-    delete [] tempmem;
   }
 }
 
@@ -143,21 +172,84 @@ void CItemField::Get(StringX &value, const Fish *bf) const
 
   if (m_Length == 0) {
     value = _T("");
+  } else { // we have data to decrypt
+    // decrypt directly into the (secure) string's buffer, with room
+    // for the last block's padding, which is then cut off
+    const size_t offset = value.length();
+    const size_t BlockLength = GetBlockSize(m_Length);
+    value.resize(offset + BlockLength / sizeof(TCHAR));
+    bf->DecryptBlocks(m_Data, reinterpret_cast<unsigned char *>(&value[offset]), BlockLength / 8);
+    value.resize(offset + m_Length / sizeof(TCHAR));
+  }
+}
+
+void CItemField::Set(const unsigned char* value, size_t length,
+                     const CItemKeyring *kr, unsigned char type)
+{
+  size_t BlockLength;
+
+  FreeData();
+  m_Length = length;
+  BlockLength = GetBlockSize(m_Length);
+
+  if (m_Length > 0) {
+    AllocData();
+    if (m_Data == nullptr) { // out of memory - try to fail gracefully
+      m_Length = 0; // at least keep structure consistent
+      return;
+    }
+
+    // Counter mode encrypts in place, so no plaintext copy's needed.
+    // Padding's kept (and randomized) so that the stored size is the
+    // same as with the Fish variant.
+    m_Nonce = kr->NewNonce();
+    kr->Apply(m_Nonce, value, m_Data, m_Length);
+    PWSrand::GetInstance()->GetRandomData(m_Data + m_Length, static_cast<unsigned long>(BlockLength - m_Length));
+  }
+  if (type != 0xff)
+    m_Type = type;
+}
+
+void CItemField::Set(const StringX &value, const CItemKeyring *kr, unsigned char type)
+{
+  const LPCTSTR plainstr = value.c_str();
+
+  Set(reinterpret_cast<const unsigned char *>(plainstr),
+      value.length() * sizeof(*plainstr), kr, type);
+}
+
+void CItemField::Get(unsigned char *value, size_t &length, const CItemKeyring *kr) const
+{
+  // Sanity check: length is 0 iff data ptr is nullptr
+  ASSERT((m_Length == 0 && m_Data == nullptr) ||
+         (m_Length > 0 && m_Data != nullptr));
+  // length is an in/out parameter, as in the Fish variant above
+  if (m_Length == 0) {
+    value[0] = TCHAR('\0');
+    length = 0;
   } else { // we have data to decrypt
     size_t BlockLength = GetBlockSize(m_Length);
-    auto *tempmem = new unsigned char[BlockLength];
-    TCHAR *pt = reinterpret_cast<TCHAR *>(tempmem);
-    size_t x;
+    ASSERT(length >= BlockLength);
 
-    // decrypt block by block
-    for (x = 0; x < BlockLength; x += 8)
-      bf->Decrypt(m_Data + x, tempmem + x);
+    kr->Apply(m_Nonce, m_Data, value, m_Length);
+    memset(value + m_Length, 0, BlockLength - m_Length);
 
-    // copy to value TCHAR by TCHAR
-    for (x = 0; x < m_Length/sizeof(TCHAR); x++)
-      value += pt[x];
+    length = m_Length;
+  }
+}
 
-    trashMemory(tempmem, BlockLength);
-    delete [] tempmem;
+void CItemField::Get(StringX &value, const CItemKeyring *kr) const
+{
+  // Sanity check: length is 0 iff data ptr is nullptr
+  ASSERT((m_Length == 0 && m_Data == nullptr) ||
+         (m_Length > 0 && m_Data != nullptr && m_Length % sizeof(TCHAR) == 0));
+
+  if (m_Length == 0) {
+    value = _T("");
+  } else { // we have data to decrypt
+    // decrypt directly into the (secure) string's buffer
+    const size_t offset = value.length();
+    value.resize(offset + m_Length / sizeof(TCHAR));
+    kr->Apply(m_Nonce, m_Data, reinterpret_cast<unsigned char *>(&value[offset]), m_Length);
   }
 }
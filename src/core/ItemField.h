@@ -19,25 +19,44 @@
 * CItemField contains the data for a given CItemData field in encrypted
 * form.
 * Set() encrypts, Get() decrypts
+*
+* A field is encrypted either with a Fish (ECB, one per CItem), or with a
+* CItemKeyring shared by many items (counter mode, with a per-field nonce).
+* It's up to the owner to Get() with the same kind of object used to Set().
+*
+* The encrypted data of all fields lives in a shared SecureArena, so that
+* loading or copying many entries doesn't mean many small heap allocations.
 */
 
 class Fish;
+class CItemKeyring;
+class SecureArena;
 
 class CItemField
 {
 public:
-  explicit CItemField(unsigned char type = 0xff): m_Type(type), m_Length(0), m_Data(nullptr)
+  explicit CItemField(unsigned char type = 0xff): m_Type(type), m_Length(0), m_Data(nullptr),
+    m_Nonce(0)
   {}
   CItemField(const CItemField &that); // copy ctor
-  ~CItemField() {if (m_Length > 0) delete[] m_Data;}
+  CItemField(CItemField &&that) noexcept; // move ctor
+  ~CItemField() {FreeData();}
 
   CItemField &operator=(const CItemField &that);
+  CItemField &operator=(CItemField &&that) noexcept;
 
   void Set(const StringX &value, const Fish *bf, unsigned char type = 0xff);
   void Set(const unsigned char* value, size_t length, const Fish *bf, unsigned char type = 0xff);
 
   void Get(StringX &value, const Fish *bf) const;
   void Get(unsigned char *value, size_t &length, const Fish *bf) const;
+
+  void Set(const StringX &value, const CItemKeyring *kr, unsigned char type = 0xff);
+  void Set(const unsigned char* value, size_t length, const CItemKeyring *kr,
+           unsigned char type = 0xff);
+
+  void Get(StringX &value, const CItemKeyring *kr) const;
+  void Get(unsigned char *value, size_t &length, const CItemKeyring *kr) const;
   unsigned char GetType() const {return m_Type;}
   size_t GetLength() const {return m_Length;}
   size_t GetSize() const {return GetBlockSize(m_Length);}
@@ -48,9 +67,15 @@ private:
   //Number of 8 byte blocks needed for size
   size_t GetBlockSize(size_t size) const;
 
+  // m_Data is allocated from/returned to here
+  static SecureArena &Arena();
+  void AllocData(); // for m_Length bytes, rounded up to block size
+  void FreeData();
+
   unsigned char m_Type; // almost const
   size_t m_Length;
   unsigned char *m_Data;
+  uint64 m_Nonce; // only used when encrypted by a CItemKeyring
 };
 
 #endif /* __ITEMFIELD_H */
@@ -0,0 +1,100 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// ItemFieldMap.h
+//-----------------------------------------------------------------------------
+
+#ifndef __ITEMFIELDMAP_H
+#define __ITEMFIELDMAP_H
+
+#include "ItemField.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+
+/**
+ * CItemFieldMap maps field types to CItemFields, with the subset of the
+ * std::map interface that CItem and its subclasses use.
+ *
+ * An item has at most a few dozen fields, so they're kept in a vector
+ * sorted by type: lookups are a binary search over contiguous memory,
+ * and there's one allocation per item rather than one per field.
+ *
+ * Unlike std::map, inserting or erasing invalidates iterators.
+ */
+
+class CItemFieldMap
+{
+public:
+  typedef std::pair<int, CItemField> value_type;
+  typedef std::vector<value_type>::iterator iterator;
+  typedef std::vector<value_type>::const_iterator const_iterator;
+
+  iterator begin() {return m_fields.begin();}
+  iterator end() {return m_fields.end();}
+  const_iterator begin() const {return m_fields.begin();}
+  const_iterator end() const {return m_fields.end();}
+
+  size_t size() const {return m_fields.size();}
+  bool empty() const {return m_fields.empty();}
+  void clear() {m_fields.clear();}
+
+  iterator find(int ft)
+  {
+    auto iter = lower_bound(ft);
+    return (iter != m_fields.end() && iter->first == ft) ? iter : m_fields.end();
+  }
+
+  const_iterator find(int ft) const
+  {
+    auto iter = lower_bound(ft);
+    return (iter != m_fields.end() && iter->first == ft) ? iter : m_fields.end();
+  }
+
+  // Inserts an empty field if ft's not there yet
+  CItemField &operator[](int ft)
+  {
+    if (m_fields.empty())
+      m_fields.reserve(InitialCapacity);
+    auto iter = lower_bound(ft);
+    if (iter == m_fields.end() || iter->first != ft)
+      iter = m_fields.insert(iter, value_type(ft, CItemField()));
+    return iter->second;
+  }
+
+  size_t erase(int ft)
+  {
+    auto iter = find(ft);
+    if (iter == m_fields.end())
+      return 0;
+    m_fields.erase(iter);
+    return 1;
+  }
+
+private:
+  // Enough for a typical entry, so that filling one (e.g., on read)
+  // allocates once rather than at every doubling
+  enum {InitialCapacity = 12};
+
+  static bool Less(const value_type &v, int ft) {return v.first < ft;}
+
+  iterator lower_bound(int ft)
+  {return std::lower_bound(m_fields.begin(), m_fields.end(), ft, Less);}
+  const_iterator lower_bound(int ft) const
+  {return std::lower_bound(m_fields.begin(), m_fields.end(), ft, Less);}
+
+  std::vector<value_type> m_fields;
+};
+
+#endif /* __ITEMFIELDMAP_H */
+//-----------------------------------------------------------------------------
+// Local variables:
+// mode: c++
+// End:
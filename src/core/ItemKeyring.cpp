@@ -0,0 +1,62 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+/// \file ItemKeyring.cpp
+//-----------------------------------------------------------------------------
+
+#include "ItemKeyring.h"
+#include "PWSrand.h"
+#include "Util.h"
+#include "crypto/TwoFish.h"
+#include "os/mem.h"
+
+CItemKeyring::CItemKeyring() : m_fish(nullptr), m_nonce(0)
+{
+  unsigned char key[32];
+  pws_os::mlock(key, sizeof(key));
+  PWSrand::GetInstance()->GetRandomData(key, sizeof(key));
+  m_fish = new TwoFish(key, sizeof(key));
+  pws_os::mlock(m_fish, sizeof(TwoFish));
+  trashMemory(key, sizeof(key));
+  pws_os::munlock(key, sizeof(key));
+
+  // Start the counter at a random point, so that nonces aren't
+  // predictable from the number of fields set so far
+  uint64 start;
+  PWSrand::GetInstance()->GetRandomData(&start, sizeof(start));
+  m_nonce = start;
+}
+
+CItemKeyring::~CItemKeyring()
+{
+  pws_os::munlock(m_fish, sizeof(TwoFish));
+  delete m_fish; // TwoFish d'tor trashes the key schedule
+}
+
+void CItemKeyring::Apply(uint64 nonce, const unsigned char *in,
+                         unsigned char *out, size_t length) const
+{
+  const unsigned int BS = TwoFish::BLOCKSIZE;
+  // Counter blocks are nonce (8 bytes) followed by block number (8 bytes),
+  // encrypted a run at a time for the keystream
+  unsigned char keystream[16 * BS];
+
+  uint64 block = 0;
+  for (size_t offset = 0; offset < length; offset += sizeof(keystream)) {
+    const size_t n = (length - offset < sizeof(keystream)) ? length - offset : sizeof(keystream);
+    const size_t nblocks = (n + BS - 1) / BS;
+    for (size_t b = 0; b < nblocks; b++, block++) {
+      putInt64(keystream + b * BS, static_cast<int64>(nonce));
+      putInt64(keystream + b * BS + 8, static_cast<int64>(block));
+    }
+    m_fish->EncryptBlocks(keystream, keystream, nblocks);
+    for (size_t i = 0; i < n; i++)
+      out[offset + i] = in[offset + i] ^ keystream[i];
+  }
+  // Only the first run can have used all of it
+  trashMemory(keystream, (length < sizeof(keystream)) ? ((length + BS - 1) / BS) * BS : sizeof(keystream));
+}
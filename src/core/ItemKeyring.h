@@ -0,0 +1,63 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// ItemKeyring.h
+//-----------------------------------------------------------------------------
+
+#ifndef __ITEMKEYRING_H
+#define __ITEMKEYRING_H
+
+#include "os/typedefs.h"
+
+#include <atomic>
+
+//-----------------------------------------------------------------------------
+
+/**
+ * CItemKeyring holds a random session key that's shared by all the
+ * items of a database, as an alternative to each CItem having its own
+ * BlowFish key schedule.
+ *
+ * Fields are encrypted in counter mode, with a nonce that's unique
+ * per CItemField::Set(). This keeps identical values in different
+ * fields (or entries) from having identical ciphertext, even though
+ * the key is shared. Only the key schedule is kept, in locked memory;
+ * the key itself is discarded once the schedule has been set up.
+ *
+ * A CItemKeyring is immutable once constructed (the nonce counter aside),
+ * so it may be shared freely between items and threads.
+ */
+
+class TwoFish;
+
+class CItemKeyring
+{
+public:
+  CItemKeyring();
+  ~CItemKeyring();
+  CItemKeyring(const CItemKeyring &) = delete;
+  CItemKeyring &operator=(const CItemKeyring &) = delete;
+
+  // Returns a nonce that has not been returned before by this keyring
+  uint64 NewNonce() const {return m_nonce++;}
+
+  // XORs length bytes of in with the keystream for nonce into out.
+  // Since this is counter mode, the same call encrypts and decrypts.
+  // in and out may be the same buffer.
+  void Apply(uint64 nonce, const unsigned char *in, unsigned char *out,
+             size_t length) const;
+
+private:
+  TwoFish *m_fish;
+  mutable std::atomic<uint64> m_nonce;
+};
+
+#endif /* __ITEMKEYRING_H */
+//-----------------------------------------------------------------------------
+// Local variables:
+// mode: c++
+// End:
@@ -40,6 +40,7 @@ void PWSLog::Add(const stringT &sLogRecord)
   PWSUtil::GetTimeStamp(sTimeStamp);
 
   // m_log preloaded, so pop_front is always valid (see GetLog).
+  std::lock_guard<std::mutex> guard(m_mutex);
   m_log.pop_front();
   m_log.push_back(sTimeStamp + sb + sLogRecord);
 }
@@ -47,6 +48,7 @@ void PWSLog::Add(const stringT &sLogRecord)
 stringT PWSLog::DumpLog() const
 {
   const TCHAR *sHeader = _T("US04 ");
+  std::lock_guard<std::mutex> guard(m_mutex);
   ostringstreamT stLog;
 
   // Start with header for Userstream
@@ -13,6 +13,7 @@
 #include "os/logit.h"
 
 #include <deque>
+#include <mutex>
 
 #define PWS_LOGIT_CONCAT(str) PWS_LOGIT_HEADER L ## str
 
@@ -39,6 +40,7 @@ private:
   PWSLog() {}
   static PWSLog *self;
   std::deque<stringT> m_log;
+  mutable std::mutex m_mutex; // files may be written off the main thread
 };
 
 #endif /* _PWSLOG_H */
@@ -10,11 +10,16 @@
 
 #include "PWScore.h"
 #include "core.h"
+#include "ItemKeyring.h"
 #include "crypto/TwoFish.h"
+#include "PWSfileV1V2.h"
+#include "PWSfileV3.h"
+#include "PWSfileV4.h"
 #include "PWSprefs.h"
 #include "PWHistory.h"
 #include "PWSLog.h"
 #include "PWSrand.h"
+#include "ReadPipeline.h"
 #include "Util.h"
 #include "SysInfo.h"
 #include "UTF8Conv.h"
@@ -40,6 +45,7 @@
 #include <set>
 #include <iterator>
 #include <map>
+#include <thread>
 
 const TCHAR *PWScore::GROUPTITLEUSERINCHEVRONS = _T("\xab%ls\xbb \xab%ls\xbb \xab%ls\xbb");
 
@@ -162,6 +168,95 @@ struct st_ValidateResults {
   }
 };
 
+// A WriteFileAsync() in progress: what's to be written, as of when it
+// was asked for, and the worker thread writing it
+struct PWScore::AsyncSave {
+  StringX filename, tempname;
+  stringT target; // filename, or what it links to
+  PWSfile::VERSION version;
+  StringX passkey;
+  uint32 nHashIters;
+  PWSfileHeader hdr; // updated as written
+  UnknownFieldList UHFL;
+  PWSFilters filters;
+  PSWDPolicyMap policies;
+  std::vector<StringX> emptyGroups;
+  // Copies of ciphertext (and shared keys), so taking them is a
+  // pass over memory that decrypts nothing
+  std::vector<CItemData> entries;
+  std::vector<CItemAtt> atts;
+
+  bool bJournal; // so this is the next checkpoint
+  std::unordered_set<CUUID> journalUUIDs; // to journal if this fails
+  bool bJournalKey = false;
+  unsigned char journalKey[SHA256::HASHLEN]; // PWSfileV3::GetJournalKey()
+  unsigned nModifications; // PWScore's, at the snapshot
+  std::vector<Observer *> observers;
+
+  std::thread worker;
+  int status;
+
+  ~AsyncSave() {trashMemory(journalKey, sizeof(journalKey));}
+
+  void Run()
+  {
+    status = Write();
+    for (auto &observer : observers)
+      observer->AsyncSaveFinished();
+  }
+
+  int Write()
+  {
+    int rc;
+    std::unique_ptr<PWSfile> out(PWSfile::MakePWSfile(tempname, passkey, version,
+                                                      PWSfile::Write, rc));
+    if (rc != PWSfile::SUCCESS)
+      return rc;
+
+    out->SetHeader(hdr);
+    out->SetUnknownHeaderFields(UHFL);
+    out->SetNHashIters(nHashIters);
+    out->SetDBFilters(filters);
+    out->SetPasswordPolicies(policies);
+    out->SetEmptyGroups(emptyGroups);
+    out->SetSyncOnClose(true);
+
+    try { // exception thrown on write error
+      rc = out->Open(passkey);
+      if (rc == PWSfile::SUCCESS) {
+        // Entries read together share a key, which moving them through
+        // one CItemData keeps from being scheduled for each
+        CItemData ci;
+        for (auto &entry : entries) {
+          ci = std::move(entry);
+          out->WriteRecord(ci);
+        }
+        for (auto &att : atts)
+          att.Write(out.get());
+        hdr = out->GetHeader();
+        auto *out3 = dynamic_cast<PWSfileV3 *>(out.get());
+        if (out3 != nullptr) {
+          out3->GetJournalKey(journalKey);
+          bJournalKey = true;
+        }
+        rc = out->Close();
+      }
+    }
+    catch (...) {
+      out->Close();
+      rc = PWSfile::FAILURE;
+    }
+    out.reset();
+
+    // Until it's replaced, filename is as it was
+    if (rc == PWSfile::SUCCESS && !pws_os::ReplaceAFile(tempname.c_str(), target))
+      rc = PWSfile::WRITE_FAIL;
+    if (rc != PWSfile::SUCCESS)
+      pws_os::DeleteAFile(tempname.c_str());
+    return rc;
+  }
+};
+
 //-----------------------------------------------------------------
 
 PWScore::PWScore() :
@@ -173,6 +268,10 @@ PWScore::PWScore() :
                      m_lockFileHandle2(INVALID_HANDLE_VALUE),
                      m_ReadFileVersion(PWSfile::UNKNOWN_VERSION),
                      m_bIsReadOnly(false),
+                     m_readWorkers(ReadPipeline::DefaultWorkers()),
+                     m_bReadSmallFiles(false),
+                     m_bJournalCheckpoint(false),
+                     m_bAsyncSaveQueued(false), m_nModifications(0),
                      m_bNotifyDB(false),
                      m_bIsOpen(false),
                      m_nRecordsWithUnknownFields(0),
@@ -195,6 +294,8 @@ PWScore::PWScore() :
 
 PWScore::~PWScore()
 {
+  CompleteAsyncSave(false);
+
   // do NOT trash m_session_*, as there may be other cores around
   // relying on it. Trashing the ciphertext encrypted with it is enough
   const unsigned int BS = TwoFish::BLOCKSIZE;
@@ -294,7 +395,10 @@ void PWScore::DoAddEntry(const CItemData &item, const CItemAtt *att)
 {
   // Also "UndoDeleteEntry" !
   ASSERT(m_pwlist.find(item.GetUUID()) == m_pwlist.end());
-  m_pwlist[item.GetUUID()] = item;
+  CItemData &ci = m_pwlist.emplace(item.GetUUID(), item).first->second;
+  ci.SetKeyring(m_keyring);
+  IndexEntry(item);
+  AddChangedEntry(item.GetUUID());
 
   if (item.NumberUnknownFields() > 0)
     IncrementNumRecordsWithUnknownFields();
@@ -304,10 +408,13 @@ void PWScore::DoAddEntry(const CItemData &item, const CItemAtt *att)
   }
 
   if (att != nullptr && att->HasContent()) {
-    m_pwlist[item.GetUUID()].SetAttUUID(att->GetUUID());
-    if (m_attlist.find(att->GetUUID()) == m_attlist.end())
-      m_attlist.insert(std::make_pair(att->GetUUID(), *att));
-    m_attlist[att->GetUUID()].IncRefcount();
+    ci.SetAttUUID(att->GetUUID());
+    auto pos = m_attlist.find(att->GetUUID());
+    if (pos == m_attlist.end()) {
+      pos = m_attlist.emplace(att->GetUUID(), *att).first;
+      pos->second.SetKeyring(m_keyring);
+    }
+    pos->second.IncRefcount();
   }
   else if(item.HasAttRef()) { // In case of duplicate or drag and drop
     const pws_os::CUUID uuid = item.GetAttUUID();
@@ -391,6 +498,8 @@ void PWScore::DoDeleteEntry(const CItemData &item)
   CUUID entry_uuid = item.GetUUID();
   auto pos = m_pwlist.find(entry_uuid);
   if (pos != m_pwlist.end()) {
+    AddChangedEntry(entry_uuid);
+
     // Simple cases first: Aliases or shortcuts, update maps
     // and refresh base's display, if changed
     if (item.IsDependent()) {
@@ -419,6 +528,7 @@ void PWScore::DoDeleteEntry(const CItemData &item)
     if (iKBShortcut != 0)
       VERIFY(DelKBShortcut(iKBShortcut, item.GetUUID()));
 
+    UnindexEntry(pos->second);
     m_pwlist.erase(pos); // at last!
 
     if (item.NumberUnknownFields() > 0)
@@ -442,7 +552,15 @@ void PWScore::DoReplaceEntry(const CItemData &old_ci, const CItemData &new_ci)
 {
   // Assumes that old_uuid == new_uuid
   ASSERT(old_ci.GetUUID() == new_ci.GetUUID());
-  m_pwlist[old_ci.GetUUID()] = new_ci;
+  auto pos = m_pwlist.find(old_ci.GetUUID());
+  if (pos != m_pwlist.end()) {
+    UnindexEntry(pos->second);
+    pos->second = new_ci;
+  } else
+    pos = m_pwlist.emplace(new_ci.GetUUID(), new_ci).first;
+  pos->second.SetKeyring(m_keyring);
+  IndexEntry(new_ci);
+  AddChangedEntry(new_ci.GetUUID());
   if (old_ci.GetEntryType() != new_ci.GetEntryType() || old_ci.GetStatus() != new_ci.GetStatus() ||
       old_ci.IsProtected() != new_ci.IsProtected())
     GUIRefreshEntry(new_ci);
@@ -503,10 +621,13 @@ void PWScore::DoReplaceAttachment(const CItemAtt &old_cia, const CItemAtt &new_c
   // Assumes that old_uuid == new_uuid
   ASSERT(old_cia.GetUUID() == new_cia.GetUUID());
   m_attlist[old_cia.GetUUID()] = new_cia;
+  m_attlist[old_cia.GetUUID()].SetKeyring(m_keyring);
 }
 
 void PWScore::ClearDBData()
 {
+  CompleteAsyncSave(false);
+
   const unsigned int BS = TwoFish::BLOCKSIZE;
   if (m_passkey_len > 0) {
     trashMemory(m_passkey, ((m_passkey_len + (BS - 1)) / BS) * BS);
@@ -519,6 +640,18 @@ void PWScore::ClearDBData()
   //Composed of ciphertext, so doesn't need to be overwritten
   m_pwlist.clear();
   m_attlist.clear();
+  m_GTUIndex.Clear();
+  m_GroupTree.Clear();
+  m_DisplayCache.Clear();
+  m_DisplayCache.Configure(PWSprefs::GetInstance()->GetPref(PWSprefs::DisplayCacheSize),
+                           PWSprefs::GetInstance()->GetPref(PWSprefs::DisplayCacheTTL));
+
+  // New database, new session key. Items still referencing the old
+  // keyring (e.g., in the undo/redo list) keep it alive as needed.
+  if (PWSprefs::GetInstance()->GetPref(PWSprefs::UseSessionKeyring))
+    m_keyring = std::make_shared<CItemKeyring>();
+  else
+    m_keyring.reset();
 
   // Clear out out dependents mappings
   m_base2aliases_mmap.clear();
@@ -556,6 +689,11 @@ void PWScore::ClearDBData()
   // Clear any unknown preferences from previous databases
   PWSprefs::GetInstance()->ClearUnknownPrefs();
 
+  // Forget the journal's keys and what was last saved
+  m_journal.reset();
+  m_journalUUIDs.clear();
+  m_bJournalCheckpoint = false;
+
   // OK now closed
   m_bIsOpen = false;
 }
@@ -622,6 +760,12 @@ int PWScore::WriteFile(const StringX &filename, PWSfile::VERSION version,
 {
   PWS_LOGIT_ARGS("bUpdateSig=%ls", bUpdateSig ? L"true" : L"false");
 
+  CompleteAsyncSave(false); // this save supersedes any queued one
+
+  std::set<CUUID> unloaded;
+  if (version >= PWSfile::V40)
+    unloaded = LoadAttachments();
+
   int status;
 
   PWSfile *out = PWSfile::MakePWSfile(filename, GetPassKey(), version,
@@ -632,6 +776,10 @@ int PWScore::WriteFile(const StringX &filename, PWSfile::VERSION version,
     return status;
   }
 
+  // For a journal of changes to the file written, see ResetJournal()
+  unsigned char journalKey[SHA256::HASHLEN];
+  bool bJournalKey = false;
+
   if (bUpdateSig) {
     // since we're writing a new file, the previous sig's
     // about to be invalidated but NOT if a user initiated Backup
@@ -666,6 +814,7 @@ int PWScore::WriteFile(const StringX &filename, PWSfile::VERSION version,
       return status;
     }
 
+    // In hash order: readers have never depended on the order of records
     RecordWriter write_record(out, this, version);
     for_each(m_pwlist.begin(), m_pwlist.end(), write_record);
 
@@ -674,13 +823,19 @@ int PWScore::WriteFile(const StringX &filename, PWSfile::VERSION version,
       for_each(m_attlist.begin(), m_attlist.end(),
                [&](std::pair<CUUID const, CItemAtt> &p)
                {
-                 p.second.Write(out);
+                 if (unloaded.find(p.first) == unloaded.end())
+                   p.second.Write(out);
                } );
 
     // Update header if V30 or later (no headers before V30)
     if (version >= PWSfile::V30) {
       m_hdr = out->GetHeader(); // update time saved, etc.
     }
+    auto *out3 = dynamic_cast<PWSfileV3 *>(out);
+    if (out3 != nullptr) {
+      out3->GetJournalKey(journalKey);
+      bJournalKey = true;
+    }
   }
 
   catch (...) {
@@ -712,40 +867,271 @@ int PWScore::WriteFile(const StringX &filename, PWSfile::VERSION version,
 
   // If not exporting, set to clean
   if (version == m_ReadFileVersion) {
-    // Set current state to CLEAN
-    m_DBCurrentState = CLEAN;
-
-    std::vector<DBStates>::iterator iter;
-
-    if (m_redo_DBState_iter != m_vDBState.end()) {
-      // Update command after of this one to be {before = CLEAN, after = DIRTY}
-      m_redo_DBState_iter->before = CLEAN;
-      m_redo_DBState_iter->after = DIRTY;
-
-      // Update all additional commands after of the next one to be
-      // {before = DIRTY, after = DIRTY}
-      iter = m_redo_DBState_iter + 1;
-      for (; iter != m_vDBState.end(); iter++) {
-        iter->before = DIRTY;
-        iter->after = DIRTY;
-      }
+    if (bUpdateSig && filename == m_currfile) {
+      ResetJournal(filename, bJournalKey ? journalKey : nullptr);
+      SetJournalCheckpoint();
     }
+    SetStateClean();
+  }
+  trashMemory(journalKey, sizeof(journalKey));
+  return SUCCESS;
+}
+
+int PWScore::WriteFileAsync(const StringX &filename, PWSfile::VERSION version)
+{
+  PWS_LOGIT;
+
+  if (version < PWSfile::V30 || GetPassKey().empty())
+    return FAILURE;
 
-    if (m_undo_DBState_iter != m_vDBState.end()) {
-      // Update command before this one to be {before = DIRTY, after = CLEAN}
-      m_undo_DBState_iter->before = DIRTY;
-      m_undo_DBState_iter->after = CLEAN;
-
-      // Update all additional commands before the previous one to be
-      // {before = DIRTY, after = DIRTY}
-      iter = m_undo_DBState_iter;
-      while (iter != m_vDBState.begin()) {
-        iter--;
-        iter->before = DIRTY;
-        iter->after = DIRTY;
+  if (m_asyncSave) { // this one will take whatever's changed meanwhile
+    m_bAsyncSaveQueued = true;
+    return SUCCESS;
+  }
+
+  // Here, rather than on the worker, so that it's just written out there
+  std::set<CUUID> unloaded;
+  if (version >= PWSfile::V40)
+    unloaded = LoadAttachments();
+
+  std::unique_ptr<AsyncSave> save(new AsyncSave);
+  save->filename = filename;
+  // Write next to a link's target, so that it's replaced, not the link
+  save->target = pws_os::fullpath(filename.c_str());
+  if (save->target.empty()) // no such file yet
+    save->target = filename.c_str();
+  save->tempname = StringX(save->target.c_str()) + _T(".tmp");
+  save->version = version;
+  save->passkey = GetPassKey();
+  save->nHashIters = GetHashIters();
+
+  // As WriteFile() does
+  m_hdr.m_prefString = PWSprefs::GetInstance()->Store();
+  m_hdr.m_whatlastsaved = m_AppNameAndVersion.c_str();
+  m_hdr.m_RUEList = m_RUEList;
+  save->hdr = m_hdr;
+  save->UHFL = m_UHFL;
+  save->filters = m_MapDBFilters;
+  save->policies = m_MapPSWDPLC;
+  save->emptyGroups = m_vEmptyGroups;
+
+  save->entries.reserve(m_pwlist.size());
+  for (const auto &p : m_pwlist)
+    save->entries.push_back(p.second);
+  if (version >= PWSfile::V40) {
+    save->atts.reserve(m_attlist.size());
+    for (const auto &p : m_attlist)
+      if (unloaded.find(p.first) == unloaded.end())
+        save->atts.push_back(p.second);
+  }
+
+  save->bJournal = filename == m_currfile && version == PWSfile::V30 && !m_isAuxCore &&
+    PWSprefs::GetInstance()->GetPref(PWSprefs::UseChangeJournal);
+  if (save->bJournal) // from now on, it's changes since this save
+    save->journalUUIDs.swap(m_journalUUIDs);
+  save->nModifications = m_nModifications;
+  save->observers = m_Observers;
+  save->status = FAILURE;
+
+  (void)PWSrand::GetInstance(); // before the worker needs it
+  save->worker = std::thread(&AsyncSave::Run, save.get());
+  m_asyncSave = std::move(save);
+  m_bAsyncSaveQueued = false;
+  return SUCCESS;
+}
+
+std::set<CUUID> PWScore::LoadAttachments() const
+{
+  std::set<CUUID> retval;
+  for (const auto &p : m_attlist) {
+    if (!p.second.LoadContent()) {
+      pws_os::Trace(_T("Couldn't load content of attachment %ls\n"),
+                    p.second.GetTitle().c_str());
+      if (m_pReporter != nullptr) {
+        stringT cs_msg;
+        Format(cs_msg, IDSC_ATTNOTSAVED, p.second.GetTitle().c_str());
+        (*m_pReporter)(cs_msg);
       }
+      retval.insert(p.first);
+    }
+  }
+  return retval;
+}
+
+int PWScore::FinishAsyncSave()
+{
+  return CompleteAsyncSave(true);
+}
+
+int PWScore::CompleteAsyncSave(bool bStartQueued)
+{
+  if (!m_asyncSave)
+    return SUCCESS;
+
+  std::unique_ptr<AsyncSave> save(std::move(m_asyncSave));
+  save->worker.join();
+  const bool bQueued = m_bAsyncSaveQueued;
+  m_bAsyncSaveQueued = false;
+
+  const int status = save->status;
+  if (status != SUCCESS) {
+    pws_os::Trace(_T("PWScore::CompleteAsyncSave: %ls\n"), StatusText(status).c_str());
+    // Still to be journaled against the last checkpoint
+    m_journalUUIDs.insert(save->journalUUIDs.begin(), save->journalUUIDs.end());
+  } else {
+    // As WriteFile() does, but as of the snapshot. Only the header
+    // fields that writing sets are taken, the rest may have changed since.
+    const PWSfileHeader &hdr = save->hdr;
+    m_hdr.m_nCurrentMajorVersion = hdr.m_nCurrentMajorVersion;
+    m_hdr.m_nCurrentMinorVersion = hdr.m_nCurrentMinorVersion;
+    m_hdr.m_file_uuid = hdr.m_file_uuid;
+    m_hdr.m_whenlastsaved = hdr.m_whenlastsaved;
+    m_hdr.m_lastsavedby = hdr.m_lastsavedby;
+    m_hdr.m_lastsavedon = hdr.m_lastsavedon;
+
+    if (save->version >= m_ReadFileVersion) {
+      m_InitialDBName = hdr.m_DB_Name;
+      m_InitialDBDesc = hdr.m_DB_Description;
+      m_InitialDBPreferences = hdr.m_prefString;
+      m_InitialEmptyGroups = save->emptyGroups;
+      m_InitialMapPSWDPLC = save->policies;
+      m_InitialMapDBFilters = save->filters;
+      m_InitialDisplayStatus = hdr.m_displaystatus;
+      m_InitialRUEList = hdr.m_RUEList;
+      m_ReadFileVersion = save->version;
+    }
+
+    delete m_pFileSig;
+    m_pFileSig = new PWSFileSig(save->filename.c_str());
+
+    if (save->filename == m_currfile) {
+      ResetJournal(save->filename, save->bJournalKey ? save->journalKey : nullptr);
+      m_bJournalCheckpoint = save->bJournal;
     }
+
+    // Anything changed meanwhile is still to be saved
+    if (m_nModifications == save->nModifications) {
+      m_vModifiedNodes.clear();
+      m_vModifiedEmptyGroups.clear();
+      for (auto &p : m_pwlist)
+        p.second.ClearStatus();
+      SetStateClean();
+    }
+  }
+
+  // After a failure, the error's for the user to see first
+  if (bStartQueued && bQueued && status == SUCCESS)
+    WriteFileAsync(save->filename, save->version);
+  return status;
+}
+
+void PWScore::SetStateClean()
+{
+  // Set current state to CLEAN
+  m_DBCurrentState = CLEAN;
+
+  std::vector<DBStates>::iterator iter;
+
+  if (m_redo_DBState_iter != m_vDBState.end()) {
+    // Update command after of this one to be {before = CLEAN, after = DIRTY}
+    m_redo_DBState_iter->before = CLEAN;
+    m_redo_DBState_iter->after = DIRTY;
+
+    // Update all additional commands after of the next one to be
+    // {before = DIRTY, after = DIRTY}
+    iter = m_redo_DBState_iter + 1;
+    for (; iter != m_vDBState.end(); iter++) {
+      iter->before = DIRTY;
+      iter->after = DIRTY;
+    }
+  }
+
+  if (m_undo_DBState_iter != m_vDBState.end()) {
+    // Update command before this one to be {before = DIRTY, after = CLEAN}
+    m_undo_DBState_iter->before = DIRTY;
+    m_undo_DBState_iter->after = CLEAN;
+
+    // Update all additional commands before the previous one to be
+    // {before = DIRTY, after = DIRTY}
+    iter = m_undo_DBState_iter;
+    while (iter != m_vDBState.begin()) {
+      iter--;
+      iter->before = DIRTY;
+      iter->after = DIRTY;
+    }
+  }
+}
+
+void PWScore::SetJournalCheckpoint()
+{
+  m_journalUUIDs.clear();
+  m_bJournalCheckpoint = m_ReadFileVersion == PWSfile::V30 && !m_isAuxCore &&
+    PWSprefs::GetInstance()->GetPref(PWSprefs::UseChangeJournal);
+}
+
+void PWScore::ResetJournal(const StringX &filename, const unsigned char *journalKey)
+{
+  // The journal was bound to the file just replaced; a new one is bound
+  // to this, and so keyed from what wrote it
+  m_journal.reset(journalKey != nullptr ? new ChangeJournal(filename, journalKey) : nullptr);
+  const stringT jname = ChangeJournal::GetJournalName(filename);
+  if (pws_os::FileExists(jname))
+    pws_os::DeleteAFile(jname);
+}
+
+void PWScore::AddChangedEntry(const CUUID &uuid)
+{
+  m_journalUUIDs.insert(uuid);
+}
+
+int PWScore::WriteJournal()
+{
+  PWS_LOGIT;
+
+  // Only entries are journaled: anything else needs a full save
+  if (!m_bJournalCheckpoint || m_asyncSave || m_bIsReadOnly || m_currfile.empty() ||
+      m_ReadFileVersion != PWSfile::V30 ||
+      !PWSprefs::GetInstance()->GetPref(PWSprefs::UseChangeJournal) ||
+      m_hdr.m_DB_Name != m_InitialDBName ||
+      m_hdr.m_DB_Description != m_InitialDBDesc ||
+      HaveDBPrefsChanged() || HaveEmptyGroupsChanged() ||
+      HavePasswordPolicyNamesChanged() || HaveDBFiltersChanged())
+    return FAILURE;
+
+  // Only the entries marked as changed are looked at, and decrypted.
+  // Whatever happened to one since, it's journaled as it is now.
+  ChangeJournal::Batch batch;
+  for (const auto &uuid : m_journalUUIDs) {
+    auto iter = m_pwlist.find(uuid);
+    if (iter != m_pwlist.end())
+      batch.Put(iter->second);
+    else
+      batch.Delete(uuid);
+  }
+
+  if (!batch.IsEmpty()) {
+    if (!m_journal) // no key for one
+      return FAILURE;
+    int status = SUCCESS;
+    // A new journal binds to the database as it is on disk, so that's
+    // checked once here; appends are checked against the binding
+    if (!m_journal->IsOpen())
+      status = HasFileChangedExternally() ? int(PWSfile::WRONG_VERSION) :
+        m_journal->Create();
+    if (status == SUCCESS)
+      status = m_journal->Append(batch); // fails if the database has changed
+    if (status != SUCCESS)
+      return status;
   }
+
+  for (const auto &uuid : m_journalUUIDs) {
+    auto iter = m_pwlist.find(uuid);
+    if (iter != m_pwlist.end())
+      iter->second.ClearStatus();
+  }
+  m_journalUUIDs.clear();
+
+  SetStateClean();
   return SUCCESS;
 }
 
@@ -971,6 +1357,7 @@ int PWScore::Execute(Command *pcmd)
 
   // Execute it
   int rc = pcmd->Execute();
+  m_nModifications++;
 
   // Save current before & after DB states
   // Note: commands should always change something but check
@@ -1009,6 +1396,7 @@ void PWScore::Undo()
 
   // Undo it
   (*m_undo_iter)->Undo();
+  m_nModifications++;
 
   // Reset command & DBstate iterator so that we know next command to undo
   if (m_undo_iter == m_vpcommands.begin()) {
@@ -1041,6 +1429,7 @@ void PWScore::Redo()
 
   // Redo it
   (*m_redo_iter)->Redo();
+  m_nModifications++;
 
   // Need to reset current DB state based on the command's after state
   m_DBCurrentState = m_redo_DBState_iter->after;
@@ -1203,8 +1592,11 @@ void PWScore::ProcessReadEntry(CItemData &ci_temp,
     m_ExpireCandidates.push_back(ExpPWEntry(ci_temp));
   }
 
-  // Finally, add it to the list!
-  m_pwlist.insert(std::make_pair(ci_temp.GetUUID(), ci_temp));
+  // Finally, add it to the list! Moving leaves ci_temp without
+  // fields, ready for the next record.
+  IndexEntry(ci_temp);
+  const CUUID uuid = ci_temp.GetUUID();
+  m_pwlist.emplace(uuid, std::move(ci_temp));
 }
 
 static void ReportReadErrors(CReport *pRpt,
@@ -1248,6 +1640,74 @@ static void ReportReadErrors(CReport *pRpt,
   }
 }
 
+static const StringX MakeDateTimeString(); // for a stale journal's new name
+
+bool PWScore::ReplayJournal(const StringX &filename, const unsigned char journalKey[32],
+                            std::vector<st_GroupTitleUser> &vGTU_INVALID_UUID,
+                            std::vector<st_GroupTitleUser> &vGTU_DUPLICATE_UUID,
+                            st_ValidateResults &st_vr)
+{
+  if (m_ReadFileVersion != PWSfile::V30)
+    return false;
+
+  std::unique_ptr<ChangeJournal> journal(new ChangeJournal(filename, journalKey));
+  const bool bKeep = filename == m_currfile && !m_isAuxCore;
+  if (!pws_os::FileExists(ChangeJournal::GetJournalName(filename))) {
+    if (bKeep)
+      m_journal = std::move(journal); // to Create()
+    return false;
+  }
+
+  // Changes are applied as if read from the database, replacing any
+  // entry of the same UUID. Dependents are sorted out after.
+  size_t numChanges = 0;
+  const int status = journal->Replay(m_keyring,
+    [&](const CUUID &uuid, CItemData *ci) {
+      auto iter = m_pwlist.find(uuid);
+      if (iter != m_pwlist.end()) {
+        const CItemData &old_ci = iter->second;
+        int32 iKBShortcut;
+        old_ci.GetKBShortcut(iKBShortcut);
+        if (iKBShortcut != 0)
+          DelKBShortcut(iKBShortcut, uuid);
+        time_t tttXTime;
+        old_ci.GetXTime(tttXTime);
+        if (tttXTime != time_t(0))
+          RemoveExpiryEntry(old_ci);
+        if (old_ci.IsPolicyNameSet())
+          DecrementPasswordPolicy(old_ci.GetPolicyName());
+        UnindexEntry(old_ci);
+        m_pwlist.erase(iter);
+      }
+      if (ci != nullptr)
+        ProcessReadEntry(*ci, vGTU_INVALID_UUID, vGTU_DUPLICATE_UUID, st_vr);
+      numChanges++;
+    });
+
+  if (status == PWSfile::WRONG_VERSION) {
+    // Written against another version of the database, so whatever's
+    // in it isn't applied, but is kept aside rather than overwritten
+    const stringT jname = ChangeJournal::GetJournalName(filename);
+    const stringT stale = ChangeJournal::GetJournalName(filename + _T("_") +
+                                                        MakeDateTimeString());
+    const bool bKept = pws_os::RenameFile(jname, stale);
+    pws_os::Trace(_T("Stale journal %ls %ls %ls\n"), jname.c_str(),
+                  bKept ? _T("renamed") : _T("couldn't be renamed"), stale.c_str());
+    if (bKept && m_pReporter != nullptr) {
+      stringT cs_msg;
+      Format(cs_msg, IDSC_STALEJOURNAL, jname.c_str(), stale.c_str());
+      (*m_pReporter)(cs_msg);
+    }
+    if (bKept && bKeep)
+      m_journal = std::move(journal); // to Create() anew
+  } else if (status != SUCCESS) {
+    pws_os::Trace(_T("Couldn't replay journal of %ls: %d\n"), filename.c_str(), status);
+  } else if (bKeep) {
+    m_journal = std::move(journal); // to append to
+  }
+  return numChanges > 0;
+}
+
 int PWScore::ReadFile(const StringX &a_filename, const StringX &a_passkey,
                       const bool bValidate, const size_t iMAXCHARS,
                       CReport *pRpt)
@@ -1260,6 +1720,8 @@ int PWScore::ReadFile(const StringX &a_filename, const StringX &a_passkey,
   st_ValidateResults st_vr;
   std::vector<st_GroupTitleUser> vGTU_INVALID_UUID, vGTU_DUPLICATE_UUID;
 
+  CompleteAsyncSave(false);
+
   // Clear any old expired password entries
   m_ExpireCandidates.clear();
 
@@ -1274,6 +1736,10 @@ int PWScore::ReadFile(const StringX &a_filename, const StringX &a_passkey,
     return status;
   }
 
+  auto *in4 = dynamic_cast<PWSfileV4 *>(in);
+  if (in4 != nullptr)
+    in4->SetLazyContent(PWSprefs::GetInstance()->GetPref(PWSprefs::LazyAttachments));
+
   status = in->Open(a_passkey);
   if (status == PWSfile::WRONG_PASSWORD) {
     // See if passkey was encoded incorrectly
@@ -1339,6 +1805,7 @@ int PWScore::ReadFile(const StringX &a_filename, const StringX &a_passkey,
   SetPassKey(a_passkey); // so user won't be prompted for saves
 
   CItemData ci_temp;
+  ci_temp.SetKeyring(m_keyring); // inherited by the entries moved into m_pwlist
   bool go = true;
 
   m_hashIters = in->GetNHashIters();
@@ -1356,9 +1823,19 @@ int PWScore::ReadFile(const StringX &a_filename, const StringX &a_passkey,
     pRpt->StartReport(IDSC_RPTVALIDATE, m_currfile.c_str());
   }
 
+  // Records are decrypted on worker threads while they can be;
+  // whatever's left (if anything) is read as before
+  std::unique_ptr<ReadPipeline> pipeline;
+  if (m_readWorkers > 0 && in->CanReadExtents() &&
+      (m_bReadSmallFiles || in->GetFileLength() >= ReadPipeline::MinFileLength))
+    pipeline.reset(new ReadPipeline(in, m_keyring, m_readWorkers));
+
   do {
     ci_temp.Clear(); // Rather than creating a new one each time.
-    status = in->ReadRecord(ci_temp);
+    if (pipeline && !pipeline->Next(ci_temp, status))
+      pipeline.reset();
+    if (!pipeline)
+      status = in->ReadRecord(ci_temp);
     switch (status) {
       case PWSfile::FAILURE:
       {
@@ -1380,9 +1857,11 @@ int PWScore::ReadFile(const StringX &a_filename, const StringX &a_passkey,
       case PWSfile::WRONG_RECORD: {
         // See if this is a V4 attachment:
         CItemAtt att;
+        att.SetKeyring(m_keyring);
         status = att.Read(in);
         if (status == PWSfile::SUCCESS) {
-          m_attlist.insert(std::make_pair(att.GetUUID(), att));
+          const CUUID att_uuid = att.GetUUID();
+          m_attlist.emplace(att_uuid, std::move(att));
         } else {
           // XXX report problem!
         }
@@ -1396,13 +1875,31 @@ int PWScore::ReadFile(const StringX &a_filename, const StringX &a_passkey,
     } // switch
   } while (go);
 
-  ParseDependants();
-
   m_nRecordsWithUnknownFields = in->GetNumRecordsWithUnknownFields();
   in->GetUnknownHeaderFields(m_UHFL);
+  // The journal's keyed from what Open() stretched, not stretched anew
+  unsigned char journalKey[SHA256::HASHLEN];
+  auto *in3 = dynamic_cast<PWSfileV3 *>(in);
+  const bool bJournalKey = in3 != nullptr;
+  if (bJournalKey)
+    in3->GetJournalKey(journalKey);
   int closeStatus = in->Close(); // in V3 & later this checks integrity
   delete in;
 
+  // Changes are only journaled against a database that checks out
+  if (closeStatus == SUCCESS && bJournalKey &&
+      ReplayJournal(a_filename, journalKey,
+                    vGTU_INVALID_UUID, vGTU_DUPLICATE_UUID, st_vr))
+    m_nRecordsWithUnknownFields = static_cast<int>(
+      std::count_if(m_pwlist.begin(), m_pwlist.end(),
+                    [](const ItemList::value_type &p) {return p.second.NumberUnknownFields() > 0;}));
+  trashMemory(journalKey, sizeof(journalKey));
+
+  ParseDependants();
+
+  if (a_filename == m_currfile && closeStatus == SUCCESS)
+    SetJournalCheckpoint();
+
   ReportReadErrors(pRpt, vGTU_INVALID_UUID, vGTU_DUPLICATE_UUID);
 
   // Validate rest of things in the database (excluding duplicate UUIDs fixed above
@@ -1526,9 +2023,24 @@ static void ManageIncBackupFiles(const stringT &cs_filenamebase,
   }
 }
 
+bool PWScore::HasFileChangedExternally() const
+{
+  // While one of our saves is in progress, the file's ours to change
+  if (m_pFileSig == nullptr || m_asyncSave || m_currfile.empty())
+    return false;
+  return PWSFileSig(m_currfile.c_str()) != *m_pFileSig;
+}
+
+void PWScore::AcceptFileChanges()
+{
+  delete m_pFileSig;
+  m_pFileSig = new PWSFileSig(m_currfile.c_str());
+}
+
 bool PWScore::BackupCurFile(unsigned int maxNumIncBackups, int backupSuffix,
                             const stringT &userBackupPrefix,
-                            const stringT &userBackupDir, stringT &bu_fname)
+                            const stringT &userBackupDir, stringT &bu_fname,
+                            bool bCopy)
 {
   stringT cs_temp;
   const stringT path(m_currfile.c_str());
@@ -1588,8 +2100,11 @@ bool PWScore::BackupCurFile(unsigned int maxNumIncBackups, int backupSuffix,
 
   bu_fname +=  _T(".ibak");
 
-  // Current file becomes backup
+  // Current file becomes backup, or, for a save that leaves it in place
+  // until the new one's written, is copied to it.
   // Directories along the specified backup path are created as needed
+  if (bCopy)
+    return pws_os::CopyAFile(m_currfile.c_str(), bu_fname);
   return pws_os::RenameFile(m_currfile.c_str(), bu_fname);
 }
 
@@ -1600,33 +2115,30 @@ void PWScore::ChangePasskey(const StringX &newPasskey)
   WriteCurFile(); // Save immediately!
 }
 
-// functor object type for find_if:
-struct FieldsMatch {
-  bool operator()(const std::pair<CUUID, CItemData> &p) {
-    const CItemData &item = p.second;
-    return (m_group == item.GetGroup() &&
-            m_title == item.GetTitle() &&
-            m_user  == item.GetUser());
-  }
-  FieldsMatch(const FieldsMatch&) = default;
-  FieldsMatch(const StringX &a_group, const StringX &a_title,
-              const StringX &a_user) :
-  m_group(a_group), m_title(a_title), m_user(a_user) {}
-
-private:
-  FieldsMatch& operator=(const FieldsMatch&) = delete;
-  const StringX &m_group;
-  const StringX &m_title;
-  const StringX &m_user;
-};
-
 // Finds stuff based on group, title & user fields only
 ItemListIter PWScore::Find(const StringX &a_group,const StringX &a_title,
                            const StringX &a_user)
 {
-  FieldsMatch fields_match(a_group, a_title, a_user);
+  // The index may return false positives, never false negatives
+  const UUIDVector candidates = m_GTUIndex.Find(a_group, a_title, a_user);
+  for (const auto &uuid : candidates) {
+    auto iter = m_pwlist.find(uuid);
+    if (iter != m_pwlist.end() &&
+        iter->second.GetGroup() == a_group &&
+        iter->second.GetTitle() == a_title &&
+        iter->second.GetUser() == a_user)
+      return iter;
+  }
+  return m_pwlist.end();
+}
 
-  return find_if(m_pwlist.begin(), m_pwlist.end(), fields_match);
+StringX PWScore::GetDisplayField(const pws_os::CUUID &entry_uuid,
+                                 CItemData::FieldType ft) const
+{
+  auto iter = m_pwlist.find(entry_uuid);
+  if (iter == m_pwlist.end())
+    return StringX();
+  return m_DisplayCache.Get(entry_uuid, iter->second, ft);
 }
 
 struct TitleMatch {
@@ -1881,13 +2393,9 @@ void PWScore::GetAllGroups(std::vector<stringT> &vAllGroups, const bool bInclude
   std::set<stringT> setGroups;
 
   // Start with groups that have elements
-  for (auto iter = m_pwlist.begin(); iter != m_pwlist.end(); iter++) {
-    const CItemData &ci = iter->second;
-    if (ci.IsGroupSet()) {
-      // We have at least one group
-      collectGroups(ci.GetGroup(), setGroups);
-    } // IsGroupSet()
-  } // for m_pwlist
+  m_GroupTree.GetAllGroups(setGroups, [this](const pws_os::CUUID &uuid) {
+    return m_pwlist.find(uuid)->second.GetGroup();
+  });
 
   if (bIncludeEmptyGroups) {
     // Now add Empty groups in the same manner
@@ -2295,7 +2803,9 @@ bool PWScore::Validate(const size_t iMAXCHARS, CReport *pRpt, st_ValidateResults
       fixedItem.SetStatus(CItemData::ES_MODIFIED);
       // We assume that this is run during file read. If not, then we
       // need to run using the Command mechanism for Undo/Redo.
-      m_pwlist[fixedItem.GetUUID()] = fixedItem;
+      UnindexEntry(ci);
+      ci = std::move(fixedItem);
+      IndexEntry(ci);
     }
   } // iteration over m_pwlist
 
@@ -2673,8 +3183,14 @@ bool PWScore::MakeEntryUnique(GTUSet &setGTU,
 
   // Add supplied GTU - if already present, change title until a
   // unique combination is found.
-  pr_gtu =  setGTU.insert(st_GroupTitleUser(sxgroup, sxtitle, sxuser));
-  if (!pr_gtu.second) { // insert failed => already in set!
+  // Entries already in the database are checked via m_GTUIndex, so
+  // setGTU need only hold those not added yet (e.g., imported so far).
+  auto insert = [this, &setGTU, &pr_gtu, &sxgroup, &sxuser](const StringX &title) {
+    pr_gtu = setGTU.insert(st_GroupTitleUser(sxgroup, title, sxuser));
+    return pr_gtu.second && Find(sxgroup, title, sxuser) == m_pwlist.end();
+  };
+
+  if (!insert(sxtitle)) { // already in set or database!
     retval = false;
     int i = 0;
     StringX s_copy;
@@ -2682,8 +3198,7 @@ bool PWScore::MakeEntryUnique(GTUSet &setGTU,
       i++;
       Format(s_copy, ids_message, i);
       sxnewtitle = sxtitle + s_copy;
-      pr_gtu =  setGTU.insert(st_GroupTitleUser(sxgroup, sxnewtitle, sxuser));
-    } while (!pr_gtu.second);
+    } while (!insert(sxnewtitle));
     sxtitle = sxnewtitle;
   }
   return retval; // false iff we had to modify sxtitle
@@ -2709,6 +3224,7 @@ void PWScore::DoAddDependentEntry(const CUUID &base_uuid,
   ASSERT(diter != m_pwlist.end());
 
   diter->second.SetBaseUUID(base_uuid);
+  AddChangedEntry(entry_uuid);
 
   bool baseWasNormal = biter->second.IsNormal();
   if (type == CItemData::ET_ALIAS) {
@@ -2844,6 +3360,7 @@ bool PWScore::DoMoveDependentEntries(const CUUID &from_baseuuid,
   for (size_t idep = 0 ; idep < tlist.size(); idep++) {
     // Add to new base in base -> entry multimap
     pmmap->insert(ItemMMap_Pair(to_baseuuid, tlist[idep]));
+    AddChangedEntry(tlist[idep]);
   }
 
   // Now delete all old base entries
@@ -2900,6 +3417,7 @@ int PWScore::DoAddDependentEntries(UUIDVector &dependentlist, CReport *pRpt,
 
       CItemData *pci_curitem = &iter->second;
       CUUID entry_uuid = pci_curitem->GetUUID();
+      AddChangedEntry(entry_uuid);
 
       if (iVia == CItemData::UUID) {
         base_uuid = pci_curitem->GetBaseUUID();
@@ -2945,6 +3463,8 @@ int PWScore::DoAddDependentEntries(UUIDVector &dependentlist, CReport *pRpt,
             // Invalid - delete!
             if (pmapDeletedItems != nullptr)
               pmapDeletedItems->insert(ItemList_Pair(*paiter, *pci_curitem));
+            AddChangedEntry(iter->first);
+            UnindexEntry(iter->second);
             m_pwlist.erase(iter);
             continue;
           }
@@ -2969,13 +3489,14 @@ int PWScore::DoAddDependentEntries(UUIDVector &dependentlist, CReport *pRpt,
             // Invalid - delete!
             if (pmapDeletedItems != nullptr)
               pmapDeletedItems->insert(ItemList_Pair(*paiter, *pci_curitem));
+            AddChangedEntry(iter->first);
+            UnindexEntry(iter->second);
             m_pwlist.erase(iter);
             continue;
           }
           if (iter->second.IsAlias()) {
             // This is an alias too!  Not allowed!  Make new one point to original base
             // Note: this may be random as who knows the order of reading records?
-            CUUID temp_uuid = iter->second.GetUUID();
             base_uuid = iter->second.GetBaseUUID(); // ??? used here ???
             if (pRpt != nullptr) {
               if (!bwarnings) {
@@ -3077,7 +3598,12 @@ void PWScore::UndoAddDependentEntries(ItemList *pmapDeletedItems,
   for (add_iter = pmapDeletedItems->begin();
        add_iter != pmapDeletedItems->end();
        add_iter++) {
+    iter = m_pwlist.find(add_iter->first);
+    if (iter != m_pwlist.end())
+      UnindexEntry(iter->second);
     m_pwlist[add_iter->first] = add_iter->second;
+    IndexEntry(add_iter->second);
+    AddChangedEntry(add_iter->first);
   }
 
   for (restore_iter = pmapSaveTypePW->begin();
@@ -3092,6 +3618,7 @@ void PWScore::UndoAddDependentEntries(ItemList *pmapDeletedItems,
     pci_changeditem->SetEntryType(pst_typepw->et);
     if (!pst_typepw->sxpw.empty())
       pci_changeditem->SetPassword(pst_typepw->sxpw);
+    AddChangedEntry(restore_iter->first);
   }
 }
 
@@ -3123,6 +3650,7 @@ void PWScore::ResetAllAliasPasswords(const CUUID &base_uuid)
     if (alias_itr != m_pwlist.end()) {
       alias_itr->second.SetPassword(csBasePassword);
       alias_itr->second.SetNormal();
+      AddChangedEntry(alias_uuid);
       GUIRefreshEntry(alias_itr->second);
     }
   }
@@ -3608,6 +4136,10 @@ int PWScore::DoUpdatePasswordHistory(int iAction, int new_default_max,
     }
   }
   delete updater;
+
+  // Those saved, for undo, are those that may have changed
+  for (const auto &saved : mapSavedHistory)
+    AddChangedEntry(saved.first);
   return num_altered;
 }
 
@@ -3620,6 +4152,7 @@ void PWScore::UndoUpdatePasswordHistory(SavePWHistoryMap &mapSavedHistory)
     if (listPos != m_pwlist.end()) {
       listPos->second.SetPWHistory(itr->second.pwh);
       listPos->second.SetStatus(itr->second.es);
+      AddChangedEntry(itr->first);
     }
   }
 }
@@ -3640,7 +4173,13 @@ int PWScore::DoRenameGroup(const StringX &sxOldPath, const StringX &sxNewPath,
 
   Command *pcmd;
 
-  for (iter = m_pwlist.begin(); iter != m_pwlist.end(); iter++) {
+  // Only entries in the group's subtree need to be looked at
+  UUIDVector vuuids;
+  m_GroupTree.GetEntries(sxOldPath, vuuids);
+
+  for (const auto &uuid : vuuids) {
+    iter = m_pwlist.find(uuid);
+    ASSERT(iter != m_pwlist.end());
     if (iter->second.GetGroup() == sxOldPath) {
       pcmd = UpdateEntryCommand::Create(this, iter->second,
                                         CItemData::GROUP, sxNewPath);
@@ -3680,32 +4219,21 @@ void PWScore::UndoChangeHeader(const StringX &sxOldValue, const PWSfile::HeaderT
   DoChangeHeader(sxOldValue, ht);
 }
 
-void PWScore::GetDBProperties(st_DBProperties &st_dbp)
+// What GetDBProperties() and PeekFile() get from the header alone
+static void GetHeaderProperties(const PWSfileHeader &hdr, st_DBProperties &st_dbp)
 {
-  st_dbp.database = m_currfile;
-
   Format(st_dbp.databaseformat, L"%d.%02d",
-                          m_hdr.m_nCurrentMajorVersion,
-                          m_hdr.m_nCurrentMinorVersion);
+                          hdr.m_nCurrentMajorVersion,
+                          hdr.m_nCurrentMinorVersion);
 
-  std::vector<std::wstring> vAllGroups;
-  GetAllGroups(vAllGroups);
-  Format(st_dbp.numgroups, L"%d", vAllGroups.size());
-  Format(st_dbp.numemptygroups, L"%d", m_vEmptyGroups.size());
-  Format(st_dbp.numentries, L"%d", m_pwlist.size());
-  if (GetReadFileVersion() >= PWSfile::V40)
-    Format(st_dbp.numattachments, L"%d", m_attlist.size());
-  else
-    st_dbp.numattachments = L"N/A";
-
-  time_t twls = m_hdr.m_whenlastsaved;
+  time_t twls = hdr.m_whenlastsaved;
   if (twls == 0) {
     LoadAString(st_dbp.whenlastsaved, IDSC_UNKNOWN);
   } else {
     st_dbp.whenlastsaved = PWSUtil::ConvertToDateTimeString(twls, PWSUtil::TMC_EXPORT_IMPORT);
   }
 
-  time_t tpwdlc = m_hdr.m_whenpwdlastchanged;
+  time_t tpwdlc = hdr.m_whenpwdlastchanged;
   if (tpwdlc == 0) {
     LoadAString(st_dbp.whenpwdlastchanged, IDSC_UNKNOWN);
   } else {
@@ -3713,30 +4241,49 @@ void PWScore::GetDBProperties(st_DBProperties &st_dbp)
   }
   
 
-  if (m_hdr.m_lastsavedby.empty() && m_hdr.m_lastsavedon.empty()) {
+  if (hdr.m_lastsavedby.empty() && hdr.m_lastsavedon.empty()) {
     LoadAString(st_dbp.wholastsaved, IDSC_UNKNOWN);
   } else {
-    StringX user = m_hdr.m_lastsavedby.empty() ?
-                          _T("?") : m_hdr.m_lastsavedby.c_str();
-    StringX host = m_hdr.m_lastsavedon.empty() ?
-                          _T("?") : m_hdr.m_lastsavedon.c_str();
+    StringX user = hdr.m_lastsavedby.empty() ?
+                          _T("?") : hdr.m_lastsavedby.c_str();
+    StringX host = hdr.m_lastsavedon.empty() ?
+                          _T("?") : hdr.m_lastsavedon.c_str();
     Format(st_dbp.wholastsaved, IDSC_USERONHOST, user.c_str(), host.c_str());
   }
 
-  if (m_hdr.m_whatlastsaved.empty()) {
+  if (hdr.m_whatlastsaved.empty()) {
     LoadAString(st_dbp.whatlastsaved, IDSC_UNKNOWN);
   } else
-    st_dbp.whatlastsaved = m_hdr.m_whatlastsaved;
+    st_dbp.whatlastsaved = hdr.m_whatlastsaved;
 
-  if(m_hdr.m_file_uuid == CUUID::NullUUID())
+  if(hdr.m_file_uuid == CUUID::NullUUID())
     st_dbp.file_uuid = _T("N/A");
   else {
-    CUUID huuid(*m_hdr.m_file_uuid.GetARep(), true); // true for canonical format
     ostringstreamT os;
-    os << std::uppercase << huuid;
+    os << std::uppercase << hdr.m_file_uuid.Canonic();
     st_dbp.file_uuid = os.str().c_str();
   }
 
+  st_dbp.db_name = hdr.m_DB_Name;
+  st_dbp.db_description = hdr.m_DB_Description;
+}
+
+void PWScore::GetDBProperties(st_DBProperties &st_dbp)
+{
+  st_dbp.database = m_currfile;
+
+  GetHeaderProperties(m_hdr, st_dbp);
+
+  std::vector<std::wstring> vAllGroups;
+  GetAllGroups(vAllGroups);
+  Format(st_dbp.numgroups, L"%d", vAllGroups.size());
+  Format(st_dbp.numemptygroups, L"%d", m_vEmptyGroups.size());
+  Format(st_dbp.numentries, L"%d", m_pwlist.size());
+  if (GetReadFileVersion() >= PWSfile::V40)
+    Format(st_dbp.numattachments, L"%d", m_attlist.size());
+  else
+    st_dbp.numattachments = L"N/A";
+
   int num = m_nRecordsWithUnknownFields;
   if (num != 0 || !m_UHFL.empty()) {
     StringX cs_Yes, cs_No, cs_HdrYesNo;
@@ -3757,9 +4304,58 @@ void PWScore::GetDBProperties(st_DBProperties &st_dbp)
   } else {
     LoadAString(st_dbp.unknownfields, IDSC_NONE);
   }
+}
+
+int PWScore::PeekFile(const StringX &filename, const StringX &passkey,
+                      st_DBProperties &st_dbp, bool bCountRecords)
+{
+  if (!pws_os::FileExists(filename.c_str()))
+    return CANT_OPEN_FILE;
+
+  int status;
+  PWSfile::VERSION version;
+  std::unique_ptr<PWSfile> in;
+  size_t numEntries = 0, numAttachments = 0;
+  if (PWSfileV3::IsV3x(filename, version)) {
+    auto *in3 = new PWSfileV3(filename, PWSfile::Read, version);
+    in.reset(in3);
+    status = in3->Peek(passkey, bCountRecords ? &numEntries : nullptr);
+  } else {
+    // Checking the passkey's all there is to tell V4 from older formats,
+    // and Peek() starts with that, so don't have MakePWSfile() do it too
+    version = PWSfile::V40;
+    auto *in4 = new PWSfileV4(filename, PWSfile::Read, version);
+    in.reset(in4);
+    status = in4->Peek(passkey, bCountRecords ? &numEntries : nullptr,
+                       bCountRecords ? &numAttachments : nullptr);
+    if (status != PWSfile::SUCCESS &&
+        PWSfileV1V2::CheckPasskey(filename, passkey) == PWSfile::SUCCESS)
+      return UNIMPLEMENTED; // no header to speak of
+  }
+  if (status != PWSfile::SUCCESS)
+    return status;
+
+  st_dbp.database = filename;
+  GetHeaderProperties(in->GetHeader(), st_dbp);
 
-  st_dbp.db_name = m_hdr.m_DB_Name;
-  st_dbp.db_description = m_hdr.m_DB_Description;
+  LoadAString(st_dbp.numgroups, IDSC_UNKNOWN);
+  const std::vector<StringX> *pvEmptyGroups = in->GetEmptyGroups();
+  Format(st_dbp.numemptygroups, L"%d", pvEmptyGroups->size());
+  if (bCountRecords) {
+    Format(st_dbp.numentries, L"%d", numEntries);
+    if (version >= PWSfile::V40)
+      Format(st_dbp.numattachments, L"%d", numAttachments);
+    else
+      st_dbp.numattachments = L"N/A";
+  } else {
+    LoadAString(st_dbp.numentries, IDSC_UNKNOWN);
+    if (version >= PWSfile::V40)
+      LoadAString(st_dbp.numattachments, IDSC_UNKNOWN);
+    else
+      st_dbp.numattachments = L"N/A";
+  }
+  LoadAString(st_dbp.unknownfields, IDSC_UNKNOWN);
+  return SUCCESS;
 }
 
 StringX PWScore::GetHeaderItem(PWSfile::HeaderType ht)
@@ -3984,15 +4580,8 @@ bool PWScore::AddEmptyGroup(const StringX &sxEmptyGroup)
   if (sxEmptyGroup.empty())
     return false;
 
-  std::vector<stringT> vAllNonEmptyGroups;
-  GetAllGroups(vAllNonEmptyGroups, false);
-
-  std::sort(vAllNonEmptyGroups.begin(), vAllNonEmptyGroups.end());
-  stringT sEG = sxEmptyGroup.c_str();
-
   // Don't add if an entry with this group alreadly exists
-  if (find(vAllNonEmptyGroups.begin(), vAllNonEmptyGroups.end(), sEG) !=
-           vAllNonEmptyGroups.end())
+  if (m_GroupTree.HasGroup(sxEmptyGroup))
     return false;
 
   // Only add if not already present
@@ -4106,6 +4695,13 @@ void PWScore::SetHashIters(uint32 value)
   m_hashIters = value;
 }
 
+void PWScore::PutAtt(const CItemAtt &att)
+{
+  CItemAtt &stored = m_attlist[att.GetUUID()];
+  stored = att;
+  stored.SetKeyring(m_keyring);
+}
+
 void PWScore::RemoveAtt(const pws_os::CUUID &attuuid)
 {
   // Should be a Command setting new CommandDBChange enum value
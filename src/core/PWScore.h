@@ -22,9 +22,17 @@
 #include "CommandInterface.h"
 #include "DBCompareData.h"
 #include "ExpiredList.h"
+#include "GTUIndex.h"
+#include "GroupTree.h"
+#include "DisplayFieldCache.h"
+#include "ChangeJournal.h"
 
 #include "coredefs.h"
 
+#include <memory>
+#include <set>
+#include <unordered_set>
+
 // Parameter list for ParseBaseEntryPWD
 struct BaseEntryParms {
   // All fields except "InputType" are 'output'.
@@ -139,7 +147,8 @@ public:
   PWSfile::VERSION GetReadFileVersion() const {return m_ReadFileVersion;}
   bool BackupCurFile(unsigned int maxNumIncBackups, int backupSuffix,
                      const stringT &userBackupPrefix,
-                     const stringT &userBackupDir, stringT &bu_fname);
+                     const stringT &userBackupDir, stringT &bu_fname,
+                     bool bCopy = false);
 
   void NewFile(const StringX &passkey);
   int WriteCurFile() {return WriteFile(m_currfile, m_ReadFileVersion);}
@@ -159,6 +168,44 @@ public:
   void SetReadOnly(bool state) {m_bIsReadOnly = state;}
   bool IsReadOnly() const {return m_bIsReadOnly;}
 
+  // Threads to decrypt records on in ReadFile() (V3 only, see ReadPipeline).
+  // Defaults to what suits the CPU; 0 reads them all on the calling thread,
+  // as do files under ReadPipeline::MinFileLength unless bSmallFiles.
+  void SetReadWorkers(unsigned n, bool bSmallFiles = false)
+  {m_readWorkers = n; m_bReadSmallFiles = bSmallFiles;}
+
+  // With PWSprefs::UseChangeJournal set, WriteJournal() saves just the
+  // entries added, changed or deleted since the last save, by appending
+  // them to the database's ChangeJournal. It fails, leaving it to
+  // WriteCurFile(), if anything else changed (header, policies, filters,
+  // empty groups...), if the database has been written by someone else
+  // since, or if it isn't V3. WriteFile() then folds the journal back
+  // into the database; ReadFile() replays it once the database has
+  // passed its HMAC check, or, if it's stale, tells the Reporter and
+  // renames it "<db>_YYYYMMDD_HHMMSS.pwsj".
+  // Commands mark the entries they change with AddChangedEntry(); so
+  // must anything that changes an entry in place, e.g., its access time.
+  int WriteJournal();
+  void AddChangedEntry(const pws_os::CUUID &uuid);
+  bool HasJournaledChanges() const
+  {return m_journal && m_journal->GetNumBatches() > 0;}
+
+  // WriteFileAsync() saves as WriteFile() does, but on another thread,
+  // from a snapshot of the database taken before it returns. It writes
+  // a temporary file next to filename (or what it links to), waits for
+  // the disk, and replaces filename with it, keeping its permissions.
+  // Until then filename is untouched, so a backup of it should be a copy
+  // (BackupCurFile(..., true)), and a failed save leaves nothing to undo.
+  // Observers are told when it's done (AsyncSaveFinished()), after which
+  // FinishAsyncSave() returns the outcome and marks the database as saved.
+  // Changes made meanwhile are left for the next save: one asked for while
+  // a save's in progress starts as a successful one's finished.
+  // V3 and later only.
+  int WriteFileAsync(const StringX &filename, PWSfile::VERSION version);
+  int WriteCurFileAsync() {return WriteFileAsync(m_currfile, m_ReadFileVersion);}
+  bool IsSaving() const {return m_asyncSave != nullptr;}
+  int FinishAsyncSave(); // waits for the save, if need be
+
   // Check/Change master passphrase
   int CheckPasskey(const StringX &filename, const StringX &passkey);
   void ChangePasskey(const StringX &newPasskey);
@@ -311,6 +358,15 @@ public:
   const CItemData &GetEntry(ItemListConstIter iter) const
   {return iter->second;}
   ItemList::size_type GetNumEntries() const {return m_pwlist.size();}
+
+  // Group, title or user of an entry, for display & sorting. Served from
+  // a cache if PWSprefs::DisplayCacheSize is non-zero. Empty if no such entry.
+  StringX GetDisplayField(const pws_os::CUUID &entry_uuid, CItemData::FieldType ft) const;
+  // Wipes cached values, e.g., when the UI is locked or minimised
+  void ClearDisplayCache() {m_DisplayCache.Clear();}
+  void PurgeDisplayCache() {m_DisplayCache.PurgeExpired();} // on a timer
+  DisplayFieldCache::Stats GetDisplayCacheStats() const
+  {return m_DisplayCache.GetStats();}
  
   // Command functions
   int Execute(Command *pcmd);
@@ -379,6 +435,10 @@ public:
 
   bool ChangeMode(stringT &locker, int &iErrorCode);
   PWSFileSig& GetCurrentFileSig() {return *m_pFileSig;}
+  // True if the database file isn't as it was last read or written here.
+  // Cheap while it hasn't changed, see PWSFileSig.
+  bool HasFileChangedExternally() const;
+  void AcceptFileChanges(); // the file as it is now is what we're saving over
 
   // Callback to be notified if the database changes
   void NotifyDBModified();
@@ -399,6 +459,12 @@ public:
   const PWSfileHeader &GetHeader() const {return m_hdr;}
 
   void GetDBProperties(st_DBProperties &st_dbp);
+  // As GetDBProperties(), for a database that needn't be open, from just
+  // its header (see PWSfileV3::Peek()). If bCountRecords, entries and
+  // attachments are counted, without being read. Groups and unknown
+  // fields are not. V3 and later only.
+  static int PeekFile(const StringX &filename, const StringX &passkey,
+                      st_DBProperties &st_dbp, bool bCountRecords = true);
   StringX GetHeaderItem(PWSfile::HeaderType ht);
 
   StringX &GetDBPreferences() {return m_hdr.m_prefString;}
@@ -445,7 +511,7 @@ public:
 
   const CItemAtt &GetAtt(const pws_os::CUUID &attuuid) const {return m_attlist.find(attuuid)->second;}
   CItemAtt &GetAtt(const pws_os::CUUID &attuuid) {return m_attlist[attuuid];}
-  void PutAtt(const CItemAtt &att) {m_attlist[att.GetUUID()] = att;}
+  void PutAtt(const CItemAtt &att);
   void RemoveAtt(const pws_os::CUUID &attuuid);
   bool HasAtt(const pws_os::CUUID &attuuid) const {return m_attlist.find(attuuid) != m_attlist.end();}
   AttList::size_type GetNumAtts() const {return m_attlist.size();}
@@ -562,6 +628,10 @@ private:
   static unsigned char m_session_key[32];
   static bool m_session_initialized;
 
+  // Shared in-memory key for this database's entries, if
+  // PWSprefs::UseSessionKeyring is set. (Re)created by ClearDBData().
+  std::shared_ptr<const CItemKeyring> m_keyring;
+
   HANDLE m_lockFileHandle;
   HANDLE m_lockFileHandle2;
 
@@ -569,6 +639,38 @@ private:
   PWSfile::VERSION m_ReadFileVersion;
 
   bool m_bIsReadOnly;
+  unsigned m_readWorkers;
+  bool m_bReadSmallFiles;
+
+  // See WriteJournal(). m_journalUUIDs are the entries added, changed or
+  // deleted since the last save, to be journaled if m_bJournalCheckpoint.
+  // m_journal, keyed for the V3 database as it is on disk, is there once
+  // that's been read or written in full.
+  void SetJournalCheckpoint();
+  bool ReplayJournal(const StringX &filename, const unsigned char journalKey[32],
+                     std::vector<st_GroupTitleUser> &vGTU_INVALID_UUID,
+                     std::vector<st_GroupTitleUser> &vGTU_DUPLICATE_UUID,
+                     st_ValidateResults &st_vr);
+  // filename's just been written in full: whatever was journaled is in it.
+  // journalKey is the writer's, or nullptr if it's not V3.
+  void ResetJournal(const StringX &filename, const unsigned char *journalKey);
+  void SetStateClean(); // after a save
+  std::unique_ptr<ChangeJournal> m_journal;
+  std::unordered_set<pws_os::CUUID> m_journalUUIDs;
+  bool m_bJournalCheckpoint;
+
+  // See WriteFileAsync(). m_nModifications counts Execute(), Undo()
+  // and Redo(), to tell if the database is still as it was saved.
+  struct AsyncSave;
+  int CompleteAsyncSave(bool bStartQueued);
+  // With PWSprefs::LazyAttachments, attachments' content is left in the
+  // file by ReadFile(). Before the file's rewritten, it has to be loaded.
+  // Those whose content's no longer there are reported, and returned, to
+  // be left out of the save rather than fail it.
+  std::set<pws_os::CUUID> LoadAttachments() const;
+  std::unique_ptr<AsyncSave> m_asyncSave;
+  bool m_bAsyncSaveQueued;
+  unsigned m_nModifications;
   bool m_bUniqueGTUValidated;
   bool m_bNotifyDB;
   bool m_bIsOpen;
@@ -653,6 +755,18 @@ private:
   void RemoveExpiryEntry(const CItemData &ci)
   {m_ExpireCandidates.Remove(ci);}
 
+  // Entries by (keyed hash of) group/title/user, for Find() & MakeEntryUnique()
+  GTUIndex m_GTUIndex;
+  // Entries by group path, for group operations
+  GroupTree m_GroupTree;
+  // Decrypted group/title/user for display, see GetDisplayField()
+  DisplayFieldCache m_DisplayCache;
+  void IndexEntry(const CItemData &ci)
+  {m_GTUIndex.Add(ci); m_GroupTree.Add(ci.GetGroup(), ci.GetUUID());}
+  void UnindexEntry(const CItemData &ci)
+  {m_GTUIndex.Remove(ci); m_GroupTree.Remove(ci.GetGroup(), ci.GetUUID());
+   m_DisplayCache.Remove(ci.GetUUID());}
+
   stringT GetXMLPWPolicies(const OrderedItemList *pOIL = nullptr);
   PSWDPolicyMap m_MapPSWDPLC;
   PSWDPolicyMap m_InitialMapPSWDPLC;  // Needed for HavePasswordPolicyNamesChanged
@@ -16,7 +16,14 @@
 #include "crypto/sha1.h" // for simple encrypt/decrypt
 #include "PWSrand.h"
 
+#include <algorithm>
 #include <cerrno>
+#include <condition_variable>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <new>
+#include <thread>
 
 PWSfile *PWSfile::MakePWSfile(const StringX &a_filename, const StringX &passkey,
                               VERSION &version, RWmode mode, int &status,
@@ -100,7 +107,9 @@ PWSfile::PWSfile(const StringX &filename, RWmode mode, VERSION v)
   : m_filename(filename), m_passkey(_T("")), m_fd(nullptr),
   m_curversion(v), m_rw(mode), m_defusername(_T("")),
   m_fish(nullptr), m_terminal(nullptr), m_status(SUCCESS),
-  m_nRecordsWithUnknownFields(0)
+  m_nRecordsWithUnknownFields(0), m_bHeaderOnly(false),
+  m_readlen(0), m_readpos(0), m_readbase(0),
+  m_scratch(nullptr), m_scratchLen(0), m_writelen(0), m_bSyncOnClose(false)
 {
 }
 
@@ -146,33 +155,109 @@ int PWSfile::Close()
 {
   delete m_fish;
   m_fish = nullptr;
+  ClearReadBuffers();
   int rc(SUCCESS);
 
   if (m_fd != nullptr) {
+    const bool flushed = (m_rw != Write) ||
+      (FlushWrites() && (!m_bSyncOnClose || pws_os::FSync(m_fd)));
     rc = pws_os::FClose(m_fd, m_rw == Write);
     m_fd = nullptr;
+    if (!flushed)
+      rc = FAILURE;
   }
+  m_writebuf.reset(); // ciphertext, no need to trash
+  m_writelen = 0;
 
   return rc;
 }
 
+// Large enough that each flush is a single write(2) straight from here,
+// bypassing stdio's own buffer. A multiple of any block size.
+static const size_t WRITE_BUFFER_SIZE = 256 * 1024;
+
 size_t PWSfile::WriteCBC(unsigned char type, const unsigned char *data,
                          size_t length)
 {
   ASSERT(m_fish != nullptr && m_IV != nullptr);
-  return _writecbc(m_fd, data, length, type, m_fish, m_IV);
+  const unsigned int BS = m_fish->GetBlockSize();
+  // Length block, plus data rounded up to whole blocks (or one more,
+  // for an empty field with an 8-byte cipher)
+  const size_t maxlen = BS + ((length + BS - 1) / BS + 1) * BS;
+
+  if (maxlen > WRITE_BUFFER_SIZE) { // rare enough to not be worth staging
+    if (!FlushWrites())
+      throw(EIO); // as _writecbc does
+    return _writecbc(m_fd, data, length, type, m_fish, m_IV);
+  }
+
+  unsigned char *out = WriteSpace(maxlen);
+  if (out == nullptr)
+    throw(EIO);
+  const size_t retval = _writecbc(out, data, length, type, m_fish, m_IV);
+  m_writelen += retval;
+  return retval;
+}
+
+unsigned char *PWSfile::WriteSpace(size_t length)
+{
+  ASSERT(m_rw == Write && length <= WRITE_BUFFER_SIZE);
+  if (m_writelen + length > WRITE_BUFFER_SIZE && !FlushWrites())
+    return nullptr;
+  if (!m_writebuf)
+    m_writebuf.reset(new unsigned char[WRITE_BUFFER_SIZE]);
+  return m_writebuf.get() + m_writelen;
+}
+
+bool PWSfile::FlushWrites()
+{
+  if (m_writelen == 0)
+    return true;
+  const size_t nw = fwrite(m_writebuf.get(), 1, m_writelen, m_fd);
+  const bool retval = (nw == m_writelen);
+  m_writelen = 0;
+  return retval;
+}
+
+bool PWSfile::WriteBytes(const void *buffer, size_t length)
+{
+  if (length > WRITE_BUFFER_SIZE)
+    return FlushWrites() && fwrite(buffer, 1, length, m_fd) == length;
+
+  unsigned char *out = WriteSpace(length);
+  if (out == nullptr)
+    return false;
+  memcpy(out, buffer, length);
+  m_writelen += length;
+  return true;
+}
+
+size_t PWSfile::WriteBlocks(const unsigned char *buffer, size_t length,
+                            Fish *fish, unsigned char *cbcbuffer)
+{
+  // Chunks are whole blocks, so only the last one may be padded
+  const size_t chunk = WRITE_BUFFER_SIZE / 4;
+  size_t numWritten = 0, offset = 0;
+
+  do {
+    const size_t n = std::min(length - offset, chunk);
+    unsigned char *out = WriteSpace(n + fish->GetBlockSize());
+    if (out == nullptr)
+      throw(EIO); // as _writecbcRest does
+    const size_t nout = _writecbcRest(out, buffer + offset, n, fish, cbcbuffer);
+    m_writelen += nout;
+    numWritten += nout;
+    offset += n;
+  } while (offset < length);
+
+  return numWritten;
 }
 
 size_t PWSfile::ReadCBC(unsigned char &type, unsigned char* &data,
                         size_t &length)
 {
-  unsigned char *buffer = nullptr;
   size_t buffer_len = 0;
-  size_t retval;
-
-  ASSERT(m_fish != nullptr && m_IV != nullptr);
-  retval = _readcbc(m_fd, buffer, buffer_len, type,
-    m_fish, m_IV, m_terminal, m_fileLength);
+  const size_t retval = DecryptField(type, buffer_len);
 
   if (buffer_len > 0) {
     if (buffer_len < length || data == nullptr)
@@ -180,19 +265,267 @@ size_t PWSfile::ReadCBC(unsigned char &type, unsigned char* &data,
     // if buffer_len > length, data is truncated to length
     // probably an error.
     if (data != nullptr) {
-      memcpy(data, buffer, length);
-      trashMemory(buffer, buffer_len);
-      delete[] buffer;
+      memcpy(data, m_scratch, length);
     } else { // nullptr data means pass buffer directly to caller
-      data = buffer; // caller must trash & delete[]!
+      // caller must trash & delete[]! Same size & padding as _readcbc's
+      const unsigned int BS = m_fish->GetBlockSize();
+      const size_t alloc_len = (buffer_len / BS) * BS + 2 * BS;
+      data = new unsigned char[alloc_len];
+      memcpy(data, m_scratch, alloc_len);
     }
-  } else {
-    // no need to delete[] buffer, since _readcbc will not allocate if
-    // buffer_len is zero
+  }
+  if (retval > 0)
+    FieldRead(type, data, length);
+  return retval;
+}
+
+size_t PWSfile::ReadFieldInPlace(unsigned char &type, const unsigned char* &data,
+                                 size_t &length)
+{
+  const size_t retval = DecryptField(type, length);
+  data = (length > 0) ? m_scratch : nullptr;
+  if (retval > 0)
+    FieldRead(type, data, length);
+  return retval;
+}
+
+size_t PWSfile::DecryptField(unsigned char &type, size_t &length)
+{
+  ASSERT(m_fish != nullptr && m_IV != nullptr);
+  if (m_readbuf) {
+    const unsigned char *in = m_readbuf.get() + m_readpos;
+    const size_t retval = _readcbc(in, m_readbuf.get() + m_readlen,
+                                   m_scratch, m_scratchLen, length, type,
+                                   m_fish, m_IV, m_terminal, m_fileLength);
+    m_readpos = in - m_readbuf.get();
+    return retval;
+  }
+
+  // Not buffered: read via stdio, and move the result to m_scratch
+  unsigned char *buffer = nullptr;
+  const size_t retval = _readcbc(m_fd, buffer, length, type,
+                                 m_fish, m_IV, m_terminal, m_fileLength);
+  if (length > 0) {
+    const unsigned int BS = m_fish->GetBlockSize();
+    const size_t alloc_len = (length / BS) * BS + 2 * BS;
+    if (alloc_len > m_scratchLen) {
+      if (m_scratch != nullptr) {
+        trashMemory(m_scratch, m_scratchLen);
+        delete[] m_scratch;
+      }
+      m_scratch = new unsigned char[alloc_len];
+      m_scratchLen = alloc_len;
+    }
+    memcpy(m_scratch, buffer, alloc_len);
+    trashMemory(buffer, alloc_len);
+    delete[] buffer;
   }
   return retval;
 }
 
+bool PWSfile::NextRecordExtent(RecordExtent &extent)
+{
+  ASSERT(m_readbuf && m_fish != nullptr && m_IV != nullptr);
+  const unsigned int BS = m_fish->GetBlockSize();
+  if (BS != sizeof(extent.cbc))
+    return false;
+
+  const unsigned char *const end = m_readbuf.get() + m_readlen;
+  const unsigned char *p = m_readbuf.get() + m_readpos;
+  const unsigned char *prev = m_IV;
+  unsigned char block[sizeof(extent.cbc)];
+  unsigned char type;
+
+  extent.begin = p;
+  memcpy(extent.cbc, m_IV, BS);
+  do {
+    if (size_t(end - p) < BS ||
+        (m_terminal != nullptr && memcmp(p, m_terminal, BS) == 0))
+      return false;
+
+    // Just the length & type, as _readcbc() would see them
+    m_fish->Decrypt(p, block);
+    for (unsigned int i = 0; i < BS; i++)
+      block[i] ^= prev[i];
+    const size_t length = getInt32(block);
+    type = block[sizeof(int32)];
+    trashMemory(block, sizeof(block));
+
+    if (m_fileLength != 0 && length >= m_fileLength)
+      return false;
+    const size_t rest = (length > 11) ? length - 11 : 0; // 11 in the length block
+    const size_t nBlocks = 1 + (rest + BS - 1) / BS;
+    if (size_t(end - p) / BS < nBlocks)
+      return false; // truncated
+
+    prev = p + (nBlocks - 1) * BS;
+    p += nBlocks * BS;
+  } while (type != CItemData::END);
+
+  extent.end = p;
+  memcpy(m_IV, prev, BS);
+  m_readpos = p - m_readbuf.get();
+  return true;
+}
+
+int PWSfile::SkipField(unsigned char &type, size_t &length,
+                       unsigned char *head)
+{
+  ASSERT(m_fish != nullptr && m_IV != nullptr);
+  const unsigned int BS = m_fish->GetBlockSize();
+  unsigned char cipher[16], block[16];
+  if (BS != sizeof(block))
+    return FAILURE;
+
+  const long start = Tell();
+  if (start < 0 || ReadBytes(cipher, BS) != BS)
+    return TRUNCATED_FILE;
+  if (m_terminal != nullptr && memcmp(cipher, m_terminal, BS) == 0)
+    return END_OF_FILE;
+
+  // Just the length & type, as _readcbc() would see them
+  m_fish->Decrypt(cipher, block);
+  for (unsigned int i = 0; i < BS; i++)
+    block[i] ^= m_IV[i];
+  length = getInt32(block);
+  type = block[sizeof(int32)];
+  if (head != nullptr)
+    memcpy(head, block + sizeof(int32) + 1, 11);
+  trashMemory(block, sizeof(block));
+
+  if (m_fileLength != 0 && length >= m_fileLength)
+    return TRUNCATED_FILE;
+  const size_t rest = (length > 11) ? length - 11 : 0; // 11 in the length block
+  const size_t nBlocks = 1 + (rest + BS - 1) / BS;
+  if (nBlocks == 1) {
+    memcpy(m_IV, cipher, BS);
+    return SUCCESS;
+  }
+
+  // The next field's CBC'd with the last block of this one
+  const long last = start + long((nBlocks - 1) * BS);
+  if (m_fileLength != 0 && ulong64(last) + BS > m_fileLength)
+    return TRUNCATED_FILE;
+  if (!Seek(last) || ReadBytes(cipher, BS) != BS)
+    return TRUNCATED_FILE;
+  memcpy(m_IV, cipher, BS);
+  return SUCCESS;
+}
+
+PWSfile::ExtentReader::ExtentReader(const PWSfile &file)
+  : m_fish(file.m_fish), m_fileLength(file.m_fileLength),
+    m_in(nullptr), m_end(nullptr), m_scratch(nullptr), m_scratchLen(0)
+{
+}
+
+PWSfile::ExtentReader::~ExtentReader()
+{
+  if (m_scratch != nullptr) {
+    trashMemory(m_scratch, m_scratchLen);
+    delete[] m_scratch;
+  }
+  trashMemory(m_cbc, sizeof(m_cbc));
+}
+
+void PWSfile::ExtentReader::Start(const RecordExtent &extent)
+{
+  m_in = extent.begin;
+  m_end = extent.end;
+  memcpy(m_cbc, extent.cbc, sizeof(m_cbc));
+}
+
+size_t PWSfile::ExtentReader::ReadFieldInPlace(unsigned char &type,
+                                               const unsigned char* &data,
+                                               size_t &length)
+{
+  // No terminal block check: NextRecordExtent() has seen to that
+  const size_t retval = _readcbc(m_in, m_end, m_scratch, m_scratchLen, length,
+                                 type, m_fish, m_cbc, nullptr, m_fileLength);
+  data = (length > 0) ? m_scratch : nullptr;
+  return retval;
+}
+
+bool PWSfile::BufferRestOfFile()
+{
+  ASSERT(m_rw == Read && m_fd != nullptr && !m_readbuf);
+  const long pos = ftell(m_fd);
+  if (pos < 0 || ulong64(pos) > m_fileLength)
+    return false;
+  const size_t len = size_t(m_fileLength - ulong64(pos));
+
+  // If we can't have the memory, reading from m_fd still works
+  std::unique_ptr<unsigned char[]> buf(new (std::nothrow) unsigned char[len + 1]);
+  if (!buf)
+    return false;
+  const size_t nread = fread(buf.get(), 1, len, m_fd);
+  if (nread != len) {
+    fseek(m_fd, pos, SEEK_SET);
+    return false;
+  }
+  fseek(m_fd, pos, SEEK_SET);
+
+  m_readbuf = std::move(buf);
+  m_readlen = len;
+  m_readpos = 0;
+  m_readbase = pos;
+  return true;
+}
+
+long PWSfile::Tell() const
+{
+  if (m_readbuf)
+    return m_readbase + long(m_readpos);
+  return ftell(m_fd) + long(m_writelen);
+}
+
+bool PWSfile::Seek(long offset)
+{
+  if (m_readbuf) {
+    if (offset < m_readbase || size_t(offset - m_readbase) > m_readlen)
+      return false;
+    m_readpos = size_t(offset - m_readbase);
+    return true;
+  }
+  return fseek(m_fd, offset, SEEK_SET) == 0;
+}
+
+size_t PWSfile::ReadBytes(void *buffer, size_t length)
+{
+  if (m_readbuf) {
+    const size_t n = std::min(length, m_readlen - m_readpos);
+    memcpy(buffer, m_readbuf.get() + m_readpos, n);
+    m_readpos += n;
+    return n;
+  }
+  return fread(buffer, 1, length, m_fd);
+}
+
+size_t PWSfile::ReadBlocks(unsigned char *buffer, size_t length,
+                           Fish *fish, unsigned char *cbcbuffer)
+{
+  if (m_readbuf) {
+    const unsigned char *in = m_readbuf.get() + m_readpos;
+    const size_t retval = _readcbc(in, m_readbuf.get() + m_readlen,
+                                   buffer, length, fish, cbcbuffer);
+    m_readpos = in - m_readbuf.get();
+    return retval;
+  }
+  return _readcbc(m_fd, buffer, length, fish, cbcbuffer);
+}
+
+void PWSfile::ClearReadBuffers()
+{
+  m_readbuf.reset(); // ciphertext, no need to trash
+  m_readlen = m_readpos = 0;
+  m_readbase = 0;
+  if (m_scratch != nullptr) {
+    trashMemory(m_scratch, m_scratchLen);
+    delete[] m_scratch;
+    m_scratch = nullptr;
+  }
+  m_scratchLen = 0;
+}
+
 int PWSfile::CheckPasskey(const StringX &filename, const StringX &passkey, VERSION &version)
 {
   /**
@@ -240,7 +573,7 @@ void PWSfile::SetUnknownHeaderFields(UnknownFieldList &UHFL)
 
 long PWSfile::GetOffset() const
 {
-  long retval = ftell(m_fd);
+  long retval = Tell();
   ASSERT(ulong64(retval) <= pws_os::fileLength(m_fd));
   return retval;
 }
@@ -250,6 +583,7 @@ long PWSfile::GetOffset() const
 static const stringT CIPHERTEXT_SUFFIX(_T(".PSF"));
 
 size_t PWSfile::fileThresholdSize = std::numeric_limits<uint32>::max(); // files this size and above encrypted differently - configurable for testing
+size_t PWSfile::fileChunkSize = 4 * 1024 * 1024;
 
 
 static stringT ErrorMessages()
@@ -296,9 +630,216 @@ static stringT ErrorMessages()
 #undef max
 #endif
 
-#ifndef BUFSIZ
-#define BUFSIZ 2048
-#endif
+namespace {
+  // Reads a file a chunk at a time on a thread of its own, a couple of
+  // chunks ahead of the caller, so that reading overlaps with the
+  // caller's en/decrypting and writing. The file mustn't be otherwise
+  // used until this is destroyed.
+  class ReadAhead
+  {
+  public:
+    ReadAhead(FILE *in, size_t chunkSize);
+    ~ReadAhead(); // stops reading, wipes the chunks
+
+    ReadAhead(const ReadAhead &) = delete;
+    ReadAhead &operator=(const ReadAhead &) = delete;
+
+    // The next chunk read, valid until the next call. length is less
+    // than chunkSize only at the end of the file, 0 once past it.
+    // Returns nullptr if the file couldn't be read.
+    const unsigned char *Next(size_t &length);
+
+  private:
+    enum {NumChunks = 3}; // one with the caller, the rest read ahead
+    void Read(); // the reader thread
+
+    FILE *m_in;
+    const size_t m_chunkSize;
+    std::vector<unsigned char> m_chunks[NumChunks];
+    size_t m_lengths[NumChunks];
+    size_t m_numRead, m_numTaken; // chunks so far, chunk i in m_chunks[i % NumChunks]
+    bool m_done, m_failed, m_stop;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_thread;
+  };
+
+  ReadAhead::ReadAhead(FILE *in, size_t chunkSize)
+    : m_in(in), m_chunkSize(chunkSize), m_numRead(0), m_numTaken(0),
+      m_done(false), m_failed(false), m_stop(false)
+  {
+    for (auto &chunk : m_chunks)
+      chunk.resize(chunkSize);
+    m_thread = std::thread(&ReadAhead::Read, this);
+  }
+
+  ReadAhead::~ReadAhead()
+  {
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      m_stop = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+    for (auto &chunk : m_chunks)
+      trashMemory(chunk.data(), chunk.size());
+  }
+
+  void ReadAhead::Read()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+      // Not into the chunk the caller has, nor any it's yet to take
+      m_cv.wait(lock, [this] {return m_stop || m_numRead < m_numTaken + NumChunks - 1;});
+      if (m_stop)
+        return;
+      const size_t i = m_numRead % NumChunks;
+      lock.unlock();
+      const size_t n = fread(m_chunks[i].data(), 1, m_chunkSize, m_in);
+      const bool failed = ferror(m_in) != 0;
+      lock.lock();
+      m_lengths[i] = n;
+      m_numRead++;
+      m_failed = failed;
+      m_done = failed || n < m_chunkSize;
+      m_cv.notify_all();
+      if (m_done)
+        return;
+    }
+  }
+
+  const unsigned char *ReadAhead::Next(size_t &length)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this] {return m_numTaken < m_numRead || m_done;});
+    if (m_failed)
+      return nullptr;
+    length = 0;
+    if (m_numTaken == m_numRead) // done
+      return m_chunks[0].data();
+    const size_t i = m_numTaken++ % NumChunks;
+    length = m_lengths[i];
+    m_cv.notify_all();
+    return m_chunks[i].data();
+  }
+
+  // As CBC decryption of a block needs only its ciphertext and its
+  // predecessor's, len bytes of in can be split between threads.
+  // Threads only pay for themselves with enough blocks to go round.
+  void DecryptBlocks(const unsigned char *in, unsigned char *out, size_t len,
+                     Fish *fish, unsigned char *cbcbuffer)
+  {
+    const unsigned int BS = fish->GetBlockSize();
+    const size_t MinBytesPerThread = 256 * 1024;
+    const unsigned ncpu = std::thread::hardware_concurrency();
+    size_t nThreads = (ncpu > 8) ? 8 : ((ncpu > 1) ? ncpu : 1);
+    if (nThreads > len / MinBytesPerThread)
+      nThreads = (len / MinBytesPerThread > 0) ? len / MinBytesPerThread : 1;
+
+    const size_t perThread = ((len / BS + nThreads - 1) / nThreads) * BS;
+    auto decrypt = [in, out, len, fish, BS, perThread](size_t begin, const unsigned char *prev) {
+      const size_t end = (len - begin < perThread) ? len : begin + perThread;
+      unsigned char cbc[16];
+      memcpy(cbc, prev, BS);
+      const unsigned char *p = in + begin;
+      _readcbc(p, in + end, out + begin, end - begin, fish, cbc);
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t begin = perThread; begin < len; begin += perThread)
+      threads.emplace_back(decrypt, begin, in + begin - BS);
+    decrypt(0, cbcbuffer);
+    for (auto &thread : threads)
+      thread.join();
+    if (len > 0)
+      memcpy(cbcbuffer, in + len - BS, BS);
+  }
+
+  // Chunks a multiple of the block size, and no bigger than need be
+  // for a small file (but with room to see its end)
+  size_t ChunkSize(size_t length, unsigned int BS)
+  {
+    size_t chunkSize = (PWSfile::fileChunkSize / BS) * BS;
+    if (chunkSize == 0)
+      chunkSize = BS;
+    const size_t needed = (length / BS + 1) * BS;
+    return (needed < chunkSize) ? needed : chunkSize;
+  }
+
+  // The main loop of PWSfile::Encrypt(): encrypts all of in, file_len
+  // bytes long, to out, a chunk at a time.
+  // Returns false if in can't be read, throws EIO if out can't be written.
+  bool EncryptChunks(FILE *in, FILE *out, size_t file_len,
+                     Fish *fish, unsigned char *ivthing, bool isBigFile)
+  {
+    const unsigned int BS = fish->GetBlockSize();
+    const size_t chunkSize = ChunkSize(file_len, BS);
+    ReadAhead reader(in, chunkSize);
+    std::vector<unsigned char> ciphertext(chunkSize + BS);
+
+    size_t nread;
+    const unsigned char *bufp = reader.Next(nread);
+    if (bufp == nullptr)
+      return false;
+
+    //write first block: length + dummy type +  bytes of data
+    size_t len = file_len;
+    if (_writecbc1st(out, &bufp, &len, 0, fish, ivthing, isBigFile) != BS)
+      return false;
+    nread -= file_len - len;
+    // The first chunk's written even if empty, for the padding
+    bool first = true;
+
+    do { // main read/encrypt/write loop
+      if (nread == 0 && !first) // save writing a block or two.
+        break;
+      const size_t n = _writecbcRest(ciphertext.data(), bufp, nread, fish, ivthing);
+      if (fwrite(ciphertext.data(), 1, n, out) != n)
+        throw(EIO);
+      first = false;
+    } while ((bufp = reader.Next(nread)) != nullptr);
+
+    return bufp != nullptr;
+  }
+
+  // The main loop of PWSfile::Decrypt(): decrypts the rest of in to out,
+  // plaintext_length bytes of it, a chunk at a time.
+  bool DecryptChunks(FILE *in, FILE *out, size_t plaintext_length,
+                     Fish *fish, unsigned char *ivthing)
+  {
+    const unsigned int BS = fish->GetBlockSize();
+    const size_t chunkSize = ChunkSize(plaintext_length, BS);
+    ReadAhead reader(in, chunkSize);
+    std::vector<unsigned char> plaintext(chunkSize);
+    size_t nleft = plaintext_length;
+    bool status = true;
+
+    for (;;) {
+      size_t nread;
+      const unsigned char *ciphertext = reader.Next(nread);
+      if (ciphertext == nullptr) {
+        status = false;
+        break;
+      }
+      nread = (nread / BS) * BS; // a partial block's no use
+      if (nread == 0) // no plaintext or we hit the exact end. In any case, break loop peacefully
+        break;
+      DecryptBlocks(ciphertext, plaintext.data(), nread, fish, ivthing);
+      // write plaintext
+      const size_t nwrite = nleft > nread ? nread : nleft;
+      if (fwrite(plaintext.data(), 1, nwrite, out) != nwrite) {
+        status = false;
+        break;
+      }
+      nleft -= nwrite;
+    }
+
+    trashMemory(plaintext.data(), plaintext.size());
+    if (nleft != 0) // truncated ciphertext?
+      status = false;
+    return status;
+  }
+} // anonymous namespace
 
 bool PWSfile::Encrypt(const stringT &fn, const StringX &passwd, stringT &errmess)
 {
@@ -309,11 +850,9 @@ bool PWSfile::Encrypt(const stringT &fn, const StringX &passwd, stringT &errmess
   unsigned char *pass = nullptr;
   unsigned char* ivthing = nullptr;
   size_t passlen = 0;
-  size_t file_len = 0, orig_filelen = 0;
-  size_t nread = 0;
+  size_t file_len = 0;
   unsigned char thesalt[SaltLength];
   unsigned int BS = 0;
-  const unsigned char* bufp = nullptr;
   bool isBigFile = false;
 
   
@@ -365,41 +904,11 @@ bool PWSfile::Encrypt(const stringT &fn, const StringX &passwd, stringT &errmess
   PWSrand::GetInstance()->GetRandomData(ivthing, BS);
   SAFE_FWRITE(ivthing, 1, BS, out)
 
-  unsigned char buf[BUFSIZ];
-  bufp = buf;
-  nread = fread(buf, 1, BUFSIZ, in);
-  orig_filelen = file_len;
-
   try {
-    //write first block: length + dummy type +  bytes of data
-    size_t nwritten = _writecbc1st(out, &bufp, &file_len, 0, fish, ivthing, isBigFile);
-    if (nwritten != BS) {
-      status = false;
-      goto exit;
-    }
-    // write rest of first buffer
-    nread -= orig_filelen - file_len;
-    nwritten = _writecbcRest(out, bufp, nread, fish, ivthing);
-    if (nwritten < nread) {
+    if (!EncryptChunks(in, out, file_len, fish, ivthing, isBigFile)) {
       status = false;
       goto exit;
     }
-
-
-    do { // main read/encrypt/write loop
-      nread = fread(buf, 1, BUFSIZ, in);
-      if (ferror(in)) { // this is how to detect fread errors
-       status = false;
-        goto exit;
-      }
-
-      if (nread == 0) // save writing a block or two.
-        break;
-
-      _writecbcRest(out, buf, nread, fish, ivthing);
-    
-    } while (!feof(in));
-
   } catch (...) { // _writecbc* throws an exception if it fails to write
     errno = EIO;
     status = false;
@@ -412,7 +921,6 @@ bool PWSfile::Encrypt(const stringT &fn, const StringX &passwd, stringT &errmess
   if (!status)
     errmess = ErrorMessages();
   delete fish;
-  trashMemory(buf, BUFSIZ);
   delete[] ivthing;
   pws_os::FClose(in, false);
   pws_os::FClose(out, true);
@@ -520,33 +1028,7 @@ bool PWSfile::Decrypt(const stringT &fn, const StringX &passwd, stringT &errmess
     }
 
     // now iterate over rest of file
-    unsigned char buf[BUFSIZ];
-    size_t nleft = plaintext_length;
-
-    do {
-      size_t nread = _readcbc(in, buf, BUFSIZ, fish, ivthing);
-      if (ferror(in)) {
-        delete fish;
-        status = false;
-        goto exit;
-      }
-      if (nread == 0) { // no plaintext or we hit the exact end. In any case, break loop peacefully
-        break;
-      }
-      // write plaintext
-      auto nwrite = nleft > BUFSIZ ? BUFSIZ : nleft;
-      if (fwrite(buf,1, nwrite, out) != nwrite) {
-        delete fish;
-        status = false;
-        goto exit;
-      }
-      nleft -= nwrite;
-    } while (!feof(in));
-
-    if (nleft != 0) {
-      // truncated ciphertext?
-      status = false;
-    }
+    status = DecryptChunks(in, out, plaintext_length, fish, ivthing);
     delete fish;
   } // write decrypted
  exit:
@@ -563,51 +1045,99 @@ bool PWSfile::Decrypt(const stringT &fn, const StringX &passwd, stringT &errmess
 // A quick way to determine if two files are equal, or if a given
 // file has been modified.
 
-// For large files (>2K), we only hash the head & tail of the file.
-// This is due to a performance trade-off.
-
-// For unencrypted file, only checking the head & tail of large files may
-// cause changes made to the middle of the file to be missed.
-// However, since we write encrypted in CBC mode, this means that if the file
-// was modified at offset X, then everything from X to the end of the file will
-// be modified and the digests would be different.
+// The whole file is hashed, so a change anywhere in it is seen. The
+// digest is cached by filename along with the file's FileStamp (inode,
+// mtime, size), and reused while the stamp's unchanged, so checking a
+// file that hasn't changed costs a stat() rather than a read.
+
+// Where mtime is coarse, a file rewritten, at the same size, within the
+// same tick as it was hashed would keep its stamp. So a cached digest is
+// only reused if the file was last modified at least SIG_RACY_SECS (2)
+// seconds before it was hashed; a younger file is hashed again each time.
+
+namespace {
+  // See PWSFileSig. A file changed within the same mtime tick as it was
+  // hashed would keep its stamp (on filesystems with coarse times), so
+  // a digest's only reused once the file's older than that.
+  struct SigCacheEntry {
+    pws_os::FileStamp stamp;
+    time_t hashed;
+    unsigned char digest[SHA256::HASHLEN];
+  };
+  const time_t SIG_RACY_SECS = 2;
+  std::mutex sigCacheMutex;
+  std::map<stringT, SigCacheEntry> sigCache;
+
+  // Returns bytes hashed, or -1 if fname can't be read. Read rather
+  // than mapped, so that a file truncated meanwhile just hashes short.
+  int64 HashFile(const stringT &fname, SHA256 &hash)
+  {
+    FILE *fp = pws_os::FOpen(fname, _T("rb"));
+    if (fp == nullptr)
+      return -1;
+    int64 total = 0;
+    unsigned char buf[64 * 1024];
+    size_t nRead;
+    while ((nRead = fread(buf, 1, sizeof(buf), fp)) > 0) {
+      hash.Update(buf, nRead);
+      total += nRead;
+    }
+    const bool bError = ferror(fp) != 0;
+    fclose(fp);
+    return bError ? -1 : total;
+  }
+}
 
 PWSFileSig::PWSFileSig(const stringT &fname)
 {
-  const long THRESHOLD = 2048; // if file's longer than this, hash only head & tail
-
   m_length = 0;
   m_iErrorCode = PWSfile::SUCCESS;
   memset(m_digest, 0, sizeof(m_digest));
-  FILE *fp = pws_os::FOpen(fname, _T("rb"));
-  if (fp != nullptr) {
-    SHA256 hash;
-    m_length = pws_os::fileLength(fp);
-    // Not the right place to be worried about min size, as this is format
-    // version specific (and we're in PWSFile).
-    // An empty file, though, should be failed.
-    if (m_length > 0) {
-      unsigned char buf[THRESHOLD];
-      if (m_length <= THRESHOLD) {
-        if (fread(buf, size_t(m_length), 1, fp) == 1) {
-          hash.Update(buf, size_t(m_length));
-          hash.Final(m_digest);
-        }
-      } else { // m_length > THRESHOLD
-        if (fread(buf, THRESHOLD / 2, 1, fp) == 1 &&
-            fseek(fp, -THRESHOLD / 2, SEEK_END) == 0 &&
-            fread(buf + THRESHOLD / 2, THRESHOLD / 2, 1, fp) == 1) {
-          hash.Update(buf, THRESHOLD);
-          hash.Final(m_digest);
-        }
-      }
-    } else { // Empty file
-      m_iErrorCode = PWSfile::TRUNCATED_FILE;
+
+  pws_os::FileStamp stamp;
+  if (!pws_os::GetFileStamp(fname, stamp)) {
+    m_iErrorCode = PWSfile::CANT_OPEN_FILE;
+    return;
+  }
+  // Not the right place to be worried about min size, as this is format
+  // version specific (and we're in PWSFile).
+  // An empty file, though, should be failed.
+  if (stamp.size == 0) {
+    m_iErrorCode = PWSfile::TRUNCATED_FILE;
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(sigCacheMutex);
+    auto cached = sigCache.find(fname);
+    if (cached != sigCache.end() && cached->second.stamp == stamp &&
+        stamp.mtime + SIG_RACY_SECS <= cached->second.hashed) {
+      m_length = stamp.size;
+      memcpy(m_digest, cached->second.digest, sizeof(m_digest));
+      return;
     }
+  }
 
-    fclose(fp);
-  } else {
+  const time_t hashed = time(nullptr);
+  SHA256 hash;
+  const int64 length = HashFile(fname, hash);
+  if (length < 0) {
     m_iErrorCode = PWSfile::CANT_OPEN_FILE;
+    return;
+  }
+  hash.Final(m_digest);
+  m_length = ulong64(length);
+
+  // Cache it, unless the file changed while we read it
+  pws_os::FileStamp after;
+  std::lock_guard<std::mutex> guard(sigCacheMutex);
+  if (pws_os::GetFileStamp(fname, after) && after == stamp && after.size == m_length) {
+    SigCacheEntry &entry = sigCache[fname];
+    entry.stamp = stamp;
+    entry.hashed = hashed;
+    memcpy(entry.digest, m_digest, sizeof(m_digest));
+  } else {
+    sigCache.erase(fname);
   }
 }
 
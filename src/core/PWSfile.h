@@ -14,6 +14,7 @@
 //-----------------------------------------------------------------------------
 
 #include <cstdio> // for FILE *
+#include <memory>
 #include <vector>
 
 #include "ItemData.h"
@@ -108,11 +109,14 @@ public:
   static bool Encrypt(const stringT &fn, const StringX &passwd, stringT &errmess);
   static bool Decrypt(const stringT &fn, const StringX &passwd, stringT &errmess);
   static size_t fileThresholdSize; // files this size and above encrypted differently - configurable for testing
+  static size_t fileChunkSize; // Encrypt/Decrypt read, crypt & write this much at a time - configurable for testing
 
   virtual ~PWSfile();
 
   virtual int Open(const StringX &passkey) = 0;
   virtual int Close();
+  // When writing, have Close() wait for the data to reach the disk
+  void SetSyncOnClose(bool bSync) {m_bSyncOnClose = bSync;}
 
   virtual int WriteRecord(const CItemData &item) = 0;
   virtual int ReadRecord(CItemData &item) = 0;
@@ -128,6 +132,7 @@ public:
   {return m_nRecordsWithUnknownFields;}
 
   long GetOffset() const;
+  ulong64 GetFileLength() const {return m_fileLength;} // as opened
   
   // Following implemented in V3 and later
   virtual uint32 GetNHashIters() const {return 0;}
@@ -153,7 +158,58 @@ public:
   size_t ReadField(unsigned char &type,
                    unsigned char* &data,
                    size_t &length) {return ReadCBC(type, data, length);}
-  
+  // As above, but data points to a buffer that's reused (and wiped) by
+  // this object, valid until the next read: no allocation per field.
+  size_t ReadFieldInPlace(unsigned char &type,
+                          const unsigned char* &data,
+                          size_t &length);
+
+  // Pipelined reading (see ReadPipeline): NextRecordExtent() locates the
+  // next record by decrypting just the first block of each of its fields,
+  // so that an ExtentReader can decrypt the rest on another thread.
+  // The fields thus read must be passed back, in file order, to
+  // RecordRead(). NextRecordExtent() returns false at the terminal block,
+  // or at anything amiss, leaving both for ReadRecord() to deal with.
+  struct RecordExtent {
+    const unsigned char *begin, *end; // ciphertext, valid until Close()
+    unsigned char cbc[16];            // CBC state at begin
+  };
+  virtual bool CanReadExtents() const {return false;}
+  bool NextRecordExtent(RecordExtent &extent);
+  // For counting records without reading them (see PWSfileV3::Peek()):
+  // decrypts just the first block of the next field, for its type,
+  // length and first 11 bytes of data (into head, if given), and skips
+  // the rest of it.
+  // Returns END_OF_FILE at the terminal block, TRUNCATED_FILE if the
+  // field's not all there.
+  int SkipField(unsigned char &type, size_t &length,
+                unsigned char *head = nullptr);
+  void RecordRead(const unsigned char *data, size_t length)
+  {FieldRead(CItemData::END, data, length);}
+
+  // One per thread; the file must stay open while in use
+  class ExtentReader
+  {
+  public:
+    ExtentReader(const PWSfile &file);
+    ~ExtentReader();
+    ExtentReader(const ExtentReader &) = delete;
+    ExtentReader &operator=(const ExtentReader &) = delete;
+
+    void Start(const RecordExtent &extent);
+    bool AtEnd() const {return m_in == m_end;}
+    // As PWSfile::ReadFieldInPlace()
+    size_t ReadFieldInPlace(unsigned char &type, const unsigned char* &data,
+                            size_t &length);
+  private:
+    Fish *m_fish;
+    const ulong64 m_fileLength;
+    const unsigned char *m_in, *m_end;
+    unsigned char m_cbc[16];
+    unsigned char *m_scratch;
+    size_t m_scratchLen;
+  };
+
 protected:
   PWSfile(const StringX &filename, RWmode mode, VERSION v = UNKNOWN_VERSION);
   void FOpen(); // calls right variant of m_fd = fopen(m_filename);
@@ -162,6 +218,31 @@ protected:
                           size_t length);
   virtual size_t ReadCBC(unsigned char &type, unsigned char* &data,
                          size_t &length);
+  // Called with each field ReadCBC() returns, e.g., to update an HMAC
+  virtual void FieldRead(unsigned char /*type*/, const unsigned char * /*data*/,
+                         size_t /*length*/) {}
+
+  // Once past the preamble, V3 and later read the rest of the file into
+  // memory in one go, and decrypt from there. The following then work on
+  // that buffer instead of m_fd, which is left where the buffer starts.
+  bool BufferRestOfFile();
+  bool IsBuffered() const {return m_readbuf != nullptr;}
+  long Tell() const;
+  bool Seek(long offset);
+  size_t ReadBytes(void *buffer, size_t length);
+  // Decrypts length bytes (a multiple of the block size) into buffer
+  size_t ReadBlocks(unsigned char *buffer, size_t length,
+                    Fish *fish, unsigned char *cbcbuffer);
+
+  // On write, ciphertext is staged in memory and written out a large
+  // chunk at a time, rather than block by block. Tell() includes what's
+  // pending. Close() flushes, so anything written directly to m_fd after
+  // the preamble must go through WriteBytes() to keep its place.
+  bool WriteBytes(const void *buffer, size_t length);
+  // Encrypts length bytes of buffer, CBC-style, without a length block
+  size_t WriteBlocks(const unsigned char *buffer, size_t length,
+                     Fish *fish, unsigned char *cbcbuffer);
+  bool FlushWrites();
 
   static void HashRandom256(unsigned char *p256); // when we don't want to expose our RNG
 
@@ -184,17 +265,35 @@ protected:
   PSWDPolicyMap m_MapPSWDPLC;
   std::vector<StringX> m_vEmptyGroups;
   ulong64 m_fileLength;
+  bool m_bHeaderOnly; // Open() just to Peek(): don't buffer the records
   Asker *m_pAsker;
   Reporter *m_pReporter;
 
 private:
   PWSfile& operator=(const PWSfile&) = delete; // Do not implement
+
+  // Decrypts next field into m_scratch, setting length
+  size_t DecryptField(unsigned char &type, size_t &length);
+  void ClearReadBuffers();
+
+  std::unique_ptr<unsigned char[]> m_readbuf; // ciphertext, if buffered
+  size_t m_readlen;  // bytes in m_readbuf
+  size_t m_readpos;  // next byte to read from m_readbuf
+  long m_readbase;   // file offset of m_readbuf[0]
+  unsigned char *m_scratch; // plaintext of last field read
+  size_t m_scratchLen;
+
+  unsigned char *WriteSpace(size_t length); // nullptr if write fails
+  std::unique_ptr<unsigned char[]> m_writebuf; // ciphertext pending write
+  size_t m_writelen; // bytes in m_writebuf
+  bool m_bSyncOnClose;
 };
 
 // A quick way to determine if two files are equal,
-// or if a given file has been modified. For large files,
-// this may miss changes made to the middle. This is due
-// to a performance trade-off.
+// or if a given file has been modified: its length and a
+// SHA-256 of all of it. Digests are cached by file, and not
+// recomputed while the file's FileStamp (inode, mtime, size)
+// stays the same, so checking an unchanged file costs a stat().
 class PWSFileSig
 {
 public:
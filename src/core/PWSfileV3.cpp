@@ -67,10 +67,21 @@ PWSfileV3::PWSfileV3(const StringX &filename, RWmode mode, VERSION version)
 {
   m_IV = m_ipthing;
   m_terminal = TERMINAL_BLOCK;
+  memset(m_journalKey, 0, sizeof(m_journalKey));
 }
 
 PWSfileV3::~PWSfileV3()
 {
+  trashMemory(m_journalKey, sizeof(m_journalKey));
+}
+
+void PWSfileV3::SetJournalKey(const unsigned char Ptag[SHA256::HASHLEN])
+{
+  // HMAC(P', "PWSJ"), so that the journal's key is no use for the file
+  static const unsigned char label[4] = {'P','W','S','J'};
+  HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> hmac(Ptag, SHA256::HASHLEN);
+  hmac.Update(label, sizeof(label));
+  hmac.Final(m_journalKey);
 }
 
 int PWSfileV3::Open(const StringX &passkey)
@@ -102,6 +113,35 @@ int PWSfileV3::Open(const StringX &passkey)
   return m_status;
 }
 
+int PWSfileV3::Peek(const StringX &passkey, size_t *numRecords)
+{
+  PWS_LOGIT;
+
+  ASSERT(m_rw == Read);
+  // Counting's quicker with the records in memory, which we can't
+  // be without anyway
+  m_bHeaderOnly = (numRecords == nullptr);
+  int status = Open(passkey);
+  if (status != SUCCESS)
+    return status;
+
+  if (numRecords != nullptr) {
+    size_t n = 0;
+    unsigned char type;
+    size_t length;
+    while ((status = SkipField(type, length)) == SUCCESS)
+      if (type == CItemData::END)
+        n++;
+    if (status == END_OF_FILE) {
+      *numRecords = n;
+      status = SUCCESS;
+    }
+  }
+
+  PWSfile::Close(); // no HMAC to check, as we've not read the records
+  return status;
+}
+
 int PWSfileV3::Close()
 {
   PWS_LOGIT;
@@ -120,14 +160,11 @@ int PWSfileV3::Close()
 
   // Write or verify HMAC, depending on RWmode.
   if (m_rw == Write) {
-    size_t fret;
-    fret = fwrite(TERMINAL_BLOCK, sizeof(TERMINAL_BLOCK), 1, m_fd);
-    if (fret != 1) {
+    if (!WriteBytes(TERMINAL_BLOCK, sizeof(TERMINAL_BLOCK))) {
       (void)PWSfile::Close();
       return FAILURE;
     }
-    fret = fwrite(digest, sizeof(digest), 1, m_fd);
-    if (fret != 1) {
+    if (!WriteBytes(digest, sizeof(digest))) {
       (void)PWSfile::Close();
       return FAILURE;
     }
@@ -136,7 +173,7 @@ int PWSfileV3::Close()
     // We're here *after* TERMINAL_BLOCK has been read
     // and detected (by _readcbc) - just read hmac & verify
     unsigned char d[SHA256::HASHLEN];
-    if (fread(d, sizeof(d), 1, m_fd) == 1 &&
+    if (ReadBytes(d, sizeof(d)) == sizeof(d) &&
         memcmp(d, digest, SHA256::HASHLEN) == 0)
       return PWSfile::Close();
     else {
@@ -288,16 +325,10 @@ int PWSfileV3::WriteRecord(const CItemData &item)
   return item.Write(this);
 }
 
-size_t PWSfileV3::ReadCBC(unsigned char &type, unsigned char* &data,
-                          size_t &length)
+void PWSfileV3::FieldRead(unsigned char , const unsigned char *data,
+                          size_t length)
 {
-  size_t numRead = PWSfile::ReadCBC(type, data, length);
-
-  if (numRead > 0) {
-    m_hmac.Update(data, static_cast<unsigned long>(length));
-  }
-
-  return numRead;
+  m_hmac.Update(data, static_cast<unsigned long>(length));
 }
 
 int PWSfileV3::ReadRecord(CItemData &item)
@@ -331,15 +362,11 @@ void PWSfileV3::StretchKey(const unsigned char *salt, unsigned long saltLen,
   delete[] pstr;
 
   ASSERT(N >= MIN_HASH_ITERATIONS); // minimal value we're willing to use
-  for (unsigned int i = 0; i < N; i++) {
-    SHA256 H;
-    // The 2nd param in next line was sizeof(X) in Beta-1
-    // (bug #1451422). This change broke the ability to read beta-1
-    // generated databases. If this is really needed, we should
-    // hack the read functionality to try both variants (ugh).
-    H.Update(X, SHA256::HASHLEN);
-    H.Final(X);
-  }
+  // X = H(X), N times. Each X is all SHA256::HASHLEN bytes: this was
+  // sizeof(X) in Beta-1 (bug #1451422). This change broke the ability
+  // to read beta-1 generated databases. If this is really needed, we
+  // should hack the read functionality to try both variants (ugh).
+  SHA256::Rehash(X, N);
 }
 
 // Following specific for PWSfileV3::WriteHeader
@@ -383,6 +410,7 @@ int PWSfileV3::WriteHeader()
   unsigned char Ptag[SHA256::HASHLEN];
 
   StretchKey(salt, sizeof(salt), m_passkey, NumHashIters, Ptag);
+  SetJournalKey(Ptag);
 
   {
     unsigned char HPtag[SHA256::HASHLEN];
@@ -441,8 +469,9 @@ int PWSfileV3::WriteHeader()
     m_hdr.m_file_uuid = uuid;
   }
 
-  numWritten = WriteCBC(HDR_UUID, *m_hdr.m_file_uuid.GetARep(),
-                        sizeof(uuid_array_t));
+  uuid_array_t file_uuid_array;
+  m_hdr.m_file_uuid.GetARep(file_uuid_array);
+  numWritten = WriteCBC(HDR_UUID, file_uuid_array, sizeof(uuid_array_t));
   if (numWritten <= 0) { m_status = FAILURE; goto end; }
 
   // Write (non default) user preferences
@@ -521,9 +550,10 @@ int PWSfileV3::WriteHeader()
     auto iter = m_hdr.m_RUEList.begin();
     // Only save up to max as defined by FormatV3.
     for (size_t n = 0; n < num; n++, iter++) {
-      const uuid_array_t *rep = iter->GetARep();
+      uuid_array_t rep;
+      iter->GetARep(rep);
       for (size_t i = 0; i < sizeof(uuid_array_t); i++) {
-        oss << setw(2) << setfill('0') << hex <<  static_cast<unsigned int>((*rep)[i]);
+        oss << setw(2) << setfill('0') << hex <<  static_cast<unsigned int>(rep[i]);
       }
     }
 
@@ -618,6 +648,7 @@ int PWSfileV3::ReadHeader()
   TwoFish TF(Ptag, sizeof(Ptag));
   TF.Decrypt(B1B2, m_key);
   TF.Decrypt(B1B2 + 16, m_key + 16);
+  SetJournalKey(Ptag);
 
   unsigned char L[32]; // for HMAC
   unsigned char B3B4[sizeof(L)];
@@ -636,6 +667,10 @@ int PWSfileV3::ReadHeader()
     return READ_FAIL;
   }
 
+  // Rest of the file's just fields, so read it all at once
+  if (!m_bHeaderOnly)
+    BufferRestOfFile();
+
   m_fish = new TwoFish(m_key, sizeof(m_key));
 
   unsigned char fieldType;
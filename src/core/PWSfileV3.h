@@ -36,23 +36,41 @@ public:
 
   virtual int WriteRecord(const CItemData &item);
   virtual int ReadRecord(CItemData &item);
+  virtual bool CanReadExtents() const {return IsBuffered();}
+
+  // Opens the file for its header only, e.g., for the properties of a
+  // database that's not open: checks passkey and reads the header, then,
+  // if numRecords isn't null, counts the records by skipping from field
+  // to field (see SkipField()), rather than decrypting them. Leaves the
+  // file closed without checking its HMAC, so neither header nor count
+  // are authenticated. Call instead of Open() on a file opened for Read.
+  int Peek(const StringX &passkey, size_t *numRecords = nullptr);
 
   virtual uint32 GetNHashIters() const {return m_nHashIters;}
   virtual void SetNHashIters(uint32 N) {m_nHashIters = N;}
 
+  // Once Open() has succeeded: a key for the database's ChangeJournal,
+  // derived from this version of the file's P', so that the journal
+  // needn't stretch the passkey again
+  void GetJournalKey(unsigned char key[SHA256::HASHLEN]) const
+  {memcpy(key, m_journalKey, sizeof(m_journalKey));}
+
  private:
+  friend class ChangeJournal; // for HashRandom256(), for its own header
+
   enum {PWSaltLength = 32}; // per format spec
   uint32 m_nHashIters;
   unsigned char m_ipthing[TwoFish::BLOCKSIZE]; // for CBC
   unsigned char m_key[32];
+  unsigned char m_journalKey[SHA256::HASHLEN]; // see GetJournalKey()
   HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> m_hmac;
   CUTF8Conv m_utf8conv;
   virtual size_t WriteCBC(unsigned char type, const StringX &data);
   virtual size_t WriteCBC(unsigned char type, const unsigned char *data,
                           size_t length);
 
-  virtual size_t ReadCBC(unsigned char &type, unsigned char* &data,
-                         size_t &length);
+  virtual void FieldRead(unsigned char type, const unsigned char *data,
+                         size_t length);
   int WriteHeader();
   int ReadHeader();
 
@@ -60,5 +78,6 @@ public:
   static void StretchKey(const unsigned char *salt, unsigned long saltLen,
                          const StringX &passkey,
                          uint32 N, unsigned char *Ptag);
+  void SetJournalKey(const unsigned char Ptag[SHA256::HASHLEN]);
 };
 #endif /* __PWSFILEV3_H */
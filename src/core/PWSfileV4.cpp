@@ -85,7 +85,8 @@ PWSfileV4::CKeyBlocks& PWSfileV4::CKeyBlocks::operator=(const PWSfileV4::CKeyBlo
 
 PWSfileV4::PWSfileV4(const StringX &filename, RWmode mode, VERSION version)
   : PWSfile(filename, mode, version),
-    m_effectiveFileLength(0), m_nHashIters(MIN_HASH_ITERATIONS)
+    m_effectiveFileLength(0), m_nHashIters(MIN_HASH_ITERATIONS),
+    m_contentLeft(0), m_bLazyContent(false)
 {
   m_IV = m_ipthing;
   m_terminal = nullptr;
@@ -98,6 +99,7 @@ PWSfileV4::~PWSfileV4()
 {
   trashMemory(m_key, sizeof(m_key));
   trashMemory(m_ell, sizeof(m_ell));
+  trashMemory(m_contentCBC, sizeof(m_contentCBC));
 }
 
 int PWSfileV4::Open(const StringX &passkey)
@@ -144,6 +146,67 @@ int PWSfileV4::Open(const StringX &passkey)
   return status;
 }
 
+int PWSfileV4::Peek(const StringX &passkey, size_t *numEntries,
+                    size_t *numAttachments)
+{
+  PWS_LOGIT;
+
+  ASSERT(m_rw == Read);
+  // Mostly attachments' content, so read as needed, whether counting or not
+  m_bHeaderOnly = true;
+  int status = Open(passkey);
+  if (status != SUCCESS)
+    return status;
+
+  if (numEntries != nullptr || numAttachments != nullptr) {
+    size_t nEntries = 0, nAtts = 0;
+    bool isAtt = false;
+    unsigned char type;
+    size_t length;
+    unsigned char head[11];
+    while (ulong64(Tell()) < m_effectiveFileLength) {
+      status = SkipField(type, length, head);
+      if (status != SUCCESS)
+        break;
+      if (type == CItemAtt::END) {
+        if (isAtt)
+          nAtts++;
+        else
+          nEntries++;
+        isAtt = false;
+      } else if (type >= CItemAtt::START_ATT && type < CItemAtt::LAST_ATT) {
+        isAtt = true;
+        // The content follows its length field, encrypted apart
+        if (type == CItemAtt::CONTENT) {
+          if (length != sizeof(uint32)) {
+            status = READ_FAIL;
+            break;
+          }
+          const size_t clen = static_cast<size_t>(getInt32(head));
+          if (clen > 0 && SkipContent(clen) < 0) {
+            status = TRUNCATED_FILE;
+            break;
+          }
+        }
+      }
+    }
+    trashMemory(head, sizeof(head));
+    if (status == SUCCESS && ulong64(Tell()) != m_effectiveFileLength)
+      status = READ_FAIL;
+    if (status == SUCCESS) {
+      if (numEntries != nullptr)
+        *numEntries = nEntries;
+      if (numAttachments != nullptr)
+        *numAttachments = nAtts;
+    }
+  }
+
+  // No HMAC to check, as we've not read the records
+  m_keyblocks.m_kbs.clear();
+  PWSfile::Close();
+  return status;
+}
+
 int PWSfileV4::Close()
 {
   PWS_LOGIT;
@@ -165,8 +228,7 @@ int PWSfileV4::Close()
   // Write or verify HMAC, depending on RWmode.
   size_t fret;
   if (m_rw == Write) {
-    fret = fwrite(digest, sizeof(digest), 1, m_fd);
-    if (fret != 1) {
+    if (!WriteBytes(digest, sizeof(digest))) {
       PWSfile::Close();
       return FAILURE;
     }
@@ -176,8 +238,8 @@ int PWSfileV4::Close()
     m_keyblocks.m_kbs.clear();
     // read hmac & verify
     unsigned char d[SHA256::HASHLEN];
-    fret = fread(d, sizeof(d), 1, m_fd);
-    if (fret != 1) {
+    fret = ReadBytes(d, sizeof(d));
+    if (fret != sizeof(d)) {
       PWSfile::Close();
       return TRUNCATED_FILE;
     }
@@ -277,88 +339,131 @@ size_t PWSfileV4::WriteContentFields(unsigned char *content, size_t len)
     return SUCCESS;
   ASSERT(content != nullptr);
 
-  unsigned char IV[TwoFish::BLOCKSIZE];
+  BeginContent(len);
+  WriteContent(content, len);
+  EndContent();
+  return len;
+}
+
+int PWSfileV4::BeginContent(size_t len)
+{
+  ASSERT(len > 0 && len <= 0xffffffffU);
+  ASSERT(m_contentFish == nullptr);
+  if (len == 0 || len > 0xffffffffU || m_contentFish != nullptr)
+    return FAILURE;
+
   unsigned char EK[KLEN];
   unsigned char AK[KLEN];
 
-  PWSrand::GetInstance()->GetRandomData(IV, sizeof(IV));
+  PWSrand::GetInstance()->GetRandomData(m_contentCBC, sizeof(m_contentCBC));
   PWSrand::GetInstance()->GetRandomData(EK, sizeof(EK));
   PWSrand::GetInstance()->GetRandomData(AK, sizeof(AK));
 
-  WriteField(CItemAtt::ATTIV, IV, sizeof(IV));
+  WriteField(CItemAtt::ATTIV, m_contentCBC, sizeof(m_contentCBC));
   WriteField(CItemAtt::ATTEK, EK, sizeof(EK));
   WriteField(CItemAtt::ATTAK, AK, sizeof(AK));
 
   // Write content length as the "value" of the content field
-  int32 len32 = static_cast<int>(len);
   unsigned char buf[4];
-  putInt32(buf, len32);
+  putInt32(buf, static_cast<int32>(len));
   WriteField(CItemAtt::CONTENT, buf, sizeof(buf));
 
   // Create fish with EK
-  TwoFish fish(EK, sizeof(EK));
+  m_contentFish.reset(new TwoFish(EK, sizeof(EK)));
   trashMemory(EK, sizeof(EK));
 
   // Create hmac with AK
-  HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> hmac;
-  hmac.Init(AK, sizeof(AK));
+  m_contentHMAC.Init(AK, sizeof(AK));
   trashMemory(AK, sizeof(AK));
 
-  // write actual content using EK
-  _writecbcRest(m_fd, content, len, &fish, IV); // length already written
+  m_contentLeft = len;
+  return SUCCESS;
+}
 
-  // update content's HMAC
-  hmac.Update(content, static_cast<unsigned long>(len));
+int PWSfileV4::WriteContent(const unsigned char *content, size_t len)
+{
+  ASSERT(m_contentFish != nullptr && len <= m_contentLeft);
+  // Only the last piece may be padded
+  ASSERT(len == m_contentLeft || len % TwoFish::BLOCKSIZE == 0);
+  if (m_contentFish == nullptr || len > m_contentLeft ||
+      (len != m_contentLeft && len % TwoFish::BLOCKSIZE != 0))
+    return FAILURE;
+  if (len == 0)
+    return SUCCESS;
+
+  // write actual content using EK, update content's HMAC
+  WriteBlocks(content, len, m_contentFish.get(), m_contentCBC);
+  m_contentHMAC.Update(content, static_cast<unsigned long>(len));
+  m_contentLeft -= len;
+  return SUCCESS;
+}
+
+int PWSfileV4::EndContent()
+{
+  ASSERT(m_contentFish != nullptr);
+  if (m_contentFish == nullptr)
+    return FAILURE;
+  m_contentFish.reset();
+  trashMemory(m_contentCBC, sizeof(m_contentCBC));
 
-  // write content's HMAC
   unsigned char digest[SHA256::HASHLEN];
-  hmac.Final(digest);
-  WriteField(CItemAtt::CONTENTHMAC, digest, sizeof(digest));
+  m_contentHMAC.Final(digest);
+  if (m_contentLeft != 0) { // the file's no good now anyway
+    m_contentLeft = 0;
+    return FAILURE;
+  }
 
-  return len;
+  // write content's HMAC
+  WriteField(CItemAtt::CONTENTHMAC, digest, sizeof(digest));
+  return SUCCESS;
 }
 
 size_t PWSfileV4::ReadContent(Fish *fish,  unsigned char *cbcbuffer,
-                              unsigned char *&content, size_t clen)
+                              unsigned char *content, size_t clen)
 {
   ASSERT(clen > 0 && fish != nullptr && cbcbuffer != nullptr);
-  // round up clen to nearest BS:
+  // round up clen to nearest BS, as written by EncryptCBC()
   const unsigned int BS = fish->GetBlockSize();
-  size_t blen = (clen/BS + 1)*BS;
+  const size_t blen = ((clen + BS - 1)/BS)*BS;
 
-  content = new unsigned char[blen]; // caller's responsible for delete[]
-  return _readcbc(m_fd, content, blen, fish, cbcbuffer);
+  return ReadBlocks(content, blen, fish, cbcbuffer);
 }
 
-size_t PWSfileV4::ReadCBC(unsigned char &type, unsigned char* &data,
-                          size_t &length)
+long PWSfileV4::SkipContent(size_t clen)
 {
-  size_t numRead = PWSfile::ReadCBC(type, data, length);
-
-  if (numRead > 0) {
-    int32 len32 = static_cast<int>(length);
-    unsigned char buf[4];
-    putInt32(buf, len32);
+  ASSERT(clen > 0 && m_rw == Read);
+  const unsigned int BS = TwoFish::BLOCKSIZE;
+  const ulong64 blen = ((clen + BS - 1)/BS)*BS;
+
+  const long offset = Tell();
+  if (offset < 0 || ulong64(offset) + blen > m_effectiveFileLength ||
+      !Seek(long(offset + blen)))
+    return -1;
+  return offset;
+}
 
-    m_hmac.Update(&type, 1);
-    m_hmac.Update(buf, sizeof(buf));
-    m_hmac.Update(data, static_cast<unsigned long>(length));
-  }
+void PWSfileV4::FieldRead(unsigned char type, const unsigned char *data,
+                          size_t length)
+{
+  int32 len32 = static_cast<int>(length);
+  unsigned char buf[4];
+  putInt32(buf, len32);
 
-  return numRead;
+  m_hmac.Update(&type, 1);
+  m_hmac.Update(buf, sizeof(buf));
+  m_hmac.Update(data, static_cast<unsigned long>(length));
 }
 
 void PWSfileV4::SaveState()
 {
-  m_savepos = ftell(m_fd);
+  m_savepos = Tell();
   memcpy(m_saveIV, m_IV, m_fish->GetBlockSize());
   m_savehmac = m_hmac;
 }
 
 void PWSfileV4::RestoreState()
 {
-  int seekstat = fseek(m_fd, m_savepos, SEEK_SET);
-  if (seekstat != 0)
+  if (!Seek(m_savepos))
     ASSERT(0);
   memcpy(m_IV, m_saveIV, m_fish->GetBlockSize());
   m_hmac = m_savehmac;
@@ -370,7 +475,7 @@ int PWSfileV4::ReadRecord(CItemData &item)
   ASSERT(m_fd != nullptr);
   ASSERT(m_curversion == V40);
   SaveState();
-  unsigned fpos = unsigned(ftell(m_fd));
+  unsigned fpos = unsigned(Tell());
   if (fpos < m_effectiveFileLength) {
     status = item.Read(this);
     if (status < 0) { // detected an inappropriate field
@@ -407,9 +512,37 @@ void PWSfileV4::StretchKey(const unsigned char *salt, unsigned long saltLen,
   size_t passLen = 0;
   unsigned char *pstr = nullptr;
 
-  HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> hmac;
   ConvertPasskey(passkey, pstr, passLen);
-  pbkdf2(pstr, static_cast<unsigned long>(passLen), salt, saltLen, N, &hmac, Ptag, &PtagLen);
+  if (PtagLen == SHA256::HASHLEN) { // as always here
+    pbkdf2_sha256(pstr, static_cast<unsigned long>(passLen), &salt, saltLen, &N, 1,
+                  reinterpret_cast<unsigned char (*)[SHA256::HASHLEN]>(Ptag));
+  } else {
+    HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> hmac;
+    pbkdf2(pstr, static_cast<unsigned long>(passLen), salt, saltLen, N, &hmac, Ptag, &PtagLen);
+  }
+
+#ifdef UNICODE
+  trashMemory(pstr, passLen);
+  delete[] pstr;
+#endif
+}
+
+void PWSfileV4::StretchKeys(const StringX &passkey, const CKeyBlocks::KeyBlock *kbs,
+                            size_t n, unsigned char (*Ptags)[SHA256::HASHLEN])
+{
+  std::vector<const unsigned char *> salts(n);
+  std::vector<unsigned int> counts(n);
+  for (size_t i = 0; i < n; i++) {
+    ASSERT(kbs[i].m_nHashIters >= MIN_HASH_ITERATIONS);
+    salts[i] = kbs[i].m_salt;
+    counts[i] = kbs[i].m_nHashIters;
+  }
+  size_t passLen = 0;
+  unsigned char *pstr = nullptr;
+
+  ConvertPasskey(passkey, pstr, passLen);
+  pbkdf2_sha256(pstr, static_cast<unsigned long>(passLen), salts.data(),
+                CKeyBlocks::PWSaltLength, counts.data(), n, Ptags);
 
 #ifdef UNICODE
   trashMemory(pstr, passLen);
@@ -419,30 +552,68 @@ void PWSfileV4::StretchKey(const unsigned char *salt, unsigned long saltLen,
 
 const short VersionNum = 0x0400;
 
-struct PWSfileV4::CKeyBlocks::KeyBlockFinder {
-  KeyBlockFinder(const KeyBlockFinder&) = default;
-  KeyBlockFinder(const StringX &passkey) : passkey(passkey) {}
-
-  bool operator()(const KeyBlock &kb) {
-    unsigned char Ptag[SHA256::HASHLEN];
-    unsigned char K[PWSfileV4::KLEN];
-    PWSfileV4::StretchKey(kb.m_salt, sizeof(kb.m_salt), passkey, kb.m_nHashIters,
-                          Ptag, sizeof(Ptag));
-    // Try to unwrap K
-    TwoFish Fish(Ptag, sizeof(Ptag)); // XXX generalize to support AES as well
-    KeyWrap kwK(&Fish);
-    
-    bool retval = kwK.Unwrap(kb.m_kw_k, K, sizeof(kb.m_kw_k));
-    if (retval) {
-      trashMemory(Ptag, sizeof(Ptag));
-      trashMemory(K, sizeof(K));
+bool PWSfileV4::CKeyBlocks::KeyBlock::Unwrap(const unsigned char Ptag[SHA256::HASHLEN],
+                                             unsigned char K[KLEN], unsigned char *L) const
+{
+  TwoFish Fish(Ptag, SHA256::HASHLEN); // XXX generalize to support AES as well
+  KeyWrap kwK(&Fish);
+  if (!kwK.Unwrap(m_kw_k, K, sizeof(m_kw_k)))
+    return false;
+  if (L != nullptr) {
+    KeyWrap kwL(&Fish);
+    if (!kwL.Unwrap(m_kw_l, L, sizeof(m_kw_l))) {
+      ASSERT(0); // Shouldn't happen if K unwrapped OK
+      return false;
     }
-    return retval;
   }
-private:
-  KeyBlockFinder& operator=(const KeyBlockFinder&) = delete; // Do not implement
-  const StringX &passkey;
-};
+  return true;
+}
+
+unsigned PWSfileV4::CKeyBlocks::FindKeyBlock(const StringX &passkey, unsigned first,
+                                             unsigned char Ptag[SHA256::HASHLEN]) const
+{
+  // Every lane of a pbkdf2_sha256() batch runs to the batch's largest
+  // iteration count, so where it has more than one lane, try the key blocks
+  // in order of iteration count, batching those that are alike. A match is
+  // only returned once every key block before it has been tried.
+  const size_t width = pbkdf2_sha256_width();
+  std::vector<unsigned> order;
+  for (unsigned i = first; i < size(); i++)
+    order.push_back(i);
+  if (width > 1)
+    std::stable_sort(order.begin(), order.end(), [this](unsigned a, unsigned b) {
+      return m_kbs[a].m_nHashIters < m_kbs[b].m_nHashIters;
+    });
+
+  std::vector<KeyBlock> batch;
+  batch.reserve(width);
+  std::vector<unsigned char> buf(width * SHA256::HASHLEN);
+  auto Ptags = reinterpret_cast<unsigned char (*)[SHA256::HASHLEN]>(buf.data());
+  unsigned char K[KLEN];
+  std::vector<bool> tried(size(), false);
+  unsigned found = size(), untried = first;
+
+  for (size_t begin = 0; begin < order.size() && untried < found; begin += width) {
+    const size_t n = std::min(width, order.size() - begin);
+    batch.assign(n, KeyBlock());
+    for (size_t i = 0; i < n; i++)
+      batch[i] = m_kbs[order[begin + i]];
+    PWSfileV4::StretchKeys(passkey, batch.data(), n, Ptags);
+    for (size_t i = 0; i < n; i++) {
+      const unsigned kb = order[begin + i];
+      tried[kb] = true;
+      if (kb < found && m_kbs[kb].Unwrap(Ptags[i], K)) {
+        memcpy(Ptag, Ptags[i], SHA256::HASHLEN);
+        found = kb;
+      }
+    }
+    while (untried < found && tried[untried])
+      untried++;
+  }
+  trashMemory(buf.data(), buf.size());
+  trashMemory(K, sizeof(K));
+  return found;
+}
 
 bool PWSfileV4::CKeyBlocks::GetKeys(const StringX &passkey, uint32 nHashIters,
                                      unsigned char K[KLEN], unsigned char L[KLEN])
@@ -454,22 +625,14 @@ bool PWSfileV4::CKeyBlocks::GetKeys(const StringX &passkey, uint32 nHashIters,
   if (m_kbs.empty())
     AddKeyBlock(passkey, passkey, nHashIters);
 
-  KeyBlockFinder find_kb(passkey);
-  auto kb_iter = find_if(m_kbs.begin(), m_kbs.end(), find_kb);
-  if (kb_iter == m_kbs.end())
+  unsigned char Ptag[SHA256::HASHLEN];
+  const unsigned i = FindKeyBlock(passkey, 0, Ptag);
+  if (i == size())
     return false;
 
-  unsigned char Ptag[SHA256::HASHLEN];
-  PWSfileV4::StretchKey(kb_iter->m_salt, sizeof(kb_iter->m_salt),
-                        passkey, kb_iter->m_nHashIters,
-                        Ptag, sizeof(Ptag));
-  TwoFish Fish(Ptag, sizeof(Ptag)); // XXX generalize to support AES as well
-  KeyWrap kwK(&Fish);
-  if (!kwK.Unwrap(kb_iter->m_kw_k, K, sizeof(kb_iter->m_kw_k)))
-    ASSERT(0);
-  KeyWrap kwL(&Fish);
-  if (!kwL.Unwrap(kb_iter->m_kw_l, L, sizeof(kb_iter->m_kw_l)))
+  if (!m_kbs[i].Unwrap(Ptag, K, L))
     ASSERT(0);
+  trashMemory(Ptag, sizeof(Ptag));
   return true;
 }
 
@@ -595,8 +758,9 @@ int PWSfileV4::WriteHeader()
     m_hdr.m_file_uuid = uuid;
   }
 
-  numWritten = WriteCBC(HDR_UUID, *m_hdr.m_file_uuid.GetARep(),
-                        sizeof(uuid_array_t));
+  uuid_array_t file_uuid_array;
+  m_hdr.m_file_uuid.GetARep(file_uuid_array);
+  numWritten = WriteCBC(HDR_UUID, file_uuid_array, sizeof(uuid_array_t));
   if (numWritten <= 0) { status = FAILURE; goto end; }
 
   // Write (non default) user preferences
@@ -677,7 +841,8 @@ int PWSfileV4::WriteHeader()
     auto iter = m_hdr.m_RUEList.begin();
     
     for (size_t n = 0; n < num; n++, iter++) {
-      const uuid_array_t *rep = iter->GetARep();
+      uuid_array_t rep;
+      iter->GetARep(rep);
       memcpy(buf_ptr, rep, sizeof(uuid_array_t));
       buf_ptr += sizeof(uuid_array_t);
     }
@@ -811,31 +976,6 @@ int PWSfileV4::ReadKeyBlock()
   return SUCCESS;
 }
 
-int PWSfileV4::TryKeyBlock(unsigned index, const StringX &passkey,
-                           unsigned char K[KLEN], unsigned char L[KLEN],
-                           uint32 &nHashIters)
-{
-  CKeyBlocks::KeyBlock &kb = m_keyblocks.at(index);
-  unsigned char Ptag[SHA256::HASHLEN];
-
-  StretchKey(kb.m_salt, sizeof(kb.m_salt), passkey, kb.m_nHashIters,
-             Ptag, sizeof(Ptag));
-  // Try to unwrap K
-  TwoFish Fish(Ptag, sizeof(Ptag)); // XXX generalize to support AES as well
-  KeyWrap kwK(&Fish);
-
-  if (!kwK.Unwrap(kb.m_kw_k, K, sizeof(kb.m_kw_k)))
-    return WRONG_PASSWORD;
-      
-  KeyWrap kwL(&Fish);
-  if (!kwL.Unwrap(kb.m_kw_l, L, sizeof(kb.m_kw_l))) {
-    ASSERT(0); // Shouln't happen if K unwrapped OK
-    return WRONG_PASSWORD;
-  }
-  nHashIters = kb.m_nHashIters;
-  return SUCCESS;
-}
-
 bool PWSfileV4::VerifyKeyBlocks()
 {
   unsigned char hnonce[SHA256::HASHLEN];
@@ -897,14 +1037,19 @@ int PWSfileV4::ParseKeyBlocks(const StringX &passkey)
     }
   } while (!EndKeyBlocks(calc_hnonce));
 
-  for (unsigned i = 0; i < m_keyblocks.size(); i++) {
-    status = TryKeyBlock(i, passkey, m_key, m_ell, m_nHashIters);
-    if (status == SUCCESS) {
-      if (!VerifyKeyBlocks())
-        status = BAD_DIGEST;
-      break;
-    }
+  unsigned char Ptag[SHA256::HASHLEN];
+  const unsigned i = m_keyblocks.FindKeyBlock(passkey, 0, Ptag);
+  if (i == m_keyblocks.size())
+    return WRONG_PASSWORD;
+
+  if (m_keyblocks[i].Unwrap(Ptag, m_key, m_ell)) {
+    m_nHashIters = m_keyblocks[i].m_nHashIters;
+    if (!VerifyKeyBlocks())
+      status = BAD_DIGEST;
+  } else {
+    status = WRONG_PASSWORD;
   }
+  trashMemory(Ptag, sizeof(Ptag));
   return status;
 }
 
@@ -926,18 +1071,10 @@ bool PWSfileV4::CKeyBlocks::AddKeyBlock(const StringX &current_passkey,
     StretchKey(kb.m_salt, sizeof(kb.m_salt), current_passkey, kb.m_nHashIters,
                Ptag, sizeof(Ptag));
   } else { // we need to get K & L from current
-    KeyBlockFinder find_kb(current_passkey);
-    auto kb_iter = find_if(m_kbs.begin(), m_kbs.end(), find_kb);
-    if (kb_iter == m_kbs.end())
+    const unsigned i = FindKeyBlock(current_passkey, 0, Ptag);
+    if (i == size())
       return false;
-    PWSfileV4::StretchKey(kb_iter->m_salt, sizeof(kb_iter->m_salt),
-                          current_passkey, kb_iter->m_nHashIters,
-                          Ptag, sizeof(Ptag));
-    TwoFish Fish(Ptag, sizeof(Ptag)); // XXX generalize to support AES as well
-    KeyWrap kwK(&Fish);
-    kwK.Unwrap(kb_iter->m_kw_k, K, sizeof(kb_iter->m_kw_k));
-    KeyWrap kwL(&Fish);
-    kwL.Unwrap(kb_iter->m_kw_l, L, sizeof(kb_iter->m_kw_l));
+    m_kbs[i].Unwrap(Ptag, K, L);
 
     StretchKey(kb.m_salt, sizeof(kb.m_salt), new_passkey, kb.m_nHashIters,
                Ptag, sizeof(Ptag));
@@ -965,10 +1102,19 @@ bool PWSfileV4::CKeyBlocks::RemoveKeyBlock(const StringX &passkey)
   if (m_kbs.size() <= 1)
     return false;
 
-  KeyBlockFinder find_kb(passkey);
+  std::vector<bool> matches(m_kbs.size(), false);
+  unsigned char Ptag[SHA256::HASHLEN];
+  for (unsigned i = FindKeyBlock(passkey, 0, Ptag); i < size();
+       i = FindKeyBlock(passkey, i + 1, Ptag))
+    matches[i] = true;
+  trashMemory(Ptag, sizeof(Ptag));
+
   const auto old_size = m_kbs.size();
-  m_kbs.erase(remove_if(m_kbs.begin(), m_kbs.end(), find_kb),
-               m_kbs.end());
+  size_t j = 0;
+  for (size_t i = 0; i < old_size; i++)
+    if (!matches[i])
+      m_kbs[j++] = m_kbs[i];
+  m_kbs.resize(j);
 
   return (m_kbs.size() != old_size);
 }
@@ -982,6 +1128,11 @@ int PWSfileV4::ReadHeader()
     return TRUNCATED_FILE;
   }
 
+  // Rest of the file's just fields (and the HMAC), so read it all at once,
+  // unless we're to skip the attachments' content
+  if (!m_bLazyContent && !m_bHeaderOnly)
+    BufferRestOfFile();
+
   m_fish = new TwoFish(m_key, sizeof(m_key));
 
   unsigned char fieldType;
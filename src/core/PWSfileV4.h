@@ -18,6 +18,7 @@
 #include "crypto/hmac.h"
 #include "UTF8Conv.h"
 
+#include <memory>
 #include <vector>
 
 class PWSfileV4 : public PWSfile
@@ -44,13 +45,40 @@ public:
   int WriteRecord(const CItemAtt &att);
   int ReadRecord(CItemAtt &att);
 
+  // As PWSfileV3::Peek(), counting entries and attachments separately.
+  // Attachments' content is skipped over, never read.
+  int Peek(const StringX &passkey, size_t *numEntries = nullptr,
+           size_t *numAttachments = nullptr);
+
   // Following writes AttIV, AttEK, AttAK, AttContent
   // and AttContentHMAC per format spec.
   // All except the content are generated internally.
   size_t WriteContentFields(unsigned char *content, size_t len);
-  // Following allocates content, caller responsible for deallocating
+  // Same, a piece at a time: BeginContent() writes the fields up to
+  // AttContent, WriteContent() encrypts the next piece of content
+  // (all pieces but the last a multiple of TwoFish::BLOCKSIZE long)
+  // and EndContent() writes the HMAC, computed along the way.
+  // EndContent() fails unless exactly len bytes were written.
+  int BeginContent(size_t len);
+  int WriteContent(const unsigned char *content, size_t len);
+  int EndContent();
+  // Reads and decrypts the next piece of content, clen bytes of it.
+  // All pieces but the last must be a multiple of the block size,
+  // and content must have room for clen rounded up to it.
   size_t ReadContent(Fish *fish, unsigned char *cbcbuffer,
-                     unsigned char *&content, size_t clen);
+                     unsigned char *content, size_t clen);
+
+  // With lazy content, attachments are read without their content,
+  // which is skipped and left to be loaded on first use (see
+  // CItemAtt::LoadContent()). As the file would mostly be content,
+  // it's then read as needed rather than all at once. Set before Open().
+  void SetLazyContent(bool lazy) {m_bLazyContent = lazy;}
+  bool IsLazyContent() const {return m_bLazyContent;}
+  // Skips the next clen bytes of content, as ReadContent() would read
+  // them. Returns the file offset they start at, -1 if they're not there.
+  long SkipContent(size_t clen);
+  // Where skipped content is to be loaded from
+  const StringX &GetFilename() const {return m_filename;}
 
   uint32 GetNHashIters() const {return m_nHashIters;}
   void SetNHashIters(uint32 N) {m_nHashIters = N;}
@@ -74,7 +102,6 @@ public:
     // ... or if passkey doesn't match.
   private:
     friend class PWSfileV4;
-    struct KeyBlockFinder; // fwd decl for functor
     // V4 Format constants:
     enum {PWSaltLength = 32,KWLEN = (KLEN + 8)};
     struct KeyBlock { // See formatV4.txt
@@ -85,8 +112,18 @@ public:
       uint32 m_nHashIters;
       unsigned char m_kw_k[KWLEN];
       unsigned char m_kw_l[KWLEN];
+      // Unwraps K (and L, if asked) with P', false if it's not this block's
+      bool Unwrap(const unsigned char Ptag[SHA256::HASHLEN],
+                  unsigned char K[KLEN], unsigned char *L = nullptr) const;
     };
     std::vector<KeyBlock> m_kbs;
+
+    // Index of the first key block from first on that passkey unwraps,
+    // with its P', or size() if none. Stretches passkey for as many of
+    // them at once as pbkdf2_sha256() does in about the time of one,
+    // batching key blocks with like iteration counts.
+    unsigned FindKeyBlock(const StringX &passkey, unsigned first,
+                          unsigned char Ptag[SHA256::HASHLEN]) const;
     
     bool GetKeys(const StringX &passkey, uint32 nHashIters,
                  unsigned char K[KLEN], unsigned char L[KLEN]); // not const
@@ -116,13 +153,16 @@ public:
   unsigned char m_ipthing[TwoFish::BLOCKSIZE]; // for CBC
   HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> m_hmac; // L
   CUTF8Conv m_utf8conv;
+  // Content being written between BeginContent() and EndContent()
+  std::unique_ptr<TwoFish> m_contentFish; // EK
+  unsigned char m_contentCBC[TwoFish::BLOCKSIZE];
+  HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> m_contentHMAC; // AK
+  size_t m_contentLeft;
+  bool m_bLazyContent;
   // Forward declaration of functors:
   struct KeyBlockWriter;
   int ParseKeyBlocks(const StringX &passkey);
   int ReadKeyBlock(); // can return SUCCESS or END_OF_FILE
-  int TryKeyBlock(unsigned index, const StringX &passkey,
-                  unsigned char K[KLEN], unsigned char L[KLEN],
-                  uint32 &nHashIters);
   void ComputeEndKB(const unsigned char hnonce[SHA256::HASHLEN],
                     unsigned char digest[SHA256::HASHLEN]);
   bool EndKeyBlocks(const unsigned char calc_hnonce[SHA256::HASHLEN]);
@@ -131,8 +171,8 @@ public:
   virtual size_t WriteCBC(unsigned char type, const unsigned char *data,
                           size_t length);
 
-  virtual size_t ReadCBC(unsigned char &type, unsigned char* &data,
-                         size_t &length);
+  virtual void FieldRead(unsigned char type, const unsigned char *data,
+                         size_t length);
 
   void GetCurrentKeys();
   bool WriteKeyBlocks();
@@ -152,5 +192,8 @@ public:
   static void StretchKey(const unsigned char *salt, unsigned long saltLen,
                          const StringX &passkey, uint32 N,
                          unsigned char *Ptag, unsigned long PtagLen);
+  // StretchKey() for n key blocks at once
+  static void StretchKeys(const StringX &passkey, const CKeyBlocks::KeyBlock *kbs,
+                          size_t n, unsigned char (*Ptags)[SHA256::HASHLEN]);
 };
 #endif /* __PWSFILEV4_H */
@@ -141,6 +141,9 @@ const PWSprefs::boolPref PWSprefs::m_bool_prefs[NumBoolPrefs] = {
   {_T("ExcludeFromClipboardHistory"), true, ptDatabase},    // database
   {_T("FindToolBarActive"), false, ptApplication},          // application
   {_T("ExcludeFromScreenCapture"), true, ptDatabase},       // database
+  {_T("UseSessionKeyring"), false, ptApplication},          // application
+  {_T("UseChangeJournal"), false, ptApplication},           // application
+  {_T("LazyAttachments"), false, ptApplication},            // application
 
 };
 
@@ -190,6 +193,8 @@ const PWSprefs::intPref PWSprefs::m_int_prefs[NumIntPrefs] = {
   {_T("WindowTransparency"), 0, ptApplication, 0, 50},              // application
   {_T("DefaultExpiryDays"), 90, ptApplication, 1, 3650},            // application
   {_T("DNDMaximumMemorySize"), 14000, ptApplication, -1, INT_MAX},   // application
+  {_T("DisplayCacheSize"), 0, ptApplication, 0, 1000000},           // application
+  {_T("DisplayCacheTTL"), 300, ptApplication, 1, 86400},            // application
 };
 
 const PWSprefs::stringPref PWSprefs::m_string_prefs[NumStringPrefs] = {
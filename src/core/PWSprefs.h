@@ -136,6 +136,9 @@ public:
     ExcludeFromClipboardHistory, // Windows only
     FindToolBarActive, // To persist Find toolbar's visibility
     ExcludeFromScreenCapture,
+    UseSessionKeyring, // Share one in-memory key among all entries of a database
+    UseChangeJournal, // Save Immediately appends changes to a journal, see ChangeJournal
+    LazyAttachments, // V4 attachments' content is loaded on first use, see CItemAtt
     NumBoolPrefs};
 
   enum IntPrefs {Column1Width, Column2Width, Column3Width, Column4Width,
@@ -149,6 +152,8 @@ public:
     AutotypeSelectAllKeyCode, AutotypeSelectAllModMask, //X only
     TreeFontPtSz, PasswordFontPtSz, NotesFontPtSz, AddEditFontPtSz, VKFontPtSz,
     WindowTransparency, DefaultExpiryDays, DNDMaxMemSize,
+    DisplayCacheSize, // Decrypted group/title/user values kept for display, 0 = off
+    DisplayCacheTTL, // Seconds a cached display value stays valid
     NumIntPrefs};
 
   enum StringPrefs {CurrentBackup, CurrentFile, LastView, DefaultUsername,
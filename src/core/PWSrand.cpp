@@ -50,6 +50,7 @@ PWSrand::~PWSrand()
 
 void PWSrand::AddEntropy(unsigned char *bytes, unsigned int numBytes)
 {
+  std::lock_guard<std::recursive_mutex> guard(m_mutex);
   ASSERT(bytes != nullptr);
 
   SHA256 s;
@@ -76,6 +77,7 @@ void PWSrand::NextRandBlock()
 
 void PWSrand::GetRandomData( void * const buffer, unsigned long length )
 {
+  std::lock_guard<std::recursive_mutex> guard(m_mutex);
   if (!m_IsInternalPRNG) {
     bool status;
     status = pws_os::GetRandomData(buffer, length);
@@ -111,6 +113,7 @@ void PWSrand::GetRandomData( void * const buffer, unsigned long length )
 // generate random numbers from a buffer filled in by GetRandomData()
 unsigned int PWSrand::RandUInt()
 {
+  std::lock_guard<std::recursive_mutex> guard(m_mutex);
   // we don't want to keep filling the random buffer for each number we
   // want, so fill the buffer with random data and use it up
 
@@ -13,6 +13,10 @@
 
 #include "crypto/sha256.h"
 
+#include <mutex>
+
+// Members are thread-safe, as entries may be built off the main thread
+// (see ReadPipeline), but GetInstance() should first be called from one.
 class PWSrand
 {
 public:
@@ -39,5 +43,6 @@ private:
 
   char rgbRandomData[SHA256::HASHLEN];
   unsigned int ibRandomData;
+  std::recursive_mutex m_mutex; // RandUInt() calls GetRandomData()
 };
 #endif /*  __PWSRAND_H */
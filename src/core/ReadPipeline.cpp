@@ -0,0 +1,169 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+/// \file ReadPipeline.cpp
+//-----------------------------------------------------------------------------
+
+#include "ReadPipeline.h"
+#include "PWSrand.h"
+#include "Util.h"
+
+#include <algorithm>
+
+ReadPipeline::ReadPipeline(PWSfile *in,
+                           const std::shared_ptr<const CItemKeyring> &keyring,
+                           unsigned nWorkers)
+  : m_in(in), m_keyring(keyring), m_maxInFlight(2 * size_t(nWorkers) + 1),
+    m_located(false), m_next(0), m_stop(false)
+{
+  ASSERT(in != nullptr && in->CanReadExtents() && nWorkers > 0);
+  (void)PWSrand::GetInstance(); // before workers need it
+  for (unsigned i = 0; i < nWorkers; i++)
+    m_workers.emplace_back(&ReadPipeline::Work, this);
+}
+
+ReadPipeline::~ReadPipeline()
+{
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_stop = true;
+  }
+  m_workCV.notify_all();
+  for (auto &worker : m_workers)
+    worker.join();
+  // Batches' plaintext is wiped by SecureAlloc as they go
+}
+
+unsigned ReadPipeline::DefaultWorkers()
+{
+  // The caller's thread is kept busy locating records and adding
+  // entries, so it doesn't count. Beyond a few workers, it's the
+  // bottleneck anyway.
+  const unsigned n = std::thread::hardware_concurrency();
+  return (n > 1) ? std::min(n - 1, 8U) : 0;
+}
+
+bool ReadPipeline::Next(CItemData &item, int &status)
+{
+  while (!m_current || m_next == m_current->items.size()) {
+    m_current.reset();
+    Fill();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_inFlight.empty())
+      return false;
+    m_doneCV.wait(lock, [this] {return m_inFlight.front()->done;});
+    m_current = std::move(m_inFlight.front());
+    m_inFlight.pop_front();
+    lock.unlock();
+
+    Plaintext &fields = m_current->fields;
+    if (!fields.empty()) {
+      m_in->RecordRead(fields.data(), fields.size());
+      trashMemory(fields.data(), fields.size());
+    }
+    Plaintext().swap(fields);
+    m_next = 0;
+  }
+
+  item = std::move(m_current->items[m_next]);
+  status = m_current->status[m_next];
+  m_next++;
+  return true;
+}
+
+void ReadPipeline::Fill()
+{
+  // Called only from Next(), so m_inFlight can only shrink under us
+  while (!m_located) {
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      if (m_inFlight.size() >= m_maxInFlight)
+        return;
+    }
+
+    std::unique_ptr<Batch> batch(new Batch);
+    batch->extents.reserve(BatchSize);
+    PWSfile::RecordExtent extent;
+    while (batch->extents.size() < BatchSize) {
+      if (!m_in->NextRecordExtent(extent)) {
+        m_located = true;
+        break;
+      }
+      batch->extents.push_back(extent);
+    }
+    if (batch->extents.empty())
+      return;
+
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      m_todo.push_back(batch.get());
+      m_inFlight.push_back(std::move(batch));
+    }
+    m_workCV.notify_one();
+  }
+}
+
+void ReadPipeline::Work()
+{
+  PWSfile::ExtentReader reader(*m_in);
+  CItemData item;
+  item.SetKeyring(m_keyring);
+
+  for (;;) {
+    Batch *batch;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_workCV.wait(lock, [this] {return m_stop || !m_todo.empty();});
+      if (m_stop)
+        return;
+      batch = m_todo.front();
+      m_todo.pop_front();
+    }
+
+    // The plaintext's no longer than the ciphertext, so one allocation
+    // (of locked pages of its own: see SecurePool) holds the batch's
+    size_t cipherLength = 0;
+    for (const auto &extent : batch->extents)
+      cipherLength += size_t(extent.end - extent.begin);
+    Plaintext &fields = batch->fields;
+    fields.reserve(cipherLength);
+    const CItemData::FieldReader next =
+      [&reader, &fields](unsigned char &type, const unsigned char* &data, size_t &length) {
+        const size_t retval = reader.ReadFieldInPlace(type, data, length);
+        if (retval > 0 && length > 0)
+          fields.insert(fields.end(), data, data + length);
+        return retval;
+      };
+
+    batch->items.reserve(batch->extents.size());
+    batch->status.reserve(batch->extents.size());
+    for (const auto &extent : batch->extents) {
+      reader.Start(extent);
+      // Normally one entry per extent. But as with ReadRecord(), a bad
+      // field ends the entry early, and the rest start another.
+      while (!reader.AtEnd()) {
+        // Reused, as is PWScore::ReadFile()'s: entries moved out of it
+        // share its key, and so don't each need a new BlowFish
+        item.Clear();
+        const int status = item.Read(next);
+        if (status == PWSfile::END_OF_FILE) // can't happen, as extents are checked
+          break;
+        // Including an attachment field's negative status, on which
+        // PWScore::ReadFile() drops the entry and reads on from there
+        batch->items.push_back(std::move(item));
+        batch->status.push_back(status);
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> guard(m_mutex);
+      batch->done = true;
+    }
+    m_doneCV.notify_one();
+  }
+}
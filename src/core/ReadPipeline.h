@@ -0,0 +1,106 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// ReadPipeline.h
+//-----------------------------------------------------------------------------
+
+#ifndef __READPIPELINE_H
+#define __READPIPELINE_H
+
+#include "ItemData.h"
+#include "ItemKeyring.h"
+#include "PWSfile.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+
+/**
+ * ReadPipeline reads a database's records on several threads:
+ *
+ * - Next(), on the caller's thread, locates records a batch at a time
+ *   (see PWSfile::NextRecordExtent()), which is cheap;
+ * - worker threads decrypt the batches and build their CItemData;
+ * - Next() then hands the entries out in file order, after passing
+ *   their fields on for the HMAC, which must also see them in order.
+ *
+ * A batch's decrypted fields are kept in one SecureAlloc buffer until
+ * they're hashed, and wiped then. At several KB, it's too large for
+ * SecurePool's size classes, and so gets locked pages of its own. A
+ * few batches at most are in flight at any time.
+ *
+ * Entries are the same as ReadRecord() would make, errors included.
+ * Once Next() returns false, any remaining records (if the file's
+ * truncated or corrupt, say) are left for in->ReadRecord(), which
+ * will take it from there as it would have anyway.
+ *
+ * Below MinFileLength, a file's only a batch or two, which one thread
+ * reads in about the time it takes to start the others, so PWScore
+ * doesn't use a ReadPipeline for it.
+ */
+
+class ReadPipeline
+{
+public:
+  // in must be open for reading, and CanReadExtents(). Neither it nor
+  // keyring may be used otherwise until this is destroyed.
+  ReadPipeline(PWSfile *in, const std::shared_ptr<const CItemKeyring> &keyring,
+               unsigned nWorkers);
+  ~ReadPipeline(); // stops workers, wipes whatever's left
+
+  ReadPipeline(const ReadPipeline &) = delete;
+  ReadPipeline &operator=(const ReadPipeline &) = delete;
+
+  // Moves the next entry into item, with PWSfile::ReadRecord()'s status
+  bool Next(CItemData &item, int &status);
+
+  // Workers worth starting on this machine, 0 if none are
+  static unsigned DefaultWorkers();
+  enum {MinFileLength = 128 * 1024}; // a few batches of typical entries
+
+private:
+  enum {BatchSize = 256};
+
+  typedef std::vector<unsigned char, S_Alloc::SecureAlloc<unsigned char>> Plaintext;
+
+  struct Batch {
+    std::vector<PWSfile::RecordExtent> extents;
+    std::vector<CItemData> items;
+    std::vector<int> status;
+    Plaintext fields; // as read, for the HMAC
+    bool done = false;
+  };
+
+  void Fill(); // queues batches, up to m_maxInFlight
+  void Work(); // worker thread
+
+  PWSfile *m_in;
+  std::shared_ptr<const CItemKeyring> m_keyring;
+  size_t m_maxInFlight;
+  bool m_located; // all extents found?
+
+  std::deque<std::unique_ptr<Batch>> m_inFlight; // in file order
+  std::deque<Batch *> m_todo; // not yet picked up by a worker
+  std::unique_ptr<Batch> m_current; // being handed out by Next()
+  size_t m_next; // in m_current
+
+  std::mutex m_mutex;
+  std::condition_variable m_workCV, m_doneCV;
+  bool m_stop;
+  std::vector<std::thread> m_workers;
+};
+
+#endif /* __READPIPELINE_H */
+//-----------------------------------------------------------------------------
+// Local variables:
+// mode: c++
+// End:
@@ -0,0 +1,129 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+/// \file SecureArena.cpp
+//-----------------------------------------------------------------------------
+
+#include "SecureArena.h"
+#include "Util.h"
+#include "os/mem.h"
+
+#include <new>
+
+namespace {
+  unsigned char *NewLocked(size_t n)
+  {
+    void *p = pws_os::mallocLocked(n);
+    if (p == nullptr)
+      throw std::bad_alloc();
+    return static_cast<unsigned char *>(p);
+  }
+}
+
+SecureArena::SecureArena() : m_used(0), m_stats{0, 0, 0, 0}
+{
+  for (auto &f : m_free)
+    f = nullptr;
+}
+
+SecureArena::~SecureArena()
+{
+  ASSERT(m_stats.live == 0);
+  for (auto slab : m_slabs) {
+    trashMemory(slab, SlabSize);
+    pws_os::freeLocked(slab, SlabSize);
+  }
+}
+
+int SecureArena::ClassOf(size_t n)
+{
+  for (int c = 0; c < NumClasses; c++)
+    if (n <= ClassSize(c))
+      return c;
+  return -1;
+}
+
+void *SecureArena::Allocate(size_t n)
+{
+  if (n == 0)
+    return nullptr;
+
+  const int c = ClassOf(n);
+  if (c < 0) {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_stats.live++; m_stats.allocs++; m_stats.heapAllocs++;
+    return NewLocked(n);
+  }
+
+  std::lock_guard<std::mutex> guard(m_mutex);
+  m_stats.live++; m_stats.allocs++;
+  if (m_free[c] != nullptr) {
+    FreeBlock *b = m_free[c];
+    m_free[c] = b->next;
+    b->next = nullptr;
+    return b;
+  }
+  return NewSlabBlock(ClassSize(c));
+}
+
+void *SecureArena::NewSlabBlock(size_t n)
+{
+  // Slabs are only ever carved into multiples of MinBlock, so every
+  // block's suitably aligned for a FreeBlock
+  if (m_slabs.empty() || m_used + n > SlabSize) {
+    m_slabs.push_back(NewLocked(SlabSize));
+    m_used = 0;
+  }
+  void *retval = m_slabs.back() + m_used;
+  m_used += n;
+  return retval;
+}
+
+void SecureArena::Deallocate(void *p, size_t n)
+{
+  if (p == nullptr)
+    return;
+
+  const int c = ClassOf(n);
+  if (c < 0) {
+    trashMemory(p, n);
+    pws_os::freeLocked(p, n);
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (--m_stats.live == 0)
+      ReleaseSlabs();
+    return;
+  }
+
+  trashMemory(p, ClassSize(c));
+  std::lock_guard<std::mutex> guard(m_mutex);
+  auto *b = static_cast<FreeBlock *>(p);
+  b->next = m_free[c];
+  m_free[c] = b;
+  if (--m_stats.live == 0)
+    ReleaseSlabs();
+}
+
+void SecureArena::ReleaseSlabs()
+{
+  // Nothing's in use, so the free lists cover everything handed out,
+  // and every freed block has already been wiped.
+  for (auto &f : m_free)
+    f = nullptr;
+  for (size_t i = 1; i < m_slabs.size(); i++)
+    pws_os::freeLocked(m_slabs[i], SlabSize);
+  if (!m_slabs.empty())
+    m_slabs.resize(1);
+  m_used = 0;
+}
+
+SecureArena::Stats SecureArena::GetStats() const
+{
+  std::lock_guard<std::mutex> guard(m_mutex);
+  Stats retval = m_stats;
+  retval.slabs = m_slabs.size();
+  return retval;
+}
@@ -0,0 +1,82 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// SecureArena.h
+//-----------------------------------------------------------------------------
+
+#ifndef __SECUREARENA_H
+#define __SECUREARENA_H
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+
+/**
+ * SecureArena hands out blocks of up to MaxBlock bytes carved out of
+ * large, locked-in-RAM slabs, rather than from the heap one by one.
+ *
+ * Blocks are rounded up to a power-of-two size class (8, 16, ... 4096),
+ * which covers all but the longest notes, say, as held in a CItemField.
+ * Freed blocks are wiped and kept on a per-class free list for reuse;
+ * otherwise allocation just bumps a pointer in the current slab.
+ * Larger requests get locked pages of their own (pws_os::mallocLocked),
+ * and are also wiped when freed. They're rare enough that the system
+ * call or two, and the page granularity, don't matter.
+ *
+ * When the last live block is released (e.g., when a database is closed)
+ * all slabs but one are returned to the system. The destructor wipes
+ * and releases whatever is left.
+ *
+ * All public members are thread-safe.
+ */
+
+class SecureArena
+{
+public:
+  enum {MinBlock = 8, MaxBlock = 4096, SlabSize = 64 * 1024};
+
+  SecureArena();
+  ~SecureArena();
+  SecureArena(const SecureArena &) = delete;
+  SecureArena &operator=(const SecureArena &) = delete;
+
+  // Returns nullptr iff n == 0
+  void *Allocate(size_t n);
+  // n must be the value passed to Allocate()
+  void Deallocate(void *p, size_t n);
+
+  struct Stats {
+    size_t slabs;     // currently held
+    size_t live;      // blocks allocated and not yet freed (incl. heap ones)
+    size_t allocs;    // total Allocate() calls that returned a block
+    size_t heapAllocs;// of which were too large for a size class (own pages)
+  };
+  Stats GetStats() const;
+
+private:
+  enum {NumClasses = 10}; // MinBlock << (NumClasses - 1) == MaxBlock
+  static int ClassOf(size_t n); // -1 if > MaxBlock
+  static size_t ClassSize(int c) {return size_t(MinBlock) << c;}
+
+  void *NewSlabBlock(size_t n);
+  void ReleaseSlabs();
+
+  struct FreeBlock {FreeBlock *next;};
+  FreeBlock *m_free[NumClasses];
+  std::vector<unsigned char *> m_slabs;
+  size_t m_used; // bytes handed out from m_slabs.back()
+  Stats m_stats;
+  mutable std::mutex m_mutex;
+};
+
+#endif /* __SECUREARENA_H */
+//-----------------------------------------------------------------------------
+// Local variables:
+// mode: c++
+// End:
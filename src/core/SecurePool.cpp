@@ -0,0 +1,367 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+/// \file SecurePool.cpp
+//-----------------------------------------------------------------------------
+
+#include "SecurePool.h"
+#include "Util.h"
+#include "os/mem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace {
+  enum {NumClasses = 9,       // MinBlock << (NumClasses - 1) == MaxBlock
+        ChunkSize = 16 * 1024, // taken from a slab by a thread at a time
+        Batch = 32,            // most blocks moved between a thread and the depot
+        // Free blocks the depot holds beyond its low-water mark before
+        // it looks for slabs with nothing in use, to give back
+        ReclaimSlack = 2 * SecurePool::SlabSize};
+
+  struct FreeBlock {FreeBlock *next;};
+
+  int ClassOf(size_t n)
+  {
+    for (int c = 0; c < NumClasses; c++)
+      if (n <= (size_t(SecurePool::MinBlock) << c))
+        return c;
+    return -1;
+  }
+
+  size_t ClassSize(int c) {return size_t(SecurePool::MinBlock) << c;}
+  // Blocks moved at a time: fewer of the larger ones, up to a chunk's worth
+  size_t BatchOf(int c) {return std::min(size_t(Batch), ChunkSize / ClassSize(c));}
+  size_t MaxCachedOf(int c) {return 2 * BatchOf(c);} // before a thread gives some back
+
+  struct Depot {
+    struct Slab {
+      unsigned char *base;
+      size_t carved; // bytes handed out from it, in blocks or chunks
+    };
+
+    std::mutex mutex;
+    std::vector<Slab> slabs; // blocks are carved from slabs.back()
+    FreeBlock *free[NumClasses] = {};
+    size_t freeBytes = 0;  // in free[]
+    size_t reclaimAt = ReclaimSlack;
+
+    // Threads count in their ThreadCache, and add to these when they
+    // come to the depot anyway, so as to keep atomics off the fast path
+    std::atomic<size_t> allocs{0}, heapAllocs{0}, frees{0}, refills{0};
+
+    // Caller must hold mutex. n is a multiple of MinBlock, <= ChunkSize,
+    // so every block's suitably aligned for anything a string holds.
+    // Slabs are locked pages of their own, as SecureArena's are.
+    unsigned char *Carve(size_t n)
+    {
+      if (slabs.empty() || slabs.back().carved + n > SecurePool::SlabSize) {
+        void *slab = pws_os::mallocLocked(SecurePool::SlabSize);
+        if (slab == nullptr)
+          throw std::bad_alloc();
+        slabs.push_back(Slab{static_cast<unsigned char *>(slab), 0});
+      }
+      Slab &slab = slabs.back();
+      unsigned char *retval = slab.base + slab.carved;
+      slab.carved += n;
+      return retval;
+    }
+
+    // These, and Carve(), are all that move blocks in and out of free[]
+    void Push(int c, void *p)
+    {
+      auto *b = static_cast<FreeBlock *>(p);
+      b->next = free[c];
+      free[c] = b;
+      freeBytes += ClassSize(c);
+    }
+
+    FreeBlock *Pop(int c)
+    {
+      FreeBlock *b = free[c];
+      if (b != nullptr) {
+        free[c] = b->next;
+        freeBytes -= ClassSize(c);
+        reclaimAt = std::min(reclaimAt, freeBytes + ReclaimSlack);
+      }
+      return b;
+    }
+
+    // After giving blocks back: once enough have come back since they
+    // were last in demand, slabs all of whose blocks are here are released
+    void MaybeReclaim()
+    {
+      if (freeBytes >= reclaimAt)
+        Reclaim();
+    }
+
+    void Reclaim();
+  };
+
+  void Depot::Reclaim()
+  {
+    // Which slab each free block is in, by address, is all it takes to
+    // see which slabs are entirely free. Blocks in threads' caches and
+    // chunks keep theirs; so does the slab being carved.
+    std::vector<size_t> order(slabs.size());
+    for (size_t i = 0; i < order.size(); i++)
+      order[i] = i;
+    std::sort(order.begin(), order.end(),
+              [this](size_t a, size_t b) {return slabs[a].base < slabs[b].base;});
+    auto slabOf = [this, &order](const void *p) {
+      auto it = std::upper_bound(order.begin(), order.end(), p,
+                                 [this](const void *q, size_t i) {return q < slabs[i].base;});
+      ASSERT(it != order.begin());
+      return *(it - 1);
+    };
+
+    std::vector<size_t> freeIn(slabs.size(), 0);
+    for (int c = 0; c < NumClasses; c++)
+      for (FreeBlock *b = free[c]; b != nullptr; b = b->next)
+        freeIn[slabOf(b)] += ClassSize(c);
+
+    std::vector<bool> empty(slabs.size(), false);
+    bool any = false;
+    for (size_t i = 0; i + 1 < slabs.size(); i++)
+      if (freeIn[i] == slabs[i].carved)
+        empty[i] = any = true;
+
+    if (any) {
+      for (int c = 0; c < NumClasses; c++) {
+        FreeBlock **link = &free[c];
+        while (*link != nullptr) {
+          if (empty[slabOf(*link)]) {
+            *link = (*link)->next;
+            freeBytes -= ClassSize(c);
+          } else
+            link = &(*link)->next;
+        }
+      }
+      // Every block in them was wiped when freed
+      size_t j = 0;
+      for (size_t i = 0; i < slabs.size(); i++) {
+        if (empty[i])
+          pws_os::freeLocked(slabs[i].base, SecurePool::SlabSize);
+        else
+          slabs[j++] = slabs[i];
+      }
+      slabs.resize(j);
+    }
+    reclaimAt = freeBytes + ReclaimSlack;
+  }
+
+  Depot &TheDepot()
+  {
+    // Deliberately never deleted: static StringXs may be freed after
+    // any static object here is destroyed.
+    static Depot *depot = new Depot;
+    return *depot;
+  }
+
+  // Trivially destructible, so that it's still usable while the thread's
+  // (or, for the main thread, the process's) other objects are destroyed.
+  struct ThreadCache {
+    FreeBlock *free[NumClasses];
+    size_t nfree[NumClasses];
+    unsigned char *chunk;
+    size_t chunkLeft;
+    bool registered; // with flusher, below
+    bool dead;       // flushed: use the depot directly from now on
+    size_t allocs, heapAllocs, frees; // not yet added to the depot's
+  };
+
+  thread_local ThreadCache tcache;
+
+  void FlushCounts(ThreadCache &tc, Depot &depot)
+  {
+    depot.allocs.fetch_add(tc.allocs, std::memory_order_relaxed);
+    depot.heapAllocs.fetch_add(tc.heapAllocs, std::memory_order_relaxed);
+    depot.frees.fetch_add(tc.frees, std::memory_order_relaxed);
+    tc.allocs = tc.heapAllocs = tc.frees = 0;
+  }
+
+  void Flush(ThreadCache &tc)
+  {
+    Depot &depot = TheDepot();
+    FlushCounts(tc, depot);
+    std::lock_guard<std::mutex> guard(depot.mutex);
+    for (int c = 0; c < NumClasses; c++) {
+      while (tc.free[c] != nullptr) {
+        FreeBlock *b = tc.free[c];
+        tc.free[c] = b->next;
+        depot.Push(c, b);
+      }
+      tc.nfree[c] = 0;
+    }
+    // Don't waste what's left of the chunk
+    for (int c = NumClasses - 1; c >= 0; c--) {
+      while (tc.chunkLeft >= ClassSize(c)) {
+        depot.Push(c, tc.chunk);
+        tc.chunk += ClassSize(c);
+        tc.chunkLeft -= ClassSize(c);
+      }
+    }
+    depot.MaybeReclaim();
+    tc.dead = true;
+  }
+
+  struct ThreadCacheFlusher {
+    void Register() {}
+    ~ThreadCacheFlusher() {Flush(tcache);}
+  };
+
+  thread_local ThreadCacheFlusher flusher;
+
+  void Register(ThreadCache &tc)
+  {
+    // First use of flusher in this thread arranges for its destructor
+    // to run when the thread exits
+    flusher.Register();
+    tc.registered = true;
+  }
+
+  void *Refill(ThreadCache &tc, int c)
+  {
+    Depot &depot = TheDepot();
+    if (!tc.registered && !tc.dead)
+      Register(tc);
+    depot.refills.fetch_add(1, std::memory_order_relaxed);
+    FlushCounts(tc, depot);
+
+    std::lock_guard<std::mutex> guard(depot.mutex);
+    if (tc.dead) {
+      FreeBlock *b = depot.Pop(c);
+      if (b != nullptr)
+        return b;
+      return depot.Carve(ClassSize(c));
+    }
+
+    const size_t batch = BatchOf(c);
+    for (size_t i = 0; i < batch && depot.free[c] != nullptr; i++) {
+      FreeBlock *b = depot.Pop(c);
+      b->next = tc.free[c];
+      tc.free[c] = b;
+      tc.nfree[c]++;
+    }
+    if (tc.free[c] != nullptr) {
+      FreeBlock *b = tc.free[c];
+      tc.free[c] = b->next;
+      tc.nfree[c]--;
+      return b;
+    }
+
+    const size_t size = ClassSize(c);
+    if (tc.chunkLeft < size) {
+      // What's left is smaller than this class, so it goes to the smaller ones
+      for (int i = c - 1; i >= 0; i--) {
+        while (tc.chunkLeft >= ClassSize(i)) {
+          auto *b = reinterpret_cast<FreeBlock *>(tc.chunk);
+          b->next = tc.free[i];
+          tc.free[i] = b;
+          tc.nfree[i]++;
+          tc.chunk += ClassSize(i);
+          tc.chunkLeft -= ClassSize(i);
+        }
+      }
+      tc.chunk = depot.Carve(ChunkSize);
+      tc.chunkLeft = ChunkSize;
+    }
+    void *retval = tc.chunk;
+    tc.chunk += size;
+    tc.chunkLeft -= size;
+    return retval;
+  }
+} // anonymous namespace
+
+void *SecurePool::Allocate(size_t n)
+{
+  ThreadCache &tc = tcache;
+  const int c = ClassOf(n);
+  if (c < 0) {
+    void *retval = pws_os::mallocLocked(n);
+    if (retval == nullptr)
+      throw std::bad_alloc();
+    tc.allocs++;
+    tc.heapAllocs++;
+    return retval;
+  }
+
+  tc.allocs++;
+  FreeBlock *b = tc.free[c];
+  if (b != nullptr) {
+    tc.free[c] = b->next;
+    tc.nfree[c]--;
+    return b;
+  }
+  return Refill(tc, c);
+}
+
+void SecurePool::Deallocate(void *p, size_t n)
+{
+  if (p == nullptr)
+    return;
+
+  trashMemory(p, n);
+
+  ThreadCache &tc = tcache;
+  tc.frees++;
+  const int c = ClassOf(n);
+  if (c < 0) {
+    pws_os::freeLocked(p, n);
+    return;
+  }
+
+  if (tc.dead) {
+    Depot &depot = TheDepot();
+    FlushCounts(tc, depot);
+    std::lock_guard<std::mutex> guard(depot.mutex);
+    depot.Push(c, p);
+    depot.MaybeReclaim();
+    return;
+  }
+  if (!tc.registered)
+    Register(tc);
+
+  auto *b = static_cast<FreeBlock *>(p);
+  b->next = tc.free[c];
+  tc.free[c] = b;
+  if (++tc.nfree[c] > MaxCachedOf(c)) {
+    // Give some back, but keep b, the likeliest to still be in cache
+    Depot &depot = TheDepot();
+    FlushCounts(tc, depot);
+    const size_t batch = BatchOf(c);
+    std::lock_guard<std::mutex> guard(depot.mutex);
+    for (size_t i = 0; i < batch; i++) {
+      FreeBlock *fb = b->next;
+      b->next = fb->next;
+      depot.Push(c, fb);
+    }
+    tc.nfree[c] -= batch;
+    depot.MaybeReclaim();
+  }
+}
+
+SecurePool::Stats SecurePool::GetStats()
+{
+  Depot &depot = TheDepot();
+  Stats retval;
+  {
+    std::lock_guard<std::mutex> guard(depot.mutex);
+    retval.slabs = depot.slabs.size();
+  }
+  // Include this thread's own counts; other threads' are added
+  // when they next go to the depot, or exit
+  const ThreadCache &tc = tcache;
+  retval.allocs = depot.allocs.load(std::memory_order_relaxed) + tc.allocs;
+  retval.heapAllocs = depot.heapAllocs.load(std::memory_order_relaxed) + tc.heapAllocs;
+  retval.live = retval.allocs - depot.frees.load(std::memory_order_relaxed) - tc.frees;
+  retval.refills = depot.refills.load(std::memory_order_relaxed);
+  return retval;
+}
@@ -0,0 +1,65 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// SecurePool.h
+//-----------------------------------------------------------------------------
+
+#ifndef __SECUREPOOL_H
+#define __SECUREPOOL_H
+
+#include <cstddef>
+
+//-----------------------------------------------------------------------------
+
+/**
+ * SecurePool is the memory behind S_Alloc::SecureAlloc, and hence behind
+ * every StringX. Strings come and go all the time (each GetTitle() makes
+ * one), so rather than a malloc/wipe/free per string, blocks of up to
+ * MaxBlock bytes come from per-thread free lists, one per size class
+ * (16, 32, ... 4096 bytes).
+ *
+ * Each thread's lists are refilled from, and overflow into, a shared
+ * depot, which carves new blocks out of slabs of locked pages of their
+ * own (pws_os::mallocLocked(), as SecureArena's are). Blocks are wiped
+ * when freed, before being recycled; they may be freed by a different
+ * thread than the one that allocated them. A thread's cached blocks go
+ * back to the depot when it exits. Once a couple of slabs' worth of
+ * blocks have come back to the depot unused, it releases any slabs none
+ * of whose blocks are in use, e.g., after a database is closed.
+ *
+ * Larger requests (the longest notes, say) get locked pages of their
+ * own, and are also wiped when freed. That costs a system call or two,
+ * but such strings are few.
+ */
+
+class SecurePool
+{
+public:
+  enum {MinBlock = 16, MaxBlock = 4096, SlabSize = 256 * 1024};
+
+  // Throws std::bad_alloc on failure, as the allocator must
+  static void *Allocate(size_t n);
+  // n must be the value passed to Allocate(). Wipes the first n bytes.
+  static void Deallocate(void *p, size_t n);
+
+  // For benchmarks and tests. Counts are for all threads, but
+  // another thread's may lag until it next refills, or exits.
+  struct Stats {
+    size_t slabs;      // currently held
+    size_t live;       // blocks allocated and not yet freed (incl. heap ones)
+    size_t allocs;     // total Allocate() calls
+    size_t heapAllocs; // of which were too large for a size class (own pages)
+    size_t refills;    // times a thread went to the depot for blocks
+  };
+  static Stats GetStats();
+};
+
+#endif /* __SECUREPOOL_H */
+//-----------------------------------------------------------------------------
+// Local variables:
+// mode: c++
+// End:
@@ -16,6 +16,9 @@
  * Like std::string in all respects, except that
  * memory is scrubbed before being returned to system.
  *
+ * Memory comes from SecurePool, which recycles (wiped) blocks
+ * rather than going to the heap for each string. All of it, whatever
+ * the size, is locked in RAM as far as the OS allows.
  */
 
 #include <string>
@@ -27,6 +30,7 @@
 
 #include "os/typedefs.h"
 #include "PwsPlatform.h"
+#include "SecurePool.h"
 
 // Using extern definition here instead of including "Util.h" because Util.h
 // references the StringX class and by including "Util.h" here, the StringX
@@ -97,35 +101,19 @@ namespace S_Alloc
       // Allocate raw memory
       pointer allocate(size_type n, const_pointer hint = nullptr) {
         UNREFERENCED_PARAMETER(hint);
-        pointer p = static_cast<pointer>(std::malloc(n * sizeof(T)));
-        if (p == nullptr)
-          throw std::bad_alloc();
-        return p;
+        return static_cast<pointer>(SecurePool::Allocate(n * sizeof(T)));
       }
 
-#ifdef _WIN32
-#pragma optimize("", off)
-#endif
-      // Free raw memory.
+      // Free raw memory, which SecurePool wipes.
       // Note that C++ standard defines this function as:
       //   deallocate(pointer p, size_type n).
       void deallocate(pointer p, size_type n) {
         // assert(p != nullptr);
         // The standard states that p must not be nullptr. However, some
-        // STL implementations fail this requirement, so the check must
-        // be made here.
-        if (p == nullptr)
-          return;
-
-        if (n > 0) {
-          const size_type N = n * sizeof(T);
-          trashMemory(static_cast<void *>(p), N);
-        }
-        std::free(p);
+        // STL implementations fail this requirement, so the check is
+        // made in SecurePool::Deallocate().
+        SecurePool::Deallocate(static_cast<void *>(p), n * sizeof(T));
       }
-#ifdef _WIN32
-#pragma optimize("", on)
-#endif
 
     private:
       // No data
@@ -52,6 +52,11 @@ public:
   // UpdateWizard: called to update text in Wizard during export Text/XML.
   virtual void UpdateWizard(const stringT &) {}
 
+  // AsyncSaveFinished: called when a PWScore::WriteFileAsync() is done,
+  // on the thread that wrote the file. The GUI should then call
+  // PWScore::FinishAsyncSave() from its own thread for the outcome.
+  virtual void AsyncSaveFinished() {}
+
   virtual ~Observer() {}
 };
 
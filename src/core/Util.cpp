@@ -40,13 +40,6 @@
 
 using namespace std;
 
-// used by CBC routines...
-static void xormem(unsigned char *mem1, const unsigned char *mem2, int length)
-{
-  for (int x = 0; x < length; x++)
-    mem1[x] ^= mem2[x];
-}
-
 //-----------------------------------------------------------------------------
 //Overwrite the memory
 // used to be a loop here, but this was deemed (1) overly paranoid
@@ -199,9 +192,12 @@ size_t _writecbc(FILE* fp, const unsigned char* buffer, size_t length, unsigned
   return numWritten;
 }
 
-
-size_t _writecbc1st(FILE* fp, const unsigned char** buffer, size_t *length, unsigned char type,
-  Fish* Algorithm, unsigned char* cbcbuffer, bool isAboveThreshold)
+// Encrypts the first block (length, type and perhaps a few bytes of data)
+// into curblock, advancing *buffer and reducing *length by the data used.
+static void EncryptLengthBlock(unsigned char *curblock,
+                               const unsigned char** buffer, size_t *length,
+                               unsigned char type, Fish* Algorithm,
+                               unsigned char* cbcbuffer, bool isAboveThreshold)
 {
   /**
    * Write the length, type and perhaps a few bytes of data.
@@ -212,14 +208,7 @@ size_t _writecbc1st(FILE* fp, const unsigned char** buffer, size_t *length, unsi
    * extra few bytes in the length block, since this is an optimization for small amounts of data,
    * irrelevant for large lengths.
    */
-  size_t numWritten = 0;
   const unsigned int BS = Algorithm->GetBlockSize();
-  // some trickery to avoid new/delete
-  unsigned char block1[16];
-
-  unsigned char* curblock = nullptr;
-  ASSERT(BS <= sizeof(block1)); // if needed we can be more sophisticated here...
-  curblock = block1;
   // Fill unused bytes of length with random data, to make
   // a dictionary attack harder
   PWSrand::GetInstance()->GetRandomData(curblock, BS);
@@ -246,16 +235,50 @@ size_t _writecbc1st(FILE* fp, const unsigned char** buffer, size_t *length, unsi
     *buffer += len1;
   }
 
-  xormem(curblock, cbcbuffer, BS); // do the CBC thing
-  Algorithm->Encrypt(curblock, curblock);
-  memcpy(cbcbuffer, curblock, BS); // update CBC for next round
+  Algorithm->EncryptCBC(curblock, curblock, 1, cbcbuffer);
+}
 
-  numWritten = fwrite(curblock, 1, BS, fp);
+// CBC-encrypts length bytes of buffer to out, padding an uneven last
+// block with randomness. Returns the number of bytes put in out.
+static size_t EncryptCBC(unsigned char *out, const unsigned char *buffer, size_t length,
+                         Fish *Algorithm, unsigned char *cbcbuffer)
+{
+  const unsigned int BS = Algorithm->GetBlockSize();
+  if (length == 0 && BS != 8) // BS == 8 for bwd compat w/pre-3 format
+    return 0;
+
+  size_t BlockLength = ((length + (BS - 1)) / BS) * BS;
+  if (BlockLength == 0 && BS == 8)
+    BlockLength = BS;
+
+  const size_t fullLength = (length / BS) * BS;
+  memcpy(out, buffer, fullLength);
+  if (fullLength < BlockLength) { // uneven last block
+    PWSrand::GetInstance()->GetRandomData(out + fullLength, BS);
+    memcpy(out + fullLength, buffer + fullLength, length - fullLength);
+  }
+
+  Algorithm->EncryptCBC(out, out, BlockLength / BS, cbcbuffer);
+  return BlockLength;
+}
+
+size_t _writecbc1st(FILE* fp, const unsigned char** buffer, size_t *length, unsigned char type,
+  Fish* Algorithm, unsigned char* cbcbuffer, bool isAboveThreshold)
+{
+  size_t numWritten = 0;
+  const unsigned int BS = Algorithm->GetBlockSize();
+  // some trickery to avoid new/delete
+  unsigned char block1[16];
+
+  ASSERT(BS <= sizeof(block1)); // if needed we can be more sophisticated here...
+  EncryptLengthBlock(block1, buffer, length, type, Algorithm, cbcbuffer, isAboveThreshold);
+
+  numWritten = fwrite(block1, 1, BS, fp);
   if (numWritten != BS) {
-    trashMemory(curblock, BS);
+    trashMemory(block1, BS);
     throw(EIO);
   }
-  trashMemory(curblock, BS);
+  trashMemory(block1, BS);
   return numWritten;
 }
 
@@ -264,75 +287,63 @@ size_t _writecbcRest(FILE *fp, const unsigned char *buffer, size_t length,
                  Fish *Algorithm, unsigned char *cbcbuffer)
 {
   // Doesn't write out length, just CBC's the data, padding with randomness
-  // as required.
-
-  const unsigned int BS = Algorithm->GetBlockSize();
+  // as required. Encrypts a chunk at a time, so that there's one fwrite()
+  // per chunk rather than per block.
   size_t numWritten = 0;
+  unsigned char chunk[4096]; // a multiple of any block size
+  size_t offset = 0;
 
-  // some trickery to avoid new/delete
-  unsigned char block1[16];
-
-  unsigned char *curblock = nullptr;
-  ASSERT(BS <= sizeof(block1)); // if needed we can be more sophisticated here...
-
-  // First encrypt and write the length of the buffer
-  curblock = block1;
-  // Fill unused bytes of length with random data, to make
-  // a dictionary attack harder
-  PWSrand::GetInstance()->GetRandomData(curblock, BS);
-
-  if (length > 0 ||
-      (BS == 8 && length == 0)) { // This part for bwd compat w/pre-3 format
-    size_t BlockLength = ((length + (BS - 1)) / BS) * BS;
-    if (BlockLength == 0 && BS == 8)
-      BlockLength = BS;
-
-    // Now, encrypt and write the (rest of the) buffer
-    for (unsigned int x = 0; x < BlockLength; x += BS) {
-      if ((length == 0) || ((length % BS != 0) && (length - x < BS))) {
-        //This is for an uneven last block
-        PWSrand::GetInstance()->GetRandomData(curblock, BS);
-        memcpy(curblock, buffer + x, length % BS);
-      } else
-        memcpy(curblock, buffer + x, BS);
-      xormem(curblock, cbcbuffer, BS);
-      Algorithm->Encrypt(curblock, curblock);
-      memcpy(cbcbuffer, curblock, BS);
-      size_t nw =  fwrite(curblock, 1, BS, fp);
-      if (nw != BS) {
-        trashMemory(curblock, BS);
+  do {
+    const size_t n = (length - offset < sizeof(chunk)) ? length - offset : sizeof(chunk);
+    const size_t nout = EncryptCBC(chunk, buffer + offset, n, Algorithm, cbcbuffer);
+    if (nout > 0) {
+      size_t nw = fwrite(chunk, 1, nout, fp);
+      if (nw != nout) {
+        trashMemory(chunk, sizeof(chunk));
         throw(EIO);
       }
       numWritten += nw;
     }
-  }
-  trashMemory(curblock, BS);
+    offset += n;
+  } while (offset < length);
+
+  trashMemory(chunk, sizeof(chunk));
   return numWritten;
 }
 
+size_t _writecbc(unsigned char *out, const unsigned char *buffer, size_t length,
+                 unsigned char type, Fish *Algorithm, unsigned char *cbcbuffer)
+{
+  EncryptLengthBlock(out, &buffer, &length, type, Algorithm, cbcbuffer, false);
+  const unsigned int BS = Algorithm->GetBlockSize();
+  return BS + EncryptCBC(out + BS, buffer, length, Algorithm, cbcbuffer);
+}
+
+size_t _writecbcRest(unsigned char *out, const unsigned char *buffer, size_t length,
+                     Fish *Algorithm, unsigned char *cbcbuffer)
+{
+  return EncryptCBC(out, buffer, length, Algorithm, cbcbuffer);
+}
+
 
 size_t readcbc1st(FILE *fp, size_t &record_size, Fish *Algorithm, unsigned char *cbcbuffer, bool isAboveThreshold)
 {
   const unsigned int BS = Algorithm->GetBlockSize();
-  unsigned char* ctblock = new unsigned char[2 * BS];
-  memset(ctblock, 0, 2 * BS);
-  unsigned char* ptblock = ctblock + BS; // too lazy to allocate twice...
+  unsigned char block[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  ASSERT(BS <= sizeof(block));
 
-  if (fread(ctblock, 1, BS, fp) != BS) {
-    delete[] ctblock;
+  if (BS > sizeof(block) || fread(block, 1, BS, fp) != BS) {
     record_size = 0;
     return 0;
   }
 
-  Algorithm->Decrypt(ctblock, ptblock);
-  xormem(ptblock, cbcbuffer, BS);
-  memcpy(cbcbuffer, ctblock, BS);
+  Algorithm->DecryptCBC(block, block, 1, cbcbuffer);
 
   if (isAboveThreshold)
-    memcpy(&record_size, ptblock, sizeof(size_t));
+    memcpy(&record_size, block, sizeof(size_t));
   else
-    record_size = getInt32(ptblock);
-  delete[] ctblock;
+    record_size = getInt32(block);
+  trashMemory(block, sizeof(block));
   return BS;
 }
 
@@ -363,8 +374,6 @@ size_t _readcbc(FILE *fp,
   // some trickery to avoid new/delete
  // Initialize memory.  (Lockheed Martin) Secure Coding  11-14-2007
   unsigned char block1[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-  unsigned char block2[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-  unsigned char block3[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
   unsigned char *lengthblock = nullptr;
 
   ASSERT(BS <= sizeof(block1)); // if needed we can be more sophisticated here...
@@ -385,12 +394,7 @@ size_t _readcbc(FILE *fp,
     memcmp(lengthblock, TERMINAL_BLOCK, BS) == 0)
     return static_cast<size_t>(-1);
 
-  unsigned char *lcpy = block2;
-  memcpy(lcpy, lengthblock, BS);
-
-  Algorithm->Decrypt(lengthblock, lengthblock);
-  xormem(lengthblock, cbcbuffer, BS);
-  memcpy(cbcbuffer, lcpy, BS);
+  Algorithm->DecryptCBC(lengthblock, lengthblock, 1, cbcbuffer);
 
   size_t length = getInt32(lengthblock);
 
@@ -433,14 +437,8 @@ size_t _readcbc(FILE *fp,
 
   if (length > 0 ||
       (BS == 8 && length == 0)) { // pre-3 pain
-    unsigned char *tempcbc = block3;
     numRead += fread(b, 1, BlockLength, fp);
-    for (unsigned int x = 0; x < BlockLength; x += BS) {
-      memcpy(tempcbc, b + x, BS);
-      Algorithm->Decrypt(b + x, b + x);
-      xormem(b + x, cbcbuffer, BS);
-      memcpy(cbcbuffer, tempcbc, BS);
-    }
+    Algorithm->DecryptCBC(b, b, BlockLength / BS, cbcbuffer);
   }
 
   if (buffer_len == 0) {
@@ -457,26 +455,98 @@ size_t _readcbc(FILE *fp, unsigned char *buffer,
 {
   const unsigned int BS = Algorithm->GetBlockSize();
   ASSERT((buffer_len % BS) == 0);
-  size_t nread = 0;
-  unsigned char *p = buffer;
-  auto *tmpcbc = new unsigned char[BS];
+  // A partial block at the end is counted, but left as read
+  const size_t nread = fread(buffer, 1, buffer_len, fp);
+  Algorithm->DecryptCBC(buffer, buffer, nread / BS, cbcbuffer);
+  return nread;
+}
 
-  do {
-    size_t nr = fread(p, 1, BS, fp);
-    nread += nr;
-    if (nr != BS)
-      break;
+size_t _readcbc(const unsigned char *&in, const unsigned char *end,
+                unsigned char * &buffer, size_t &buffer_cap,
+                size_t &buffer_len,
+                unsigned char &type, Fish *Algorithm,
+                unsigned char *cbcbuffer,
+                const unsigned char *TERMINAL_BLOCK, ulong64 file_len)
+{
+  const unsigned int BS = Algorithm->GetBlockSize();
+  unsigned char lengthblock[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
 
-    memcpy(tmpcbc, p, BS);
-    Algorithm->Decrypt(p, p);
-    xormem(p, cbcbuffer, BS);
-    memcpy(cbcbuffer, tmpcbc, BS);
+  ASSERT(BS <= sizeof(lengthblock));
+  if ((BS > sizeof(lengthblock)) || (BS == 0))
+    return 0;
 
-    p += nr;
-  } while (nread < buffer_len);
+  buffer_len = 0;
+  if (size_t(end - in) < BS)
+    return 0;
 
-  delete[] tmpcbc;
-  return nread;
+  if (TERMINAL_BLOCK != nullptr &&
+      memcmp(in, TERMINAL_BLOCK, BS) == 0) {
+    in += BS;
+    return static_cast<size_t>(-1);
+  }
+
+  Algorithm->DecryptCBC(in, lengthblock, 1, cbcbuffer);
+  in += BS;
+  size_t numRead = BS;
+
+  size_t length = getInt32(lengthblock);
+  type = lengthblock[sizeof(int32)];
+
+  if ((file_len != 0 && length >= file_len)) {
+    pws_os::Trace0(_T("_readcbc: Read size larger than file length - aborting\n"));
+    trashMemory(lengthblock, BS);
+    return 0;
+  }
+
+  // Same allocation as the FILE* version, in case a caller relies on the slack
+  const size_t needed = (length / BS) * BS + 2 * BS;
+  if (needed > buffer_cap) {
+    if (buffer != nullptr) {
+      trashMemory(buffer, buffer_cap);
+      delete[] buffer;
+    }
+    buffer = new unsigned char[needed];
+    buffer_cap = needed;
+  }
+  memset(buffer, 0, needed);
+
+  buffer_len = length;
+  unsigned char *b = buffer;
+  if (BS == 16) {
+    const size_t len1 = (length > 11) ? 11 : length;
+    memcpy(b, lengthblock + 5, len1);
+    length -= len1;
+    b += len1;
+  }
+  trashMemory(lengthblock, BS);
+
+  size_t BlockLength = ((length + (BS - 1)) / BS) * BS;
+  if (BlockLength == 0 && BS == 8) // see FILE* version
+    BlockLength = BS;
+
+  if (length > 0 || (BS == 8 && length == 0)) {
+    // A short read decrypts only what's there, like fread() would
+    const size_t avail = ((size_t(end - in)) / BS) * BS;
+    const size_t n = (BlockLength < avail) ? BlockLength : avail;
+    Algorithm->DecryptCBC(in, b, n / BS, cbcbuffer);
+    in += n;
+    numRead += n;
+  }
+  return numRead;
+}
+
+size_t _readcbc(const unsigned char *&in, const unsigned char *end,
+                unsigned char *buffer,
+                const size_t buffer_len, Fish *Algorithm,
+                unsigned char *cbcbuffer)
+{
+  const unsigned int BS = Algorithm->GetBlockSize();
+  ASSERT((buffer_len % BS) == 0);
+  const size_t avail = ((size_t(end - in)) / BS) * BS;
+  const size_t n = (buffer_len < avail) ? buffer_len : avail;
+  Algorithm->DecryptCBC(in, buffer, n / BS, cbcbuffer);
+  in += n;
+  return n;
 }
 
 // PWSUtil implementations
@@ -67,6 +67,23 @@ extern size_t _readcbc(FILE *fp, unsigned char *buffer,
                        const size_t buffer_len, Fish *Algorithm,
                        unsigned char *cbcbuffer);
 
+// In-memory versions of the above, reading from [in, end) and advancing in.
+// Return values are as for the FILE* versions.
+// Here buffer is reused: grown (old contents trashed) to buffer_cap as needed,
+// *** trash & delete[] are responsibility of caller ***
+extern size_t _readcbc(const unsigned char *&in, const unsigned char *end,
+                       unsigned char * &buffer, size_t &buffer_cap,
+                       size_t &buffer_len,
+                       unsigned char &type, Fish *Algorithm,
+                       unsigned char *cbcbuffer,
+                       const unsigned char *TERMINAL_BLOCK = nullptr,
+                       ulong64 file_len = 0);
+
+extern size_t _readcbc(const unsigned char *&in, const unsigned char *end,
+                       unsigned char *buffer,
+                       const size_t buffer_len, Fish *Algorithm,
+                       unsigned char *cbcbuffer);
+
 // _writecbc* will throw(EIO) iff a write fail occurs!
 // version used to write records:
 extern size_t _writecbc(FILE* fp, const unsigned char* buffer, size_t length,
@@ -83,6 +100,15 @@ extern size_t _writecbcRest(FILE* fp, const unsigned char* buffer, size_t length
 extern size_t _writecbc(FILE *fp, const unsigned char *buffer, size_t length,
                         Fish *Algorithm, unsigned char *cbcbuffer);
 
+// In-memory versions of _writecbc & _writecbcRest, encrypting to out, which
+// must have room for the length block (_writecbc only) plus length rounded
+// up to whole blocks (at least one block for 8-byte ciphers).
+// Return the number of bytes put in out.
+extern size_t _writecbc(unsigned char *out, const unsigned char *buffer, size_t length,
+                        unsigned char type, Fish *Algorithm, unsigned char *cbcbuffer);
+extern size_t _writecbcRest(unsigned char *out, const unsigned char *buffer, size_t length,
+                            Fish *Algorithm, unsigned char *cbcbuffer);
+
 // The following can be used directly or via template functions getInt<> / putInt<>
 
 /*
@@ -638,8 +638,9 @@ void XMLFileHandlers::AddXMLEntries()
   bool bIntoEmpty = m_pXMLcore->GetNumEntries() == 0;
 
   // Initialize sets
+  // (MakeEntryUnique() checks against existing entries itself,
+  // so setGTU only needs to track the entries we import)
   GTUSet setGTU;
-  m_pXMLcore->InitialiseGTU(setGTU);
   UUIDSet setUUID;
   m_pXMLcore->InitialiseUUID(setUUID);
 
@@ -297,6 +297,8 @@
 #define IDSC_FILTERSEXPORTEDTODB        3460
 #define IDSC_FOUNDENTRIESFILTER         3461
 #define IDSC_IMPORTINVALIDDELIMITER     3462
+#define IDSC_STALEJOURNAL               3463
+#define IDSC_ATTNOTSAVED                3464
 
 #define IDSC_TOTP_ERROR_SUCCESS               3500
 #define IDSC_TOTP_ERROR_UNKNOWN               3501
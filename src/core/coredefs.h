@@ -9,6 +9,7 @@
 #define __COREDEFS_H
 
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <set>
 #include <list>
@@ -78,12 +79,17 @@ struct st_PWH_status {
   CItemData::EntryStatus es;
 };
 
-typedef std::map<pws_os::CUUID, CItemData, std::less<pws_os::CUUID> > ItemList;
+// Hashed on the UUID. An insertion that rehashes invalidates iterators,
+// but not references or pointers to entries, so an ItemListIter mustn't
+// be held across anything that may add an entry (AddEntryCommand, Merge,
+// Import...). Iteration order, and so that of records in a saved file,
+// is the table's, neither UUID nor insertion order.
+typedef std::unordered_map<pws_os::CUUID, CItemData> ItemList;
 typedef ItemList::iterator ItemListIter;
 typedef ItemList::const_iterator ItemListConstIter;
 typedef std::pair<pws_os::CUUID, CItemData> ItemList_Pair;
 
-typedef std::map<pws_os::CUUID, CItemAtt, std::less<pws_os::CUUID> > AttList;
+typedef std::unordered_map<pws_os::CUUID, CItemAtt> AttList;
 typedef AttList::iterator AttListIter;
 typedef AttList::const_iterator AttListConstIter;
 typedef std::pair<pws_os::CUUID, CItemAtt> AttList_Pair;
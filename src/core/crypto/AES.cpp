@@ -11,9 +11,12 @@
 //-----------------------------------------------------------------------------
 
 #include "AES.h"
+#include "CPUFeatures.h"
 #include "bitops.h"
 #include "../Util.h"
 
+#include <cstring>
+
 #define LTC_CLEAN_STACK
 
 enum class CryptStatus {
@@ -589,26 +592,299 @@ static CryptStatus rijndael_ecb_decrypt(const unsigned char *ct, unsigned char *
 #endif
 #endif /* ENCRYPT_ONLY */
 
+/*
+ * The same, with the CPU's AES instructions: AES-NI on x86, the
+ * Cryptography Extension on ARMv8. These are compiled for the
+ * instructions whatever the build's target, and only called once
+ * HasHardware() says the CPU has them.
+ * Both use the round keys rijndael_setup() computes, as bytes: the
+ * decryption keys there are already those of the "equivalent inverse
+ * cipher" the instructions implement.
+ * CBC decryption has no dependency between blocks, so it does several
+ * at once, to keep the pipelined AES units busy.
+ */
+
+typedef unsigned char RoundKeys[15][AES::BLOCKSIZE];
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define AES_HW
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define AES_HW_TARGET __attribute__((target("aes,sse2")))
+#else
+#define AES_HW_TARGET
+#endif
+
+#define LOADB(p) _mm_loadu_si128(reinterpret_cast<const __m128i *>(p))
+#define STOREB(p, b) _mm_storeu_si128(reinterpret_cast<__m128i *>(p), b)
+#define LOADK(k) LOADB(k)
+
+AES_HW_TARGET
+static void aes_hw_encrypt(const unsigned char *in, unsigned char *out,
+                           const RoundKeys &rk, int Nr)
+{
+  __m128i b = _mm_xor_si128(LOADB(in), LOADK(rk[0]));
+  for (int r = 1; r < Nr; r++)
+    b = _mm_aesenc_si128(b, LOADK(rk[r]));
+  STOREB(out, _mm_aesenclast_si128(b, LOADK(rk[Nr])));
+}
+
+AES_HW_TARGET
+static void aes_hw_decrypt(const unsigned char *in, unsigned char *out,
+                           const RoundKeys &rk, int Nr)
+{
+  __m128i b = _mm_xor_si128(LOADB(in), LOADK(rk[0]));
+  for (int r = 1; r < Nr; r++)
+    b = _mm_aesdec_si128(b, LOADK(rk[r]));
+  STOREB(out, _mm_aesdeclast_si128(b, LOADK(rk[Nr])));
+}
+
+AES_HW_TARGET
+static void aes_hw_decrypt_cbc(const unsigned char *in, unsigned char *out,
+                               size_t nblocks, unsigned char *cbc,
+                               const RoundKeys &rk, int Nr)
+{
+  const size_t BS = AES::BLOCKSIZE;
+  __m128i prev = LOADB(cbc);
+
+  for (; nblocks >= 8; nblocks -= 8, in += 8 * BS, out += 8 * BS) {
+    __m128i b[8];
+    __m128i k = LOADK(rk[0]);
+    for (int i = 0; i < 8; i++)
+      b[i] = _mm_xor_si128(LOADB(in + i * BS), k);
+    for (int r = 1; r < Nr; r++) {
+      k = LOADK(rk[r]);
+      for (int i = 0; i < 8; i++)
+        b[i] = _mm_aesdec_si128(b[i], k);
+    }
+    k = LOADK(rk[Nr]);
+    for (int i = 0; i < 8; i++)
+      b[i] = _mm_aesdeclast_si128(b[i], k);
+    // All of in's blocks are read before any of out's written, in case they're the same
+    b[0] = _mm_xor_si128(b[0], prev);
+    for (int i = 1; i < 8; i++)
+      b[i] = _mm_xor_si128(b[i], LOADB(in + (i - 1) * BS));
+    prev = LOADB(in + 7 * BS);
+    for (int i = 0; i < 8; i++)
+      STOREB(out + i * BS, b[i]);
+  }
+
+  for (; nblocks > 0; nblocks--, in += BS, out += BS) {
+    const __m128i c = LOADB(in);
+    __m128i b = _mm_xor_si128(c, LOADK(rk[0]));
+    for (int r = 1; r < Nr; r++)
+      b = _mm_aesdec_si128(b, LOADK(rk[r]));
+    STOREB(out, _mm_xor_si128(_mm_aesdeclast_si128(b, LOADK(rk[Nr])), prev));
+    prev = c;
+  }
+  STOREB(cbc, prev);
+}
+
+#elif (defined(_M_ARM64) || defined(__aarch64__)) && \
+      (defined(_MSC_VER) || defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+// With gcc and clang, only when building for a target with the Cryptography
+// Extension, e.g. -march=armv8-a+crypto (the default on Apple's)
+#define AES_HW
+#include <arm_neon.h>
+
+#define AES_HW_TARGET
+
+#define LOADB(p) vld1q_u8(p)
+#define STOREB(p, b) vst1q_u8(p, b)
+#define LOADK(k) LOADB(k)
+
+AES_HW_TARGET
+static void aes_hw_encrypt(const unsigned char *in, unsigned char *out,
+                           const RoundKeys &rk, int Nr)
+{
+  uint8x16_t b = LOADB(in);
+  for (int r = 0; r < Nr - 1; r++)
+    b = vaesmcq_u8(vaeseq_u8(b, LOADK(rk[r])));
+  b = vaeseq_u8(b, LOADK(rk[Nr - 1]));
+  STOREB(out, veorq_u8(b, LOADK(rk[Nr])));
+}
+
+AES_HW_TARGET
+static void aes_hw_decrypt(const unsigned char *in, unsigned char *out,
+                           const RoundKeys &rk, int Nr)
+{
+  uint8x16_t b = LOADB(in);
+  for (int r = 0; r < Nr - 1; r++)
+    b = vaesimcq_u8(vaesdq_u8(b, LOADK(rk[r])));
+  b = vaesdq_u8(b, LOADK(rk[Nr - 1]));
+  STOREB(out, veorq_u8(b, LOADK(rk[Nr])));
+}
+
+AES_HW_TARGET
+static void aes_hw_decrypt_cbc(const unsigned char *in, unsigned char *out,
+                               size_t nblocks, unsigned char *cbc,
+                               const RoundKeys &rk, int Nr)
+{
+  const size_t BS = AES::BLOCKSIZE;
+  uint8x16_t prev = LOADB(cbc);
+
+  for (; nblocks >= 4; nblocks -= 4, in += 4 * BS, out += 4 * BS) {
+    uint8x16_t b[4];
+    for (int i = 0; i < 4; i++)
+      b[i] = LOADB(in + i * BS);
+    for (int r = 0; r < Nr - 1; r++) {
+      const uint8x16_t k = LOADK(rk[r]);
+      for (int i = 0; i < 4; i++)
+        b[i] = vaesimcq_u8(vaesdq_u8(b[i], k));
+    }
+    const uint8x16_t k = LOADK(rk[Nr - 1]), klast = LOADK(rk[Nr]);
+    for (int i = 0; i < 4; i++)
+      b[i] = veorq_u8(vaesdq_u8(b[i], k), klast);
+    // All of in's blocks are read before any of out's written, in case they're the same
+    b[0] = veorq_u8(b[0], prev);
+    for (int i = 1; i < 4; i++)
+      b[i] = veorq_u8(b[i], LOADB(in + (i - 1) * BS));
+    prev = LOADB(in + 3 * BS);
+    for (int i = 0; i < 4; i++)
+      STOREB(out + i * BS, b[i]);
+  }
+
+  for (; nblocks > 0; nblocks--, in += BS, out += BS) {
+    const uint8x16_t c = LOADB(in);
+    unsigned char pt[AES::BLOCKSIZE];
+    aes_hw_decrypt(in, pt, rk, Nr);
+    STOREB(out, veorq_u8(LOADB(pt), prev));
+    prev = c;
+  }
+  STOREB(cbc, prev);
+}
+#endif /* x86, ARMv8 */
+
+static bool useHardware = true; // unless an AES::Restrict says otherwise
+
+AES::Restrict::Restrict(bool hardware) : m_hardware(useHardware)
+{
+  useHardware = hardware;
+}
+
+AES::Restrict::~Restrict()
+{
+  useHardware = m_hardware;
+}
+
+bool AES::HasHardware()
+{
+#ifdef AES_HW
+  return CPUFeatures::HasAES();
+#else
+  return false;
+#endif
+}
+
 AES::AES(const unsigned char* key, int keylen)
+  : m_hardware(useHardware && HasHardware())
 {
   CryptStatus status = rijndael_setup(key, keylen, 0, &key_schedule);
 
   ASSERT(status == CryptStatus::OK);
   if (status != CryptStatus::OK)
     throw status;
+
+  if (m_hardware) {
+    for (int r = 0; r <= key_schedule.Nr; r++)
+      for (int i = 0; i < 4; i++) {
+        STORE32H(key_schedule.eK[4 * r + i], m_roundKeys[0][r] + 4 * i);
+        STORE32H(key_schedule.dK[4 * r + i], m_roundKeys[1][r] + 4 * i);
+      }
+  }
 }
 
 AES::~AES()
 {
   trashMemory(&key_schedule, sizeof(key_schedule));
+  if (m_hardware)
+    trashMemory(m_roundKeys, sizeof(m_roundKeys));
 }
 
 void AES::Encrypt(const unsigned char *in, unsigned char *out) const
 {
+#ifdef AES_HW
+  if (m_hardware) {
+    aes_hw_encrypt(in, out, m_roundKeys[0], key_schedule.Nr);
+    return;
+  }
+#endif
   rijndael_ecb_encrypt(in, out, &key_schedule);
 }
 
 void AES::Decrypt(const unsigned char *in, unsigned char *out) const
 {
+#ifdef AES_HW
+  if (m_hardware) {
+    aes_hw_decrypt(in, out, m_roundKeys[1], key_schedule.Nr);
+    return;
+  }
+#endif
   rijndael_ecb_decrypt(in, out, &key_schedule);
 }
+
+void AES::EncryptBlocks(const unsigned char *in, unsigned char *out,
+                        size_t nblocks) const
+{
+#ifdef AES_HW
+  if (m_hardware) {
+    for (; nblocks > 0; nblocks--, in += BLOCKSIZE, out += BLOCKSIZE)
+      aes_hw_encrypt(in, out, m_roundKeys[0], key_schedule.Nr);
+    return;
+  }
+#endif
+  for (; nblocks > 0; nblocks--, in += BLOCKSIZE, out += BLOCKSIZE)
+    rijndael_ecb_encrypt(in, out, &key_schedule);
+}
+
+void AES::DecryptBlocks(const unsigned char *in, unsigned char *out,
+                        size_t nblocks) const
+{
+#ifdef AES_HW
+  if (m_hardware) {
+    for (; nblocks > 0; nblocks--, in += BLOCKSIZE, out += BLOCKSIZE)
+      aes_hw_decrypt(in, out, m_roundKeys[1], key_schedule.Nr);
+    return;
+  }
+#endif
+  for (; nblocks > 0; nblocks--, in += BLOCKSIZE, out += BLOCKSIZE)
+    rijndael_ecb_decrypt(in, out, &key_schedule);
+}
+
+void AES::EncryptCBC(const unsigned char *in, unsigned char *out,
+                     size_t nblocks, unsigned char *cbc) const
+{
+  // Each block needs the one before, so there's nothing to overlap
+  for (; nblocks > 0; nblocks--, in += BLOCKSIZE, out += BLOCKSIZE) {
+    for (unsigned int i = 0; i < BLOCKSIZE; i++)
+      out[i] = in[i] ^ cbc[i];
+#ifdef AES_HW
+    if (m_hardware)
+      aes_hw_encrypt(out, out, m_roundKeys[0], key_schedule.Nr);
+    else
+#endif
+      rijndael_ecb_encrypt(out, out, &key_schedule);
+    memcpy(cbc, out, BLOCKSIZE);
+  }
+}
+
+void AES::DecryptCBC(const unsigned char *in, unsigned char *out, size_t nblocks,
+                     unsigned char *cbc) const
+{
+#ifdef AES_HW
+  if (m_hardware) {
+    aes_hw_decrypt_cbc(in, out, nblocks, cbc, m_roundKeys[1], key_schedule.Nr);
+    return;
+  }
+#endif
+  unsigned char ct[BLOCKSIZE];
+  for (; nblocks > 0; nblocks--, in += BLOCKSIZE, out += BLOCKSIZE) {
+    memcpy(ct, in, BLOCKSIZE);
+    rijndael_ecb_decrypt(in, out, &key_schedule);
+    for (unsigned int i = 0; i < BLOCKSIZE; i++)
+      out[i] ^= cbc[i];
+    memcpy(cbc, ct, BLOCKSIZE);
+  }
+}
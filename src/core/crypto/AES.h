@@ -30,8 +30,41 @@ public:
   void Decrypt(const unsigned char *in, unsigned char *out) const;
   unsigned int GetBlockSize() const {return BLOCKSIZE;}
 
+  // The whole run of blocks in one go, see Fish. With AES instructions,
+  // DecryptCBC() does several blocks at a time.
+  void EncryptBlocks(const unsigned char *in, unsigned char *out,
+                     size_t nblocks) const override;
+  void DecryptBlocks(const unsigned char *in, unsigned char *out,
+                     size_t nblocks) const override;
+  void EncryptCBC(const unsigned char *in, unsigned char *out,
+                  size_t nblocks, unsigned char *cbc) const override;
+  void DecryptCBC(const unsigned char *in, unsigned char *out,
+                  size_t nblocks, unsigned char *cbc) const override;
+
+  // Whether this object uses the CPU's AES instructions (AES-NI or
+  // ARMv8 Crypto) or the portable table-based code
+  bool IsHardware() const {return m_hardware;}
+  // Whether this build and the CPU we're running on have them
+  static bool HasHardware();
+
+  // For testing: AES objects made while one of these exists use the
+  // instructions only if it allows them (and there are any)
+  class Restrict {
+  public:
+    explicit Restrict(bool hardware);
+    ~Restrict();
+    Restrict(const Restrict &) = delete;
+    Restrict &operator=(const Restrict &) = delete;
+  private:
+    bool m_hardware; // as it was before
+  };
+
 private:
   rijndael_key key_schedule;
+  bool m_hardware;
+  // key_schedule byte-ordered for the instructions: encryption then
+  // decryption round keys
+  unsigned char m_roundKeys[2][15][BLOCKSIZE];
 };
 #endif /* __AES_H */
 //-----------------------------------------------------------------------------
@@ -474,4 +474,76 @@ void BlowFish::Decrypt(const unsigned char *in, unsigned char *out) const
 
 }
 
+void BlowFish::LoadBlock(const unsigned char *in, uint32 &xl, uint32 &xr)
+{
+  memcpy(&xl, in, sizeof(uint32));
+  memcpy(&xr, in + sizeof(uint32), sizeof(uint32));
+#ifdef PWS_BIG_ENDIAN
+  byteswap(xl);
+  byteswap(xr);
+#endif
+}
+
+void BlowFish::StoreBlock(uint32 xl, uint32 xr, unsigned char *out)
+{
+#ifdef PWS_BIG_ENDIAN
+  byteswap(xl);
+  byteswap(xr);
+#endif
+  memcpy(out, &xl, sizeof(uint32));
+  memcpy(out + sizeof(uint32), &xr, sizeof(uint32));
+}
+
+void BlowFish::EncryptBlocks(const unsigned char *in, unsigned char *out,
+                             size_t nblocks) const
+{
+  uint32 xl, xr;
+  for (; nblocks > 0; nblocks--, in += BLOCKSIZE, out += BLOCKSIZE) {
+    LoadBlock(in, xl, xr);
+    Blowfish_encipher(&xl, &xr);
+    StoreBlock(xl, xr, out);
+  }
+}
+
+void BlowFish::DecryptBlocks(const unsigned char *in, unsigned char *out,
+                             size_t nblocks) const
+{
+  uint32 xl, xr;
+  for (; nblocks > 0; nblocks--, in += BLOCKSIZE, out += BLOCKSIZE) {
+    LoadBlock(in, xl, xr);
+    Blowfish_decipher(&xl, &xr);
+    StoreBlock(xl, xr, out);
+  }
+}
+
+void BlowFish::EncryptCBC(const unsigned char *in, unsigned char *out,
+                          size_t nblocks, unsigned char *cbc) const
+{
+  uint32 xl, xr, vl, vr;
+  LoadBlock(cbc, vl, vr);
+  for (; nblocks > 0; nblocks--, in += BLOCKSIZE, out += BLOCKSIZE) {
+    LoadBlock(in, xl, xr);
+    xl ^= vl; xr ^= vr;
+    Blowfish_encipher(&xl, &xr);
+    StoreBlock(xl, xr, out);
+    vl = xl; vr = xr;
+  }
+  StoreBlock(vl, vr, cbc);
+}
+
+void BlowFish::DecryptCBC(const unsigned char *in, unsigned char *out,
+                          size_t nblocks, unsigned char *cbc) const
+{
+  uint32 xl, xr, cl, cr, vl, vr;
+  LoadBlock(cbc, vl, vr);
+  for (; nblocks > 0; nblocks--, in += BLOCKSIZE, out += BLOCKSIZE) {
+    LoadBlock(in, cl, cr);
+    xl = cl; xr = cr;
+    Blowfish_decipher(&xl, &xr);
+    StoreBlock(xl ^ vl, xr ^ vr, out);
+    vl = cl; vr = cr;
+  }
+  StoreBlock(vl, vr, cbc);
+}
+
 //-----------------------------------------------------------------------------
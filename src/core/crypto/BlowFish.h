@@ -33,6 +33,16 @@ public:
   void Decrypt(const unsigned char *in, unsigned char *out) const;
   unsigned int GetBlockSize() const {return BLOCKSIZE;}
 
+  // The whole run of blocks in one go, see Fish
+  void EncryptBlocks(const unsigned char *in, unsigned char *out,
+                     size_t nblocks) const override;
+  void DecryptBlocks(const unsigned char *in, unsigned char *out,
+                     size_t nblocks) const override;
+  void EncryptCBC(const unsigned char *in, unsigned char *out,
+                  size_t nblocks, unsigned char *cbc) const override;
+  void DecryptCBC(const unsigned char *in, unsigned char *out,
+                  size_t nblocks, unsigned char *cbc) const override;
+
 private:
   static const unsigned int bf_N = 16;
   uint32 bf_S[4][256];
@@ -41,6 +51,9 @@ private:
   static const uint32 tempbf_P[bf_N + 2];
   void Blowfish_encipher(uint32* xl, uint32* xr) const;
   void Blowfish_decipher(uint32* xl, uint32* xr) const;
+  // A block's bytes to and from the words Blowfish_en/decipher() work on
+  static void LoadBlock(const unsigned char *in, uint32 &xl, uint32 &xr);
+  static void StoreBlock(uint32 xl, uint32 xr, unsigned char *out);
   void InitializeBlowfish(const unsigned char key[], short keybytes);
 };
 #endif /* __BLOWFISH_H */
@@ -0,0 +1,142 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// CPUFeatures.cpp
+//-----------------------------------------------------------------------------
+
+#include "CPUFeatures.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PWS_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define PWS_ARM64
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+namespace {
+#ifdef PWS_X86
+  // regs = {eax, ebx, ecx, edx} for cpuid leaf/subleaf, all 0 if the
+  // CPU doesn't go that far
+  void CPUID(unsigned int leaf, unsigned int subleaf, unsigned int regs[4])
+  {
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#ifdef _MSC_VER
+    int r[4];
+    __cpuid(r, 0);
+    if (static_cast<unsigned int>(r[0]) < leaf)
+      return;
+    __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; i++)
+      regs[i] = static_cast<unsigned int>(r[i]);
+#else
+    if (__get_cpuid_max(0, nullptr) < leaf)
+      return;
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+  }
+
+  bool DetectAES()
+  {
+    unsigned int regs[4];
+    CPUID(1, 0, regs);
+    return (regs[2] & (1u << 25)) != 0 && // AES-NI
+           (regs[3] & (1u << 26)) != 0;   // SSE2
+  }
+
+  bool DetectSHA256()
+  {
+    unsigned int regs[4];
+    CPUID(1, 0, regs);
+    if ((regs[2] & (1u << 9)) == 0 ||  // SSSE3
+        (regs[2] & (1u << 19)) == 0)   // SSE4.1
+      return false;
+    CPUID(7, 0, regs);
+    return (regs[1] & (1u << 29)) != 0; // SHA
+  }
+
+  bool DetectAVX2()
+  {
+    unsigned int regs[4];
+    CPUID(1, 0, regs);
+    if ((regs[2] & (1u << 27)) == 0 || // OSXSAVE
+        (regs[2] & (1u << 28)) == 0)   // AVX
+      return false;
+    // The OS must save and restore the YMM registers (XCR0 bits 1 & 2)
+#ifdef _MSC_VER
+    const unsigned long long xcr0 = _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    const unsigned long long xcr0 = eax | (static_cast<unsigned long long>(edx) << 32);
+#endif
+    if ((xcr0 & 6) != 6)
+      return false;
+    CPUID(7, 0, regs);
+    return (regs[1] & (1u << 5)) != 0; // AVX2
+  }
+#elif defined(PWS_ARM64)
+  bool DetectAVX2() {return false;}
+
+  bool DetectAES()
+  {
+#if defined(__APPLE__)
+    return true; // all Apple ARM64 CPUs have it
+#elif defined(_WIN32)
+    return IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE) != 0;
+#elif defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#else
+    return false;
+#endif
+  }
+
+  bool DetectSHA256()
+  {
+#if defined(__APPLE__)
+    return true;
+#elif defined(_WIN32)
+    return IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE) != 0;
+#elif defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+#else
+    return false;
+#endif
+  }
+#else
+  bool DetectAES() {return false;}
+  bool DetectSHA256() {return false;}
+  bool DetectAVX2() {return false;}
+#endif
+} // anonymous namespace
+
+bool CPUFeatures::HasAES()
+{
+  static const bool hasAES = DetectAES();
+  return hasAES;
+}
+
+bool CPUFeatures::HasSHA256()
+{
+  static const bool hasSHA256 = DetectSHA256();
+  return hasSHA256;
+}
+
+bool CPUFeatures::HasAVX2()
+{
+  static const bool hasAVX2 = DetectAVX2();
+  return hasAVX2;
+}
@@ -0,0 +1,28 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// CPUFeatures.h
+// What the CPU we're running on can do for the crypto code, so that it
+// can pick an implementation at runtime rather than at build time.
+//-----------------------------------------------------------------------------
+#ifndef __CPUFEATURES_H
+#define __CPUFEATURES_H
+
+namespace CPUFeatures {
+  // AES-NI on x86, the ARMv8 Cryptography Extension AES instructions on ARM
+  bool HasAES();
+  // The SHA extensions on x86, the ARMv8 Cryptography Extension SHA2 ones on ARM
+  bool HasSHA256();
+  // AVX2 on x86 (with the OS saving the registers), for 8 32-bit lanes
+  bool HasAVX2();
+}
+
+#endif /* __CPUFEATURES_H */
+//-----------------------------------------------------------------------------
+// Local variables:
+// mode: c++
+// End:
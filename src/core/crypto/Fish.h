@@ -12,6 +12,8 @@
 #include "../../os/mem.h"
 #include "../Util.h"
 
+#include <cstring>
+
 /**
 * Fish is an abstract base class for BlowFish and TwoFish
 * (and for any block cipher, but it's cooler to call it "Fish"
@@ -28,8 +30,66 @@ public:
   // (blocksize dependent on cipher)
   virtual void Encrypt(const unsigned char *pt, unsigned char *ct) const = 0;
   virtual void Decrypt(const unsigned char *ct, unsigned char *pt) const = 0;
+
+  // Following encrypt/decrypt nblocks consecutive blocks, each on its own
+  // (ECB) or chained (CBC). in may be the same as out. For CBC, cbc holds
+  // the IV (or the ciphertext block preceding in) on entry, and on return
+  // the last ciphertext block, to carry on from.
+  // The ciphers override these with loops of their own; the defaults are
+  // block at a time, for anything else.
+  virtual void EncryptBlocks(const unsigned char *in, unsigned char *out,
+                             size_t nblocks) const;
+  virtual void DecryptBlocks(const unsigned char *in, unsigned char *out,
+                             size_t nblocks) const;
+  virtual void EncryptCBC(const unsigned char *in, unsigned char *out,
+                          size_t nblocks, unsigned char *cbc) const;
+  virtual void DecryptCBC(const unsigned char *in, unsigned char *out,
+                          size_t nblocks, unsigned char *cbc) const;
 };
 
+inline void Fish::EncryptBlocks(const unsigned char *in, unsigned char *out,
+                                size_t nblocks) const
+{
+  const unsigned int BS = GetBlockSize();
+  for (; nblocks > 0; nblocks--, in += BS, out += BS)
+    Encrypt(in, out);
+}
+
+inline void Fish::DecryptBlocks(const unsigned char *in, unsigned char *out,
+                                size_t nblocks) const
+{
+  const unsigned int BS = GetBlockSize();
+  for (; nblocks > 0; nblocks--, in += BS, out += BS)
+    Decrypt(in, out);
+}
+
+inline void Fish::EncryptCBC(const unsigned char *in, unsigned char *out,
+                             size_t nblocks, unsigned char *cbc) const
+{
+  const unsigned int BS = GetBlockSize();
+  for (; nblocks > 0; nblocks--, in += BS, out += BS) {
+    for (unsigned int i = 0; i < BS; i++)
+      out[i] = in[i] ^ cbc[i];
+    Encrypt(out, out);
+    std::memcpy(cbc, out, BS);
+  }
+}
+
+inline void Fish::DecryptCBC(const unsigned char *in, unsigned char *out,
+                             size_t nblocks, unsigned char *cbc) const
+{
+  const unsigned int BS = GetBlockSize();
+  unsigned char ct[16];
+  ASSERT(BS <= sizeof(ct));
+  for (; nblocks > 0; nblocks--, in += BS, out += BS) {
+    std::memcpy(ct, in, BS);
+    Decrypt(in, out);
+    for (unsigned int i = 0; i < BS; i++)
+      out[i] ^= cbc[i];
+    std::memcpy(cbc, ct, BS);
+  }
+}
+
 
 /*
 * Returns a Fish object set up for encryption or decryption.
@@ -479,26 +479,31 @@ CryptStatus twofish_setup(const unsigned char *key, int keylen, int num_rounds,
 #endif
 
 /*
-  Encrypts a block of text with Twofish
-  @param pt The input plaintext (16 bytes)
-  @param ct The output ciphertext (16 bytes)
+  Encrypts blocks of text with Twofish, chaining them (CBC) if cbc isn't nullptr
+  @param pt The input plaintext (16 bytes per block)
+  @param ct The output ciphertext (16 bytes per block, may be pt)
+  @param nblocks The number of blocks
+  @param cbc The IV or previous ciphertext block (16 bytes), updated; or nullptr
   @param skey The key as scheduled
 */
 #ifdef LTC_CLEAN_STACK
-static void _twofish_ecb_encrypt(const unsigned char *pt, unsigned char *ct, const twofish_key *skey)
+static void _twofish_ecb_encrypt(const unsigned char *pt, unsigned char *ct, size_t nblocks,
+                                 unsigned char *cbc, const twofish_key *skey)
 #else
-static void twofish_ecb_encrypt(const unsigned char *pt, unsigned char *ct, const twofish_key *skey)
+static void twofish_ecb_encrypt(const unsigned char *pt, unsigned char *ct, size_t nblocks,
+                                unsigned char *cbc, const twofish_key *skey)
 #endif
 {
   uint32 a,b,c,d,ta,tb,tc,td,t1,t2;
+  uint32 va = 0, vb = 0, vc = 0, vd = 0;
   uint32 const *k;
   int r;
 #if !defined(TWOFISH_SMALL) && !defined(__GNUC__)
   const uint32 *S1, *S2, *S3, *S4;
 #endif    
 
-  ASSERT(pt   != nullptr);
-  ASSERT(ct   != nullptr);
+  ASSERT(nblocks == 0 || pt != nullptr);
+  ASSERT(nblocks == 0 || ct != nullptr);
   ASSERT(skey != nullptr);
 
 #if !defined(TWOFISH_SMALL) && !defined(__GNUC__)
@@ -508,67 +513,89 @@ static void twofish_ecb_encrypt(const unsigned char *pt, unsigned char *ct, cons
   S4 = skey->S[3];
 #endif    
 
-  LOAD32L(a,&pt[0]); LOAD32L(b,&pt[4]);
-  LOAD32L(c,&pt[8]); LOAD32L(d,&pt[12]);
-  a ^= skey->K[0];
-  b ^= skey->K[1];
-  c ^= skey->K[2];
-  d ^= skey->K[3];
-
-  k  = skey->K + 8;
-  for (r = 8; r != 0; --r) {
-    t2 = g1_func(b, skey);
-    t1 = g_func(a, skey) + t2;
-    c  = RORc(c ^ (t1 + k[0]), 1);
-    d  = ROLc(d, 1) ^ (t2 + t1 + k[1]);
-
-    t2 = g1_func(d, skey);
-    t1 = g_func(c, skey) + t2;
-    a  = RORc(a ^ (t1 + k[2]), 1);
-    b  = ROLc(b, 1) ^ (t2 + t1 + k[3]);
-    k += 4;
+  if (cbc != nullptr) {
+    LOAD32L(va,&cbc[0]); LOAD32L(vb,&cbc[4]);
+    LOAD32L(vc,&cbc[8]); LOAD32L(vd,&cbc[12]);
   }
 
-  /* output with "undo last swap" */
-  ta = c ^ skey->K[4];
-  tb = d ^ skey->K[5];
-  tc = a ^ skey->K[6];
-  td = b ^ skey->K[7];
+  for (; nblocks != 0; --nblocks, pt += 16, ct += 16) {
+    LOAD32L(a,&pt[0]); LOAD32L(b,&pt[4]);
+    LOAD32L(c,&pt[8]); LOAD32L(d,&pt[12]);
+    a ^= va ^ skey->K[0];
+    b ^= vb ^ skey->K[1];
+    c ^= vc ^ skey->K[2];
+    d ^= vd ^ skey->K[3];
+
+    k  = skey->K + 8;
+    for (r = 8; r != 0; --r) {
+      t2 = g1_func(b, skey);
+      t1 = g_func(a, skey) + t2;
+      c  = RORc(c ^ (t1 + k[0]), 1);
+      d  = ROLc(d, 1) ^ (t2 + t1 + k[1]);
+
+      t2 = g1_func(d, skey);
+      t1 = g_func(c, skey) + t2;
+      a  = RORc(a ^ (t1 + k[2]), 1);
+      b  = ROLc(b, 1) ^ (t2 + t1 + k[3]);
+      k += 4;
+    }
+
+    /* output with "undo last swap" */
+    ta = c ^ skey->K[4];
+    tb = d ^ skey->K[5];
+    tc = a ^ skey->K[6];
+    td = b ^ skey->K[7];
 
-  /* store output */
-  STORE32L(ta,&ct[0]); STORE32L(tb,&ct[4]);
-  STORE32L(tc,&ct[8]); STORE32L(td,&ct[12]);
+    /* store output */
+    STORE32L(ta,&ct[0]); STORE32L(tb,&ct[4]);
+    STORE32L(tc,&ct[8]); STORE32L(td,&ct[12]);
+
+    if (cbc != nullptr) {
+      va = ta; vb = tb; vc = tc; vd = td;
+    }
+  }
+
+  if (cbc != nullptr) {
+    STORE32L(va,&cbc[0]); STORE32L(vb,&cbc[4]);
+    STORE32L(vc,&cbc[8]); STORE32L(vd,&cbc[12]);
+  }
 }
 
 #ifdef LTC_CLEAN_STACK
-static void twofish_ecb_encrypt(const unsigned char *pt, unsigned char *ct, const twofish_key *skey)
+static void twofish_ecb_encrypt(const unsigned char *pt, unsigned char *ct, size_t nblocks,
+                                unsigned char *cbc, const twofish_key *skey)
 {
-  _twofish_ecb_encrypt(pt, ct, skey);
-  burnStack(sizeof(uint32) * 10 + sizeof(uint32));
+  _twofish_ecb_encrypt(pt, ct, nblocks, cbc, skey);
+  burnStack(sizeof(uint32) * 14 + sizeof(uint32));
 }
 #endif
 
 /*
-  Decrypts a block of text with Twofish
-  @param ct The input ciphertext (16 bytes)
-  @param pt The output plaintext (16 bytes)
+  Decrypts blocks of text with Twofish, unchaining them (CBC) if cbc isn't nullptr
+  @param ct The input ciphertext (16 bytes per block)
+  @param pt The output plaintext (16 bytes per block, may be ct)
+  @param nblocks The number of blocks
+  @param cbc The IV or previous ciphertext block (16 bytes), updated; or nullptr
   @param skey The key as scheduled 
 */
 #ifdef LTC_CLEAN_STACK
-static void _twofish_ecb_decrypt(const unsigned char *ct, unsigned char *pt, const twofish_key *skey)
+static void _twofish_ecb_decrypt(const unsigned char *ct, unsigned char *pt, size_t nblocks,
+                                 unsigned char *cbc, const twofish_key *skey)
 #else
-static void twofish_ecb_decrypt(const unsigned char *ct, unsigned char *pt, const twofish_key *skey)
+static void twofish_ecb_decrypt(const unsigned char *ct, unsigned char *pt, size_t nblocks,
+                                unsigned char *cbc, const twofish_key *skey)
 #endif
 {
   uint32 a,b,c,d,ta,tb,tc,td,t1,t2;
+  uint32 va = 0, vb = 0, vc = 0, vd = 0;
   uint32 const *k;
   int r;
 #if !defined(TWOFISH_SMALL) && !defined(__GNUC__)
   const uint32 *S1, *S2, *S3, *S4;
 #endif    
 
-  ASSERT(pt   != nullptr);
-  ASSERT(ct   != nullptr);
+  ASSERT(nblocks == 0 || pt != nullptr);
+  ASSERT(nblocks == 0 || ct != nullptr);
   ASSERT(skey != nullptr);
 
 #if !defined(TWOFISH_SMALL) && !defined(__GNUC__)
@@ -578,46 +605,63 @@ static void twofish_ecb_decrypt(const unsigned char *ct, unsigned char *pt, cons
   S4 = skey->S[3];
 #endif    
 
-  /* load input */
-  LOAD32L(ta,&ct[0]); LOAD32L(tb,&ct[4]);
-  LOAD32L(tc,&ct[8]); LOAD32L(td,&ct[12]);
-
-  /* undo undo final swap */
-  a = tc ^ skey->K[6];
-  b = td ^ skey->K[7];
-  c = ta ^ skey->K[4];
-  d = tb ^ skey->K[5];
-
-  k = skey->K + 36;
-  for (r = 8; r != 0; --r) {
-    t2 = g1_func(d, skey);
-    t1 = g_func(c, skey) + t2;
-    a = ROLc(a, 1) ^ (t1 + k[2]);
-    b = RORc(b ^ (t2 + t1 + k[3]), 1);
-
-    t2 = g1_func(b, skey);
-    t1 = g_func(a, key) + t2;
-    c = ROLc(c, 1) ^ (t1 + k[0]);
-    d = RORc(d ^ (t2 +  t1 + k[1]), 1);
-    k -= 4;
+  if (cbc != nullptr) {
+    LOAD32L(va,&cbc[0]); LOAD32L(vb,&cbc[4]);
+    LOAD32L(vc,&cbc[8]); LOAD32L(vd,&cbc[12]);
   }
 
-  /* pre-white */
-  a ^= skey->K[0];
-  b ^= skey->K[1];
-  c ^= skey->K[2];
-  d ^= skey->K[3];
+  for (; nblocks != 0; --nblocks, ct += 16, pt += 16) {
+    /* load input (kept in ta..td for chaining, as pt may be ct) */
+    LOAD32L(ta,&ct[0]); LOAD32L(tb,&ct[4]);
+    LOAD32L(tc,&ct[8]); LOAD32L(td,&ct[12]);
+
+    /* undo undo final swap */
+    a = tc ^ skey->K[6];
+    b = td ^ skey->K[7];
+    c = ta ^ skey->K[4];
+    d = tb ^ skey->K[5];
+
+    k = skey->K + 36;
+    for (r = 8; r != 0; --r) {
+      t2 = g1_func(d, skey);
+      t1 = g_func(c, skey) + t2;
+      a = ROLc(a, 1) ^ (t1 + k[2]);
+      b = RORc(b ^ (t2 + t1 + k[3]), 1);
+
+      t2 = g1_func(b, skey);
+      t1 = g_func(a, skey) + t2;
+      c = ROLc(c, 1) ^ (t1 + k[0]);
+      d = RORc(d ^ (t2 +  t1 + k[1]), 1);
+      k -= 4;
+    }
+
+    /* pre-white */
+    a ^= va ^ skey->K[0];
+    b ^= vb ^ skey->K[1];
+    c ^= vc ^ skey->K[2];
+    d ^= vd ^ skey->K[3];
+
+    /* store */
+    STORE32L(a, &pt[0]); STORE32L(b, &pt[4]);
+    STORE32L(c, &pt[8]); STORE32L(d, &pt[12]);
+
+    if (cbc != nullptr) {
+      va = ta; vb = tb; vc = tc; vd = td;
+    }
+  }
 
-  /* store */
-  STORE32L(a, &pt[0]); STORE32L(b, &pt[4]);
-  STORE32L(c, &pt[8]); STORE32L(d, &pt[12]);
+  if (cbc != nullptr) {
+    STORE32L(va,&cbc[0]); STORE32L(vb,&cbc[4]);
+    STORE32L(vc,&cbc[8]); STORE32L(vd,&cbc[12]);
+  }
 }
 
 #ifdef LTC_CLEAN_STACK
-static void twofish_ecb_decrypt(const unsigned char *ct, unsigned char *pt, const twofish_key *skey)
+static void twofish_ecb_decrypt(const unsigned char *ct, unsigned char *pt, size_t nblocks,
+                                unsigned char *cbc, const twofish_key *skey)
 {
-  _twofish_ecb_decrypt(ct, pt, skey);
-  burnStack(sizeof(uint32) * 10 + sizeof(uint32));
+  _twofish_ecb_decrypt(ct, pt, nblocks, cbc, skey);
+  burnStack(sizeof(uint32) * 14 + sizeof(uint32));
 }
 #endif
 
@@ -637,10 +681,34 @@ TwoFish::~TwoFish()
 
 void TwoFish::Encrypt(const unsigned char *in, unsigned char *out) const
 {
-  twofish_ecb_encrypt(in, out, &key_schedule);
+  twofish_ecb_encrypt(in, out, 1, nullptr, &key_schedule);
 }
 
 void TwoFish::Decrypt(const unsigned char *in, unsigned char *out) const
 {
-  twofish_ecb_decrypt(in, out, &key_schedule);
+  twofish_ecb_decrypt(in, out, 1, nullptr, &key_schedule);
+}
+
+void TwoFish::EncryptBlocks(const unsigned char *in, unsigned char *out,
+                            size_t nblocks) const
+{
+  twofish_ecb_encrypt(in, out, nblocks, nullptr, &key_schedule);
+}
+
+void TwoFish::DecryptBlocks(const unsigned char *in, unsigned char *out,
+                            size_t nblocks) const
+{
+  twofish_ecb_decrypt(in, out, nblocks, nullptr, &key_schedule);
+}
+
+void TwoFish::EncryptCBC(const unsigned char *in, unsigned char *out,
+                         size_t nblocks, unsigned char *cbc) const
+{
+  twofish_ecb_encrypt(in, out, nblocks, cbc, &key_schedule);
+}
+
+void TwoFish::DecryptCBC(const unsigned char *in, unsigned char *out,
+                         size_t nblocks, unsigned char *cbc) const
+{
+  twofish_ecb_decrypt(in, out, nblocks, cbc, &key_schedule);
 }
@@ -36,6 +36,16 @@ public:
   void Decrypt(const unsigned char *in, unsigned char *out) const;
   unsigned int GetBlockSize() const {return BLOCKSIZE;}
 
+  // The whole run of blocks in one go, see Fish
+  void EncryptBlocks(const unsigned char *in, unsigned char *out,
+                     size_t nblocks) const override;
+  void DecryptBlocks(const unsigned char *in, unsigned char *out,
+                     size_t nblocks) const override;
+  void EncryptCBC(const unsigned char *in, unsigned char *out,
+                  size_t nblocks, unsigned char *cbc) const override;
+  void DecryptCBC(const unsigned char *in, unsigned char *out,
+                  size_t nblocks, unsigned char *cbc) const override;
+
 private:
   twofish_key key_schedule;
 };
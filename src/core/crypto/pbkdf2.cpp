@@ -9,10 +9,13 @@
 // Based on LibTomCrypt by
 // Tom St Denis, tomstdenis@iahu.ca, http://libtomcrypt.org
 
+#include "pbkdf2.h"
 #include "bitops.h"
 #include "hmac.h"
 
 #include <cstring>
+#include <thread>
+#include <vector>
 
 /**
    @param password          The input password (or key)
@@ -90,3 +93,134 @@ void pbkdf2(const unsigned char *password, unsigned long password_len,
 
   delete[] buf[0];
 }
+
+/*
+ * pbkdf2_sha256: as pbkdf2() with HMAC<SHA256>, for one block of output,
+ * but with the HMAC's key pads hashed once rather than at every iteration,
+ * and every iteration's HMAC being two SHA256::HashDigests() calls on all
+ * of a thread's streams at once.
+ */
+
+namespace {
+  struct PBKDF2Stream {
+    ulong32 U[8]; // the last HMAC, as words
+    ulong32 T[8]; // the XOR of them all
+  };
+
+  // Runs streams [0, n) from their first HMAC to their iteration counts
+  void pbkdf2_sha256_iterate(const ulong32 istate[8], const ulong32 ostate[8],
+                             PBKDF2Stream *streams, const unsigned int *counts,
+                             size_t n)
+  {
+    unsigned int maxCount = 0;
+    for (size_t i = 0; i < n; i++)
+      if (counts[i] > maxCount)
+        maxCount = counts[i];
+
+    // The streams' Us side by side, for HashDigests()
+    std::vector<ulong32> words(8 * n);
+    ulong32 (*U)[8] = reinterpret_cast<ulong32 (*)[8]>(words.data());
+    for (size_t i = 0; i < n; i++)
+      memcpy(U[i], streams[i].U, sizeof(U[i]));
+
+    for (unsigned int itts = 1; itts < maxCount; itts++) {
+      SHA256::HashDigests(istate, 1, U, n);
+      SHA256::HashDigests(ostate, 1, U, n);
+      for (size_t i = 0; i < n; i++)
+        if (itts < counts[i])
+          for (int y = 0; y < 8; y++)
+            streams[i].T[y] ^= U[i][y];
+    }
+    trashMemory(words.data(), words.size() * sizeof(ulong32));
+  }
+}
+
+size_t pbkdf2_sha256_width()
+{
+  const size_t nThreads = std::thread::hardware_concurrency();
+  return SHA256::DigestLanes() * (nThreads > 0 ? nThreads : 1);
+}
+
+void pbkdf2_sha256(const unsigned char *password, unsigned long password_len,
+                   const unsigned char *const salts[], unsigned long salt_len,
+                   const unsigned int iteration_counts[], size_t n,
+                   unsigned char (*out)[32])
+{
+  const unsigned int BS = SHA256::BLOCKSIZE, HL = SHA256::HASHLEN;
+  ASSERT(password != nullptr || password_len == 0);
+  ASSERT(out != nullptr);
+  if (n == 0)
+    return;
+
+  // The HMAC key and its pads, as for HMAC<>
+  unsigned char K[BS] = {0}, pad[BS];
+  if (password_len > BS) {
+    SHA256 H0;
+    H0.Update(password, password_len);
+    H0.Final(K);
+  } else {
+    memcpy(K, password, password_len);
+  }
+  ulong32 istate[8], ostate[8];
+  {
+    for (unsigned int i = 0; i < BS; i++)
+      pad[i] = K[i] ^ 0x36;
+    SHA256 Hi;
+    Hi.Update(pad, BS);
+    Hi.GetState(istate);
+    for (unsigned int i = 0; i < BS; i++)
+      pad[i] = K[i] ^ 0x5c;
+    SHA256 Ho;
+    Ho.Update(pad, BS);
+    Ho.GetState(ostate);
+  }
+
+  // U1 = PRF(P, S||INT(1)) for each stream
+  std::vector<PBKDF2Stream> streams(n);
+  for (size_t i = 0; i < n; i++) {
+    unsigned char blkno[4], u[HL];
+    STORE32H(static_cast<ulong32>(1), blkno);
+    HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> hmac(password, password_len);
+    hmac.Update(salts[i], salt_len);
+    hmac.Update(blkno, sizeof(blkno));
+    hmac.Final(u);
+    for (int y = 0; y < 8; y++) {
+      LOAD32H(streams[i].U[y], u + 4 * y);
+    }
+    memcpy(streams[i].T, streams[i].U, sizeof(streams[i].T));
+    trashMemory(u, sizeof(u));
+  }
+
+  // Then the rest, a share of the streams per thread, each share a whole
+  // number of lanes where possible. The calling thread does the first.
+  const size_t lanes = SHA256::DigestLanes();
+  size_t nThreads = std::thread::hardware_concurrency();
+  if (nThreads == 0)
+    nThreads = 1;
+  const size_t nGroups = (n + lanes - 1) / lanes;
+  if (nThreads > nGroups)
+    nThreads = nGroups;
+  const size_t perThread = ((nGroups + nThreads - 1) / nThreads) * lanes;
+
+  std::vector<std::thread> threads;
+  for (size_t begin = perThread; begin < n; begin += perThread) {
+    const size_t count = (n - begin < perThread) ? n - begin : perThread;
+    threads.emplace_back(pbkdf2_sha256_iterate, istate, ostate,
+                         &streams[begin], iteration_counts + begin, count);
+  }
+  pbkdf2_sha256_iterate(istate, ostate, streams.data(), iteration_counts,
+                        (n < perThread) ? n : perThread);
+  for (auto &t : threads)
+    t.join();
+
+  for (size_t i = 0; i < n; i++)
+    for (int y = 0; y < 8; y++) {
+      STORE32H(streams[i].T[y], out[i] + 4 * y);
+    }
+
+  trashMemory(streams.data(), n * sizeof(PBKDF2Stream));
+  trashMemory(K, sizeof(K));
+  trashMemory(pad, sizeof(pad));
+  trashMemory(istate, sizeof(istate));
+  trashMemory(ostate, sizeof(ostate));
+}
@@ -14,6 +14,9 @@
 
 #ifndef __PBKDF2_H
 #define __PBKDF2_H
+
+#include <cstddef>
+
 class HMAC_BASE;
 /**
    @param password          The input password (or key)
@@ -30,4 +33,25 @@ void pbkdf2(const unsigned char *password, unsigned long password_len,
             const unsigned char *salt,     unsigned long salt_len,
             int iteration_count,           HMAC_BASE *hmac,
             unsigned char *out,            unsigned long *outlen);
+
+/**
+   PBKDF2 with HMAC-SHA256, of one password with each of n salts, as when
+   trying it against each of a V4 database's key blocks. Each output is
+   one hash long. The n are computed side by side, in SIMD lanes and on
+   as many threads as there are cores, so that up to pbkdf2_sha256_width()
+   of them take about as long as one.
+   @param password          The input password (or key)
+   @param password_len      The length of the password (octets)
+   @param salts             The n salts
+   @param salt_len          The length of each salt (octets)
+   @param iteration_counts  The n iteration counts
+   @param n                 How many
+   @param out               [out] The n results, each SHA256::HASHLEN octets
+*/
+void pbkdf2_sha256(const unsigned char *password, unsigned long password_len,
+                   const unsigned char *const salts[], unsigned long salt_len,
+                   const unsigned int iteration_counts[], size_t n,
+                   unsigned char (*out)[32]);
+
+size_t pbkdf2_sha256_width();
 #endif /* __PBKDF2_H */
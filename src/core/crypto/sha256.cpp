@@ -10,6 +10,7 @@
 // Tom St Denis, tomstdenis@iahu.ca, http://libtomcrypt.org
 //-----------------------------------------------------------------------------
 #include "sha256.h"
+#include "CPUFeatures.h"
 #include "bitops.h"
 #include "../Util.h"
 
@@ -179,6 +180,378 @@ static void sha256_compress(ulong32 state[8], const unsigned char *buf)
 }
 #endif
 
+/*
+ * The same, with the CPU's SHA-256 instructions: the SHA extensions on
+ * x86, the Cryptography Extension on ARMv8. These are compiled for the
+ * instructions whatever the build's target, and only called once
+ * HasHardware() says the CPU has them.
+ * sha256_hw_rounds() does the 64 rounds of one block, given its
+ * (byte-swapped) message words, so that Rehash() can feed the last
+ * digest straight back in as the next message.
+ */
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SHA256_HW
+#include <immintrin.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SHA256_HW_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+#else
+#define SHA256_HW_TARGET
+#endif
+
+alignas(16) static const ulong32 K256[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+// Four rounds, and the schedule of the message words they free up:
+// cur holds w[4g..4g+3]; next becomes w[4g+16..4g+19] over the coming groups
+#define SHA_NI_ROUNDS(g, cur, prev, next)                               \
+  msg = _mm_add_epi32(cur, _mm_load_si128(reinterpret_cast<const __m128i *>(K256 + 4 * g))); \
+  cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);                       \
+  if (g >= 3 && g <= 14) {                                             \
+    next = _mm_add_epi32(next, _mm_alignr_epi8(cur, prev, 4));         \
+    next = _mm_sha256msg2_epu32(next, cur);                            \
+  }                                                                    \
+  abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E)); \
+  if (g >= 1 && g <= 12)                                               \
+    prev = _mm_sha256msg1_epu32(prev, cur);
+
+// abef, cdgh: the state as the instructions want it
+SHA256_HW_TARGET
+static inline void sha256_hw_rounds(__m128i &abef, __m128i &cdgh,
+                                    __m128i m0, __m128i m1, __m128i m2, __m128i m3)
+{
+  const __m128i abef0 = abef, cdgh0 = cdgh;
+  __m128i msg;
+  SHA_NI_ROUNDS( 0, m0, m3, m1); SHA_NI_ROUNDS( 1, m1, m0, m2);
+  SHA_NI_ROUNDS( 2, m2, m1, m3); SHA_NI_ROUNDS( 3, m3, m2, m0);
+  SHA_NI_ROUNDS( 4, m0, m3, m1); SHA_NI_ROUNDS( 5, m1, m0, m2);
+  SHA_NI_ROUNDS( 6, m2, m1, m3); SHA_NI_ROUNDS( 7, m3, m2, m0);
+  SHA_NI_ROUNDS( 8, m0, m3, m1); SHA_NI_ROUNDS( 9, m1, m0, m2);
+  SHA_NI_ROUNDS(10, m2, m1, m3); SHA_NI_ROUNDS(11, m3, m2, m0);
+  SHA_NI_ROUNDS(12, m0, m3, m1); SHA_NI_ROUNDS(13, m1, m0, m2);
+  SHA_NI_ROUNDS(14, m2, m1, m3); SHA_NI_ROUNDS(15, m3, m2, m0);
+  abef = _mm_add_epi32(abef, abef0);
+  cdgh = _mm_add_epi32(cdgh, cdgh0);
+}
+#undef SHA_NI_ROUNDS
+
+// state[0..7] <-> the ABEF/CDGH registers the instructions use
+SHA256_HW_TARGET
+static inline void sha256_hw_load(const ulong32 state[8], __m128i &abef, __m128i &cdgh)
+{
+  const __m128i dcba = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state)), 0xB1);
+  const __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state + 4)), 0x1B);
+  abef = _mm_alignr_epi8(dcba, efgh, 8);
+  cdgh = _mm_blend_epi16(efgh, dcba, 0xF0);
+}
+
+// ...and back, as words in state order: a, b, c, d and e, f, g, h
+SHA256_HW_TARGET
+static inline void sha256_hw_unload(__m128i abef, __m128i cdgh, __m128i &abcd, __m128i &efgh)
+{
+  const __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+  const __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+  abcd = _mm_blend_epi16(feba, dchg, 0xF0);
+  efgh = _mm_alignr_epi8(dchg, feba, 8);
+}
+
+SHA256_HW_TARGET
+static void sha256_hw_compress(ulong32 state[8], const unsigned char *buf, size_t nblocks)
+{
+  const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+  __m128i abef, cdgh;
+  sha256_hw_load(state, abef, cdgh);
+  for (; nblocks > 0; nblocks--, buf += 64) {
+    const __m128i *in = reinterpret_cast<const __m128i *>(buf);
+    sha256_hw_rounds(abef, cdgh,
+                     _mm_shuffle_epi8(_mm_loadu_si128(in), bswap),
+                     _mm_shuffle_epi8(_mm_loadu_si128(in + 1), bswap),
+                     _mm_shuffle_epi8(_mm_loadu_si128(in + 2), bswap),
+                     _mm_shuffle_epi8(_mm_loadu_si128(in + 3), bswap));
+  }
+  __m128i abcd, efgh;
+  sha256_hw_unload(abef, cdgh, abcd, efgh);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(state), abcd);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(state + 4), efgh);
+}
+
+// digest = SHA256(digest), n times: each message is the last digest,
+// then the padding of a 32 byte message
+SHA256_HW_TARGET
+static void sha256_hw_rehash(const ulong32 iv[8], unsigned char digest[32], unsigned int n)
+{
+  const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+  const __m128i pad0 = _mm_set_epi32(0, 0, 0, static_cast<int>(0x80000000));
+  const __m128i pad1 = _mm_set_epi32(32 * 8, 0, 0, 0);
+  __m128i abef0, cdgh0;
+  sha256_hw_load(iv, abef0, cdgh0);
+  __m128i abcd = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(digest)), bswap);
+  __m128i efgh = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(digest + 16)), bswap);
+  for (; n > 0; n--) {
+    __m128i abef = abef0, cdgh = cdgh0;
+    sha256_hw_rounds(abef, cdgh, abcd, efgh, pad0, pad1);
+    sha256_hw_unload(abef, cdgh, abcd, efgh);
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(digest), _mm_shuffle_epi8(abcd, bswap));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(digest + 16), _mm_shuffle_epi8(efgh, bswap));
+}
+
+// Each of the n messages m (as words) = hash of prefixBlocks blocks, whose
+// chaining state is state, then the message
+SHA256_HW_TARGET
+static void sha256_hw_digests(const ulong32 state[8], ulong32 bitlen,
+                              ulong32 (*m)[8], size_t n)
+{
+  const __m128i pad0 = _mm_set_epi32(0, 0, 0, static_cast<int>(0x80000000));
+  const __m128i pad1 = _mm_set_epi32(static_cast<int>(bitlen), 0, 0, 0);
+  __m128i abef0, cdgh0;
+  sha256_hw_load(state, abef0, cdgh0);
+  for (size_t i = 0; i < n; i++) {
+    __m128i abef = abef0, cdgh = cdgh0, abcd, efgh;
+    sha256_hw_rounds(abef, cdgh,
+                     _mm_loadu_si128(reinterpret_cast<const __m128i *>(m[i])),
+                     _mm_loadu_si128(reinterpret_cast<const __m128i *>(m[i] + 4)),
+                     pad0, pad1);
+    sha256_hw_unload(abef, cdgh, abcd, efgh);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(m[i]), abcd);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(m[i] + 4), efgh);
+  }
+}
+
+#elif (defined(_M_ARM64) || defined(__aarch64__)) && \
+      (defined(_MSC_VER) || defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2))
+// With gcc and clang, only when building for a target with the Cryptography
+// Extension, e.g. -march=armv8-a+crypto (the default on Apple's)
+#define SHA256_HW
+#include <arm_neon.h>
+
+static const ulong32 K256[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+// Four rounds, and the schedule of the message words they free up:
+// cur holds w[4g..4g+3], and becomes w[4g+16..4g+19]
+#define SHA_ARM_ROUNDS(g, cur, w1, w2, w3)                 \
+  wk = vaddq_u32(cur, vld1q_u32(K256 + 4 * g));            \
+  if (g < 12)                                              \
+    cur = vsha256su1q_u32(vsha256su0q_u32(cur, w1), w2, w3); \
+  tmp = abcd;                                              \
+  abcd = vsha256hq_u32(abcd, efgh, wk);                    \
+  efgh = vsha256h2q_u32(efgh, tmp, wk);
+
+static inline void sha256_hw_rounds(uint32x4_t &abcd, uint32x4_t &efgh,
+                                    uint32x4_t m0, uint32x4_t m1, uint32x4_t m2, uint32x4_t m3)
+{
+  const uint32x4_t abcd0 = abcd, efgh0 = efgh;
+  uint32x4_t wk, tmp;
+  SHA_ARM_ROUNDS( 0, m0, m1, m2, m3); SHA_ARM_ROUNDS( 1, m1, m2, m3, m0);
+  SHA_ARM_ROUNDS( 2, m2, m3, m0, m1); SHA_ARM_ROUNDS( 3, m3, m0, m1, m2);
+  SHA_ARM_ROUNDS( 4, m0, m1, m2, m3); SHA_ARM_ROUNDS( 5, m1, m2, m3, m0);
+  SHA_ARM_ROUNDS( 6, m2, m3, m0, m1); SHA_ARM_ROUNDS( 7, m3, m0, m1, m2);
+  SHA_ARM_ROUNDS( 8, m0, m1, m2, m3); SHA_ARM_ROUNDS( 9, m1, m2, m3, m0);
+  SHA_ARM_ROUNDS(10, m2, m3, m0, m1); SHA_ARM_ROUNDS(11, m3, m0, m1, m2);
+  SHA_ARM_ROUNDS(12, m0, m1, m2, m3); SHA_ARM_ROUNDS(13, m1, m2, m3, m0);
+  SHA_ARM_ROUNDS(14, m2, m3, m0, m1); SHA_ARM_ROUNDS(15, m3, m0, m1, m2);
+  abcd = vaddq_u32(abcd, abcd0);
+  efgh = vaddq_u32(efgh, efgh0);
+}
+#undef SHA_ARM_ROUNDS
+
+static inline uint32x4_t sha256_hw_load_msg(const unsigned char *p)
+{
+  return vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p)));
+}
+
+static void sha256_hw_compress(ulong32 state[8], const unsigned char *buf, size_t nblocks)
+{
+  uint32x4_t abcd = vld1q_u32(state), efgh = vld1q_u32(state + 4);
+  for (; nblocks > 0; nblocks--, buf += 64)
+    sha256_hw_rounds(abcd, efgh,
+                     sha256_hw_load_msg(buf), sha256_hw_load_msg(buf + 16),
+                     sha256_hw_load_msg(buf + 32), sha256_hw_load_msg(buf + 48));
+  vst1q_u32(state, abcd);
+  vst1q_u32(state + 4, efgh);
+}
+
+// digest = SHA256(digest), n times: each message is the last digest,
+// then the padding of a 32 byte message
+static void sha256_hw_rehash(const ulong32 iv[8], unsigned char digest[32], unsigned int n)
+{
+  const ulong32 padding[8] = {0x80000000, 0, 0, 0, 0, 0, 0, 32 * 8};
+  const uint32x4_t pad0 = vld1q_u32(padding), pad1 = vld1q_u32(padding + 4);
+  const uint32x4_t abcd0 = vld1q_u32(iv), efgh0 = vld1q_u32(iv + 4);
+  uint32x4_t abcd = sha256_hw_load_msg(digest), efgh = sha256_hw_load_msg(digest + 16);
+  for (; n > 0; n--) {
+    uint32x4_t m0 = abcd, m1 = efgh;
+    abcd = abcd0; efgh = efgh0;
+    sha256_hw_rounds(abcd, efgh, m0, m1, pad0, pad1);
+  }
+  vst1q_u8(digest, vrev32q_u8(vreinterpretq_u8_u32(abcd)));
+  vst1q_u8(digest + 16, vrev32q_u8(vreinterpretq_u8_u32(efgh)));
+}
+// Each of the n messages m (as words) = hash of prefixBlocks blocks, whose
+// chaining state is state, then the message
+static void sha256_hw_digests(const ulong32 state[8], ulong32 bitlen,
+                              ulong32 (*m)[8], size_t n)
+{
+  const ulong32 padding[8] = {0x80000000, 0, 0, 0, 0, 0, 0, bitlen};
+  const uint32x4_t pad0 = vld1q_u32(padding), pad1 = vld1q_u32(padding + 4);
+  const uint32x4_t abcd0 = vld1q_u32(state), efgh0 = vld1q_u32(state + 4);
+  for (size_t i = 0; i < n; i++) {
+    uint32x4_t abcd = abcd0, efgh = efgh0;
+    sha256_hw_rounds(abcd, efgh, vld1q_u32(m[i]), vld1q_u32(m[i] + 4), pad0, pad1);
+    vst1q_u32(m[i], abcd);
+    vst1q_u32(m[i] + 4, efgh);
+  }
+}
+#endif /* x86, ARMv8 */
+
+/*
+ * Without SHA-256 instructions, HashDigests() can still do 8 messages at
+ * once, a 32-bit lane each, with AVX2.
+ */
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SHA256_AVX2
+#include <immintrin.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SHA256_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define SHA256_AVX2_TARGET
+#endif
+
+// K256 as for the SHA extensions, above
+#define V_ROR(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+#define V_XOR3(x, y, z) _mm256_xor_si256(_mm256_xor_si256(x, y), z)
+#define V_ADD(x, y) _mm256_add_epi32(x, y)
+
+SHA256_AVX2_TARGET
+static void sha256_avx2_digests(const ulong32 state[8], ulong32 bitlen,
+                                ulong32 (*m)[8], size_t n)
+{
+  const size_t LANES = 8;
+  for (size_t base = 0; base < n; base += LANES) {
+    const size_t lanes = (n - base < LANES) ? n - base : LANES;
+    // Word j of each lane's message, unused lanes zero
+    alignas(32) ulong32 words[8][LANES] = {{0}};
+    for (size_t l = 0; l < lanes; l++)
+      for (int j = 0; j < 8; j++)
+        words[j][l] = m[base + l][j];
+
+    __m256i W[16];
+    for (int j = 0; j < 8; j++)
+      W[j] = _mm256_load_si256(reinterpret_cast<const __m256i *>(words[j]));
+    W[8] = _mm256_set1_epi32(static_cast<int>(0x80000000));
+    for (int j = 9; j < 15; j++)
+      W[j] = _mm256_setzero_si256();
+    W[15] = _mm256_set1_epi32(static_cast<int>(bitlen));
+
+    __m256i S[8];
+    for (int j = 0; j < 8; j++)
+      S[j] = _mm256_set1_epi32(static_cast<int>(state[j]));
+    __m256i a = S[0], b = S[1], c = S[2], d = S[3], e = S[4], f = S[5], g = S[6], h = S[7];
+
+    for (int t = 0; t < 64; t++) {
+      __m256i w;
+      if (t < 16) {
+        w = W[t];
+      } else {
+        const __m256i w2 = W[(t - 2) & 15], w15 = W[(t - 15) & 15];
+        const __m256i gamma1 = V_XOR3(V_ROR(w2, 17), V_ROR(w2, 19), _mm256_srli_epi32(w2, 10));
+        const __m256i gamma0 = V_XOR3(V_ROR(w15, 7), V_ROR(w15, 18), _mm256_srli_epi32(w15, 3));
+        w = V_ADD(V_ADD(gamma1, W[(t - 7) & 15]), V_ADD(gamma0, W[t & 15]));
+        W[t & 15] = w;
+      }
+      const __m256i sigma1 = V_XOR3(V_ROR(e, 6), V_ROR(e, 11), V_ROR(e, 25));
+      const __m256i ch = _mm256_xor_si256(g, _mm256_and_si256(e, _mm256_xor_si256(f, g)));
+      const __m256i t0 = V_ADD(V_ADD(h, sigma1),
+                               V_ADD(ch, V_ADD(_mm256_set1_epi32(static_cast<int>(K256[t])), w)));
+      const __m256i sigma0 = V_XOR3(V_ROR(a, 2), V_ROR(a, 13), V_ROR(a, 22));
+      const __m256i maj = _mm256_or_si256(_mm256_and_si256(_mm256_or_si256(a, b), c),
+                                          _mm256_and_si256(a, b));
+      h = g; g = f; f = e;
+      e = V_ADD(d, t0);
+      d = c; c = b; b = a;
+      a = V_ADD(t0, V_ADD(sigma0, maj));
+    }
+
+    S[0] = V_ADD(S[0], a); S[1] = V_ADD(S[1], b); S[2] = V_ADD(S[2], c); S[3] = V_ADD(S[3], d);
+    S[4] = V_ADD(S[4], e); S[5] = V_ADD(S[5], f); S[6] = V_ADD(S[6], g); S[7] = V_ADD(S[7], h);
+    for (int j = 0; j < 8; j++)
+      _mm256_store_si256(reinterpret_cast<__m256i *>(words[j]), S[j]);
+    for (size_t l = 0; l < lanes; l++)
+      for (int j = 0; j < 8; j++)
+        m[base + l][j] = words[j][l];
+    trashMemory(words, sizeof(words));
+  }
+}
+
+#undef V_ROR
+#undef V_XOR3
+#undef V_ADD
+#endif /* AVX2 */
+
+// Unless a SHA256::Restrict says otherwise
+static bool useHardware = true;
+static bool useSIMD = true;
+
+SHA256::Restrict::Restrict(bool hardware, bool simd)
+  : m_hardware(useHardware), m_simd(useSIMD)
+{
+  useHardware = hardware;
+  useSIMD = simd;
+}
+
+SHA256::Restrict::~Restrict()
+{
+  useHardware = m_hardware;
+  useSIMD = m_simd;
+}
+
+bool SHA256::HasHardware()
+{
+#ifdef SHA256_HW
+  return CPUFeatures::HasSHA256();
+#else
+  return false;
+#endif
+}
+
+// Compresses nblocks consecutive blocks, with whichever implementation
+static void sha256_compress_blocks(ulong32 state[8], const unsigned char *buf, size_t nblocks)
+{
+#ifdef SHA256_HW
+  if (useHardware && SHA256::HasHardware()) {
+    sha256_hw_compress(state, buf, nblocks);
+    return;
+  }
+#endif
+  for (; nblocks > 0; nblocks--, buf += 64)
+    sha256_compress(state, buf);
+}
+
+static const ulong32 sha256_iv[8] = {
+  0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL, 0xA54FF53AUL,
+  0x510E527FUL, 0x9B05688CUL, 0x1F83D9ABUL, 0x5BE0CD19UL
+};
+
 /*
   Initialize the hash state
 */
@@ -186,14 +559,7 @@ SHA256::SHA256()
 {
   curlen = 0;
   length = 0;
-  state[0] = 0x6A09E667UL;
-  state[1] = 0xBB67AE85UL;
-  state[2] = 0x3C6EF372UL;
-  state[3] = 0xA54FF53AUL;
-  state[4] = 0x510E527FUL;
-  state[5] = 0x9B05688CUL;
-  state[6] = 0x1F83D9ABUL;
-  state[7] = 0x5BE0CD19UL;
+  memcpy(state, sha256_iv, sizeof(state));
 }
 
 SHA256::~SHA256()
@@ -214,10 +580,11 @@ void SHA256::Update(const unsigned char *in, size_t inlen)
   ASSERT(curlen <= sizeof(buf));
   while (inlen > 0) {
     if (curlen == 0 && inlen >= block_size) {
-      sha256_compress(state, in);
-      length += block_size * 8;
-      in             += block_size;
-      inlen          -= block_size;
+      const size_t nblocks = inlen / block_size;
+      sha256_compress_blocks(state, in, nblocks);
+      length += nblocks * block_size * 8;
+      in             += nblocks * block_size;
+      inlen          -= nblocks * block_size;
     } else {
       n = std::min(inlen, (block_size - curlen));
       memcpy(buf + curlen, in, static_cast<size_t>(n));
@@ -225,7 +592,7 @@ void SHA256::Update(const unsigned char *in, size_t inlen)
       in             += n;
       inlen          -= n;
       if (curlen == block_size) {
-        sha256_compress(state, buf);
+        sha256_compress_blocks(state, buf, 1);
         length += 8*block_size;
         curlen = 0;
       }
@@ -259,7 +626,7 @@ void SHA256::Final(unsigned char digest[HASHLEN])
     while (curlen < 64) {
       buf[curlen++] = 0;
     }
-    sha256_compress(state, buf);
+    sha256_compress_blocks(state, buf, 1);
     curlen = 0;
   }
 
@@ -270,7 +637,7 @@ void SHA256::Final(unsigned char digest[HASHLEN])
 
   /* store length */
   STORE64H(length, buf+56);
-  sha256_compress(state, buf);
+  sha256_compress_blocks(state, buf, 1);
 
   /* copy output */
   for (i = 0; i < 8; i++) {
@@ -281,3 +648,98 @@ void SHA256::Final(unsigned char digest[HASHLEN])
   trashMemory(buf, sizeof(buf));
 #endif
 }
+
+/*
+  Replace digest by its hash, n times over, as for key stretching.
+  Each message is one 32 byte digest, so it's one block with fixed
+  padding, and there's no need for the generic Update/Final.
+  @param digest The digest to rehash, and the result (32 bytes)
+  @param n      How many times
+*/
+void SHA256::Rehash(unsigned char digest[HASHLEN], unsigned int n)
+{
+  ASSERT(digest != nullptr);
+#ifdef SHA256_HW
+  if (useHardware && HasHardware()) {
+    sha256_hw_rehash(sha256_iv, digest, n);
+    return;
+  }
+#endif
+  unsigned char block[BLOCKSIZE] = {0};
+  memcpy(block, digest, HASHLEN);
+  block[HASHLEN] = 0x80;
+  STORE64H(static_cast<ulong64>(HASHLEN * 8), block + BLOCKSIZE - 8);
+
+  ulong32 st[8];
+  for (; n > 0; n--) {
+    memcpy(st, sha256_iv, sizeof(st));
+    sha256_compress(st, block);
+    for (int i = 0; i < 8; i++) {
+      STORE32H(st[i], block + (4*i));
+    }
+  }
+  memcpy(digest, block, HASHLEN);
+#ifdef LTC_CLEAN_STACK
+  trashMemory(st, sizeof(st));
+  trashMemory(block, sizeof(block));
+#endif
+}
+
+void SHA256::GetState(ulong32 st[8]) const
+{
+  ASSERT(curlen == 0);
+  memcpy(st, state, sizeof(state));
+}
+
+size_t SHA256::DigestLanes()
+{
+#ifdef SHA256_HW
+  if (useHardware && HasHardware())
+    return 1;
+#endif
+#ifdef SHA256_AVX2
+  if (useSIMD && CPUFeatures::HasAVX2())
+    return 8;
+#endif
+  return 1;
+}
+
+/*
+  For iterated hashing of digests, as in PBKDF2 with HMAC-SHA256: replaces
+  each message by its hash, where it's preceded by the prefixBlocks blocks
+  whose chaining state is state (e.g., an HMAC key pad).
+  @param state        The state after the prefix (GetState())
+  @param prefixBlocks How many blocks that was
+  @param m            The n messages, each a digest as big-endian words
+  @param n            How many
+*/
+void SHA256::HashDigests(const ulong32 state[8], size_t prefixBlocks,
+                         ulong32 (*m)[8], size_t n)
+{
+  const ulong32 bitlen = static_cast<ulong32>((prefixBlocks * BLOCKSIZE + HASHLEN) * 8);
+#ifdef SHA256_HW
+  if (useHardware && HasHardware()) {
+    sha256_hw_digests(state, bitlen, m, n);
+    return;
+  }
+#endif
+#ifdef SHA256_AVX2
+  if (useSIMD && CPUFeatures::HasAVX2()) {
+    sha256_avx2_digests(state, bitlen, m, n);
+    return;
+  }
+#endif
+  unsigned char block[BLOCKSIZE] = {0};
+  block[HASHLEN] = 0x80;
+  STORE32H(bitlen, block + BLOCKSIZE - 4);
+  for (size_t i = 0; i < n; i++) {
+    for (int j = 0; j < 8; j++) {
+      STORE32H(m[i][j], block + (4*j));
+    }
+    memcpy(m[i], state, sizeof(ulong32) * 8);
+    sha256_compress(m[i], block);
+  }
+#ifdef LTC_CLEAN_STACK
+  trashMemory(block, sizeof(block));
+#endif
+}
@@ -25,6 +25,36 @@ public:
   void Update(const unsigned char *in, size_t inlen);
   void Final(unsigned char digest[HASHLEN]);
 
+  // digest = SHA256(digest), n times, for key stretching
+  static void Rehash(unsigned char digest[HASHLEN], unsigned int n);
+
+  // The chaining state, once a whole number of blocks have been hashed
+  void GetState(ulong32 st[8]) const;
+  // Each of n digests (as words) = SHA256(whatever gave state, then it),
+  // several at a time where possible - for PBKDF2
+  static void HashDigests(const ulong32 state[8], size_t prefixBlocks,
+                          ulong32 (*m)[8], size_t n);
+  // How many digests HashDigests() does in about the time of one
+  static size_t DigestLanes();
+
+  // Whether this build and the CPU we're running on have SHA-256
+  // instructions (SHA extensions or ARMv8 Crypto)
+  static bool HasHardware();
+  // Hashing uses them if there are any. Without them, HashDigests()
+  // uses AVX2 if there is.
+
+  // For testing: while one of these exists, hashing uses the SHA-256
+  // instructions and AVX2 only if it allows them
+  class Restrict {
+  public:
+    explicit Restrict(bool hardware, bool simd = true);
+    ~Restrict();
+    Restrict(const Restrict &) = delete;
+    Restrict &operator=(const Restrict &) = delete;
+  private:
+    bool m_hardware, m_simd; // as they were before
+  };
+
 private:
   ulong64 length;
   size_t curlen;
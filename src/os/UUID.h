@@ -24,47 +24,88 @@ typedef uuid_t uuid_array_t;
 typedef uuid_t UUID;
 #endif
 
-#include <memory> // for memcmp
+#include <functional> // for std::hash
 #include <iostream>
+#include <type_traits>
 #include "typedefs.h"
 #include "../core/StringX.h"
 
 #include <vector>
 
 namespace pws_os {
+/**
+ * A CUUID is a plain 16-byte value, held as two 64-bit words so that
+ * comparing and hashing are a couple of integer operations. The words
+ * are big-endian, i.e., ordering by them is the same as ordering the
+ * array representation bytewise, on all platforms.
+ *
+ * It's trivially copyable and destructible: UUIDs aren't secret, so
+ * there's nothing to wipe, and copies in containers cost no more
+ * than the bytes themselves.
+ */
 class CUUID
 {
 public:
   CUUID(); // UUID generated at creation time
-  CUUID(const CUUID &uuid);
-  CUUID(const uuid_array_t &ua, bool canonic = false); // for storing an existing UUID
+  constexpr CUUID(uint64 hi, uint64 lo) : m_hi(hi), m_lo(lo) {}
+  CUUID(const uuid_array_t &ua) : m_hi(Get64(ua)), m_lo(Get64(ua + 8)) {} // for storing an existing UUID
   CUUID(const StringX &s); // s is a hex string as returned by cast to StringX
   static const CUUID &NullUUID(); // singleton all-zero
-  ~CUUID();
 
-  // Following get Array Representation of the uuid:
-  void GetARep(uuid_array_t &ua) const;
-  const uuid_array_t *GetARep() const; // internally allocated, deleted in d'tor
-  
-  CUUID &operator=(const CUUID &that);
+  // Array Representation of the uuid:
+  void GetARep(uuid_array_t &ua) const {Put64(ua, m_hi); Put64(ua + 8, m_lo);}
+
   operator StringX() const; // GetHexStr, e.g., "204012e6600f4e01a5eb515267cb0d50"
-  bool operator==(const CUUID &that) const;
-  bool operator!=(const CUUID &that) const { return !(*this == that); }
-  bool operator<(const CUUID &that) const;
 
-  friend std::ostream &operator<<(std::ostream &os, const pws_os::CUUID &uuid);
-  friend std::wostream &operator<<(std::wostream &os, const pws_os::CUUID &uuid);
+  constexpr bool operator==(const CUUID &that) const
+  {return m_hi == that.m_hi && m_lo == that.m_lo;}
+  constexpr bool operator!=(const CUUID &that) const {return !(*this == that);}
+  constexpr bool operator<(const CUUID &that) const
+  {return m_hi < that.m_hi || (m_hi == that.m_hi && m_lo < that.m_lo);}
+
+  // For unordered containers. UUIDs are (mostly) random, so folding
+  // the two halves together is good enough.
+  constexpr size_t Hash() const
+  {return static_cast<size_t>(m_hi ^ (m_lo * 0x9E3779B97F4A7C15ULL));}
+
+  // Streams as 8-4-4-4-12 rather than 32 hex digits, e.g., for display:
+  //   os << std::uppercase << uuid.Canonic();
+  struct CanonicRep {const CUUID &uuid;};
+  CanonicRep Canonic() const {return CanonicRep{*this};}
 
 private:
-  UUID m_uuid;
-  mutable uuid_array_t *m_ua; // for GetUUID();
-  mutable bool m_canonic;
+  static uint64 Get64(const unsigned char *p)
+  {
+    uint64 v = 0;
+    for (int i = 0; i < 8; i++)
+      v = (v << 8) | p[i];
+    return v;
+  }
+
+  static void Put64(unsigned char *p, uint64 v)
+  {
+    for (int i = 7; i >= 0; i--, v >>= 8)
+      p[i] = static_cast<unsigned char>(v);
+  }
+
+  uint64 m_hi, m_lo;
 };
 
+static_assert(std::is_trivially_copyable<CUUID>::value, "CUUID should be a plain value");
+
 std::ostream &operator<<(std::ostream &os, const CUUID &uuid);
 std::wostream &operator<<(std::wostream &os, const CUUID &uuid);
+std::ostream &operator<<(std::ostream &os, const CUUID::CanonicRep &uuid);
+std::wostream &operator<<(std::wostream &os, const CUUID::CanonicRep &uuid);
 } // end of pws_os namespace
 
+namespace std {
+template<> struct hash<pws_os::CUUID>
+{
+  size_t operator()(const pws_os::CUUID &uuid) const {return uuid.Hash();}
+};
+}
+
 typedef std::vector<pws_os::CUUID> UUIDVector;
 typedef UUIDVector::iterator UUIDVectorIter;
 
@@ -24,6 +24,10 @@ namespace pws_os {
   extern bool RenameFile(const stringT &oldname, const stringT &newname);
   extern bool CopyAFile(const stringT &from, const stringT &to); // creates dirs as needed!
   extern bool DeleteAFile(const stringT &filename);
+  // Puts from in to's place in one step, keeping to's permissions (and
+  // owner, where allowed) if it exists, and waits for the disk.
+  // from should be in the same directory as to, and to not a link.
+  extern bool ReplaceAFile(const stringT &from, const stringT &to);
   extern void FindFiles(const stringT &filter, std::vector<stringT> &res);
   extern bool LockFile(const stringT &filename, stringT &locker,
                        HANDLE &lockFileHandle);
@@ -33,9 +37,25 @@ namespace pws_os {
 
   extern std::FILE *FOpen(const stringT &filename, const TCHAR *mode);
   extern int FClose(std::FILE *fd, const bool &bIsWrite);
+  extern bool FSync(std::FILE *fd); // flushes fd's buffers, then waits for the disk
   extern size_t fileLength(std::FILE *fp);
   extern bool GetFileTimes(const stringT &filename,
       time_t &ctime, time_t &mtime, time_t &atime);
+
+  // Which file, which version of it: if none of these has changed,
+  // nor (short of deliberate effort) has the file's content
+  struct FileStamp {
+    ulong64 device, inode; // or volume serial number and file index
+    time_t mtime;
+    long mtime_nsec;       // as fine as the filesystem keeps it
+    ulong64 size;
+    bool operator==(const FileStamp &that) const
+    {return device == that.device && inode == that.inode && mtime == that.mtime &&
+        mtime_nsec == that.mtime_nsec && size == that.size;}
+    bool operator!=(const FileStamp &that) const {return !(*this == that);}
+  };
+  extern bool GetFileStamp(const stringT &filename, FileStamp &stamp);
+
   extern bool SetFileTimes(const stringT &filename,
       time_t ctime, time_t mtime, time_t atime);
   extern bool ProgramExists(const stringT &filename);
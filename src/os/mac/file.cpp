@@ -164,6 +164,55 @@ bool pws_os::DeleteAFile(const stringT &filename)
   return retval;
 }
 
+static bool ReplaceAFile(const char *szfrom, const char *szto)
+{
+  // A new file, in to's place, should be no more open than to was
+  struct stat info;
+  if (::stat(szto, &info) == 0) {
+    ::chmod(szfrom, info.st_mode & 07777);
+    // Only root can give it away, but we may well share to's group
+    if (::chown(szfrom, info.st_uid, info.st_gid) != 0 &&
+        ::chown(szfrom, static_cast<uid_t>(-1), info.st_gid) != 0)
+      pws_os::Trace(_T("ReplaceAFile: %s keeps its owner and group\n"), szfrom);
+  }
+
+  if (::rename(szfrom, szto) != 0)
+    return false;
+
+  // The rename's only durable once the directory's on disk
+  const string to(szto);
+  const string::size_type slash = to.find_last_of('/');
+  const string dir = (slash == string::npos) ? string(".") :
+                     (slash == 0) ? string("/") : to.substr(0, slash);
+  const int dirfd = ::open(dir.c_str(), O_RDONLY);
+  if (dirfd == -1)
+    return false;
+  const bool retval = ::fsync(dirfd) == 0;
+  ::close(dirfd);
+  return retval;
+}
+
+bool pws_os::ReplaceAFile(const stringT &from, const stringT &to)
+{
+#ifndef UNICODE
+  return ::ReplaceAFile(from.c_str(), to.c_str());
+#else
+  size_t fromsize = wcstombs(NULL, from.c_str(), 0) + 1;
+  assert(fromsize > 0);
+  char *szfrom = new char[fromsize];
+  wcstombs(szfrom, from.c_str(), fromsize);
+  size_t tosize = wcstombs(NULL, to.c_str(), 0) + 1;
+  assert(tosize > 0);
+  char *szto = new char[tosize];
+  wcstombs(szto, to.c_str(), tosize);
+
+  bool retval = ::ReplaceAFile(szfrom, szto);
+  delete[] szfrom;
+  delete[] szto;
+  return retval;
+#endif /* UNICODE */
+}
+
 static string filterString;
 
 #if defined(__x86_64__) || defined(__x86_64) || defined(__amd64) || defined(__amd64__)
@@ -440,6 +489,13 @@ int pws_os::FClose(std::FILE *fd, const bool &bIsWrite)
   return 0;
 }
 
+bool pws_os::FSync(std::FILE *fd)
+{
+  if (fflush(fd) != 0)
+    return false;
+  return fsync(fileno(fd)) == 0;
+}
+
 size_t pws_os::fileLength(std::FILE *fp)
 {
   int fd = fileno(fp);
@@ -471,6 +527,24 @@ bool pws_os::GetFileTimes(const stringT &filename,
   }
 }
 
+bool pws_os::GetFileStamp(const stringT &filename, FileStamp &stamp)
+{
+  struct stat info;
+  size_t N = wcstombs(NULL, filename.c_str(), 0) + 1;
+  char *fn = new char[N];
+  wcstombs(fn, filename.c_str(), N);
+  int status = ::stat(fn, &info);
+  delete[] fn;
+  if (status != 0)
+    return false;
+  stamp.device = ulong64(info.st_dev);
+  stamp.inode = ulong64(info.st_ino);
+  stamp.mtime = info.st_mtime;
+  stamp.mtime_nsec = info.st_mtimespec.tv_nsec;
+  stamp.size = ulong64(info.st_size);
+  return true;
+}
+
 bool pws_os::SetFileTimes(const stringT &filename,
       time_t ctime, time_t mtime, time_t atime)
 {
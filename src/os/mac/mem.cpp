@@ -26,6 +26,22 @@ bool pws_os::munlock(void *p, size_t size)
   return ::munlock(p, size) == 0;
 }
 
+void *pws_os::mallocLocked(size_t size)
+{
+  void *p = ::mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANON, -1, 0);
+  if (p == MAP_FAILED)
+    return NULL;
+  ::mlock(p, size);
+  return p;
+}
+
+void pws_os::freeLocked(void *p, size_t size)
+{
+  if (p != NULL)
+    ::munmap(p, size); // also unlocks
+}
+
 // Following has OS support only in Windows
 bool pws_os::mcryptProtect(void *, size_t)
 {
@@ -18,6 +18,15 @@ namespace pws_os {
   extern bool mlock(void *p, size_t size);
   extern bool munlock(void *p, size_t size);
 
+  /**
+   * Allocates size bytes of whole pages of their own, locked in RAM if
+   * the OS allows (if not, they're still returned). As no other data
+   * shares the pages, releasing them can't unlock anything else.
+   * Returns nullptr on failure. Callers wipe before freeLocked().
+   */
+  extern void *mallocLocked(size_t size);
+  extern void freeLocked(void *p, size_t size);
+
   /**
    * Following are wrappers for Window's 'protect memory' functions,
    * that use an unspecified algorithm with an unspecified key
@@ -14,7 +14,7 @@
 //
 
 #include "../UUID.h"
-#include "../../core/Util.h" /* for trashMemory() */
+#include "../../core/Util.h"
 #include "../../core/StringXStream.h"
 #include <iomanip>
 #include <assert.h>
@@ -26,124 +26,75 @@
 
 using namespace std;
 
-static const uuid_array_t zua = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-static pws_os::CUUID nullUUID(zua);
+static const pws_os::CUUID nullUUID(0, 0);
 
 const pws_os::CUUID &pws_os::CUUID::NullUUID()
 {
   return nullUUID;
 }
 
-pws_os::CUUID::CUUID() : m_ua(nullptr), m_canonic(false)
+pws_os::CUUID::CUUID()
 {
-  uuid_generate(m_uuid);
-}
-
-pws_os::CUUID::CUUID(const CUUID &uuid)
-  : m_ua(nullptr), m_canonic(uuid.m_canonic)
-{
-  uuid_copy(m_uuid, uuid.m_uuid);
-}
-
-pws_os::CUUID &pws_os::CUUID::operator=(const CUUID &that)
-{
-  if (this != &that) {
-    uuid_copy(m_uuid, that.m_uuid);
-    if (m_ua) {
-      trashMemory(m_ua, sizeof(uuid_array_t));
-      delete[] m_ua;
-      m_ua = nullptr;
-    }
-    m_canonic = that.m_canonic;
-  }
-  return *this;
-}
-
-pws_os::CUUID::CUUID(const uuid_array_t &uuid_array, bool canonic)
-  : m_ua(nullptr), m_canonic(canonic)
-{
-  uuid_copy(m_uuid, uuid_array);
+  uuid_t uuid;
+  uuid_generate(uuid);
+  *this = CUUID(uuid);
 }
 
 pws_os::CUUID::CUUID(const StringX &s)
-  : m_ua(nullptr), m_canonic(false)
 {
   // s is a hex string as returned by cast to StringX
   ASSERT(s.length() == 32);
-  unsigned char *uu = m_uuid;
+  uuid_array_t uuid_array;
 
-  int x;
-  for (unsigned int i = 0; i < 16; i++) {
-    iStringXStream is(s.substr(i*2, 2));
+  unsigned int x(0);
+  for (size_t i = 0; i < 16; i++) {
+    iStringXStream is(s.substr(i * 2, 2));
     is >> hex >> x;
-    uu[i] = static_cast<unsigned char>(x);
-  }
-}
-
-pws_os::CUUID::~CUUID()
-{
-  trashMemory(reinterpret_cast<unsigned char *>(&m_uuid), sizeof(m_uuid));
-  if (m_ua) {
-    trashMemory(m_ua, sizeof(uuid_array_t));
-    delete[] m_ua;
+    uuid_array[i] = static_cast<unsigned char>(x);
   }
+  *this = CUUID(uuid_array);
 }
 
-void pws_os::CUUID::GetARep(uuid_array_t &uuid_array) const
+template<class CharT>
+static void PutUUID(std::basic_ostream<CharT> &os, const pws_os::CUUID &uuid, bool canonic)
 {
-  uuid_copy(uuid_array, m_uuid);
-}
-
-const uuid_array_t *pws_os::CUUID::GetARep() const
-{
-  if (m_ua == nullptr) {
-    m_ua = reinterpret_cast<uuid_array_t *>(new uuid_array_t);
-    GetARep(*m_ua);
+  uuid_array_t uuid_array;
+  uuid.GetARep(uuid_array);
+  for (size_t i = 0; i < sizeof(uuid_array_t); i++) {
+    os << setw(2) << setfill(CharT('0')) << hex << int(uuid_array[i]);
+    if (canonic && (i == 3 || i == 5 || i == 7 || i == 9))
+      os << CharT('-');
   }
-  return m_ua;
 }
 
-bool pws_os::CUUID::operator==(const CUUID &that) const
+std::ostream &pws_os::operator<<(std::ostream &os, const pws_os::CUUID &uuid)
 {
-  return uuid_compare(this->m_uuid, that.m_uuid) == 0;
+  PutUUID(os, uuid, false);
+  return os;
 }
 
-bool pws_os::CUUID::operator<(const pws_os::CUUID &that) const
+std::wostream &pws_os::operator<<(std::wostream &os, const pws_os::CUUID &uuid)
 {
-  return uuid_compare(m_uuid, that.m_uuid) < 0;
+  PutUUID(os, uuid, false);
+  return os;
 }
 
-std::ostream &pws_os::operator<<(std::ostream &os, const pws_os::CUUID &uuid)
+std::ostream &pws_os::operator<<(std::ostream &os, const pws_os::CUUID::CanonicRep &uuid)
 {
-  uuid_array_t uuid_a;
-  uuid.GetARep(uuid_a);
-  for (size_t i = 0; i < sizeof(uuid_array_t); i++) {
-    os << setw(2) << setfill('0') << hex << int(uuid_a[i]);
-    if (uuid.m_canonic && (i == 3 || i == 5 || i == 7 || i == 9))
-      os << "-";
-  }
+  PutUUID(os, uuid.uuid, true);
   return os;
 }
 
-std::wostream &pws_os::operator<<(std::wostream &os, const pws_os::CUUID &uuid)
+std::wostream &pws_os::operator<<(std::wostream &os, const pws_os::CUUID::CanonicRep &uuid)
 {
-  uuid_array_t uuid_a;
-  uuid.GetARep(uuid_a);
-  for (size_t i = 0; i < sizeof(uuid_array_t); i++) {
-    os << setw(2) << setfill(wchar_t('0')) << hex << int(uuid_a[i]);
-    if (uuid.m_canonic && (i == 3 || i == 5 || i == 7 || i == 9))
-      os << L"-";
-  }
+  PutUUID(os, uuid.uuid, true);
   return os;
 }
 
 pws_os::CUUID::operator StringX() const
 {
   oStringXStream os;
-  bool sc = m_canonic;
-  m_canonic = false;
   os << *this;
-  m_canonic = sc;
   return os.str();
 }
 
@@ -14,27 +14,27 @@
 //
 
 #include "../UUID.h"
-#include "../../core/Util.h" /* for trashMemory() */
+#include "../../core/Util.h"
 #include "../../core/StringXStream.h"
 #include <iomanip>
 #include <assert.h>
 
 using namespace std;
 
-static void array2UUUID(const uuid_array_t &ua, UUID &uuid)
+static const pws_os::CUUID nullUUID(0, 0);
+
+const pws_os::CUUID &pws_os::CUUID::NullUUID()
 {
-  unsigned long *p0 = (unsigned long *)ua;
-  uuid.Data1 = htonl(*p0);
-  unsigned short *p1 = (unsigned short *)&ua[4];
-  uuid.Data2 = htons(*p1);
-  unsigned short *p2 = (unsigned short *)&ua[6];
-  uuid.Data3 = htons(*p2);
-  for (int i = 0; i < 8; i++)
-    uuid.Data4[i] = ua[i + 8];
+  return nullUUID;
 }
 
-static void UUID2array(const UUID &uuid, uuid_array_t &ua)
+pws_os::CUUID::CUUID()
 {
+  UUID uuid;
+  UuidCreate(&uuid);
+
+  // Array representation is big-endian, as on other platforms
+  uuid_array_t ua;
   unsigned long *p0 = (unsigned long *)ua;
   *p0 = htonl(uuid.Data1);
   unsigned short *p1 = (unsigned short *)&ua[4];
@@ -43,128 +43,64 @@ static void UUID2array(const UUID &uuid, uuid_array_t &ua)
   *p2 = htons(uuid.Data3);
   for (int i = 0; i < 8; i++)
     ua[i + 8] = uuid.Data4[i];
-}
-
-static const uuid_array_t zua = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-static pws_os::CUUID nullUUID(zua);
-
-const pws_os::CUUID &pws_os::CUUID::NullUUID()
-{
-  return nullUUID;
-}
-
-pws_os::CUUID::CUUID()
-  : m_ua(NULL), m_canonic(false)
-{
-  UuidCreate(&m_uuid);
-}
-
-pws_os::CUUID::CUUID(const CUUID &uuid)
-  : m_ua(NULL), m_canonic(uuid.m_canonic)
-{
-  std::memcpy(&m_uuid, &uuid.m_uuid, sizeof(m_uuid));
-}
-
-pws_os::CUUID::CUUID(const uuid_array_t &ua, bool canonic)
-  : m_ua(NULL), m_canonic(canonic)
-{
-  array2UUUID(ua, m_uuid);
+  *this = CUUID(ua);
 }
 
 pws_os::CUUID::CUUID(const StringX &s)
-  : m_ua(NULL), m_canonic(false)
 {
   // s is a hex string as returned by cast to StringX
   ASSERT(s.length() == 32);
-  uuid_array_t ua;
+  uuid_array_t uuid_array;
 
   unsigned int x(0);
   for (size_t i = 0; i < 16; i++) {
     iStringXStream is(s.substr(i * 2, 2));
     is >> hex >> x;
-    ua[i] = static_cast<unsigned char>(x);
+    uuid_array[i] = static_cast<unsigned char>(x);
   }
-  array2UUUID(ua, m_uuid);
+  *this = CUUID(uuid_array);
 }
 
-pws_os::CUUID::~CUUID()
+template<class CharT>
+static void PutUUID(std::basic_ostream<CharT> &os, const pws_os::CUUID &uuid, bool canonic)
 {
-  trashMemory(reinterpret_cast<unsigned char *>(&m_uuid), sizeof(m_uuid));
-  if (m_ua) {
-    trashMemory(m_ua, sizeof(uuid_array_t));
-    delete[] m_ua;
-  }
-}
-
-pws_os::CUUID &pws_os::CUUID::operator=(const CUUID &that)
-{
-  if (this != &that) {
-    std::memcpy(&m_uuid, &that.m_uuid, sizeof(m_uuid));
-    if (m_ua) {
-      trashMemory(m_ua, sizeof(uuid_array_t));
-      delete[] m_ua;
-      m_ua = NULL;
-    }
-    m_canonic = that.m_canonic;
-  }
-  return *this;
-}
-
-void pws_os::CUUID::GetARep(uuid_array_t &ua) const
-{
-  UUID2array(m_uuid, ua);
-}
-
-const uuid_array_t *pws_os::CUUID::GetARep() const
-{
-  if (m_ua == NULL) {
-    m_ua = (uuid_array_t *)(new uuid_array_t);
-    GetARep(*m_ua);
+  uuid_array_t uuid_array;
+  uuid.GetARep(uuid_array);
+  for (size_t i = 0; i < sizeof(uuid_array_t); i++) {
+    os << setw(2) << setfill(CharT('0')) << hex << int(uuid_array[i]);
+    if (canonic && (i == 3 || i == 5 || i == 7 || i == 9))
+      os << CharT('-');
   }
-  return m_ua;
 }
 
-bool pws_os::CUUID::operator==(const pws_os::CUUID &that) const
+std::ostream &pws_os::operator<<(std::ostream &os, const pws_os::CUUID &uuid)
 {
-  return std::memcmp(&this->m_uuid, &that.m_uuid, sizeof(m_uuid)) == 0;
+  PutUUID(os, uuid, false);
+  return os;
 }
 
-bool pws_os::CUUID::operator<(const pws_os::CUUID &that) const
+std::wostream &pws_os::operator<<(std::wostream &os, const pws_os::CUUID &uuid)
 {
-  return std::memcmp(&this->m_uuid, &that.m_uuid, sizeof(m_uuid)) < 0;
+  PutUUID(os, uuid, false);
+  return os;
 }
 
-std::ostream &pws_os::operator<<(std::ostream &os, const pws_os::CUUID &uuid)
+std::ostream &pws_os::operator<<(std::ostream &os, const pws_os::CUUID::CanonicRep &uuid)
 {
-  uuid_array_t ua;
-  uuid.GetARep(ua);
-  for (size_t i = 0; i < sizeof(uuid_array_t); i++) {
-    os << setw(2) << setfill('0') << hex << int(ua[i]);
-    if (uuid.m_canonic && (i == 3 || i == 5 || i == 7 || i == 9))
-      os << "-";
-  }
+  PutUUID(os, uuid.uuid, true);
   return os;
 }
 
-std::wostream &pws_os::operator<<(std::wostream &os, const pws_os::CUUID &uuid)
+std::wostream &pws_os::operator<<(std::wostream &os, const pws_os::CUUID::CanonicRep &uuid)
 {
-  uuid_array_t ua;
-  uuid.GetARep(ua);
-  for (size_t i = 0; i < sizeof(uuid_array_t); i++) {
-    os << setw(2) << setfill(wchar_t('0')) << hex << int(ua[i]);
-    if (uuid.m_canonic && (i == 3 || i == 5 || i == 7 || i == 9))
-      os << L"-";
-  }
+  PutUUID(os, uuid.uuid, true);
   return os;
 }
 
 pws_os::CUUID::operator StringX() const
 {
   oStringXStream os;
-  bool sc = m_canonic;
-  m_canonic = false;
   os << *this;
-  m_canonic = sc;
   return os.str();
 }
 
@@ -129,6 +129,16 @@ bool pws_os::DeleteAFile(const stringT &filename)
   return DeleteFile(filename.c_str()) == TRUE;
 }
 
+bool pws_os::ReplaceAFile(const stringT &from, const stringT &to)
+{
+  // ReplaceFile keeps to's attributes and ACLs, but needs it to exist
+  if (FileExists(to))
+    return ::ReplaceFile(to.c_str(), from.c_str(), nullptr,
+                         REPLACEFILE_IGNORE_MERGE_ERRORS, nullptr, nullptr) != FALSE;
+  return ::MoveFileEx(from.c_str(), to.c_str(),
+                      MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != FALSE;
+}
+
 void pws_os::FindFiles(const stringT &filter, std::vector<stringT> &res)
 {
   res.clear();
@@ -431,6 +441,17 @@ int pws_os::FClose(std::FILE *fd, const bool &bIsWrite)
   }
 }
 
+bool pws_os::FSync(std::FILE *fd)
+{
+  if (fflush(fd) != 0)
+    return false;
+  // Windows FlushFileBuffers == Linux fsync
+  const intptr_t iosfhandle = _get_osfhandle(_fileno(fd));
+  if ((HANDLE)iosfhandle == INVALID_HANDLE_VALUE)
+    return false;
+  return FlushFileBuffers((HANDLE)iosfhandle) != FALSE;
+}
+
 size_t pws_os::fileLength(std::FILE *fp) {
   if (fp != nullptr) {
     auto pos = _ftelli64(fp);
@@ -457,6 +478,30 @@ bool pws_os::GetFileTimes(const stringT &filename,
   }
 }
 
+bool pws_os::GetFileStamp(const stringT &filename, FileStamp &stamp)
+{
+  HANDLE hFile = CreateFile(filename.c_str(), FILE_READ_ATTRIBUTES,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (hFile == INVALID_HANDLE_VALUE)
+    return false;
+  BY_HANDLE_FILE_INFORMATION info;
+  const BOOL brc = GetFileInformationByHandle(hFile, &info);
+  CloseHandle(hFile);
+  if (!brc)
+    return false;
+
+  // FILETIME counts 100ns intervals since 1601
+  const ulong64 ft = (ulong64(info.ftLastWriteTime.dwHighDateTime) << 32) |
+    info.ftLastWriteTime.dwLowDateTime;
+  stamp.device = info.dwVolumeSerialNumber;
+  stamp.inode = (ulong64(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+  stamp.mtime = time_t((ft - 116444736000000000ULL) / 10000000);
+  stamp.mtime_nsec = long((ft % 10000000) * 100);
+  stamp.size = (ulong64(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+  return true;
+}
+
 void TimetToFileTime(time_t t, FILETIME *pft)
 {
   LONGLONG ll = Int32x32To64(t, 10000000) + 116444736000000000;
@@ -27,6 +27,20 @@ bool pws_os::munlock(void *p, size_t size)
   return VirtualUnlock(p, size) != 0;
 }
 
+void *pws_os::mallocLocked(size_t size)
+{
+  void *p = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+  if (p != NULL)
+    VirtualLock(p, size);
+  return p;
+}
+
+void pws_os::freeLocked(void *p, size_t)
+{
+  if (p != NULL)
+    VirtualFree(p, 0, MEM_RELEASE); // also unlocks
+}
+
 typedef BOOL (WINAPI *LP_CryptProtectMemory)(LPVOID pDataIn, DWORD cbDataIn, DWORD dwFlags);
 
 bool pws_os::mcryptProtect(void *p, size_t size)
@@ -15,7 +15,11 @@
 #include "core/crypto/AES.h"
 #include "gtest/gtest.h"
 
-TEST(AESTest, aes_test)
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+static void TestVectors()
 {
   static const struct { 
     int keylen;
@@ -74,5 +78,68 @@ TEST(AESTest, aes_test)
 
     delete tf;
   }
-  SUCCEED();
+}
+
+TEST(AESTest, aes_test)
+{
+  TestVectors(); // with AES instructions, if the CPU has them
+}
+
+TEST(AESTest, aes_test_portable)
+{
+  AES::Restrict portable(false);
+  TestVectors();
+}
+
+// DecryptCBC() in one go, in place or not, must match block-by-block CBC,
+// whichever implementation's used, for any number of blocks
+TEST(AESTest, cbc_decrypt)
+{
+  const unsigned char key[32] = {
+    0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0,
+    0x85, 0x7d, 0x77, 0x81, 0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7,
+    0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4};
+  const unsigned char iv[16] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+  const unsigned int BS = AES::BLOCKSIZE;
+  const size_t maxBlocks = 21;
+
+  std::vector<unsigned char> pt(maxBlocks * BS), ct(maxBlocks * BS);
+  for (size_t i = 0; i < pt.size(); i++)
+    pt[i] = static_cast<unsigned char>(i * 31 + 7);
+
+  for (int hw = 0; hw < 2; hw++) {
+    AES::Restrict impl(hw != 0);
+    for (int keylen = 16; keylen <= 32; keylen += 8) {
+      AES aes(key, keylen);
+      EXPECT_EQ(hw != 0 && AES::HasHardware(), aes.IsHardware());
+
+      unsigned char cbc[BS];
+      memcpy(cbc, iv, BS);
+      for (size_t b = 0; b < maxBlocks; b++) {
+        unsigned char x[BS];
+        for (unsigned int i = 0; i < BS; i++)
+          x[i] = pt[b * BS + i] ^ cbc[i];
+        aes.Encrypt(x, &ct[b * BS]);
+        memcpy(cbc, &ct[b * BS], BS);
+      }
+
+      for (size_t n = 0; n <= maxBlocks; n++) {
+        std::vector<unsigned char> out(n * BS + 1, 0xee);
+        memcpy(cbc, iv, BS);
+        aes.DecryptCBC(ct.data(), out.data(), n, cbc);
+        EXPECT_EQ(0, memcmp(out.data(), pt.data(), n * BS)) << "hw " << hw << ", keylen " << keylen << ", " << n << " blocks";
+        EXPECT_EQ(0xee, out[n * BS]);
+        EXPECT_EQ(0, memcmp(cbc, n == 0 ? iv : &ct[(n - 1) * BS], BS));
+
+        // in place, and in two goes
+        std::vector<unsigned char> buf(ct.begin(), ct.begin() + n * BS);
+        memcpy(cbc, iv, BS);
+        aes.DecryptCBC(buf.data(), buf.data(), n / 2, cbc);
+        aes.DecryptCBC(buf.data() + n / 2 * BS, buf.data() + n / 2 * BS, n - n / 2, cbc);
+        EXPECT_TRUE(std::equal(buf.begin(), buf.end(), pt.begin())) << "hw " << hw << ", keylen " << keylen << ", " << n << " blocks in place";
+      }
+    }
+  }
 }
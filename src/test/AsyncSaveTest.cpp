@@ -0,0 +1,216 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// AsyncSaveTest.cpp: Unit test for saving on another thread
+
+#ifdef WIN32
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "DatabaseTest.h"
+
+#include "core/UIinterface.h"
+
+#include <atomic>
+
+#ifndef WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+  class SaveObserver : public Observer
+  {
+  public:
+    void AsyncSaveFinished() override {m_numFinished++;}
+    std::atomic<int> m_numFinished{0};
+  };
+}
+
+class AsyncSaveTest : public DatabaseTest
+{
+protected:
+  AsyncSaveTest() : DatabaseTest(L"in-the-background", L"asyncsave.psafe3", 100) {}
+
+  SaveObserver observer;
+};
+
+TEST_F(AsyncSaveTest, Save)
+{
+  PWScore core;
+  core.RegisterObserver(&observer);
+  Open(core);
+
+  Retitle(core, 1, L"Saved");
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteCurFileAsync());
+  EXPECT_TRUE(core.IsSaving());
+  EXPECT_EQ(PWScore::SUCCESS, core.FinishAsyncSave());
+  EXPECT_FALSE(core.IsSaving());
+  EXPECT_EQ(1, observer.m_numFinished);
+  EXPECT_FALSE(core.HasDBChanged());
+  EXPECT_FALSE(pws_os::FileExists(fname + L".tmp"));
+  EXPECT_TRUE(core.GetCurrentFileSig() == PWSFileSig(fname));
+
+  PWScore reopened;
+  Open(reopened);
+  EXPECT_EQ(L"Saved", Title(reopened, 1));
+  EXPECT_EQ(size_t(N), reopened.GetNumEntries());
+}
+
+TEST_F(AsyncSaveTest, ChangesMeanwhile)
+{
+  PWScore core;
+  Open(core);
+
+  Retitle(core, 1, L"Before");
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteCurFileAsync());
+  // Whether or not the save's done by now, it has what was there before
+  Retitle(core, 2, L"During");
+  CItemData added;
+  added.CreateUUID();
+  added.SetTitle(L"Added during");
+  added.SetPassword(L"password");
+  core.Execute(AddEntryCommand::Create(&core, added));
+  EXPECT_EQ(PWScore::SUCCESS, core.FinishAsyncSave());
+  EXPECT_TRUE(core.HasDBChanged());
+
+  {
+    PWScore reopened;
+    Open(reopened);
+    EXPECT_EQ(L"Before", Title(reopened, 1));
+    EXPECT_EQ(L"Title 2", Title(reopened, 2));
+    EXPECT_EQ(size_t(N), reopened.GetNumEntries());
+  }
+
+  // ...and left to the next one
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteCurFileAsync());
+  EXPECT_EQ(PWScore::SUCCESS, core.FinishAsyncSave());
+  EXPECT_FALSE(core.HasDBChanged());
+  PWScore reopened;
+  Open(reopened);
+  EXPECT_EQ(L"During", Title(reopened, 2));
+  EXPECT_EQ(size_t(N + 1), reopened.GetNumEntries());
+}
+
+TEST_F(AsyncSaveTest, Queued)
+{
+  PWScore core;
+  core.RegisterObserver(&observer);
+  Open(core);
+
+  Retitle(core, 1, L"First");
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteCurFileAsync());
+  Retitle(core, 2, L"Second");
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteCurFileAsync()); // queued
+
+  EXPECT_EQ(PWScore::SUCCESS, core.FinishAsyncSave());
+  EXPECT_TRUE(core.IsSaving()); // the queued one
+  EXPECT_EQ(PWScore::SUCCESS, core.FinishAsyncSave());
+  EXPECT_FALSE(core.IsSaving());
+  EXPECT_EQ(2, observer.m_numFinished);
+  EXPECT_FALSE(core.HasDBChanged());
+
+  PWScore reopened;
+  Open(reopened);
+  EXPECT_EQ(L"First", Title(reopened, 1));
+  EXPECT_EQ(L"Second", Title(reopened, 2));
+}
+
+TEST_F(AsyncSaveTest, Failure)
+{
+  PWScore core;
+  core.RegisterObserver(&observer);
+  Open(core);
+  Retitle(core, 1, L"Unsaved");
+
+  const StringX nowhere(L"no-such-dir/asyncsave.psafe3");
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteFileAsync(nowhere, PWSfile::V30));
+  EXPECT_NE(PWScore::SUCCESS, core.FinishAsyncSave());
+  EXPECT_EQ(1, observer.m_numFinished);
+  EXPECT_TRUE(core.HasDBChanged());
+
+  PWScore reopened;
+  Open(reopened);
+  EXPECT_EQ(L"Title 1", Title(reopened, 1));
+}
+
+TEST_F(AsyncSaveTest, NoQueuedAfterFailure)
+{
+  PWScore core;
+  Open(core);
+  Retitle(core, 1, L"Unsaved");
+
+  const StringX nowhere(L"no-such-dir/asyncsave.psafe3");
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteFileAsync(nowhere, PWSfile::V30));
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteFileAsync(nowhere, PWSfile::V30)); // queued
+  EXPECT_NE(PWScore::SUCCESS, core.FinishAsyncSave());
+  EXPECT_FALSE(core.IsSaving());
+  EXPECT_TRUE(core.HasDBChanged());
+}
+
+TEST_F(AsyncSaveTest, BackupCopy)
+{
+  PWScore core;
+  Open(core);
+
+  stringT bu_fname;
+  ASSERT_TRUE(core.BackupCurFile(1, 0, L"", L"", bu_fname, true));
+  EXPECT_TRUE(pws_os::FileExists(fname)); // still there to save over
+  EXPECT_TRUE(PWSFileSig(fname) == PWSFileSig(bu_fname));
+
+  Retitle(core, 1, L"Saved");
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteCurFileAsync());
+  EXPECT_EQ(PWScore::SUCCESS, core.FinishAsyncSave());
+  EXPECT_FALSE(PWSFileSig(fname) == PWSFileSig(bu_fname));
+  pws_os::DeleteAFile(bu_fname);
+}
+
+#ifndef WIN32
+TEST_F(AsyncSaveTest, KeepsLinkAndMode)
+{
+  const std::string target("asyncsave.psafe3"), link("asyncsave-link.psafe3");
+  ASSERT_EQ(0, ::chmod(target.c_str(), 0640));
+  ASSERT_EQ(0, ::symlink(target.c_str(), link.c_str()));
+
+  PWScore core;
+  core.SetCurFile(L"asyncsave-link.psafe3");
+  ASSERT_EQ(PWScore::SUCCESS, core.ReadCurFile(passkey));
+  Retitle(core, 1, L"Through a link");
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteCurFileAsync());
+  EXPECT_EQ(PWScore::SUCCESS, core.FinishAsyncSave());
+
+  struct stat info;
+  ASSERT_EQ(0, ::lstat(link.c_str(), &info));
+  EXPECT_TRUE(S_ISLNK(info.st_mode));
+  ASSERT_EQ(0, ::stat(target.c_str(), &info));
+  EXPECT_EQ(mode_t(0640), info.st_mode & 07777);
+  EXPECT_FALSE(pws_os::FileExists(L"asyncsave-link.psafe3.tmp"));
+
+  PWScore reopened;
+  Open(reopened);
+  EXPECT_EQ(L"Through a link", Title(reopened, 1));
+  ::unlink(link.c_str());
+}
+#endif
+
+TEST_F(AsyncSaveTest, SyncSaveWaits)
+{
+  PWScore core;
+  Open(core);
+
+  Retitle(core, 1, L"Async");
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteCurFileAsync());
+  Retitle(core, 2, L"Sync");
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteCurFile());
+  EXPECT_FALSE(core.IsSaving());
+  EXPECT_FALSE(core.HasDBChanged());
+
+  PWScore reopened;
+  Open(reopened);
+  EXPECT_EQ(L"Async", Title(reopened, 1));
+  EXPECT_EQ(L"Sync", Title(reopened, 2));
+}
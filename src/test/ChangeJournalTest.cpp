@@ -0,0 +1,436 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// ChangeJournalTest.cpp: Unit test for saving changes to a journal
+
+#ifdef WIN32
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "DatabaseTest.h"
+
+#include "core/ChangeJournal.h"
+#include "core/PWSprefs.h"
+#include "core/Proxy.h"
+
+#include <vector>
+
+namespace {
+  class MessageCollector : public Reporter
+  {
+  public:
+    void operator()(const stringT &, const stringT &message) override {m_messages.push_back(message);}
+    void operator()(const stringT &message) override {m_messages.push_back(message);}
+    std::vector<stringT> m_messages;
+  };
+}
+
+class ChangeJournalTest : public DatabaseTest
+{
+protected:
+  ChangeJournalTest() : DatabaseTest(L"jotted-down", L"journal.psafe3", 100),
+                        jname(ChangeJournal::GetJournalName(fname.c_str())) {}
+  void SetUp() override;
+  void TearDown() override;
+
+  // Expects both to have the same entries
+  void ExpectSame(PWScore &core1, PWScore &core2);
+  // What PWScore keys the journal with, for the database as it is
+  void GetJournalKey(unsigned char key[32]);
+  // Number of changes in the journal
+  size_t NumJournaled();
+  // Journals set aside as stale
+  std::vector<stringT> StaleJournals();
+
+  long FileLength(const stringT &name);
+  void Truncate(const stringT &name, long length);
+  void Overwrite(const stringT &name, const std::vector<unsigned char> &data);
+  std::vector<unsigned char> Contents(const stringT &name);
+
+  const stringT jname;
+};
+
+void ChangeJournalTest::SetUp()
+{
+  PWSprefs::GetInstance()->SetPref(PWSprefs::UseChangeJournal, true);
+  DatabaseTest::SetUp();
+}
+
+void ChangeJournalTest::TearDown()
+{
+  DatabaseTest::TearDown();
+  if (pws_os::FileExists(jname))
+    pws_os::DeleteAFile(jname);
+  for (const auto &stale : StaleJournals())
+    pws_os::DeleteAFile(stale);
+  PWSprefs::GetInstance()->SetPref(PWSprefs::UseChangeJournal, false);
+}
+
+void ChangeJournalTest::ExpectSame(PWScore &core1, PWScore &core2)
+{
+  EXPECT_EQ(core1.GetNumEntries(), core2.GetNumEntries());
+  for (auto iter = core1.GetEntryIter(); iter != core1.GetEntryEndIter(); iter++) {
+    auto other = core2.Find(iter->first);
+    EXPECT_TRUE(other != core2.GetEntryEndIter());
+    if (other != core2.GetEntryEndIter()) {
+      EXPECT_EQ(iter->second, other->second);
+      EXPECT_EQ(iter->second.GetEntryType(), other->second.GetEntryType());
+    }
+  }
+}
+
+void ChangeJournalTest::GetJournalKey(unsigned char key[32])
+{
+  PWSfileV3 in(fname.c_str(), PWSfile::Read, PWSfile::V30);
+  ASSERT_EQ(PWSfile::SUCCESS, in.Open(passkey));
+  in.GetJournalKey(key);
+  in.Close();
+}
+
+size_t ChangeJournalTest::NumJournaled()
+{
+  size_t numChanges = 0;
+  unsigned char key[32];
+  GetJournalKey(key);
+  ChangeJournal journal(fname.c_str(), key);
+  EXPECT_EQ(PWSfile::SUCCESS,
+            journal.Replay(nullptr,
+                           [&numChanges](const pws_os::CUUID &, CItemData *) {numChanges++;}));
+  return numChanges;
+}
+
+std::vector<stringT> ChangeJournalTest::StaleJournals()
+{
+  std::vector<stringT> stale;
+  pws_os::FindFiles(L"journal.psafe3_*.pwsj", stale);
+  return stale;
+}
+
+long ChangeJournalTest::FileLength(const stringT &name)
+{
+  FILE *f = pws_os::FOpen(name, _T("rb"));
+  if (f == nullptr)
+    return -1;
+  const long length = static_cast<long>(pws_os::fileLength(f));
+  fclose(f);
+  return length;
+}
+
+std::vector<unsigned char> ChangeJournalTest::Contents(const stringT &name)
+{
+  std::vector<unsigned char> data(static_cast<size_t>(FileLength(name)));
+  FILE *f = pws_os::FOpen(name, _T("rb"));
+  if (f != nullptr) {
+    EXPECT_EQ(data.size(), fread(data.data(), 1, data.size(), f));
+    fclose(f);
+  }
+  return data;
+}
+
+void ChangeJournalTest::Overwrite(const stringT &name,
+                                  const std::vector<unsigned char> &data)
+{
+  FILE *f = pws_os::FOpen(name, _T("wb"));
+  ASSERT_NE(nullptr, f);
+  ASSERT_EQ(data.size(), fwrite(data.data(), 1, data.size(), f));
+  fclose(f);
+}
+
+void ChangeJournalTest::Truncate(const stringT &name, long length)
+{
+  std::vector<unsigned char> data = Contents(name);
+  ASSERT_LE(size_t(length), data.size());
+  data.resize(size_t(length));
+  Overwrite(name, data);
+}
+
+TEST_F(ChangeJournalTest, Replay)
+{
+  const std::vector<unsigned char> db = Contents(fname);
+  PWScore core;
+  Open(core);
+
+  Retitle(core, 3, L"Retitled");
+  EXPECT_TRUE(core.HasDBChanged());
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteJournal());
+  EXPECT_FALSE(core.HasDBChanged());
+
+  CItemData added;
+  added.CreateUUID();
+  added.SetTitle(L"Added");
+  added.SetPassword(L"new password");
+  core.Execute(AddEntryCommand::Create(&core, added));
+  core.Execute(DeleteEntryCommand::Create(&core, core.Find(uuids[5])->second));
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteJournal());
+  EXPECT_TRUE(core.HasJournaledChanges());
+
+  // The database itself is untouched
+  EXPECT_EQ(db, Contents(fname));
+  EXPECT_TRUE(pws_os::FileExists(jname));
+
+  PWScore reopened;
+  Open(reopened);
+  ExpectSame(core, reopened);
+  EXPECT_EQ(L"Retitled", reopened.Find(uuids[3])->second.GetTitle());
+  EXPECT_TRUE(reopened.Find(uuids[5]) == reopened.GetEntryEndIter());
+  EXPECT_TRUE(reopened.HasJournaledChanges());
+  EXPECT_FALSE(reopened.HasDBChanged());
+
+  // ...and carries on where the journal left off
+  Retitle(reopened, 7, L"Retitled again");
+  EXPECT_EQ(PWScore::SUCCESS, reopened.WriteJournal());
+  PWScore third;
+  Open(third);
+  ExpectSame(reopened, third);
+}
+
+TEST_F(ChangeJournalTest, UnchangedAppendsNothing)
+{
+  PWScore core;
+  Open(core);
+
+  // Aliases are re-encrypted as they're written, which mustn't
+  // make them look changed the next time around
+  CItemData alias;
+  alias.CreateUUID();
+  alias.SetTitle(L"Alias");
+  alias.SetPassword(L"[Alias]"); // as the UI does
+  alias.SetAlias();
+  core.Execute(AddEntryCommand::Create(&core, alias, uuids[0]));
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteJournal());
+  const long length = FileLength(jname);
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteJournal());
+  EXPECT_EQ(length, FileLength(jname));
+
+  PWScore reopened;
+  Open(reopened);
+  ExpectSame(core, reopened);
+  auto iter = reopened.Find(alias.GetUUID());
+  ASSERT_TRUE(iter != reopened.GetEntryEndIter());
+  EXPECT_TRUE(iter->second.IsAlias());
+  EXPECT_EQ(uuids[0], iter->second.GetBaseUUID());
+  EXPECT_EQ(L"password0", reopened.GetBaseEntry(&iter->second)->GetPassword());
+}
+
+TEST_F(ChangeJournalTest, TornTail)
+{
+  PWScore core;
+  Open(core);
+  Retitle(core, 1, L"First");
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteJournal());
+  const long first = FileLength(jname);
+  Retitle(core, 2, L"Second");
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteJournal());
+  const long second = FileLength(jname);
+  ASSERT_LT(first, second);
+  const std::vector<unsigned char> journal = Contents(jname);
+
+  // As if the second append was cut short anywhere
+  for (long length = first; length < second; length += 7) {
+    Overwrite(jname, journal);
+    Truncate(jname, length);
+    PWScore reopened;
+    Open(reopened);
+    EXPECT_EQ(L"First", reopened.Find(uuids[1])->second.GetTitle());
+    EXPECT_EQ(L"Title 2", reopened.Find(uuids[2])->second.GetTitle());
+  }
+
+  // Or garbled
+  std::vector<unsigned char> garbled(journal);
+  garbled[size_t(second) - 40] ^= 1;
+  Overwrite(jname, garbled);
+
+  PWScore reopened;
+  Open(reopened);
+  EXPECT_EQ(L"First", reopened.Find(uuids[1])->second.GetTitle());
+  EXPECT_EQ(L"Title 2", reopened.Find(uuids[2])->second.GetTitle());
+
+  // The next append replaces the torn batch
+  Retitle(reopened, 3, L"Third");
+  EXPECT_EQ(PWScore::SUCCESS, reopened.WriteJournal());
+  PWScore third;
+  Open(third);
+  EXPECT_EQ(L"First", third.Find(uuids[1])->second.GetTitle());
+  EXPECT_EQ(L"Title 2", third.Find(uuids[2])->second.GetTitle());
+  EXPECT_EQ(L"Third", third.Find(uuids[3])->second.GetTitle());
+}
+
+TEST_F(ChangeJournalTest, FullSaveCompacts)
+{
+  PWScore core;
+  Open(core);
+  Retitle(core, 4, L"Journaled");
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteJournal());
+  const std::vector<unsigned char> journal = Contents(jname);
+
+  Retitle(core, 4, L"Saved");
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteCurFile());
+  EXPECT_FALSE(pws_os::FileExists(jname));
+  EXPECT_FALSE(core.HasJournaledChanges());
+
+  // A journal left over from before then (say, if deleting it failed)
+  // no longer matches the database, so isn't replayed, but is kept
+  // aside, and the user told
+  Overwrite(jname, journal);
+
+  MessageCollector messages;
+  PWScore::SetReporter(&messages);
+  PWScore reopened;
+  Open(reopened);
+  PWScore::SetReporter(nullptr);
+  EXPECT_EQ(L"Saved", reopened.Find(uuids[4])->second.GetTitle());
+  EXPECT_FALSE(reopened.HasJournaledChanges());
+  ExpectSame(core, reopened);
+
+  EXPECT_EQ(1U, messages.m_messages.size());
+  EXPECT_FALSE(pws_os::FileExists(jname));
+  const std::vector<stringT> stale = StaleJournals();
+  ASSERT_EQ(1U, stale.size());
+  EXPECT_TRUE(Contents(stale[0]) == journal);
+}
+
+TEST_F(ChangeJournalTest, OnlyChangedEntries)
+{
+  PWScore core;
+  Open(core);
+
+  Retitle(core, 1, L"One");
+  Retitle(core, 2, L"Two");
+  Retitle(core, 1, L"One again");
+  CItemData ci(core.Find(uuids[3])->second);
+  core.Execute(DeleteEntryCommand::Create(&core, ci));
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteJournal());
+  EXPECT_EQ(3U, NumJournaled());
+
+  // Undone is changed too
+  core.Undo();
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteJournal());
+  EXPECT_EQ(4U, NumJournaled());
+
+  PWScore reopened;
+  Open(reopened);
+  ExpectSame(core, reopened);
+  EXPECT_EQ(L"One again", reopened.Find(uuids[1])->second.GetTitle());
+}
+
+TEST_F(ChangeJournalTest, DatabaseReplaced)
+{
+  PWScore core;
+  Open(core);
+  Retitle(core, 1, L"Journaled");
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteJournal());
+
+  // Someone else saves the database in full
+  {
+    PWScore other;
+    Open(other);
+    Retitle(other, 2, L"Elsewhere");
+    EXPECT_EQ(PWScore::SUCCESS, other.WriteCurFile());
+  }
+
+  Retitle(core, 3, L"Too late");
+  EXPECT_NE(PWScore::SUCCESS, core.WriteJournal());
+  EXPECT_TRUE(core.HasDBChanged());
+}
+
+TEST_F(ChangeJournalTest, CorruptDatabase)
+{
+  PWScore core;
+  Open(core);
+  Retitle(core, 1, L"Journaled");
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteJournal());
+  const std::vector<unsigned char> journal = Contents(jname);
+
+  // A database that fails its HMAC check doesn't get the journal's
+  // changes, nor is it journaled against
+  std::vector<unsigned char> db = Contents(fname);
+  db[db.size() / 2] ^= 1;
+  Overwrite(fname, db);
+
+  PWScore reopened;
+  reopened.SetCurFile(fname.c_str());
+  EXPECT_EQ(PWScore::BAD_DIGEST, reopened.ReadCurFile(passkey));
+  EXPECT_NE(L"Journaled", reopened.Find(uuids[1])->second.GetTitle());
+  EXPECT_FALSE(reopened.HasJournaledChanges());
+  Retitle(reopened, 2, L"Not journaled");
+  EXPECT_NE(PWScore::SUCCESS, reopened.WriteJournal());
+  EXPECT_TRUE(Contents(jname) == journal);
+}
+
+TEST_F(ChangeJournalTest, OnlyEntries)
+{
+  PWScore core;
+  Open(core);
+
+  std::vector<StringX> emptyGroups(1, L"Empty");
+  core.Execute(DBEmptyGroupsCommand::Create(&core, emptyGroups,
+                                            DBEmptyGroupsCommand::EG_REPLACEALL));
+  EXPECT_NE(PWScore::SUCCESS, core.WriteJournal());
+  EXPECT_FALSE(pws_os::FileExists(jname));
+
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteCurFile());
+  PWSprefs::GetInstance()->SetPref(PWSprefs::UseChangeJournal, false);
+  Retitle(core, 1, L"Not journaled");
+  EXPECT_NE(PWScore::SUCCESS, core.WriteJournal());
+  EXPECT_FALSE(pws_os::FileExists(jname));
+}
+
+TEST_F(ChangeJournalTest, WrongKey)
+{
+  unsigned char key[32];
+  GetJournalKey(key);
+  ChangeJournal journal(fname.c_str(), key);
+  ASSERT_EQ(PWSfile::SUCCESS, journal.Create());
+  ChangeJournal::Batch batch;
+  batch.Delete(uuids[0]);
+  ASSERT_EQ(PWSfile::SUCCESS, journal.Append(batch));
+
+  size_t applied = 0;
+  unsigned char wrongKey[32];
+  memcpy(wrongKey, key, sizeof(key));
+  wrongKey[0] ^= 1;
+  ChangeJournal wrong(fname.c_str(), wrongKey);
+  EXPECT_EQ(PWSfile::WRONG_PASSWORD,
+            wrong.Replay(nullptr,
+                         [&applied](const pws_os::CUUID &, CItemData *) {applied++;}));
+  EXPECT_EQ(0U, applied);
+  EXPECT_FALSE(wrong.IsOpen());
+
+  ChangeJournal other(fname.c_str(), key);
+  EXPECT_EQ(PWSfile::SUCCESS,
+            other.Replay(nullptr,
+                         [&](const pws_os::CUUID &uuid, CItemData *ci) {
+                           EXPECT_EQ(uuids[0], uuid);
+                           EXPECT_EQ(nullptr, ci);
+                           applied++;
+                         }));
+  EXPECT_EQ(1U, applied);
+  EXPECT_EQ(1U, other.GetNumBatches());
+}
+
+TEST_F(ChangeJournalTest, AsyncSaveCompacts)
+{
+  PWScore core;
+  Open(core);
+  Retitle(core, 1, L"Journaled");
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteJournal());
+
+  Retitle(core, 2, L"Saved");
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteCurFileAsync());
+  EXPECT_NE(PWScore::SUCCESS, core.WriteJournal()); // not while saving
+  Retitle(core, 3, L"Meanwhile");
+  EXPECT_EQ(PWScore::SUCCESS, core.FinishAsyncSave());
+  EXPECT_FALSE(pws_os::FileExists(jname));
+
+  // Journaled against the database as saved
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteJournal());
+  EXPECT_TRUE(core.HasJournaledChanges());
+  PWScore reopened;
+  Open(reopened);
+  ExpectSame(core, reopened);
+  EXPECT_EQ(L"Meanwhile", reopened.Find(uuids[3])->second.GetTitle());
+}
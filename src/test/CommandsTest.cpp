@@ -14,6 +14,7 @@
 #include "core/PWScore.h"
 #include "core/PWSfileV3.h"
 #include "core/PWHistory.h"
+#include "core/core.h"
 #include "os/file.h"
 
 #include "gtest/gtest.h"
@@ -213,6 +214,8 @@ TEST_F(CommandsTest, EditEntry)
 
   iter = core.Find(it.GetUUID());
   EXPECT_EQ(core.GetEntry(iter).GetTitle(), it2.GetTitle());
+  EXPECT_EQ(core.GetEntryEndIter(), core.Find(L"", L"NoDrama", L""));
+  EXPECT_NE(core.GetEntryEndIter(), core.Find(L"", L"NoDramamine", L""));
   core.Undo();
   EXPECT_TRUE(core.HasDBChanged());
 
@@ -254,11 +257,16 @@ TEST_F(CommandsTest, RenameGroup)
   iter = core.Find(uuid);
   ASSERT_NE(core.GetEntryEndIter(), iter);
   EXPECT_EQ(core.GetEntry(iter).GetGroup(), L"Group0.Beta");
+  // Find by group/title/user should follow the rename
+  EXPECT_EQ(core.GetEntryEndIter(), core.Find(L"Group0.Alpha", L"b title", L""));
+  EXPECT_NE(core.GetEntryEndIter(), core.Find(L"Group0.Beta", L"b title", L""));
   core.Undo();
 
   iter = core.Find(uuid);
   ASSERT_NE(core.GetEntryEndIter(), iter);
   EXPECT_EQ(core.GetEntry(iter).GetGroup(), L"Group0.Alpha");
+  EXPECT_NE(core.GetEntryEndIter(), core.Find(L"Group0.Alpha", L"b title", L""));
+  EXPECT_EQ(core.GetEntryEndIter(), core.Find(L"Group0.Beta", L"b title", L""));
 
   // Get core to delete any existing commands
   core.ClearCommands();
@@ -273,7 +281,6 @@ TEST_F(CommandsTest, CountGroups)
   di.CreateUUID();
   di.SetTitle(L"b title");
   di.SetPassword(L"b password");
-  const pws_os::CUUID uuid = di.GetUUID();
 
   Command *pcmd = AddEntryCommand::Create(&core, di);  
   core.Execute(pcmd);
@@ -411,6 +418,53 @@ TEST_F(CommandsTest, UpdatePassword)
   pws_os::DeleteAFile(fname);
 }
 
+TEST_F(CommandsTest, FindByGTU)
+{
+  PWScore core;
+  CItemData a, b;
+  a.CreateUUID();
+  a.SetGroup(L"G");
+  a.SetTitle(L"T");
+  a.SetUser(L"U");
+  a.SetPassword(L"pa");
+  b.CreateUUID();
+  b.SetGroup(L"G");
+  b.SetTitle(L"TU"); // same concatenation as a's title + user
+  b.SetPassword(L"pb");
+
+  MultiCommands *pmulticmds = MultiCommands::Create(&core);
+  pmulticmds->Add(AddEntryCommand::Create(&core, a));
+  pmulticmds->Add(AddEntryCommand::Create(&core, b));
+  core.Execute(pmulticmds);
+
+  auto iter = core.Find(L"G", L"T", L"U");
+  ASSERT_NE(core.GetEntryEndIter(), iter);
+  EXPECT_EQ(a.GetUUID(), iter->first);
+  iter = core.Find(L"G", L"TU", L"");
+  ASSERT_NE(core.GetEntryEndIter(), iter);
+  EXPECT_EQ(b.GetUUID(), iter->first);
+  EXPECT_EQ(core.GetEntryEndIter(), core.Find(L"G", L"T", L""));
+
+  // Existing entries needn't be in the set for MakeEntryUnique to see them
+  GTUSet setGTU;
+  StringX title(L"T");
+  EXPECT_FALSE(core.MakeEntryUnique(setGTU, L"G", title, L"U", IDSC_IMPORTNUMBER));
+  EXPECT_NE(L"T", title);
+  title = L"T";
+  EXPECT_TRUE(core.MakeEntryUnique(setGTU, L"G", title, L"V", IDSC_IMPORTNUMBER));
+  EXPECT_EQ(L"T", title);
+  // ...but new ones in the set count too
+  EXPECT_FALSE(core.MakeEntryUnique(setGTU, L"G", title, L"V", IDSC_IMPORTNUMBER));
+
+  core.Execute(DeleteEntryCommand::Create(&core, a));
+  EXPECT_EQ(core.GetEntryEndIter(), core.Find(L"G", L"T", L"U"));
+  core.Undo();
+  EXPECT_NE(core.GetEntryEndIter(), core.Find(L"G", L"T", L"U"));
+
+  // Get core to delete any existing commands
+  core.ClearCommands();
+}
+
 TEST_F(CommandsTest, UpdateEntry)
 {
   PWScore core;
@@ -0,0 +1,82 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// DatabaseTest.h
+// Fixture for tests that write a V3 database of N entries, then open,
+// change and save it with PWScore.
+//-----------------------------------------------------------------------------
+
+#ifndef _DATABASETEST_H
+#define _DATABASETEST_H
+
+#include "core/PWScore.h"
+#include "core/PWSfileV3.h"
+#include "os/file.h"
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+class DatabaseTest : public ::testing::Test
+{
+protected:
+  DatabaseTest(const StringX &passkey_, const stringT &fname_, size_t n)
+    : passkey(passkey_), fname(fname_), N(n) {}
+
+  void SetUp() override
+  {
+    PWSfileV3 fw(fname.c_str(), PWSfile::Write, PWSfile::V30);
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passkey));
+    for (size_t i = 0; i < N; i++) {
+      CItemData ci;
+      ci.CreateUUID();
+      MakeEntry(ci, i, StringX(std::to_wstring(i).c_str()));
+      uuids.push_back(ci.GetUUID());
+      ASSERT_EQ(PWSfile::SUCCESS, fw.WriteRecord(ci));
+    }
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+  }
+
+  void TearDown() override {pws_os::DeleteAFile(fname);}
+
+  // Entry i, s being i as a string. Those before it are in uuids.
+  virtual void MakeEntry(CItemData &ci, size_t i, const StringX &s)
+  {
+    (void)i;
+    ci.SetGroup(L"Group" + s.substr(0, 1));
+    ci.SetTitle(L"Title " + s);
+    ci.SetUser(L"user" + s);
+    ci.SetPassword(L"password" + s);
+    ci.SetCTime(1409901293);
+  }
+
+  void Open(PWScore &core)
+  {
+    core.SetCurFile(fname.c_str());
+    ASSERT_EQ(PWScore::SUCCESS, core.ReadCurFile(passkey));
+  }
+
+  // Changes entry i's title, as the UI would
+  void Retitle(PWScore &core, size_t i, const StringX &title)
+  {
+    auto iter = core.Find(uuids[i]);
+    ASSERT_TRUE(iter != core.GetEntryEndIter());
+    CItemData ci(iter->second);
+    ci.SetTitle(title);
+    core.Execute(EditEntryCommand::Create(&core, iter->second, ci));
+  }
+
+  StringX Title(PWScore &core, size_t i) {return core.Find(uuids[i])->second.GetTitle();}
+
+  const StringX passkey;
+  const stringT fname;
+  const size_t N;
+  std::vector<pws_os::CUUID> uuids; // of the entries written, in order
+};
+
+#endif /* _DATABASETEST_H */
@@ -0,0 +1,139 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// DisplayFieldCacheTest.cpp: Unit test for DisplayFieldCache class
+
+#ifdef WIN32
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "core/DisplayFieldCache.h"
+#include "core/PWScore.h"
+#include "core/PWSprefs.h"
+#include "gtest/gtest.h"
+
+static CItemData MakeItem(const StringX &group, const StringX &title, const StringX &user)
+{
+  CItemData ci;
+  ci.CreateUUID();
+  ci.SetGroup(group);
+  ci.SetTitle(title);
+  ci.SetUser(user);
+  ci.SetPassword(L"password");
+  return ci;
+}
+
+TEST(DisplayFieldCacheTest, HitsAndMisses)
+{
+  DisplayFieldCache cache(10, 300);
+  const CItemData ci = MakeItem(L"g", L"t", L"u");
+
+  EXPECT_EQ(L"t", cache.Get(ci.GetUUID(), ci, CItemData::TITLE));
+  EXPECT_EQ(L"t", cache.Get(ci.GetUUID(), ci, CItemData::TITLE));
+  EXPECT_EQ(L"g", cache.Get(ci.GetUUID(), ci, CItemData::GROUP));
+  EXPECT_EQ(L"u", cache.Get(ci.GetUUID(), ci, CItemData::USER));
+  EXPECT_EQ(L"password", cache.Get(ci.GetUUID(), ci, CItemData::PASSWORD)); // never cached
+
+  DisplayFieldCache::Stats stats = cache.GetStats();
+  EXPECT_EQ(1U, stats.hits);
+  EXPECT_EQ(3U, stats.misses);
+  EXPECT_EQ(3U, stats.size);
+
+  cache.PurgeExpired(); // none are
+  EXPECT_EQ(3U, cache.GetStats().size);
+
+  cache.Remove(ci.GetUUID());
+  EXPECT_EQ(0U, cache.GetStats().size);
+}
+
+TEST(DisplayFieldCacheTest, Bounded)
+{
+  DisplayFieldCache cache(2, 300);
+  const CItemData a = MakeItem(L"", L"a", L""), b = MakeItem(L"", L"b", L""),
+    c = MakeItem(L"", L"c", L"");
+
+  cache.Get(a.GetUUID(), a, CItemData::TITLE);
+  cache.Get(b.GetUUID(), b, CItemData::TITLE);
+  cache.Get(a.GetUUID(), a, CItemData::TITLE); // a is now more recent than b
+  cache.Get(c.GetUUID(), c, CItemData::TITLE); // so b goes
+
+  DisplayFieldCache::Stats stats = cache.GetStats();
+  EXPECT_EQ(2U, stats.size);
+  EXPECT_EQ(1U, stats.evictions);
+
+  cache.ResetStats();
+  cache.Get(a.GetUUID(), a, CItemData::TITLE);
+  cache.Get(b.GetUUID(), b, CItemData::TITLE);
+  stats = cache.GetStats();
+  EXPECT_EQ(1U, stats.hits);
+  EXPECT_EQ(1U, stats.misses);
+
+  cache.Configure(1, 300);
+  EXPECT_EQ(1U, cache.GetStats().size);
+  cache.Configure(0, 300); // disabled
+  EXPECT_FALSE(cache.IsEnabled());
+  EXPECT_EQ(L"a", cache.Get(a.GetUUID(), a, CItemData::TITLE));
+  EXPECT_EQ(0U, cache.GetStats().size);
+}
+
+TEST(DisplayFieldCacheTest, Expiry)
+{
+  DisplayFieldCache cache(10, 0); // everything's stale at once
+  const CItemData ci = MakeItem(L"g", L"t", L"u");
+
+  EXPECT_EQ(L"t", cache.Get(ci.GetUUID(), ci, CItemData::TITLE));
+  EXPECT_EQ(L"t", cache.Get(ci.GetUUID(), ci, CItemData::TITLE));
+
+  DisplayFieldCache::Stats stats = cache.GetStats();
+  EXPECT_EQ(0U, stats.hits);
+  EXPECT_EQ(2U, stats.misses);
+  EXPECT_EQ(1U, stats.expirations);
+  EXPECT_EQ(1U, stats.size);
+
+  // Stale values needn't wait to be looked up again to go
+  EXPECT_EQ(L"g", cache.Get(ci.GetUUID(), ci, CItemData::GROUP));
+  cache.PurgeExpired();
+  stats = cache.GetStats();
+  EXPECT_EQ(3U, stats.expirations);
+  EXPECT_EQ(0U, stats.size);
+}
+
+TEST(DisplayFieldCacheTest, PWScore)
+{
+  PWSprefs *prefs = PWSprefs::GetInstance();
+  const unsigned int oldSize = prefs->GetPref(PWSprefs::DisplayCacheSize);
+  prefs->SetPref(PWSprefs::DisplayCacheSize, 100);
+
+  PWScore core;
+  core.ClearDBData(); // picks up the preference
+  const CItemData di = MakeItem(L"g", L"old", L"u");
+  core.Execute(AddEntryCommand::Create(&core, di));
+
+  const pws_os::CUUID uuid = di.GetUUID();
+  EXPECT_EQ(L"old", core.GetDisplayField(uuid, CItemData::TITLE));
+  EXPECT_EQ(L"old", core.GetDisplayField(uuid, CItemData::TITLE));
+  EXPECT_EQ(1U, core.GetDisplayCacheStats().hits);
+
+  // Editing the entry mustn't leave a stale value behind...
+  core.Execute(UpdateEntryCommand::Create(&core, core.GetEntry(core.Find(uuid)),
+                                          CItemData::TITLE, L"new"));
+  EXPECT_EQ(L"new", core.GetDisplayField(uuid, CItemData::TITLE));
+
+  // ...nor should undoing the edit
+  core.Undo();
+  EXPECT_EQ(L"old", core.GetDisplayField(uuid, CItemData::TITLE));
+
+  // ...or deleting the entry
+  core.Execute(DeleteEntryCommand::Create(&core, core.GetEntry(core.Find(uuid))));
+  EXPECT_EQ(L"", core.GetDisplayField(uuid, CItemData::TITLE));
+
+  core.ClearDisplayCache();
+  EXPECT_EQ(0U, core.GetDisplayCacheStats().size);
+
+  core.ClearCommands();
+  prefs->SetPref(PWSprefs::DisplayCacheSize, oldSize);
+}
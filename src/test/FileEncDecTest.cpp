@@ -123,6 +123,19 @@ TEST_F(FileEncDecTest, BigFile)
   PWSfile::fileThresholdSize = oldThreshold;
 }
 
+TEST_F(FileEncDecTest, ChunkedFile)
+{
+  // Many chunks, the last one short, read ahead & decrypted as they come
+  auto oldChunkSize = PWSfile::fileChunkSize;
+  PWSfile::fileChunkSize = 4000; // not a multiple of either block size
+  TestFile(L"image1.jpg");
+  auto oldThreshold = PWSfile::fileThresholdSize;
+  PWSfile::fileThresholdSize = 100000;
+  TestFile(L"image1.jpg");
+  PWSfile::fileThresholdSize = oldThreshold;
+  PWSfile::fileChunkSize = oldChunkSize;
+}
+
 void FileEncDecTest::TestFile(const stringT& testfile)
 {
   const stringT originalTestFile = testfile; 
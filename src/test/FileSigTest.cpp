@@ -0,0 +1,129 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// FileSigTest.cpp: Unit test for PWSFileSig and external change detection
+
+#ifdef WIN32
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "core/PWScore.h"
+#include "core/PWSfile.h"
+#include "core/PWSprefs.h"
+#include "os/file.h"
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+class FileSigTest : public ::testing::Test
+{
+protected:
+  FileSigTest() : fname(L"filesig.dat") {}
+  void TearDown()
+  {
+    if (pws_os::FileExists(fname))
+      pws_os::DeleteAFile(fname);
+  }
+
+  void Write(const std::vector<unsigned char> &data, const TCHAR *mode = _T("wb"));
+
+  const stringT fname;
+};
+
+void FileSigTest::Write(const std::vector<unsigned char> &data, const TCHAR *mode)
+{
+  FILE *f = pws_os::FOpen(fname, mode);
+  ASSERT_NE(nullptr, f);
+  if (!data.empty()) {
+    EXPECT_EQ(data.size(), fwrite(data.data(), 1, data.size(), f));
+  }
+  fclose(f);
+}
+
+TEST_F(FileSigTest, WholeFile)
+{
+  std::vector<unsigned char> data(100000);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = static_cast<unsigned char>(i * 7);
+  Write(data);
+
+  PWSFileSig sig(fname);
+  EXPECT_TRUE(sig.IsValid());
+  EXPECT_TRUE(sig == PWSFileSig(fname));
+
+  // Same length, changed well away from either end
+  data[data.size() / 2] ^= 1;
+  Write(data);
+  EXPECT_TRUE(sig != PWSFileSig(fname));
+
+  data[data.size() / 2] ^= 1;
+  Write(data);
+  EXPECT_TRUE(sig == PWSFileSig(fname));
+
+  // Changed in place, same inode and length
+  FILE *f = pws_os::FOpen(fname, _T("r+b"));
+  ASSERT_NE(nullptr, f);
+  ASSERT_EQ(0, fseek(f, 1000, SEEK_SET));
+  fputc(data[1000] ^ 0x80, f);
+  fclose(f);
+  EXPECT_TRUE(sig != PWSFileSig(fname));
+}
+
+TEST_F(FileSigTest, Errors)
+{
+  PWSFileSig missing(fname);
+  EXPECT_EQ(PWSfile::CANT_OPEN_FILE, missing.GetErrorCode());
+
+  Write(std::vector<unsigned char>());
+  PWSFileSig empty(fname);
+  EXPECT_EQ(PWSfile::TRUNCATED_FILE, empty.GetErrorCode());
+  EXPECT_FALSE(empty == PWSFileSig(fname)); // invalid ones never match
+}
+
+TEST_F(FileSigTest, ChangedExternally)
+{
+  const StringX passkey(L"sig-nature");
+  const stringT dbname(L"filesig.psafe3");
+  PWSprefs::GetInstance()->SetPref(PWSprefs::UseChangeJournal, true);
+  {
+    PWScore core;
+    core.NewFile(passkey);
+    core.SetCurFile(dbname.c_str());
+    ASSERT_EQ(PWScore::SUCCESS, core.WriteCurFile());
+  }
+
+  PWScore core;
+  core.SetCurFile(dbname.c_str());
+  ASSERT_EQ(PWScore::SUCCESS, core.ReadCurFile(passkey));
+  EXPECT_FALSE(core.HasFileChangedExternally());
+
+  {
+    // Someone else saves it
+    PWScore other;
+    other.SetCurFile(dbname.c_str());
+    ASSERT_EQ(PWScore::SUCCESS, other.ReadCurFile(passkey));
+    ASSERT_EQ(PWScore::SUCCESS, other.WriteCurFile());
+  }
+  EXPECT_TRUE(core.HasFileChangedExternally());
+
+  // Journaling would append to a journal the file no longer matches
+  CItemData ci;
+  ci.CreateUUID();
+  ci.SetTitle(L"title");
+  ci.SetPassword(L"password");
+  core.Execute(AddEntryCommand::Create(&core, ci));
+  EXPECT_NE(PWScore::SUCCESS, core.WriteJournal());
+
+  core.AcceptFileChanges();
+  EXPECT_FALSE(core.HasFileChangedExternally());
+  EXPECT_EQ(PWScore::SUCCESS, core.WriteCurFile());
+  EXPECT_FALSE(core.HasFileChangedExternally());
+
+  PWSprefs::GetInstance()->SetPref(PWSprefs::UseChangeJournal, false);
+  pws_os::DeleteAFile(dbname);
+}
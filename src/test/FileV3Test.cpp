@@ -16,6 +16,8 @@
 
 #include "gtest/gtest.h"
 
+#include <vector>
+
 // A fixture for factoring common code across tests
 class FileV3Test : public ::testing::Test
 {
@@ -155,6 +157,47 @@ TEST_F(FileV3Test, ItemTest)
   EXPECT_EQ(PWSfile::SUCCESS, fr.Close());
 }
 
+TEST_F(FileV3Test, PeekTest)
+{
+  PWSfileHeader hdr1;
+  hdr1.m_DB_Name = _T("peeked");
+  hdr1.m_DB_Description = _T("Just the header, please");
+  PWSfileV3 fw(fname.c_str(), PWSfile::Write, PWSfile::V30);
+  fw.SetHeader(hdr1);
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passphrase));
+  hdr1 = fw.GetHeader();
+  EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(smallItem));
+  EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(fullItem));
+  EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(smallItem));
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+
+  PWSfileV3 fr1(fname.c_str(), PWSfile::Read, PWSfile::V30);
+  EXPECT_EQ(PWSfile::WRONG_PASSWORD, fr1.Peek(_T("x")));
+
+  PWSfileV3 fr2(fname.c_str(), PWSfile::Read, PWSfile::V30);
+  ASSERT_EQ(PWSfile::SUCCESS, fr2.Peek(passphrase));
+  EXPECT_EQ(hdr1, fr2.GetHeader());
+
+  size_t n = 0;
+  PWSfileV3 fr3(fname.c_str(), PWSfile::Read, PWSfile::V30);
+  ASSERT_EQ(PWSfile::SUCCESS, fr3.Peek(passphrase, &n));
+  EXPECT_EQ(hdr1, fr3.GetHeader());
+  EXPECT_EQ(3U, n);
+
+  // Cut short in the middle of the records
+  FILE *f = pws_os::FOpen(fname, _T("rb"));
+  ASSERT_NE(nullptr, f);
+  std::vector<unsigned char> data(pws_os::fileLength(f));
+  ASSERT_EQ(data.size(), fread(data.data(), 1, data.size(), f));
+  fclose(f);
+  f = pws_os::FOpen(fname, _T("wb"));
+  ASSERT_NE(nullptr, f);
+  ASSERT_EQ(data.size() - 200, fwrite(data.data(), 1, data.size() - 200, f));
+  fclose(f);
+  PWSfileV3 fr4(fname.c_str(), PWSfile::Read, PWSfile::V30);
+  EXPECT_NE(PWSfile::SUCCESS, fr4.Peek(passphrase, &n));
+}
+
 TEST_F(FileV3Test, UnknownPersistencyTest)
 {
   CItemData d1;
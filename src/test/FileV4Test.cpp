@@ -13,11 +13,25 @@
 
 #include "core/PWSfileV4.h"
 #include "core/PWScore.h"
+#include "core/PWSprefs.h"
+#include "core/crypto/sha256.h"
 
 #include "os/file.h"
 
 #include "gtest/gtest.h"
 
+#include <vector>
+
+namespace {
+  class MessageCollector : public Reporter
+  {
+  public:
+    void operator()(const stringT &, const stringT &message) override {m_messages.push_back(message);}
+    void operator()(const stringT &message) override {m_messages.push_back(message);}
+    std::vector<stringT> m_messages;
+  };
+}
+
 // A fixture for factoring common code across tests
 class FileV4Test : public ::testing::Test
 {
@@ -204,6 +218,79 @@ TEST_F(FileV4Test, MulitKeysTest)
   EXPECT_FALSE(kbs.RemoveKeyBlock(passphrase));
 }
 
+// Each of several users' passphrases opens the file, whichever key block
+// it's in, and nothing else does
+TEST_F(FileV4Test, ManyKeysTest)
+{
+  const size_t N = 10;
+  std::vector<StringX> passphrases;
+  PWSfileV4::CKeyBlocks kbs;
+  ASSERT_TRUE(kbs.AddKeyBlock(passphrase, passphrase));
+  for (size_t i = 1; i < N; i++) {
+    passphrases.push_back(StringX(_T("user passphrase ")) + StringX(std::to_wstring(i).c_str()));
+    ASSERT_TRUE(kbs.AddKeyBlock(passphrase, passphrases.back(), MIN_HASH_ITERATIONS + unsigned(i)));
+  }
+  passphrases.push_back(passphrase);
+
+  PWSfileV4 fw(fname.c_str(), PWSfile::Write, PWSfile::V40);
+  fw.SetKeyBlocks(kbs);
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passphrases[N / 2]));
+  EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(smallItem));
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+
+  for (const auto &pw : passphrases) {
+    PWSfileV4 fr(fname.c_str(), PWSfile::Read, PWSfile::V40);
+    ASSERT_EQ(PWSfile::SUCCESS, fr.Open(pw)) << pw.c_str();
+    EXPECT_EQ(PWSfile::SUCCESS, fr.ReadRecord(item));
+    EXPECT_EQ(smallItem, item);
+    EXPECT_EQ(PWSfile::SUCCESS, fr.Close());
+  }
+  PWSfileV4 fr(fname.c_str(), PWSfile::Read, PWSfile::V40);
+  EXPECT_EQ(PWSfile::WRONG_PASSWORD, fr.Open(_T("none of the above")));
+}
+
+// Key blocks batched by iteration count still find each passphrase, and
+// RemoveKeyBlock still finds every block a passphrase opens
+TEST_F(FileV4Test, MixedIterationsTest)
+{
+  const unsigned iters[] = {16, 1, 4, 1, 8, 2, 1, 16, 2, 4};
+  const size_t N = sizeof(iters) / sizeof(iters[0]);
+  std::vector<StringX> passphrases;
+  PWSfileV4::CKeyBlocks kbs;
+  ASSERT_TRUE(kbs.AddKeyBlock(passphrase, passphrase));
+  for (size_t i = 0; i < N; i++) {
+    passphrases.push_back(StringX(_T("user passphrase ")) + StringX(std::to_wstring(i % 7).c_str()));
+    ASSERT_TRUE(kbs.AddKeyBlock(passphrase, passphrases.back(), MIN_HASH_ITERATIONS * iters[i]));
+  }
+
+  PWSfileV4 fw(fname.c_str(), PWSfile::Write, PWSfile::V40);
+  fw.SetKeyBlocks(kbs);
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passphrase));
+  EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(smallItem));
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+
+  // With SHA-256 instructions, one key block at a time; without, as many
+  // as there are SIMD lanes
+  for (bool hw : {true, false}) {
+    SHA256::Restrict impl(hw);
+    for (const auto &pw : passphrases) {
+      PWSfileV4 fr(fname.c_str(), PWSfile::Read, PWSfile::V40);
+      ASSERT_EQ(PWSfile::SUCCESS, fr.Open(pw)) << pw.c_str() << ", hw " << hw;
+      EXPECT_EQ(PWSfile::SUCCESS, fr.ReadRecord(item));
+      EXPECT_EQ(smallItem, item);
+      EXPECT_EQ(PWSfile::SUCCESS, fr.Close());
+    }
+
+    // "user passphrase 0" .. "2" are in two key blocks each
+    PWSfileV4::CKeyBlocks kbs2(kbs);
+    EXPECT_TRUE(kbs2.RemoveKeyBlock(passphrases[0])) << "hw " << hw;
+    EXPECT_FALSE(kbs2.RemoveKeyBlock(passphrases[7])) << "hw " << hw;
+    EXPECT_TRUE(kbs2.RemoveKeyBlock(passphrases[9])) << "hw " << hw;
+    EXPECT_FALSE(kbs2.RemoveKeyBlock(passphrases[2])) << "hw " << hw;
+    EXPECT_TRUE(kbs2.RemoveKeyBlock(passphrases[5])) << "hw " << hw;
+  }
+}
+
 TEST_F(FileV4Test, AttTest)
 {
   PWSfileV4 fw(fname.c_str(), PWSfile::Write, PWSfile::V40);
@@ -222,6 +309,197 @@ TEST_F(FileV4Test, AttTest)
   EXPECT_EQ(attItem, readAtt);
 }
 
+TEST_F(FileV4Test, LargeAttTest)
+{
+  // Content a multiple of the block size, of the piece size, and neither
+  const size_t lengths[] = {64, CItemAtt::CONTENT_CHUNK, 2 * CItemAtt::CONTENT_CHUNK + 7};
+  std::vector<CItemAtt> atts;
+  for (auto len : lengths) {
+    std::vector<unsigned char> content(len);
+    for (size_t i = 0; i < len; i++)
+      content[i] = static_cast<unsigned char>(i + len);
+    CItemAtt att;
+    att.CreateUUID();
+    att.SetContent(content.data(), content.size());
+    atts.push_back(att);
+  }
+
+  PWSfileV4 fw(fname.c_str(), PWSfile::Write, PWSfile::V40);
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passphrase));
+  for (const auto &att : atts)
+    EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(att));
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+
+  PWSfileV4 fr(fname.c_str(), PWSfile::Read, PWSfile::V40);
+  ASSERT_EQ(PWSfile::SUCCESS, fr.Open(passphrase));
+  for (auto &att : atts) {
+    CItemAtt readAtt;
+    EXPECT_EQ(PWSfile::SUCCESS, fr.ReadRecord(readAtt));
+    att.SetOffset(readAtt.GetOffset());
+    EXPECT_EQ(att, readAtt);
+  }
+  EXPECT_EQ(PWSfile::END_OF_FILE, fr.ReadRecord(item));
+  EXPECT_EQ(PWSfile::SUCCESS, fr.Close());
+}
+
+TEST_F(FileV4Test, LazyAttTest)
+{
+  PWSfileV4 fw(fname.c_str(), PWSfile::Write, PWSfile::V40);
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passphrase));
+  EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(attItem));
+  EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(smallItem));
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+
+  CItemAtt readAtt;
+  PWSfileV4 fr(fname.c_str(), PWSfile::Read, PWSfile::V40);
+  fr.SetLazyContent(true);
+  ASSERT_EQ(PWSfile::SUCCESS, fr.Open(passphrase));
+  EXPECT_EQ(PWSfile::SUCCESS, fr.ReadRecord(readAtt));
+  EXPECT_EQ(PWSfile::SUCCESS, fr.ReadRecord(item)); // found past the content
+  EXPECT_EQ(smallItem, item);
+  EXPECT_EQ(PWSfile::SUCCESS, fr.Close());
+
+  EXPECT_FALSE(readAtt.IsContentLoaded());
+  EXPECT_TRUE(readAtt.HasContent());
+  EXPECT_EQ(attItem.GetContentLength(), readAtt.GetContentLength());
+  CItemAtt copyAtt(readAtt); // loads on its own
+  CItemAtt touchedAtt(readAtt);
+
+  attItem.SetOffset(readAtt.GetOffset());
+  EXPECT_EQ(attItem, readAtt); // loads
+  EXPECT_TRUE(readAtt.IsContentLoaded());
+
+  // The file written back as it was, as a sync tool might, still has
+  // the content where it was
+  FILE *f = pws_os::FOpen(fname, _T("rb"));
+  ASSERT_NE(nullptr, f);
+  std::vector<unsigned char> data(static_cast<size_t>(pws_os::fileLength(f)));
+  ASSERT_EQ(data.size(), fread(data.data(), 1, data.size(), f));
+  fclose(f);
+  f = pws_os::FOpen(fname, _T("wb"));
+  ASSERT_NE(nullptr, f);
+  ASSERT_EQ(data.size(), fwrite(data.data(), 1, data.size(), f));
+  fclose(f);
+  EXPECT_TRUE(touchedAtt.LoadContent());
+  EXPECT_EQ(attItem, touchedAtt);
+
+  // Once the file's rewritten, content not yet loaded is unavailable
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passphrase));
+  EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(attItem));
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+  EXPECT_FALSE(copyAtt.LoadContent());
+  EXPECT_FALSE(copyAtt.IsContentLoaded());
+  unsigned char buf[16];
+  EXPECT_EQ(0U, copyAtt.ReadContent(0, buf, sizeof(buf)));
+  EXPECT_NE(PWScore::SUCCESS, copyAtt.Export(L"lazy-export.tmp"));
+}
+
+TEST_F(FileV4Test, CoreLazyAttTest)
+{
+  PWSprefs::GetInstance()->SetPref(PWSprefs::LazyAttachments, true);
+  const StringX passkey(L"3rdMambo");
+  fullItem.SetAttUUID(attItem.GetUUID());
+  {
+    PWScore core;
+    core.NewFile(passkey);
+    core.Execute(AddEntryCommand::Create(&core, fullItem, pws_os::CUUID::NullUUID(), &attItem));
+    ASSERT_EQ(PWSfile::SUCCESS, core.WriteFile(fname.c_str(), PWSfile::V40));
+    core.ClearCommands();
+  }
+
+  PWScore core;
+  ASSERT_EQ(PWSfile::SUCCESS, core.ReadFile(fname.c_str(), passkey));
+  ASSERT_TRUE(core.HasAtt(attItem.GetUUID()));
+  EXPECT_FALSE(core.GetAtt(attItem.GetUUID()).IsContentLoaded());
+
+  // Rewriting the file loads the content first
+  ASSERT_EQ(PWSfile::SUCCESS, core.WriteFile(fname.c_str(), PWSfile::V40));
+  EXPECT_TRUE(core.GetAtt(attItem.GetUUID()).IsContentLoaded());
+
+  PWSprefs::GetInstance()->SetPref(PWSprefs::LazyAttachments, false);
+  PWScore reread;
+  ASSERT_EQ(PWSfile::SUCCESS, reread.ReadFile(fname.c_str(), passkey));
+  ASSERT_TRUE(reread.HasAtt(attItem.GetUUID()));
+  const CItemAtt &readAtt = reread.GetAtt(attItem.GetUUID());
+  EXPECT_TRUE(readAtt.IsContentLoaded());
+  ASSERT_EQ(attItem.GetContentLength(), readAtt.GetContentLength());
+  std::vector<unsigned char> c1(attItem.GetContentSize()), c2(readAtt.GetContentSize());
+  ASSERT_TRUE(attItem.GetContent(c1.data(), c1.size()));
+  ASSERT_TRUE(readAtt.GetContent(c2.data(), c2.size()));
+  EXPECT_TRUE(c1 == c2);
+
+  // Content that can no longer be loaded is reported, and only that
+  // attachment's left out of the save
+  PWSprefs::GetInstance()->SetPref(PWSprefs::LazyAttachments, true);
+  PWScore stale;
+  ASSERT_EQ(PWSfile::SUCCESS, stale.ReadFile(fname.c_str(), passkey));
+  ASSERT_EQ(PWSfile::SUCCESS, reread.WriteFile(fname.c_str(), PWSfile::V40));
+  MessageCollector reporter;
+  PWScore::SetReporter(&reporter);
+  EXPECT_EQ(PWScore::SUCCESS, stale.WriteFile(fname.c_str(), PWSfile::V40));
+  EXPECT_EQ(1U, reporter.m_messages.size());
+  if (!reporter.m_messages.empty()) {
+    EXPECT_NE(stringT::npos, reporter.m_messages[0].find(attItem.GetTitle().c_str()));
+  }
+  EXPECT_EQ(PWScore::SUCCESS, stale.WriteFile(fname.c_str(), PWSfile::V40));
+  PWScore::SetReporter(nullptr);
+  PWSprefs::GetInstance()->ResetPref(PWSprefs::LazyAttachments);
+
+  PWScore saved;
+  ASSERT_EQ(PWSfile::SUCCESS, saved.ReadFile(fname.c_str(), passkey));
+  EXPECT_EQ(1U, saved.GetNumEntries());
+  EXPECT_FALSE(saved.HasAtt(attItem.GetUUID()));
+}
+
+TEST_F(FileV4Test, PeekTest)
+{
+  PWSfileHeader hdr1;
+  hdr1.m_DB_Name = _T("peeked");
+  std::vector<unsigned char> content(3 * CItemAtt::CONTENT_CHUNK + 5, 'p');
+  CItemAtt bigAtt;
+  bigAtt.CreateUUID();
+  bigAtt.SetContent(content.data(), content.size());
+
+  PWSfileV4 fw(fname.c_str(), PWSfile::Write, PWSfile::V40);
+  fw.SetHeader(hdr1);
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passphrase));
+  hdr1 = fw.GetHeader();
+  EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(smallItem));
+  EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(attItem));
+  EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(fullItem));
+  EXPECT_EQ(PWSfile::SUCCESS, fw.WriteRecord(bigAtt));
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+
+  PWSfileV4 fr1(fname.c_str(), PWSfile::Read, PWSfile::V40);
+  EXPECT_EQ(PWSfile::WRONG_PASSWORD, fr1.Peek(_T("x")));
+
+  size_t nEntries = 0, nAtts = 0;
+  PWSfileV4 fr2(fname.c_str(), PWSfile::Read, PWSfile::V40);
+  ASSERT_EQ(PWSfile::SUCCESS, fr2.Peek(passphrase, &nEntries, &nAtts));
+  EXPECT_EQ(hdr1, fr2.GetHeader());
+  EXPECT_EQ(2U, nEntries);
+  EXPECT_EQ(2U, nAtts);
+
+  // Through the core, as for a database that's not open
+  PWScore core;
+  st_DBProperties dbp;
+  ASSERT_EQ(PWScore::SUCCESS, core.PeekFile(fname.c_str(), passphrase, dbp));
+  EXPECT_EQ(StringX(fname.c_str()), dbp.database);
+  EXPECT_EQ(L"peeked", dbp.db_name);
+  EXPECT_EQ(L"2", dbp.numentries);
+  EXPECT_EQ(L"2", dbp.numattachments);
+  EXPECT_EQ(0U, core.GetNumEntries());
+  EXPECT_EQ(PWScore::WRONG_PASSWORD, core.PeekFile(fname.c_str(), _T("x"), dbp));
+
+  ASSERT_EQ(PWScore::SUCCESS, core.ReadFile(fname.c_str(), passphrase));
+  st_DBProperties dbpRead;
+  core.GetDBProperties(dbpRead);
+  EXPECT_EQ(dbpRead.numentries, dbp.numentries);
+  EXPECT_EQ(dbpRead.numattachments, dbp.numattachments);
+  EXPECT_EQ(dbpRead.whenlastsaved, dbp.whenlastsaved);
+  EXPECT_EQ(dbpRead.file_uuid, dbp.file_uuid);
+}
+
 TEST_F(FileV4Test, HdrItemAttTest)
 {
   PWSfileHeader hdr1;
@@ -287,3 +565,45 @@ TEST_F(FileV4Test, CoreRWTest)
   // Get core to delete any existing commands
   core.ClearCommands();
 }
+
+TEST_F(FileV4Test, CoreRWKeyringTest)
+{
+  PWSprefs::GetInstance()->SetPref(PWSprefs::UseSessionKeyring, true);
+  PWScore core;
+  const StringX passkey(L"3rdMambo");
+
+  fullItem.SetAttUUID(attItem.GetUUID());
+  core.NewFile(passkey);
+  core.Execute(AddEntryCommand::Create(&core, fullItem, pws_os::CUUID::NullUUID(), &attItem));
+  core.Execute(AddEntryCommand::Create(&core, smallItem));
+  EXPECT_EQ(PWSfile::SUCCESS, core.WriteFile(fname.c_str(), PWSfile::V40));
+
+  // Added items are re-encrypted under the core's keyring
+  const CItemData &addedItem = core.GetEntry(core.Find(fullItem.GetUUID()));
+  ASSERT_TRUE(addedItem.GetKeyring() != nullptr);
+  EXPECT_TRUE(fullItem == addedItem);
+
+  core.ClearDBData();
+  EXPECT_EQ(PWSfile::SUCCESS, core.ReadFile(fname.c_str(), passkey, true));
+  ASSERT_EQ(2U, core.GetNumEntries());
+  ASSERT_EQ(1U, core.GetNumAtts());
+
+  // All entries read share a single keyring
+  const CItemData &readFullItem = core.GetEntry(core.Find(fullItem.GetUUID()));
+  const CItemData &readSmallItem = core.GetEntry(core.Find(smallItem.GetUUID()));
+  ASSERT_TRUE(readFullItem.GetKeyring() != nullptr);
+  EXPECT_EQ(readFullItem.GetKeyring(), readSmallItem.GetKeyring());
+  EXPECT_EQ(readFullItem.GetKeyring(), core.GetAtt(attItem.GetUUID()).GetKeyring());
+  EXPECT_TRUE(fullItem == readFullItem);
+  EXPECT_TRUE(smallItem == readSmallItem);
+  const CItemAtt &readAtt = core.GetAtt(attItem.GetUUID());
+  EXPECT_EQ(attItem.GetTitle(), readAtt.GetTitle());
+  ASSERT_EQ(attItem.GetContentLength(), readAtt.GetContentLength());
+  std::vector<unsigned char> c1(attItem.GetContentSize()), c2(readAtt.GetContentSize());
+  ASSERT_TRUE(attItem.GetContent(c1.data(), c1.size()));
+  ASSERT_TRUE(readAtt.GetContent(c2.data(), c2.size()));
+  EXPECT_TRUE(memcmp(c1.data(), c2.data(), attItem.GetContentLength()) == 0);
+
+  core.ClearCommands();
+  PWSprefs::GetInstance()->ResetPref(PWSprefs::UseSessionKeyring);
+}
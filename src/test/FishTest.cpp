@@ -0,0 +1,144 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// FishTest.cpp: Unit test for the ciphers' multi-block (ECB/CBC) interface
+
+#ifdef WIN32
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "core/crypto/AES.h"
+#include "core/crypto/BlowFish.h"
+#include "core/crypto/TwoFish.h"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+  // Single blocks from the cipher under test, runs of them from Fish's
+  // block at a time defaults, as the reference
+  class OneAtATime : public Fish
+  {
+  public:
+    explicit OneAtATime(const Fish &fish) : m_fish(fish) {}
+    unsigned int GetBlockSize() const override {return m_fish.GetBlockSize();}
+    void Encrypt(const unsigned char *in, unsigned char *out) const override {m_fish.Encrypt(in, out);}
+    void Decrypt(const unsigned char *in, unsigned char *out) const override {m_fish.Decrypt(in, out);}
+  private:
+    const Fish &m_fish;
+  };
+
+  const unsigned char key[32] = {
+    0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0,
+    0x85, 0x7d, 0x77, 0x81, 0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7,
+    0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4};
+  const unsigned char iv[16] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+}
+
+// For any number of blocks, in place or not, and in two goes,
+// each of fish's bulk calls must match the reference
+static void TestBulk(const Fish &fish, const char *name)
+{
+  const OneAtATime ref(fish);
+  const unsigned int BS = fish.GetBlockSize();
+  const size_t maxBlocks = 21;
+
+  std::vector<unsigned char> pt(maxBlocks * BS);
+  for (size_t i = 0; i < pt.size(); i++)
+    pt[i] = static_cast<unsigned char>(i * 31 + 7);
+
+  for (size_t n = 0; n <= maxBlocks; n++) {
+    for (int op = 0; op < 4; op++) {
+      std::vector<unsigned char> expected(n * BS), out(n * BS + 1, 0xee);
+      unsigned char refcbc[16], cbc[16];
+      memcpy(refcbc, iv, BS);
+      memcpy(cbc, iv, BS);
+      switch (op) {
+        case 0:
+          ref.EncryptBlocks(pt.data(), expected.data(), n);
+          fish.EncryptBlocks(pt.data(), out.data(), n);
+          break;
+        case 1:
+          ref.DecryptBlocks(pt.data(), expected.data(), n);
+          fish.DecryptBlocks(pt.data(), out.data(), n);
+          break;
+        case 2:
+          ref.EncryptCBC(pt.data(), expected.data(), n, refcbc);
+          fish.EncryptCBC(pt.data(), out.data(), n, cbc);
+          break;
+        case 3:
+          ref.DecryptCBC(pt.data(), expected.data(), n, refcbc);
+          fish.DecryptCBC(pt.data(), out.data(), n, cbc);
+          break;
+      }
+      EXPECT_TRUE(std::equal(expected.begin(), expected.end(), out.begin()))
+        << name << ", op " << op << ", " << n << " blocks";
+      EXPECT_EQ(0xee, out[n * BS]);
+      EXPECT_EQ(0, memcmp(refcbc, cbc, BS)) << name << ", op " << op << ", " << n << " blocks";
+
+      // in place, and in two goes
+      std::vector<unsigned char> buf(pt.begin(), pt.begin() + n * BS);
+      unsigned char *const mid = buf.data() + n / 2 * BS;
+      memcpy(cbc, iv, BS);
+      switch (op) {
+        case 0:
+          fish.EncryptBlocks(buf.data(), buf.data(), n / 2);
+          fish.EncryptBlocks(mid, mid, n - n / 2);
+          break;
+        case 1:
+          fish.DecryptBlocks(buf.data(), buf.data(), n / 2);
+          fish.DecryptBlocks(mid, mid, n - n / 2);
+          break;
+        case 2:
+          fish.EncryptCBC(buf.data(), buf.data(), n / 2, cbc);
+          fish.EncryptCBC(mid, mid, n - n / 2, cbc);
+          break;
+        case 3:
+          fish.DecryptCBC(buf.data(), buf.data(), n / 2, cbc);
+          fish.DecryptCBC(mid, mid, n - n / 2, cbc);
+          break;
+      }
+      EXPECT_TRUE(buf == expected) << name << ", op " << op << ", " << n << " blocks in place";
+      EXPECT_EQ(0, memcmp(refcbc, cbc, BS));
+    }
+  }
+
+  // and what's CBC-encrypted in bulk decrypts in bulk
+  std::vector<unsigned char> buf(pt);
+  unsigned char cbc[16];
+  memcpy(cbc, iv, BS);
+  fish.EncryptCBC(buf.data(), buf.data(), maxBlocks, cbc);
+  memcpy(cbc, iv, BS);
+  fish.DecryptCBC(buf.data(), buf.data(), maxBlocks, cbc);
+  EXPECT_TRUE(buf == pt) << name;
+}
+
+TEST(FishTest, TwoFish)
+{
+  for (int keylen = 16; keylen <= 32; keylen += 8)
+    TestBulk(TwoFish(key, keylen), "TwoFish");
+}
+
+TEST(FishTest, AES)
+{
+  for (int hw = 0; hw < 2; hw++) {
+    AES::Restrict impl(hw != 0);
+    for (int keylen = 16; keylen <= 32; keylen += 8)
+      TestBulk(AES(key, keylen), hw ? "AES instructions" : "AES tables");
+  }
+}
+
+TEST(FishTest, BlowFish)
+{
+  TestBulk(BlowFish(key, 20), "BlowFish");
+  TestBulk(BlowFish(key, sizeof(key)), "BlowFish");
+}
@@ -0,0 +1,137 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// GroupTreeTest.cpp: Unit test for GroupTree class
+
+#ifdef WIN32
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "core/GroupTree.h"
+#include "core/PWScore.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <map>
+
+namespace {
+  // Stands in for PWScore, which hands GetAllGroups() entries' groups
+  class Groups {
+  public:
+    pws_os::CUUID Add(GroupTree &tree, const StringX &group)
+    {
+      pws_os::CUUID uuid;
+      m_groups[uuid] = group;
+      tree.Add(group, uuid);
+      return uuid;
+    }
+    GroupTree::GroupOf Of() const
+    {
+      return [this](const pws_os::CUUID &uuid) {return m_groups.at(uuid);};
+    }
+  private:
+    std::map<pws_os::CUUID, StringX> m_groups;
+  };
+}
+
+TEST(GroupTreeTest, AddRemove)
+{
+  GroupTree tree;
+  Groups g;
+
+  const pws_os::CUUID u1 = g.Add(tree, L"a.b.c");
+  const pws_os::CUUID u2 = g.Add(tree, L"a.b");
+  g.Add(tree, L"x");
+  g.Add(tree, L""); // no group
+
+  EXPECT_EQ(4U, tree.NumEntries(L""));
+  EXPECT_EQ(2U, tree.NumEntries(L"a"));
+  EXPECT_EQ(2U, tree.NumEntries(L"a.b"));
+  EXPECT_EQ(1U, tree.NumEntries(L"a.b.c"));
+  EXPECT_FALSE(tree.HasGroup(L"a.c"));
+  EXPECT_FALSE(tree.HasGroup(L"b"));
+
+  std::set<stringT> groups;
+  tree.GetAllGroups(groups, g.Of());
+  const std::set<stringT> expected = {L"a", L"a.b", L"a.b.c", L"x"};
+  EXPECT_EQ(expected, groups);
+
+  UUIDVector v;
+  tree.GetEntries(L"a", v);
+  EXPECT_EQ(2U, v.size());
+  EXPECT_NE(v.end(), std::find(v.begin(), v.end(), u1));
+  EXPECT_NE(v.end(), std::find(v.begin(), v.end(), u2));
+
+  // Removing the last entry below a group removes the group
+  tree.Remove(L"a.b.c", u1);
+  EXPECT_FALSE(tree.HasGroup(L"a.b.c"));
+  EXPECT_TRUE(tree.HasGroup(L"a.b"));
+  tree.Remove(L"a.b", u2);
+  EXPECT_FALSE(tree.HasGroup(L"a"));
+  EXPECT_EQ(2U, tree.NumEntries(L""));
+
+  tree.Clear();
+  EXPECT_EQ(0U, tree.NumEntries(L""));
+}
+
+TEST(GroupTreeTest, Dots)
+{
+  // Same prefixes as PWScore::GetAllGroups() always produced
+  GroupTree tree;
+  Groups g;
+
+  g.Add(tree, L"a..b");
+  g.Add(tree, L".c");
+
+  std::set<stringT> groups;
+  tree.GetAllGroups(groups, g.Of());
+  const std::set<stringT> expected = {L"a", L"a.", L"a..b", L"", L".c"};
+  EXPECT_EQ(expected, groups);
+  EXPECT_EQ(1U, tree.NumEntries(L"a."));
+}
+
+TEST(GroupTreeTest, SameNames)
+{
+  // Nodes are keyed by their parent as well as their name
+  GroupTree tree;
+  Groups g;
+
+  g.Add(tree, L"a.x");
+  g.Add(tree, L"b.x.y");
+  g.Add(tree, L"x");
+
+  EXPECT_EQ(1U, tree.NumEntries(L"a.x"));
+  EXPECT_EQ(1U, tree.NumEntries(L"b.x"));
+  EXPECT_EQ(1U, tree.NumEntries(L"x"));
+  EXPECT_FALSE(tree.HasGroup(L"x.y"));
+
+  std::set<stringT> groups;
+  tree.GetAllGroups(groups, g.Of());
+  const std::set<stringT> expected = {L"a", L"a.x", L"b", L"b.x", L"b.x.y", L"x"};
+  EXPECT_EQ(expected, groups);
+}
+
+TEST(GroupTreeTest, ClearedWithDatabase)
+{
+  // Locking clears the database, and with it the group names
+  PWScore core;
+  CItemData ci;
+  ci.CreateUUID();
+  ci.SetGroup(L"a.b");
+  ci.SetTitle(L"title");
+  ci.SetPassword(L"password");
+  core.Execute(AddEntryCommand::Create(&core, ci));
+
+  std::vector<stringT> groups;
+  core.GetAllGroups(groups, false);
+  EXPECT_EQ(2U, groups.size());
+
+  core.ClearDBData();
+  groups.clear();
+  core.GetAllGroups(groups, false);
+  EXPECT_TRUE(groups.empty());
+}
@@ -12,6 +12,7 @@
 #endif
 
 #include "core/ItemAtt.h"
+#include "core/ItemKeyring.h"
 #include "core/PWScore.h"
 #include "os/file.h"
 #include "os/dir.h"
@@ -19,6 +20,7 @@
 
 #include "gtest/gtest.h"
 
+#include <memory>
 #include <vector>
 
 using namespace std;
@@ -30,6 +32,8 @@ protected:
   ItemAttTest(); // to init members
   void SetUp();
 
+  static vector<unsigned char> MakeContent(size_t len);
+
   // members used to populate and test fullItem:
   const StringX title, mediaType;
   stringT fullfileName, fileName, filePath;
@@ -54,6 +58,14 @@ void ItemAttTest::SetUp()
     }
 }
 
+vector<unsigned char> ItemAttTest::MakeContent(size_t len)
+{
+  vector<unsigned char> v(len);
+  for (size_t i = 0; i < len; i++)
+    v[i] = static_cast<unsigned char>((i * 31) ^ (i >> 8));
+  return v;
+}
+
 // And now the tests...
 
 TEST_F(ItemAttTest, EmptyItems)
@@ -180,3 +192,84 @@ TEST_F(ItemAttTest, Getters_n_Setters)
 
   delete[] contentVal;
 }
+
+TEST_F(ItemAttTest, ContentPieces)
+{
+  const size_t CHUNK = CItemAtt::CONTENT_CHUNK;
+  const vector<unsigned char> content = MakeContent(2 * CHUNK + 123);
+
+  CItemAtt ai1, ai2;
+  ai1.SetContent(content.data(), content.size());
+  ASSERT_EQ(content.size(), ai1.GetContentLength());
+
+  // Same content, appended in uneven bits
+  const size_t bits[] = {1, 7, CHUNK - 9, CHUNK, 2, 122};
+  size_t offset = 0;
+  for (auto n : bits) {
+    ai2.AppendContent(content.data() + offset, n);
+    offset += n;
+  }
+  ASSERT_EQ(content.size(), offset);
+  EXPECT_TRUE(ai1 == ai2);
+
+  // Read back at, around and across piece boundaries
+  vector<unsigned char> buf(CHUNK + 100);
+  const size_t offsets[] = {0, 5, CHUNK - 1, CHUNK, CHUNK + 50, 2 * CHUNK + 100};
+  for (auto off : offsets) {
+    const size_t expected = min(buf.size(), content.size() - off);
+    ASSERT_EQ(expected, ai1.ReadContent(off, buf.data(), buf.size()));
+    EXPECT_EQ(0, memcmp(content.data() + off, buf.data(), expected)) << off;
+  }
+  EXPECT_EQ(0U, ai1.ReadContent(content.size(), buf.data(), buf.size()));
+
+  vector<unsigned char> all(ai1.GetContentSize());
+  ASSERT_TRUE(ai1.GetContent(all.data(), all.size()));
+  EXPECT_EQ(0, memcmp(content.data(), all.data(), content.size()));
+
+  // Rekeying rekeys the content too
+  ai2.SetKeyring(make_shared<CItemKeyring>());
+  EXPECT_TRUE(ai1 == ai2);
+  ai2.SetKeyring(nullptr);
+  EXPECT_TRUE(ai1 == ai2);
+
+  // A difference in the last piece is noticed
+  ai2.SetContent(content.data(), content.size() - 1);
+  ai2.AppendContent(content.data(), 1);
+  EXPECT_FALSE(ai1 == ai2);
+
+  ai1.ClearContent();
+  EXPECT_FALSE(ai1.HasContent());
+  EXPECT_EQ(0U, ai1.GetContentLength());
+}
+
+TEST_F(ItemAttTest, ImpExpLarge)
+{
+  const stringT testImpFile(L"input.tmp");
+  const stringT testExpFile(L"output.tmp");
+  const vector<unsigned char> content = MakeContent(3 * CItemAtt::CONTENT_CHUNK + 5);
+
+  FILE *f = pws_os::FOpen(testImpFile, L"wb");
+  ASSERT_TRUE(f != nullptr);
+  ASSERT_EQ(1U, fwrite(content.data(), content.size(), 1, f));
+  fclose(f);
+
+  CItemAtt ai;
+  EXPECT_EQ(PWScore::SUCCESS, ai.Import(testImpFile));
+  EXPECT_EQ(content.size(), ai.GetContentLength());
+
+  // A failed import leaves the content as it was
+  EXPECT_EQ(PWScore::CANT_OPEN_FILE, ai.Import(L"nosuchfile"));
+  EXPECT_EQ(content.size(), ai.GetContentLength());
+
+  EXPECT_EQ(PWScore::SUCCESS, ai.Export(testExpFile));
+  f = pws_os::FOpen(testExpFile, L"rb");
+  ASSERT_TRUE(f != nullptr);
+  vector<unsigned char> exported(static_cast<size_t>(pws_os::fileLength(f)));
+  ASSERT_EQ(content.size(), exported.size());
+  ASSERT_EQ(1U, fread(exported.data(), exported.size(), 1, f));
+  fclose(f);
+  EXPECT_TRUE(content == exported);
+
+  pws_os::DeleteAFile(testImpFile);
+  pws_os::DeleteAFile(testExpFile);
+}
@@ -12,10 +12,14 @@
 #endif
 
 #include "core/ItemData.h"
+#include "core/ItemKeyring.h"
 #include "core/PWSprefs.h"
 #include "core/PWHistory.h"
 #include "gtest/gtest.h"
 
+#include <type_traits>
+#include <utility>
+
 // A fixture for factoring common code across tests
 class ItemDataTest : public ::testing::Test
 {
@@ -108,6 +112,29 @@ TEST_F(ItemDataTest, Assignment)
   EXPECT_TRUE(d1 == d2);  
 }
 
+TEST_F(ItemDataTest, Move)
+{
+  static_assert(std::is_nothrow_move_constructible<CItemData>::value &&
+                std::is_nothrow_move_assignable<CItemData>::value,
+                "containers should move, not copy, CItemData");
+
+  CItemData d1;
+  d1.SetTitle(_T("title"));
+  d1.SetPassword(_T("password!"));
+  d1.SetStatus(CItemData::ES_MODIFIED);
+  const CItemData copy(d1);
+
+  CItemData d2(std::move(d1));
+  EXPECT_TRUE(copy == d2);
+  EXPECT_EQ(_T("password!"), d2.GetPassword());
+
+  CItemData d3;
+  d3.SetTitle(_T("eltit"));
+  d3 = std::move(d2);
+  EXPECT_TRUE(copy == d3);
+  EXPECT_EQ(_T("title"), d3.GetTitle());
+}
+
 TEST_F(ItemDataTest, Getters_n_Setters)
 {
   // Setters called in SetUp()
@@ -295,3 +322,30 @@ TEST_F(ItemDataTest, UnknownFields)
   // how they're processed. Worth exposing an API
   // just for testing, TBD.
 }
+
+TEST_F(ItemDataTest, Keyring)
+{
+  auto keyring = std::make_shared<const CItemKeyring>();
+  CItemData di(fullItem);
+
+  di.SetKeyring(keyring); // re-encrypts existing fields
+  EXPECT_EQ(keyring, di.GetKeyring());
+  EXPECT_TRUE(fullItem == di);
+  EXPECT_EQ(title, di.GetTitle());
+  EXPECT_EQ(notes, di.GetNotes());
+  di.GetXTime(tVal);
+  EXPECT_EQ(xTime, tVal);
+
+  // copies share the keyring
+  CItemData di2(di);
+  EXPECT_EQ(keyring, di2.GetKeyring());
+  di2.SetPassword(L"new password");
+  EXPECT_EQ(L"new password", di2.GetPassword());
+  EXPECT_FALSE(di == di2);
+
+  // and back again
+  di2.SetKeyring(nullptr);
+  EXPECT_EQ(L"new password", di2.GetPassword());
+  di2.SetPassword(password);
+  EXPECT_TRUE(di == di2);
+}
@@ -11,6 +11,7 @@
 #endif
 
 #include "core/ItemField.h"
+#include "core/ItemKeyring.h"
 #include "core/crypto/BlowFish.h"
 #include "crypto/sha1.h"
 #include "gtest/gtest.h"
@@ -78,3 +79,53 @@ TEST_F(ItemFieldTest, testMe)
   EXPECT_EQ(sizeof(v1), lenV2);
   EXPECT_TRUE(memcmp(v1, v2, sizeof(v1)) == 0);
 }
+
+TEST_F(ItemFieldTest, keyring)
+{
+  const unsigned char v1[20] = {0xa0, 0xa1, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+                                0xa8, 0xa9, 0xaa, 0xab, 0xac, 0xad, 0xae, 0xaf,
+                                0xb0, 0xb1, 0xb2, 0xb3};
+  unsigned char v2[24] = {0};
+  size_t lenV2 = sizeof(v2);
+  CItemKeyring kr;
+
+  CItemField i1(1), i2(2);
+  i1.Set(v1, sizeof(v1), &kr);
+  i2.Set(v1, sizeof(v1), &kr);
+  i1.Get(v2, lenV2, &kr);
+  EXPECT_EQ(sizeof(v1), lenV2);
+  EXPECT_TRUE(memcmp(v1, v2, sizeof(v1)) == 0);
+
+  // copies share the nonce, so decrypt with the same keyring
+  CItemField i3(i2);
+  lenV2 = sizeof(v2);
+  i3.Get(v2, lenV2, &kr);
+  EXPECT_EQ(sizeof(v1), lenV2);
+  EXPECT_TRUE(memcmp(v1, v2, sizeof(v1)) == 0);
+
+  const StringX sx(L"a string that spans more than one block");
+  StringX sx2;
+  i1.Set(sx, &kr);
+  i1.Get(sx2, &kr);
+  EXPECT_EQ(sx, sx2);
+}
+
+// Non-empty strings of any length, decrypted whole blocks at a time,
+// are appended without their padding
+TEST_F(ItemFieldTest, strings)
+{
+  CItemKeyring kr;
+  StringX sx(L"a");
+  for (size_t len = 1; len <= 100; len++) {
+    CItemField i1(1), i2(2);
+    i1.Set(sx, m_bf);
+    i2.Set(sx, &kr);
+
+    StringX sx1(L"prefix"), sx2(L"prefix");
+    i1.Get(sx1, m_bf);
+    i2.Get(sx2, &kr);
+    EXPECT_EQ(L"prefix" + sx, sx1) << len;
+    EXPECT_EQ(L"prefix" + sx, sx2) << len;
+    sx += static_cast<wchar_t>(L'a' + len % 26);
+  }
+}
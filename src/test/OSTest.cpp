@@ -9,6 +9,8 @@
 
 #include "os/media.h"
 #include "os/dir.h"
+#include "os/UUID.h"
+#include "core/StringXStream.h"
 #include "gtest/gtest.h"
 
 TEST(OSTest, testMedia)
@@ -44,4 +46,33 @@ TEST(OSTest, testPath)
 
   out_path = pws_os::makepath(in_drive, in_dir, in_file, in_ext);
   EXPECT_EQ(in_path, out_path);
-}
\ No newline at end of file
+}
+TEST(OSTest, testUUID)
+{
+  const uuid_array_t ua = {0x20, 0x40, 0x12, 0xe6, 0x60, 0x0f, 0x4e, 0x01,
+                           0xa5, 0xeb, 0x51, 0x52, 0x67, 0xcb, 0x0d, 0x50};
+  const pws_os::CUUID uuid(ua);
+
+  uuid_array_t out;
+  uuid.GetARep(out);
+  EXPECT_EQ(0, memcmp(ua, out, sizeof(ua)));
+
+  const StringX sx = uuid;
+  EXPECT_EQ(StringX(_T("204012e6600f4e01a5eb515267cb0d50")), sx);
+  EXPECT_EQ(uuid, pws_os::CUUID(sx));
+
+  oStringXStream os;
+  os << std::uppercase << uuid.Canonic();
+  EXPECT_EQ(StringX(_T("204012E6-600F-4E01-A5EB-515267CB0D50")), os.str());
+
+  // Ordering is bytewise on the array representation
+  uuid_array_t ua2;
+  memcpy(ua2, ua, sizeof(ua));
+  ua2[15]++;
+  EXPECT_TRUE(uuid < pws_os::CUUID(ua2));
+  ua2[15]--; ua2[0] = 0x1f;
+  EXPECT_TRUE(pws_os::CUUID(ua2) < uuid);
+
+  EXPECT_NE(pws_os::CUUID(), pws_os::CUUID());
+  EXPECT_EQ(pws_os::CUUID::NullUUID(), pws_os::CUUID(0, 0));
+}
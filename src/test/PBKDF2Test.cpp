@@ -0,0 +1,116 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// PBKDF2Test.cpp: Unit test for PBKDF2 with HMAC-SHA256,
+// generic and several-salts-at-once
+
+#ifdef WIN32
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "core/crypto/hmac.h"
+#include "core/crypto/pbkdf2.h"
+#include "core/crypto/sha256.h"
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <vector>
+
+namespace {
+  void Generic(const unsigned char *pw, unsigned long pwlen,
+               const unsigned char *salt, unsigned long saltlen,
+               int count, unsigned char out[SHA256::HASHLEN])
+  {
+    HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> hmac;
+    unsigned long outlen = SHA256::HASHLEN;
+    pbkdf2(pw, pwlen, salt, saltlen, count, &hmac, out, &outlen);
+    EXPECT_EQ(32UL, outlen);
+  }
+
+  // Runs test with each implementation of SHA256::HashDigests() this
+  // machine has: SHA instructions, AVX2 lanes, portable
+  template<class F> void ForEachImpl(F test)
+  {
+    const bool settings[3][2] = {{true, true}, {false, true}, {false, false}};
+    for (const auto &s : settings) {
+      SHA256::Restrict impl(s[0], s[1]);
+      test(s[0], s[1]);
+    }
+  }
+}
+
+// Test vectors for PBKDF2-HMAC-SHA256, as widely published
+TEST(PBKDF2Test, sha256_vectors)
+{
+  static const struct {
+    int count;
+    unsigned char dk[32];
+  } tests[] = {
+    {1, {0x12, 0x0f, 0xb6, 0xcf, 0xfc, 0xf8, 0xb3, 0x2c, 0x43, 0xe7, 0x22, 0x52,
+         0x56, 0xc4, 0xf8, 0x37, 0xa8, 0x65, 0x48, 0xc9, 0x2c, 0xcc, 0x35, 0x48,
+         0x08, 0x05, 0x98, 0x7c, 0xb7, 0x0b, 0xe1, 0x7b}},
+    {2, {0xae, 0x4d, 0x0c, 0x95, 0xaf, 0x6b, 0x46, 0xd3, 0x2d, 0x0a, 0xdf, 0xf9,
+         0x28, 0xf0, 0x6d, 0xd0, 0x2a, 0x30, 0x3f, 0x8e, 0xf3, 0xc2, 0x51, 0xdf,
+         0xd6, 0xe2, 0xd8, 0x5a, 0x95, 0x47, 0x4c, 0x43}},
+    {4096, {0xc5, 0xe4, 0x78, 0xd5, 0x92, 0x88, 0xc8, 0x41, 0xaa, 0x53, 0x0d, 0xb6,
+            0x84, 0x5c, 0x4c, 0x8d, 0x96, 0x28, 0x93, 0xa0, 0x01, 0xce, 0x4e, 0x11,
+            0xa4, 0x96, 0x38, 0x73, 0xaa, 0x98, 0x13, 0x4a}},
+  };
+  const unsigned char *pw = reinterpret_cast<const unsigned char *>("password");
+  const unsigned char *salt = reinterpret_cast<const unsigned char *>("salt");
+
+  for (const auto &t : tests) {
+    unsigned char dk[32];
+    Generic(pw, 8, salt, 4, t.count, dk);
+    EXPECT_EQ(0, memcmp(dk, t.dk, 32)) << "generic, count " << t.count;
+
+    ForEachImpl([&](bool hw, bool simd) {
+      const unsigned int count = t.count;
+      pbkdf2_sha256(pw, 8, &salt, 4, &count, 1, &dk);
+      EXPECT_EQ(0, memcmp(dk, t.dk, 32)) << "count " << t.count << ", hw "
+        << hw << ", simd " << simd;
+    });
+  }
+}
+
+// Many salts at once, with differing counts, must each give what
+// they would on their own
+TEST(PBKDF2Test, sha256_many)
+{
+  const size_t N = 19; // more than a lane's worth, and not a multiple
+  std::vector<unsigned char> saltbuf(N * 32);
+  std::vector<const unsigned char *> salts(N);
+  std::vector<unsigned int> counts(N);
+  for (size_t i = 0; i < N; i++) {
+    for (size_t j = 0; j < 32; j++)
+      saltbuf[i * 32 + j] = static_cast<unsigned char>(i * 17 + j);
+    salts[i] = &saltbuf[i * 32];
+    counts[i] = 100 + static_cast<unsigned int>((i * 7) % 5); // some the same
+  }
+
+  for (const char *password : {"short", // and one that's longer than a block:
+      "a passphrase longer than a SHA-256 block, so that HMAC hashes it first"}) {
+    const unsigned char *pw = reinterpret_cast<const unsigned char *>(password);
+    const unsigned long pwlen = static_cast<unsigned long>(strlen(password));
+
+    std::vector<unsigned char> expected(N * 32);
+    for (size_t i = 0; i < N; i++)
+      Generic(pw, pwlen, salts[i], 32, counts[i], &expected[i * 32]);
+
+    ForEachImpl([&](bool hw, bool simd) {
+      for (size_t n : {size_t(1), size_t(2), size_t(8), N}) {
+        std::vector<unsigned char> dk(n * 32);
+        pbkdf2_sha256(pw, pwlen, salts.data(), 32, counts.data(), n,
+                      reinterpret_cast<unsigned char (*)[32]>(dk.data()));
+        for (size_t i = 0; i < n; i++)
+          EXPECT_EQ(0, memcmp(&dk[i * 32], &expected[i * 32], 32))
+            << "salt " << i << " of " << n << ", hw " << hw
+            << ", simd " << simd;
+      }
+    });
+  }
+}
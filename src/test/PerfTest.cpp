@@ -0,0 +1,1053 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// PerfTest.cpp: Benchmarks for core operations on large databases.
+//
+// These take a while, and their results are timings rather than pass/fail,
+// so they're disabled by default. Run them with:
+//   coretest --gtest_also_run_disabled_tests --gtest_filter='PerfTest.*'
+
+#ifdef WIN32
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "core/PWScore.h"
+#include "core/DisplayFieldCache.h"
+#include "core/ItemAtt.h"
+#include "core/ItemKeyring.h"
+#include "core/PWSfileV3.h"
+#include "core/PWSfileV4.h"
+#include "core/PWSprefs.h"
+#include "core/SecurePool.h"
+#include "core/core.h"
+#include "core/crypto/AES.h"
+#include "core/crypto/BlowFish.h"
+#include "core/crypto/TwoFish.h"
+#include "core/crypto/hmac.h"
+#include "core/crypto/pbkdf2.h"
+#include "core/crypto/sha256.h"
+
+#include "os/file.h"
+
+#include "gtest/gtest.h"
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Heap allocations made through operator new, counted by coretest.cpp
+// while nAllocCounters != 0
+extern std::atomic<int> nAllocCounters;
+extern std::atomic<size_t> nAllocs;
+
+namespace {
+  class AllocationCounter
+  {
+  public:
+    AllocationCounter() : m_start(nAllocs) {nAllocCounters++;}
+    ~AllocationCounter() {nAllocCounters--;}
+    size_t Count() const {return nAllocs - m_start;}
+  private:
+    const size_t m_start;
+  };
+}
+
+class PerfTest : public ::testing::Test
+{
+protected:
+  PerfTest() : passkey(L"perf-passkey"), fname(L"perftest.psafe3") {}
+  void TearDown();
+
+  // Writes a V3 database with n synthetic entries,
+  // every aliasEvery'th of which (if non-zero) is an alias of the previous one
+  void MakeDB(size_t n, size_t aliasEvery = 0);
+  static CItemData MakeEntry(size_t i,
+                             const std::shared_ptr<const CItemKeyring> &keyring = nullptr);
+
+  // Milliseconds since start
+  typedef std::chrono::steady_clock Clock;
+  static double Elapsed(const Clock::time_point &start)
+  {return std::chrono::duration<double, std::milli>(Clock::now() - start).count();}
+
+  // Resident set size in KB, 0 if unknown on this platform
+  static long RSS();
+  static long PeakRSS(); // high-water mark, KB
+
+  // CPU timestamp counter, for cycles per byte, 0 if there isn't one.
+  // It ticks at the CPU's nominal frequency, whatever the current one.
+  static unsigned long long Cycles();
+
+  // Results, as "[ PERF     ] what, ..." lines. kb, if given, is memory
+  // used (RSS, or peak RSS, growth); cycles, if non-zero, a Cycles() delta.
+  static void Report(const std::string &what, size_t n, double ms, long kb = -1);
+  static void ReportMB(const std::string &what, double mb, double ms,
+                       unsigned long long cycles = 0, long kb = -1);
+  static void Report(const std::string &what, double ms);
+  static void Note(const std::string &what); // anything else worth showing
+
+  const StringX passkey;
+  const stringT fname;
+};
+
+void PerfTest::TearDown()
+{
+  pws_os::DeleteAFile(fname);
+}
+
+CItemData PerfTest::MakeEntry(size_t i, const std::shared_ptr<const CItemKeyring> &keyring)
+{
+  CItemData ci;
+  stringT s = std::to_wstring(i);
+
+  ci.SetKeyring(keyring);
+  ci.CreateUUID();
+  ci.SetGroup((L"Group" + std::to_wstring(i % 100) + L".Sub" + std::to_wstring(i % 7)).c_str());
+  ci.SetTitle((L"Title " + s).c_str());
+  ci.SetUser((L"user" + s + L"@example.com").c_str());
+  ci.SetPassword((L"p4ssw0rd-" + s).c_str());
+  ci.SetURL((L"https://www.example.com/login/" + s).c_str());
+  ci.SetNotes(L"Some notes, long enough to need several cipher blocks.");
+  ci.SetCTime(1409901293);
+  ci.SetPMTime(1409901295);
+  ci.SetRMTime(1409901296);
+  return ci;
+}
+
+void PerfTest::MakeDB(size_t n, size_t aliasEvery)
+{
+  PWSfileV3 fw(fname.c_str(), PWSfile::Write, PWSfile::V30);
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passkey));
+  pws_os::CUUID prev;
+  for (size_t i = 0; i < n; i++) {
+    CItemData ci = MakeEntry(i);
+    if (aliasEvery != 0 && i % aliasEvery == 0 && i > 0) // as written by PWScore::WriteFile
+      ci.SetPassword(StringX(L"[[") + StringX(prev) + StringX(L"]]"));
+    prev = ci.GetUUID();
+    ASSERT_EQ(PWSfile::SUCCESS, fw.WriteRecord(ci));
+  }
+  ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+}
+
+long PerfTest::RSS()
+{
+#ifdef __linux__
+  long pages = 0, resident = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f != nullptr) {
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+      resident = 0;
+    fclose(f);
+  }
+  return resident * 4; // assumes 4KB pages
+#else
+  return 0;
+#endif
+}
+
+long PerfTest::PeakRSS()
+{
+#ifdef __linux__
+  struct rusage ru;
+  return getrusage(RUSAGE_SELF, &ru) == 0 ? ru.ru_maxrss : 0;
+#else
+  return 0;
+#endif
+}
+
+unsigned long long PerfTest::Cycles()
+{
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+void PerfTest::Report(const std::string &what, size_t n, double ms, long kb)
+{
+  std::cout << "[ PERF     ] " << what << ", " << n << " entries: "
+            << ms << " ms";
+  if (kb >= 0)
+    std::cout << ", " << kb << " KB";
+  std::cout << std::endl;
+}
+
+void PerfTest::ReportMB(const std::string &what, double mb, double ms,
+                        unsigned long long cycles, long kb)
+{
+  std::cout << "[ PERF     ] " << what << ", " << mb << " MB: " << ms << " ms, "
+            << mb * 1000 / ms << " MB/s";
+  if (cycles != 0)
+    std::cout << ", " << double(cycles) / (mb * 1024 * 1024) << " cycles/byte";
+  if (kb >= 0)
+    std::cout << ", " << kb << " KB";
+  std::cout << std::endl;
+}
+
+void PerfTest::Report(const std::string &what, double ms)
+{
+  std::cout << "[ PERF     ] " << what << ": " << ms << " ms" << std::endl;
+}
+
+void PerfTest::Note(const std::string &what)
+{
+  std::cout << "[ PERF     ] " << what << std::endl;
+}
+
+TEST_F(PerfTest, DISABLED_OpenKeyring)
+{
+  const size_t N = 100000;
+  MakeDB(N);
+
+  for (bool useKeyring : {false, true}) {
+    PWSprefs::GetInstance()->SetPref(PWSprefs::UseSessionKeyring, useKeyring);
+    const char *mode = useKeyring ? "session keyring" : "per-item BlowFish";
+    {
+      PWScore core;
+      const long rss0 = RSS();
+
+      auto start = Clock::now();
+      ASSERT_EQ(PWSfile::SUCCESS, core.ReadFile(fname.c_str(), passkey));
+      Report(std::string("ReadFile, ") + mode, N, Elapsed(start), RSS() - rss0);
+
+      // Touch every entry, as sorting or searching would
+      start = Clock::now();
+      size_t total = 0;
+      for (auto iter = core.GetEntryIter(); iter != core.GetEntryEndIter(); iter++)
+        total += core.GetEntry(iter).GetTitle().length();
+      EXPECT_NE(0U, total);
+      Report(std::string("GetTitle on all, ") + mode, N, Elapsed(start), RSS() - rss0);
+    }
+  }
+  PWSprefs::GetInstance()->ResetPref(PWSprefs::UseSessionKeyring);
+}
+
+TEST_F(PerfTest, DISABLED_FieldAccess)
+{
+  const size_t N = 100000;
+  // Shared keyring, so as to time field storage rather than key setup
+  const auto keyring = std::make_shared<CItemKeyring>();
+  std::vector<CItemData> entries;
+  entries.reserve(N);
+  auto start = Clock::now();
+  for (size_t i = 0; i < N; i++)
+    entries.push_back(MakeEntry(i, keyring));
+  Report("Create", N, Elapsed(start));
+
+  start = Clock::now();
+  size_t n = 0;
+  for (const auto &ci : entries) {
+    n += ci.IsPasswordSet() ? 1 : 0;
+    n += ci.IsEmailSet() ? 1 : 0; // not set
+    n += ci.IsNotesSet() ? 1 : 0;
+  }
+  EXPECT_EQ(2 * N, n);
+  Report("IsFieldSet x3", N, Elapsed(start));
+
+  start = Clock::now();
+  size_t total = 0;
+  for (const auto &ci : entries)
+    total += ci.GetUser().length();
+  EXPECT_NE(0U, total);
+  Report("GetUser", N, Elapsed(start));
+
+  start = Clock::now();
+  for (auto &ci : entries)
+    ci.SetEmail(L"someone@example.com");
+  Report("SetEmail", N, Elapsed(start));
+
+  start = Clock::now();
+  total = 0;
+  for (const auto &ci : entries)
+    total += ci.GetSize();
+  EXPECT_NE(0U, total);
+  Report("GetSize", N, Elapsed(start));
+
+  const std::vector<CItemData> copies(entries);
+  start = Clock::now();
+  n = 0;
+  for (size_t i = 0; i < N; i++)
+    n += (entries[i] == copies[i]) ? 1 : 0;
+  EXPECT_EQ(N, n);
+  Report("operator==", N, Elapsed(start));
+}
+
+TEST_F(PerfTest, DISABLED_FieldCrypt)
+{
+  // Just a field's own encryption, for a notes-sized value and a short one
+  const size_t N = 200000;
+  const unsigned char key[32] = {0};
+  const BlowFish bf(key, sizeof(key));
+  CItemKeyring kr;
+
+  for (size_t len : {20, 400}) {
+    const StringX value(len, L'x');
+    CItemField field(CItemData::NOTES);
+    StringX out;
+    const std::string what = std::to_string(len) + " chars";
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < N; i++)
+      field.Set(value, &bf);
+    Report("Set, BlowFish, " + what, N, Elapsed(start));
+    start = Clock::now();
+    for (size_t i = 0; i < N; i++) {
+      out.clear();
+      field.Get(out, &bf);
+    }
+    Report("Get, BlowFish, " + what, N, Elapsed(start));
+    EXPECT_EQ(value, out);
+
+    start = Clock::now();
+    for (size_t i = 0; i < N; i++)
+      field.Set(value, &kr);
+    Report("Set, keyring, " + what, N, Elapsed(start));
+    start = Clock::now();
+    for (size_t i = 0; i < N; i++) {
+      out.clear();
+      field.Get(out, &kr);
+    }
+    Report("Get, keyring, " + what, N, Elapsed(start));
+    EXPECT_EQ(value, out);
+  }
+}
+
+// Time looking up each of keys in m (in the order given)
+template<class M> static size_t LookupAll(const M &m, const UUIDVector &keys)
+{
+  size_t found = 0;
+  for (const auto &uuid : keys)
+    found += (m.find(uuid) != m.end()) ? 1 : 0;
+  return found;
+}
+
+TEST_F(PerfTest, DISABLED_FindByUUID)
+{
+  std::mt19937 rng(42);
+  for (size_t N : {10000, 100000, 1000000}) {
+    UUIDVector keys(N);
+    for (auto &uuid : keys)
+      uuid = pws_os::CUUID();
+    UUIDVector shuffled(keys);
+    std::shuffle(shuffled.begin(), shuffled.end(), rng);
+
+    // ItemList vs. the std::map it used to be
+    {
+      std::map<pws_os::CUUID, CItemData> m;
+      for (const auto &uuid : keys)
+        m.emplace(uuid, CItemData());
+      auto start = Clock::now();
+      EXPECT_EQ(N, LookupAll(m, shuffled));
+      Report("std::map find", N, Elapsed(start));
+    }
+    {
+      ItemList m;
+      for (const auto &uuid : keys)
+        m.emplace(uuid, CItemData());
+      auto start = Clock::now();
+      EXPECT_EQ(N, LookupAll(m, shuffled));
+      Report("ItemList find", N, Elapsed(start));
+    }
+  }
+
+  // Through PWScore, with 10% aliases for ParseDependants() to resolve
+  PWSprefs::GetInstance()->SetPref(PWSprefs::UseSessionKeyring, true);
+  for (size_t N : {10000, 100000}) {
+    MakeDB(N, 10);
+    PWScore core;
+    auto start = Clock::now();
+    ASSERT_EQ(PWSfile::SUCCESS, core.ReadFile(fname.c_str(), passkey));
+    Report("ReadFile incl. ParseDependants", N, Elapsed(start));
+
+    UUIDVector uuids;
+    size_t aliases = 0;
+    for (auto iter = core.GetEntryIter(); iter != core.GetEntryEndIter(); iter++) {
+      uuids.push_back(iter->first);
+      aliases += iter->second.IsAlias() ? 1 : 0;
+    }
+    EXPECT_EQ(N / 10 - 1, aliases);
+    std::shuffle(uuids.begin(), uuids.end(), rng);
+    start = Clock::now();
+    size_t found = 0;
+    for (const auto &uuid : uuids)
+      found += (core.Find(uuid) != core.GetEntryEndIter()) ? 1 : 0;
+    Report("PWScore::Find(uuid)", N, Elapsed(start));
+    EXPECT_EQ(N, found);
+  }
+  PWSprefs::GetInstance()->ResetPref(PWSprefs::UseSessionKeyring);
+}
+
+TEST_F(PerfTest, DISABLED_FindByGTU)
+{
+  const size_t N = 100000, M = 1000;
+  MakeDB(N);
+  PWSprefs::GetInstance()->SetPref(PWSprefs::UseSessionKeyring, true);
+  PWScore core;
+  ASSERT_EQ(PWSfile::SUCCESS, core.ReadFile(fname.c_str(), passkey));
+
+  std::vector<st_GroupTitleUser> gtus;
+  for (size_t i = 0; i < N; i += N / M) {
+    const CItemData ci = MakeEntry(i);
+    gtus.push_back(st_GroupTitleUser(ci.GetGroup(), ci.GetTitle(), ci.GetUser()));
+  }
+
+  auto start = Clock::now();
+  size_t found = 0;
+  for (const auto &gtu : gtus)
+    found += (core.Find(gtu.group, gtu.title, gtu.user) != core.GetEntryEndIter()) ? 1 : 0;
+  EXPECT_EQ(M, found);
+  Report("Find(group, title, user) x1000", N, Elapsed(start));
+
+  // As done when importing M entries
+  start = Clock::now();
+  GTUSet setGTU;
+  size_t renamed = 0;
+  for (const auto &gtu : gtus) {
+    StringX title(gtu.title);
+    renamed += core.MakeEntryUnique(setGTU, gtu.group, title, gtu.user, IDSC_IMPORTNUMBER) ? 0 : 1;
+  }
+  EXPECT_EQ(M, renamed);
+  Report("MakeEntryUnique x1000", N, Elapsed(start));
+
+  PWSprefs::GetInstance()->ResetPref(PWSprefs::UseSessionKeyring);
+}
+
+TEST_F(PerfTest, DISABLED_ReadFileAllocs)
+{
+  const size_t N = 50000;
+  MakeDB(N);
+
+  PWScore core;
+  const AllocationCounter allocs;
+  auto start = Clock::now();
+  ASSERT_EQ(PWSfile::SUCCESS, core.ReadFile(fname.c_str(), passkey));
+  const double ms = Elapsed(start);
+  const size_t n = allocs.Count();
+  ASSERT_EQ(N, core.GetNumEntries());
+
+  Report("ReadFile", N, ms);
+  Note("ReadFile: " + std::to_string(n) + " allocations, " +
+       std::to_string(double(n) / N) + " per entry");
+}
+
+TEST_F(PerfTest, DISABLED_StringAlloc)
+{
+  const size_t N = 100000;
+  const auto keyring = std::make_shared<CItemKeyring>();
+  std::vector<CItemData> entries;
+  entries.reserve(N);
+  for (size_t i = 0; i < N; i++)
+    entries.push_back(MakeEntry(i, keyring));
+  std::shuffle(entries.begin(), entries.end(), std::mt19937(42));
+
+  std::vector<StringX> titles;
+  for (const auto &ci : entries)
+    titles.push_back(ci.GetTitle());
+
+  const SecurePool::Stats before = SecurePool::GetStats();
+
+  // Just allocating and freeing
+  auto start = Clock::now();
+  size_t total = 0;
+  for (int rep = 0; rep < 10; rep++) {
+    for (const auto &title : titles) {
+      StringX sx(title);
+      sx += L" (copy)";
+      total += sx.length();
+    }
+  }
+  EXPECT_NE(0U, total);
+  Report("StringX copy and append x10", N, Elapsed(start));
+
+  // Every comparison makes two StringXs, as the UI's sort does
+  start = Clock::now();
+  std::sort(entries.begin(), entries.end(),
+            [](const CItemData &a, const CItemData &b) {return a.GetTitle() < b.GetTitle();});
+  Report("Sort by title", N, Elapsed(start));
+
+  const SecurePool::Stats after = SecurePool::GetStats();
+  Note("SecurePool: " + std::to_string(after.allocs - before.allocs) + " allocations, " +
+       std::to_string(after.heapAllocs - before.heapAllocs) + " on their own pages, " +
+       std::to_string(after.refills - before.refills) + " refills, " +
+       std::to_string(after.slabs) + " slabs");
+  EXPECT_EQ(before.live, after.live);
+}
+
+TEST_F(PerfTest, DISABLED_DisplayFieldCache)
+{
+  // What a grid does when it's sorted and scrolled: asks for
+  // the same few fields of every row, again and again
+  const size_t N = 100000;
+  // Rows are seldom in the order the entries were read
+  std::vector<size_t> rows(N);
+  for (size_t i = 0; i < N; i++)
+    rows[i] = i;
+  std::shuffle(rows.begin(), rows.end(), std::mt19937(42));
+
+  for (const bool useKeyring : {false, true}) {
+    const auto keyring = useKeyring ? std::make_shared<CItemKeyring>() : nullptr;
+    std::vector<CItemData> entries;
+    entries.reserve(N);
+    std::vector<pws_os::CUUID> uuids; // as a grid keeps them
+    for (size_t i = 0; i < N; i++) {
+      entries.push_back(MakeEntry(i, keyring));
+      uuids.push_back(entries.back().GetUUID());
+    }
+
+    for (const size_t capacity : {size_t(0), 3 * N}) {
+      DisplayFieldCache cache(capacity, 300);
+      const auto start = Clock::now();
+      size_t total = 0;
+      for (int rep = 0; rep < 10; rep++)
+        for (const size_t i : rows)
+          for (auto ft : {CItemData::GROUP, CItemData::TITLE, CItemData::USER})
+            total += cache.Get(uuids[i], entries[i], ft).length();
+      EXPECT_NE(0U, total);
+      Report(std::string("Group/title/user x10, ") +
+             (useKeyring ? "keyring, " : "per-entry keys, ") +
+             (capacity == 0 ? "uncached" : "cached"), N, Elapsed(start));
+      if (capacity != 0) {
+        const DisplayFieldCache::Stats stats = cache.GetStats();
+        Note("DisplayFieldCache: " + std::to_string(stats.hits) + " hits, " +
+             std::to_string(stats.misses) + " misses, " +
+             std::to_string(stats.evictions) + " evictions");
+        EXPECT_EQ(3 * N, stats.misses);
+      }
+    }
+  }
+}
+
+TEST_F(PerfTest, DISABLED_OpenLargeSafe)
+{
+  // About 100 MB of records
+  const size_t N = 320000;
+  MakeDB(N);
+
+  FILE *f = pws_os::FOpen(fname, _T("rb"));
+  ASSERT_NE(nullptr, f);
+  const double mb = double(pws_os::fileLength(f)) / (1024 * 1024);
+  fclose(f);
+  Note("File size: " + std::to_string(mb) + " MB");
+
+  // Just reading and decrypting records...
+  auto start = Clock::now();
+  {
+    PWSfileV3 fr(fname.c_str(), PWSfile::Read, PWSfile::V30);
+    ASSERT_EQ(PWSfile::SUCCESS, fr.Open(passkey));
+    CItemData ci;
+    size_t n = 0;
+    while (fr.ReadRecord(ci) == PWSfile::SUCCESS)
+      n++;
+    EXPECT_EQ(N, n);
+    EXPECT_EQ(PWSfile::SUCCESS, fr.Close());
+  }
+  Report("PWSfileV3 read all records", N, Elapsed(start));
+
+  // ...and all that goes with opening a database
+  PWScore core;
+  const AllocationCounter allocs;
+  start = Clock::now();
+  ASSERT_EQ(PWSfile::SUCCESS, core.ReadFile(fname.c_str(), passkey));
+  Report("ReadFile", N, Elapsed(start));
+  Note("ReadFile: " + std::to_string(double(allocs.Count()) / N) +
+       " allocations per entry");
+}
+
+TEST_F(PerfTest, DISABLED_SaveThroughput)
+{
+  // Records are cycled from a prebuilt set, so that what's measured is
+  // mostly encrypting and writing, rather than building entries
+  const size_t M = 10000;
+  const auto keyring = std::make_shared<CItemKeyring>();
+  std::vector<CItemData> entries;
+  entries.reserve(M);
+  for (size_t i = 0; i < M; i++)
+    entries.push_back(MakeEntry(i, keyring));
+
+  for (size_t N : {10000, 100000, 1000000}) {
+    const auto start = Clock::now();
+    {
+      PWSfileV3 fw(fname.c_str(), PWSfile::Write, PWSfile::V30);
+      ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passkey));
+      for (size_t i = 0; i < N; i++)
+        ASSERT_EQ(PWSfile::SUCCESS, fw.WriteRecord(entries[i % M]));
+      ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+    }
+    const double ms = Elapsed(start);
+
+    FILE *f = pws_os::FOpen(fname, _T("rb"));
+    ASSERT_NE(nullptr, f);
+    const double mb = double(pws_os::fileLength(f)) / (1024 * 1024);
+    fclose(f);
+    Report("PWSfileV3 write records", N, ms);
+    ReportMB("PWSfileV3 write records", mb, ms);
+  }
+}
+
+TEST_F(PerfTest, DISABLED_PipelinedOpen)
+{
+  const size_t N = 100000;
+  Note(std::to_string(std::thread::hardware_concurrency()) + " hardware threads");
+
+  // On few cores, the calling thread's CPU time shows what's left
+  // to it, i.e., how far more cores could take this
+  auto threadCPU = []() {
+#ifdef __linux__
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+#else
+    return 0.0;
+#endif
+  };
+
+  // The small one's just over ReadPipeline::MinFileLength, below
+  // which ReadFile() doesn't start workers (unless told to, as here)
+  for (size_t n : {size_t(500), N}) {
+    MakeDB(n, 10);
+    FILE *f = pws_os::FOpen(fname, _T("rb"));
+    ASSERT_NE(nullptr, f);
+    Note(std::to_string(n) + " entries, " +
+         std::to_string(pws_os::fileLength(f) / 1024) + " KB");
+    fclose(f);
+
+    for (unsigned workers : {0, 1, 2, 4, 8}) {
+      PWScore core;
+      core.SetReadWorkers(workers, true);
+      const double cpu0 = threadCPU();
+      const auto start = Clock::now();
+      ASSERT_EQ(PWSfile::SUCCESS, core.ReadFile(fname.c_str(), passkey));
+      const double ms = Elapsed(start);
+      EXPECT_EQ(n, core.GetNumEntries());
+      const std::string what = "ReadFile, " + std::to_string(workers) + " workers";
+      Report(what, n, ms);
+      Report(what + ", calling thread CPU", threadCPU() - cpu0);
+    }
+  }
+}
+
+TEST_F(PerfTest, DISABLED_JournaledSave)
+{
+  // Save Immediately after each of a run of edits, in full vs. to the journal
+  const size_t N = 50000, M = 1000;
+  MakeDB(N);
+  PWSprefs *prefs = PWSprefs::GetInstance();
+  const stringT jname = ChangeJournal::GetJournalName(fname.c_str());
+
+  for (bool journal : {false, true}) {
+    prefs->SetPref(PWSprefs::UseChangeJournal, journal);
+    PWScore core;
+    core.SetCurFile(fname.c_str());
+    ASSERT_EQ(PWSfile::SUCCESS, core.ReadCurFile(passkey));
+    // Full saves take long enough that a few make the point
+    const size_t edits = journal ? M : 10;
+
+    auto iter = core.GetEntryIter();
+    const auto start = Clock::now();
+    for (size_t i = 0; i < edits; i++, iter++) {
+      CItemData ci(iter->second);
+      ci.SetNotes(L"edited");
+      core.Execute(EditEntryCommand::Create(&core, iter->second, ci));
+      ASSERT_EQ(PWSfile::SUCCESS, journal ? core.WriteJournal() : core.WriteCurFile());
+    }
+    const double ms = Elapsed(start);
+    const std::string what = journal ? "Edit + WriteJournal" : "Edit + WriteCurFile";
+    Report(what, N, ms);
+    Report(what + ", per edit", ms / edits);
+    core.ClearCommands();
+  }
+  prefs->SetPref(PWSprefs::UseChangeJournal, false);
+  pws_os::DeleteAFile(jname);
+}
+
+TEST_F(PerfTest, DISABLED_AsyncSave)
+{
+  // What the calling (UI) thread waits for
+  for (size_t N : {10000, 100000}) {
+    MakeDB(N);
+    PWScore core;
+    core.SetCurFile(fname.c_str());
+    ASSERT_EQ(PWSfile::SUCCESS, core.ReadCurFile(passkey));
+
+    auto start = Clock::now();
+    ASSERT_EQ(PWSfile::SUCCESS, core.WriteCurFile());
+    Report("WriteCurFile", N, Elapsed(start));
+
+    start = Clock::now();
+    ASSERT_EQ(PWSfile::SUCCESS, core.WriteCurFileAsync());
+    Report("WriteCurFileAsync (snapshot)", N, Elapsed(start));
+    ASSERT_EQ(PWSfile::SUCCESS, core.FinishAsyncSave());
+    Report("...until finished", N, Elapsed(start));
+  }
+}
+
+TEST_F(PerfTest, DISABLED_FileSig)
+{
+  const size_t MB = 64;
+  {
+    std::vector<unsigned char> block(1024 * 1024, 'x');
+    FILE *f = pws_os::FOpen(fname, _T("wb"));
+    ASSERT_NE(nullptr, f);
+    for (size_t i = 0; i < MB; i++)
+      ASSERT_EQ(block.size(), fwrite(block.data(), 1, block.size(), f));
+    fclose(f);
+  }
+  // Digests of files this recently written aren't reused (see PWSFileSig)
+  std::this_thread::sleep_for(std::chrono::seconds(3));
+
+  auto start = Clock::now();
+  PWSFileSig first(fname);
+  const double ms = Elapsed(start);
+  ReportMB("PWSFileSig", MB, ms);
+
+  const size_t N = 1000;
+  start = Clock::now();
+  for (size_t i = 0; i < N; i++)
+    ASSERT_TRUE(first == PWSFileSig(fname));
+  Report("PWSFileSig of the unchanged file", N, Elapsed(start));
+}
+
+TEST_F(PerfTest, DISABLED_LargeAttachment)
+{
+  // Memory used on top of the attachment's own (encrypted) copy is
+  // what matters, so the file's bigger than anything allocated before
+  const size_t MB = 256;
+  const stringT attname(L"perf-attachment.bin");
+  {
+    std::vector<unsigned char> block(1024 * 1024);
+    FILE *f = pws_os::FOpen(attname, _T("wb"));
+    ASSERT_NE(nullptr, f);
+    for (size_t i = 0; i < MB; i++) {
+      std::fill(block.begin(), block.end(), static_cast<unsigned char>(i));
+      ASSERT_EQ(block.size(), fwrite(block.data(), 1, block.size(), f));
+    }
+    fclose(f);
+  }
+
+  // Memory reported is peak RSS growth
+  CItemAtt att;
+  att.CreateUUID();
+  long peak = PeakRSS();
+  auto start = Clock::now();
+  ASSERT_EQ(PWScore::SUCCESS, att.Import(attname));
+  ReportMB("Import", MB, Elapsed(start), 0, PeakRSS() - peak);
+
+  peak = PeakRSS();
+  start = Clock::now();
+  ASSERT_EQ(PWScore::SUCCESS, att.Export(attname));
+  ReportMB("Export", MB, Elapsed(start), 0, PeakRSS() - peak);
+
+  peak = PeakRSS();
+  start = Clock::now();
+  {
+    PWSfileV4 fw(fname.c_str(), PWSfile::Write, PWSfile::V40);
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passkey));
+    ASSERT_EQ(PWSfile::SUCCESS, fw.WriteRecord(att));
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+  }
+  ReportMB("PWSfileV4 write attachment", MB, Elapsed(start), 0, PeakRSS() - peak);
+
+  att.Clear(); // so that reading it back needs new memory
+  peak = PeakRSS();
+  start = Clock::now();
+  {
+    PWSfileV4 fr(fname.c_str(), PWSfile::Read, PWSfile::V40);
+    ASSERT_EQ(PWSfile::SUCCESS, fr.Open(passkey));
+    ASSERT_EQ(PWSfile::SUCCESS, fr.ReadRecord(att));
+    ASSERT_EQ(PWSfile::SUCCESS, fr.Close());
+  }
+  ReportMB("PWSfileV4 read attachment", MB, Elapsed(start), 0, PeakRSS() - peak);
+  EXPECT_EQ(MB * 1024 * 1024, att.GetContentLength());
+
+  pws_os::DeleteAFile(attname);
+}
+
+TEST_F(PerfTest, DISABLED_LazyAttachments)
+{
+  const size_t N = 10000, nAtts = 32, MB = 8;
+  const stringT v4name(L"perf-lazy.psafe4");
+  {
+    PWScore core;
+    core.NewFile(passkey);
+    std::vector<unsigned char> content(MB * 1024 * 1024);
+    for (size_t i = 0; i < N; i++) {
+      CItemData ci = MakeEntry(i, nullptr);
+      if (i < nAtts) {
+        std::fill(content.begin(), content.end(), static_cast<unsigned char>(i));
+        CItemAtt att;
+        att.CreateUUID();
+        att.SetContent(content.data(), content.size());
+        ci.SetAttUUID(att.GetUUID());
+        core.Execute(AddEntryCommand::Create(&core, ci, pws_os::CUUID::NullUUID(), &att));
+      } else
+        core.Execute(AddEntryCommand::Create(&core, ci));
+    }
+    ASSERT_EQ(PWSfile::SUCCESS, core.WriteFile(v4name.c_str(), PWSfile::V40));
+    core.ClearCommands();
+  }
+
+  PWSprefs *prefs = PWSprefs::GetInstance();
+  for (bool lazy : {false, true}) {
+    prefs->SetPref(PWSprefs::LazyAttachments, lazy);
+    PWScore core;
+    auto start = Clock::now();
+    ASSERT_EQ(PWSfile::SUCCESS, core.ReadFile(v4name.c_str(), passkey));
+    ASSERT_EQ(nAtts, core.GetNumAtts());
+    Report(std::string("ReadFile with 32 x 8 MB attachments, ") +
+           (lazy ? "lazy" : "eager"), N, Elapsed(start));
+  }
+  prefs->ResetPref(PWSprefs::LazyAttachments);
+  pws_os::DeleteAFile(v4name);
+}
+
+TEST_F(PerfTest, DISABLED_PeekFile)
+{
+  const size_t N = 100000;
+  MakeDB(N);
+
+  {
+    PWScore core;
+    auto start = Clock::now();
+    ASSERT_EQ(PWSfile::SUCCESS, core.ReadFile(fname.c_str(), passkey));
+    Report("ReadFile", N, Elapsed(start));
+  }
+  for (bool count : {true, false}) {
+    st_DBProperties dbp;
+    auto start = Clock::now();
+    ASSERT_EQ(PWScore::SUCCESS, PWScore::PeekFile(fname.c_str(), passkey, dbp, count));
+    Report(count ? "PeekFile, counting records" : "PeekFile, header only", N, Elapsed(start));
+    if (count) {
+      EXPECT_EQ(StringX(std::to_wstring(N).c_str()), dbp.numentries);
+    }
+  }
+}
+
+TEST_F(PerfTest, DISABLED_FileEncDec)
+{
+  // Above fileThresholdSize, i.e., TwoFish, as for the files that matter
+  const size_t MB = 256;
+  const stringT plainname(L"perf-encdec.bin");
+  const stringT ciphername = plainname + L".PSF";
+  {
+    std::vector<unsigned char> block(1024 * 1024);
+    FILE *f = pws_os::FOpen(plainname, _T("wb"));
+    ASSERT_NE(nullptr, f);
+    for (size_t i = 0; i < MB; i++) {
+      std::fill(block.begin(), block.end(), static_cast<unsigned char>(i));
+      ASSERT_EQ(block.size(), fwrite(block.data(), 1, block.size(), f));
+    }
+    fclose(f);
+  }
+  auto oldThreshold = PWSfile::fileThresholdSize;
+  PWSfile::fileThresholdSize = 1024 * 1024;
+
+  stringT errmess;
+  auto start = Clock::now();
+  ASSERT_TRUE(PWSfile::Encrypt(plainname, passkey, errmess));
+  ReportMB("Encrypt", MB, Elapsed(start));
+  ASSERT_TRUE(pws_os::DeleteAFile(plainname));
+  start = Clock::now();
+  ASSERT_TRUE(PWSfile::Decrypt(ciphername, passkey, errmess));
+  ReportMB("Decrypt, " + std::to_string(std::thread::hardware_concurrency()) + " cores",
+           MB, Elapsed(start));
+
+  PWSfile::fileThresholdSize = oldThreshold;
+  pws_os::DeleteAFile(plainname);
+  pws_os::DeleteAFile(ciphername);
+}
+
+TEST_F(PerfTest, DISABLED_AES)
+{
+  const size_t MB = 64, len = MB * 1024 * 1024;
+  const unsigned int BS = AES::BLOCKSIZE;
+  std::vector<unsigned char> buf(len);
+  for (size_t i = 0; i < len; i++)
+    buf[i] = static_cast<unsigned char>(i);
+  unsigned char key[32] = {0}, cbc[BS] = {0};
+
+  for (bool hw : {false, true}) {
+    if (hw && !AES::HasHardware()) {
+      Note("No AES instructions on this CPU");
+      break;
+    }
+    AES::Restrict only(hw);
+    AES aes(key, sizeof(key));
+    const std::string impl = hw ? "AES-256, instructions" : "AES-256, tables";
+
+    auto start = Clock::now();
+    auto c0 = Cycles();
+    for (size_t i = 0; i < len; i += BS)
+      aes.Encrypt(&buf[i], &buf[i]);
+    ReportMB(impl + ", Encrypt per block", MB, Elapsed(start), Cycles() - c0);
+
+    start = Clock::now();
+    c0 = Cycles();
+    for (size_t i = 0; i < len; i += BS)
+      aes.Decrypt(&buf[i], &buf[i]);
+    ReportMB(impl + ", Decrypt per block", MB, Elapsed(start), Cycles() - c0);
+
+    start = Clock::now();
+    c0 = Cycles();
+    aes.DecryptCBC(buf.data(), buf.data(), len / BS, cbc);
+    ReportMB(impl + ", DecryptCBC", MB, Elapsed(start), Cycles() - c0);
+  }
+}
+
+TEST_F(PerfTest, DISABLED_TwoFish)
+{
+  // Block at a time through Fish, as callers used to, vs. runs of blocks
+  const size_t MB = 64, len = MB * 1024 * 1024;
+  const unsigned int BS = TwoFish::BLOCKSIZE;
+  std::vector<unsigned char> buf(len);
+  for (size_t i = 0; i < len; i++)
+    buf[i] = static_cast<unsigned char>(i);
+  unsigned char key[32] = {0}, cbc[BS] = {0};
+  const std::unique_ptr<Fish> fish(new TwoFish(key, sizeof(key)));
+
+  auto start = Clock::now();
+  auto c0 = Cycles();
+  for (size_t i = 0; i < len; i += BS)
+    fish->Encrypt(&buf[i], &buf[i]);
+  ReportMB("TwoFish, Encrypt per block", MB, Elapsed(start), Cycles() - c0);
+
+  start = Clock::now();
+  c0 = Cycles();
+  for (size_t i = 0; i < len; i += BS)
+    fish->Decrypt(&buf[i], &buf[i]);
+  ReportMB("TwoFish, Decrypt per block", MB, Elapsed(start), Cycles() - c0);
+
+  start = Clock::now();
+  c0 = Cycles();
+  fish->EncryptBlocks(buf.data(), buf.data(), len / BS);
+  ReportMB("TwoFish, EncryptBlocks", MB, Elapsed(start), Cycles() - c0);
+
+  start = Clock::now();
+  c0 = Cycles();
+  fish->EncryptCBC(buf.data(), buf.data(), len / BS, cbc);
+  ReportMB("TwoFish, EncryptCBC", MB, Elapsed(start), Cycles() - c0);
+
+  start = Clock::now();
+  c0 = Cycles();
+  fish->DecryptCBC(buf.data(), buf.data(), len / BS, cbc);
+  ReportMB("TwoFish, DecryptCBC", MB, Elapsed(start), Cycles() - c0);
+}
+
+TEST_F(PerfTest, DISABLED_SHA256)
+{
+  const unsigned int N = MAX_USABLE_HASH_ITERS;
+  const size_t MB = 64, len = MB * 1024 * 1024;
+  std::vector<unsigned char> buf(len, 0x5a);
+  unsigned char digest[SHA256::HASHLEN];
+
+  // Unlocking a database is mostly stretching its passkey
+  {
+    PWSfileV3 fw(fname.c_str(), PWSfile::Write, PWSfile::V30);
+    fw.SetNHashIters(N);
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passkey));
+    ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+  }
+
+  for (bool hw : {false, true}) {
+    if (hw && !SHA256::HasHardware()) {
+      Note("No SHA-256 instructions on this CPU");
+      break;
+    }
+    SHA256::Restrict only(hw);
+    const std::string impl = hw ? "instructions" : "portable";
+
+    auto start = Clock::now();
+    auto c0 = Cycles();
+    SHA256 md;
+    md.Update(buf.data(), len);
+    md.Final(digest);
+    ReportMB("SHA256, " + impl, MB, Elapsed(start), Cycles() - c0);
+
+    // As StretchKey was, an object per iteration
+    start = Clock::now();
+    for (unsigned int i = 0; i < N; i++) {
+      SHA256 H;
+      H.Update(digest, SHA256::HASHLEN);
+      H.Final(digest);
+    }
+    Report("Update/Final x " + std::to_string(N) + ", " + impl, Elapsed(start));
+
+    start = Clock::now();
+    SHA256::Rehash(digest, N);
+    Report("Rehash x " + std::to_string(N) + ", " + impl, Elapsed(start));
+
+    start = Clock::now();
+    EXPECT_EQ(PWSfile::SUCCESS, PWSfileV3::CheckPasskey(fname.c_str(), passkey, nullptr));
+    Report("PWSfileV3::CheckPasskey x " + std::to_string(N) + ", " + impl, Elapsed(start));
+  }
+}
+
+TEST_F(PerfTest, DISABLED_V4KeyBlocks)
+{
+  // Opening a V4 database shared by nUsers, with the last one's passphrase
+  // (as bad as it gets, short of a wrong one)
+  const unsigned int N = 1 << 17;
+  const stringT v4name(L"perftest.psafe4");
+  const StringX lastUser(L"user passphrase 9");
+
+  // For comparison: as before, the generic pbkdf2() per key block
+  {
+    const unsigned char salt[32] = {0};
+    unsigned char Ptag[SHA256::HASHLEN];
+    unsigned long len = sizeof(Ptag);
+    HMAC<SHA256, SHA256::HASHLEN, SHA256::BLOCKSIZE> hmac;
+    auto start = Clock::now();
+    pbkdf2(reinterpret_cast<const unsigned char *>("passkey"), 7, salt, sizeof(salt),
+           N, &hmac, Ptag, &len);
+    Report("Generic pbkdf2, 1 key block x " + std::to_string(N), Elapsed(start));
+  }
+
+  for (size_t nUsers : {size_t(1), size_t(4), size_t(10)}) {
+    PWSfileV4::CKeyBlocks kbs;
+    const StringX last = nUsers == 1 ? passkey : lastUser;
+    ASSERT_TRUE(kbs.AddKeyBlock(passkey, passkey, N));
+    for (size_t i = 1; i < nUsers; i++)
+      ASSERT_TRUE(kbs.AddKeyBlock(passkey, StringX(L"user passphrase ") +
+                                  StringX(std::to_wstring(i + 10 - nUsers).c_str()), N));
+    {
+      PWSfileV4 fw(v4name.c_str(), PWSfile::Write, PWSfile::V40);
+      fw.SetKeyBlocks(kbs);
+      ASSERT_EQ(PWSfile::SUCCESS, fw.Open(passkey));
+      ASSERT_EQ(PWSfile::SUCCESS, fw.Close());
+    }
+
+    const bool settings[3][2] = {{true, true}, {false, true}, {false, false}};
+    for (const auto &st : settings) {
+      SHA256::Restrict only(st[0], st[1]);
+      if ((st[0] && !SHA256::HasHardware()) || (!st[0] && st[1] && SHA256::DigestLanes() == 1))
+        continue; // nothing different to time here
+      const std::string impl = st[0] ? "SHA instructions" : (st[1] ? "AVX2 lanes" : "portable");
+      PWSfileV4 fr(v4name.c_str(), PWSfile::Read, PWSfile::V40);
+      auto start = Clock::now();
+      ASSERT_EQ(PWSfile::SUCCESS, fr.Open(last));
+      Report("Open, " + std::to_string(nUsers) + " key blocks x " + std::to_string(N) +
+             ", " + impl + ", width " + std::to_string(pbkdf2_sha256_width()), Elapsed(start));
+      fr.Close();
+    }
+  }
+  pws_os::DeleteAFile(v4name);
+}
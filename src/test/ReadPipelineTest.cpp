@@ -0,0 +1,114 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// ReadPipelineTest.cpp: Unit test for reading records on several threads
+
+#ifdef WIN32
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "DatabaseTest.h"
+
+#include <vector>
+
+class ReadPipelineTest : public DatabaseTest
+{
+protected:
+  ReadPipelineTest()
+    : DatabaseTest(L"pipe-dream", L"pipeline.psafe3", 2000) {} // several batches' worth
+  void MakeEntry(CItemData &ci, size_t i, const StringX &s) override;
+
+  // Reads fname sequentially and with workers, expecting the same
+  // status and entries either way. Returns the status.
+  int ReadBothWays(size_t &numEntries);
+  void Truncate(long length);
+};
+
+void ReadPipelineTest::MakeEntry(CItemData &ci, size_t i, const StringX &s)
+{
+  DatabaseTest::MakeEntry(ci, i, s);
+  if (i % 10 == 1) // as written by PWScore::WriteFile
+    ci.SetPassword(StringX(L"[[") + StringX(uuids[i - 1]) + StringX(L"]]"));
+  if (i % 7 == 0)
+    ci.SetNotes(StringX(500, L'n') + s); // many blocks
+  if (i % 13 == 0) {
+    const unsigned char unknown[] = {1, 2, 3};
+    ci.SetUnknownField(0xdf, sizeof(unknown), unknown);
+  }
+}
+
+int ReadPipelineTest::ReadBothWays(size_t &numEntries)
+{
+  PWScore sequential, pipelined;
+  sequential.SetReadWorkers(0);
+  pipelined.SetReadWorkers(3, true);
+
+  const int status = sequential.ReadFile(fname.c_str(), passkey);
+  EXPECT_EQ(status, pipelined.ReadFile(fname.c_str(), passkey));
+  numEntries = sequential.GetNumEntries();
+  EXPECT_EQ(numEntries, pipelined.GetNumEntries());
+  EXPECT_EQ(sequential.GetNumRecordsWithUnknownFields(),
+            pipelined.GetNumRecordsWithUnknownFields());
+
+  for (auto iter = sequential.GetEntryIter(); iter != sequential.GetEntryEndIter(); iter++) {
+    auto other = pipelined.Find(iter->first);
+    EXPECT_TRUE(other != pipelined.GetEntryEndIter());
+    if (other != pipelined.GetEntryEndIter()) {
+      EXPECT_EQ(iter->second, other->second);
+      EXPECT_EQ(iter->second.GetEntryType(), other->second.GetEntryType());
+    }
+  }
+  return status;
+}
+
+void ReadPipelineTest::Truncate(long length)
+{
+  FILE *f = pws_os::FOpen(fname, _T("rb"));
+  ASSERT_NE(nullptr, f);
+  std::vector<unsigned char> data(static_cast<size_t>(length));
+  ASSERT_EQ(data.size(), fread(&data[0], 1, data.size(), f));
+  fclose(f);
+  f = pws_os::FOpen(fname, _T("wb"));
+  ASSERT_NE(nullptr, f);
+  ASSERT_EQ(data.size(), fwrite(&data[0], 1, data.size(), f));
+  fclose(f);
+}
+
+TEST_F(ReadPipelineTest, SameAsSequential)
+{
+  size_t n = 0;
+  EXPECT_EQ(PWSfile::SUCCESS, ReadBothWays(n));
+  EXPECT_EQ(size_t(N), n);
+}
+
+TEST_F(ReadPipelineTest, BadDigest)
+{
+  FILE *f = pws_os::FOpen(fname, _T("r+b"));
+  ASSERT_NE(nullptr, f);
+  ASSERT_EQ(0, fseek(f, -1, SEEK_END));
+  const int c = fgetc(f);
+  ASSERT_EQ(0, fseek(f, -1, SEEK_END));
+  fputc(c ^ 1, f);
+  fclose(f);
+
+  size_t n = 0;
+  EXPECT_EQ(PWSfile::BAD_DIGEST, ReadBothWays(n));
+  EXPECT_EQ(size_t(N), n);
+}
+
+TEST_F(ReadPipelineTest, Truncated)
+{
+  FILE *f = pws_os::FOpen(fname, _T("rb"));
+  ASSERT_NE(nullptr, f);
+  const long length = static_cast<long>(pws_os::fileLength(f));
+  fclose(f);
+  Truncate(length / 2 + 5); // mid-record, and not on a block boundary
+
+  size_t n = 0;
+  ReadBothWays(n);
+  EXPECT_LT(n, size_t(N));
+}
@@ -13,7 +13,10 @@
 #include "core/crypto/sha256.h"
 #include "gtest/gtest.h"
 
-TEST(SHA256Test, sha256_test)
+#include <cstring>
+#include <vector>
+
+static void TestVectors()
 {
   static const struct {
     const char *msg;
@@ -43,3 +46,74 @@ TEST(SHA256Test, sha256_test)
     EXPECT_TRUE(memcmp(tmp, tests[i].hash, 32) == 0) << "test vector " << i;
   }
 }
+
+TEST(SHA256Test, sha256_test)
+{
+  TestVectors(); // with SHA-256 instructions, if the CPU has them
+}
+
+TEST(SHA256Test, sha256_test_portable)
+{
+  SHA256::Restrict portable(false);
+  TestVectors();
+}
+
+// Many blocks in one Update, and the two implementations agree on
+// all the ways a message can fall across blocks
+TEST(SHA256Test, long_messages)
+{
+  static const unsigned char million_a[32] = {
+    0xcd, 0xc7, 0x6e, 0x5c, 0x99, 0x14, 0xfb, 0x92,
+    0x81, 0xa1, 0xc7, 0xe2, 0x84, 0xd7, 0x3e, 0x67,
+    0xf1, 0x80, 0x9a, 0x48, 0xa4, 0x97, 0x20, 0x0e,
+    0x04, 0x6d, 0x39, 0xcc, 0xc7, 0x11, 0x2c, 0xd0
+  };
+  std::vector<unsigned char> msg(1000000, 'a');
+  unsigned char tmp[2][32];
+
+  for (int hw = 0; hw < 2; hw++) {
+    SHA256::Restrict impl(hw != 0);
+    SHA256 md;
+    md.Update(msg.data(), 5); // so the rest isn't block-aligned
+    md.Update(msg.data() + 5, msg.size() - 5);
+    md.Final(tmp[0]);
+    EXPECT_EQ(0, memcmp(tmp[0], million_a, 32)) << "hw " << hw;
+  }
+
+  for (size_t i = 0; i < 300; i++)
+    msg[i] = static_cast<unsigned char>(i * 13);
+  for (size_t len = 0; len <= 300; len++) {
+    for (int hw = 0; hw < 2; hw++) {
+      SHA256::Restrict impl(hw != 0);
+      SHA256 md;
+      md.Update(msg.data(), len);
+      md.Final(tmp[hw]);
+    }
+    EXPECT_EQ(0, memcmp(tmp[0], tmp[1], 32)) << "length " << len;
+  }
+}
+
+TEST(SHA256Test, rehash)
+{
+  unsigned char expected[32], digest[32];
+  SHA256 md;
+  md.Update(reinterpret_cast<const unsigned char *>("abc"), 3);
+  md.Final(expected);
+  memcpy(digest, expected, 32);
+
+  for (unsigned int n : {0U, 1U, 2U, 1000U}) {
+    for (int hw = 0; hw < 2; hw++) {
+      SHA256::Restrict impl(hw != 0);
+      unsigned char x[32];
+      memcpy(x, expected, 32);
+      for (unsigned int i = 0; i < n; i++) {
+        SHA256 h;
+        h.Update(x, 32);
+        h.Final(x);
+      }
+      memcpy(digest, expected, 32);
+      SHA256::Rehash(digest, n);
+      EXPECT_EQ(0, memcmp(digest, x, 32)) << "hw " << hw << ", n " << n;
+    }
+  }
+}
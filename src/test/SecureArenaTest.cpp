@@ -0,0 +1,78 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// SecureArenaTest.cpp: Unit test for SecureArena class
+
+#ifdef WIN32
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "core/SecureArena.h"
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <vector>
+
+TEST(SecureArenaTest, AllocFree)
+{
+  SecureArena arena;
+  EXPECT_EQ(nullptr, arena.Allocate(0));
+
+  auto *p = static_cast<unsigned char *>(arena.Allocate(13));
+  ASSERT_NE(nullptr, p);
+  memset(p, 0xAA, 13);
+  EXPECT_EQ(1U, arena.GetStats().live);
+  EXPECT_EQ(1U, arena.GetStats().slabs);
+
+  // Freed block of same size class should be reused, wiped
+  auto *q = static_cast<unsigned char *>(arena.Allocate(16));
+  arena.Deallocate(p, 13);
+  auto *r = static_cast<unsigned char *>(arena.Allocate(9));
+  EXPECT_EQ(p, r);
+  for (int i = 8; i < 16; i++) // first 8 bytes hold free list link
+    EXPECT_EQ(0, r[i]);
+
+  arena.Deallocate(q, 16);
+  arena.Deallocate(r, 9);
+  EXPECT_EQ(0U, arena.GetStats().live);
+
+  // Strings of a few hundred characters come from a slab too
+  void *s = arena.Allocate(1000);
+  memset(s, 0x33, 1000);
+  EXPECT_EQ(0U, arena.GetStats().heapAllocs);
+  arena.Deallocate(s, 1000);
+}
+
+TEST(SecureArenaTest, LargeAndMany)
+{
+  SecureArena arena;
+
+  // Too large for a size class: gets locked pages of its own
+  void *big = arena.Allocate(SecureArena::MaxBlock + 1);
+  ASSERT_NE(nullptr, big);
+  memset(big, 0x55, SecureArena::MaxBlock + 1);
+  EXPECT_EQ(1U, arena.GetStats().heapAllocs);
+  EXPECT_EQ(0U, arena.GetStats().slabs);
+  arena.Deallocate(big, SecureArena::MaxBlock + 1);
+
+  // Enough blocks to need more than one slab
+  const size_t N = 3 * SecureArena::SlabSize / SecureArena::MaxBlock;
+  std::vector<void *> blocks;
+  for (size_t i = 0; i < N; i++) {
+    void *p = arena.Allocate(SecureArena::MaxBlock);
+    memset(p, int(i), SecureArena::MaxBlock);
+    blocks.push_back(p);
+  }
+  EXPECT_EQ(3U, arena.GetStats().slabs);
+  EXPECT_EQ(N, arena.GetStats().live);
+
+  for (auto p : blocks)
+    arena.Deallocate(p, SecureArena::MaxBlock);
+  // All free: keep just one slab around
+  EXPECT_EQ(0U, arena.GetStats().live);
+  EXPECT_EQ(1U, arena.GetStats().slabs);
+}
@@ -0,0 +1,112 @@
+/*
+* Copyright (c) 2003-2024 Rony Shapiro <ronys@pwsafe.org>.
+* All rights reserved. Use of the code is allowed under the
+* Artistic License 2.0 terms, as specified in the LICENSE file
+* distributed with this code, or available from
+* http://www.opensource.org/licenses/artistic-license-2.0.php
+*/
+// SecurePoolTest.cpp: Unit test for SecurePool class
+// The pool's shared by everything in the process, so we look at
+// changes in its stats rather than their values.
+
+#ifdef WIN32
+#include "../ui/Windows/stdafx.h"
+#endif
+
+#include "core/SecurePool.h"
+#include "core/StringX.h"
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+TEST(SecurePoolTest, AllocFree)
+{
+  const SecurePool::Stats before = SecurePool::GetStats();
+
+  auto *p = static_cast<unsigned char *>(SecurePool::Allocate(20));
+  ASSERT_NE(nullptr, p);
+  memset(p, 0xAA, 20);
+  EXPECT_EQ(before.live + 1, SecurePool::GetStats().live);
+
+  // Freed block of same size class should be reused, wiped
+  SecurePool::Deallocate(p, 20);
+  auto *q = static_cast<unsigned char *>(SecurePool::Allocate(32));
+  EXPECT_EQ(p, q);
+  for (size_t i = sizeof(void *); i < 20; i++) // first bytes hold free list link
+    EXPECT_EQ(0, q[i]);
+  SecurePool::Deallocate(q, 32);
+
+  // Too large for a size class: gets locked pages of its own
+  void *big = SecurePool::Allocate(SecurePool::MaxBlock + 1);
+  ASSERT_NE(nullptr, big);
+  memset(big, 0x55, SecurePool::MaxBlock + 1);
+  SecurePool::Deallocate(big, SecurePool::MaxBlock + 1);
+
+  const SecurePool::Stats after = SecurePool::GetStats();
+  EXPECT_EQ(before.live, after.live);
+  EXPECT_EQ(before.allocs + 3, after.allocs);
+  EXPECT_EQ(before.heapAllocs + 1, after.heapAllocs);
+}
+
+TEST(SecurePoolTest, StringX)
+{
+  const SecurePool::Stats before = SecurePool::GetStats();
+  {
+    StringX sx(L"long enough not to fit in the string object itself");
+    sx += sx;
+    EXPECT_LT(before.live, SecurePool::GetStats().live);
+  }
+  const SecurePool::Stats after = SecurePool::GetStats();
+  EXPECT_EQ(before.live, after.live);
+  EXPECT_LT(before.allocs, after.allocs);
+}
+
+TEST(SecurePoolTest, Threads)
+{
+  const SecurePool::Stats before = SecurePool::GetStats();
+  const size_t N = 10000;
+  std::vector<void *> fromThread;
+
+  // Blocks allocated by a thread can outlive it, and be freed elsewhere.
+  // Those it frees itself go back to the depot when it exits.
+  std::thread t([&fromThread]() {
+    std::vector<void *> mine;
+    for (size_t i = 0; i < N; i++) {
+      void *p = SecurePool::Allocate(i % SecurePool::MaxBlock);
+      memset(p, int(i), i % SecurePool::MaxBlock);
+      (i % 2 == 0 ? fromThread : mine).push_back(p);
+    }
+    for (size_t i = 0; i < mine.size(); i++)
+      SecurePool::Deallocate(mine[i], (2 * i + 1) % SecurePool::MaxBlock);
+  });
+  t.join();
+
+  EXPECT_EQ(before.live + N / 2, SecurePool::GetStats().live);
+  for (size_t i = 0; i < fromThread.size(); i++)
+    SecurePool::Deallocate(fromThread[i], (2 * i) % SecurePool::MaxBlock);
+  EXPECT_EQ(before.live, SecurePool::GetStats().live);
+}
+
+TEST(SecurePoolTest, ReleasesEmptySlabs)
+{
+  // Enough of the largest blocks to fill several slabs, all freed:
+  // the slabs that held them should go back to the system
+  const SecurePool::Stats before = SecurePool::GetStats();
+  const size_t N = 6 * SecurePool::SlabSize / SecurePool::MaxBlock;
+  std::vector<void *> blocks;
+  for (size_t i = 0; i < N; i++) {
+    void *p = SecurePool::Allocate(SecurePool::MaxBlock);
+    memset(p, int(i), SecurePool::MaxBlock);
+    blocks.push_back(p);
+  }
+  const SecurePool::Stats peak = SecurePool::GetStats();
+  EXPECT_EQ(before.heapAllocs, peak.heapAllocs);
+
+  for (void *p : blocks)
+    SecurePool::Deallocate(p, SecurePool::MaxBlock);
+  const SecurePool::Stats after = SecurePool::GetStats();
+  EXPECT_EQ(before.live, after.live);
+  EXPECT_LE(after.slabs + 3, peak.slabs);
+}
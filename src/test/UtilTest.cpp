@@ -8,8 +8,13 @@
 // UtilTest.cpp: Unit test for selected functions in Util.cpp
 
 #include "core/Util.h"
+#include "core/crypto/BlowFish.h"
+#include "core/crypto/TwoFish.h"
 #include "gtest/gtest.h"
 
+#include <cstdio>
+#include <vector>
+
 TEST(UtilTest1, convert_test_ascii)
 {
   StringX src(L"abc");
@@ -32,3 +37,77 @@ TEST(UtilTest2, convert_test_nonascii)
   EXPECT_STREQ("אבג", reinterpret_cast<const char *>(dst));
   delete[] dst;
 }
+
+// Records written with _writecbc() read back the same whichever
+// _readcbc() reads them, and so does typeless content
+TEST(UtilTest3, cbc_records)
+{
+  const unsigned char key[32] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+                                 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32};
+  const TwoFish tf(key, sizeof(key));
+  const BlowFish bf(key, 20);
+  const Fish *const fishes[] = {&tf, &bf};
+
+  std::vector<unsigned char> data(300);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = static_cast<unsigned char>(i * 7 + 1);
+  const size_t lengths[] = {0, 1, 11, 12, 16, 27, 28, 100, 300};
+
+  for (const Fish *fish : fishes) {
+    Fish *algorithm = const_cast<Fish *>(fish);
+    const unsigned int BS = fish->GetBlockSize();
+    const std::vector<unsigned char> iv(BS, 0x5a);
+
+    FILE *f = tmpfile();
+    ASSERT_NE(nullptr, f);
+    std::vector<unsigned char> cbc(iv);
+    for (size_t len : lengths)
+      _writecbc(f, data.data(), len, static_cast<unsigned char>(len), algorithm, cbc.data());
+    const size_t contentLength = 10 * BS;
+    _writecbcRest(f, data.data(), contentLength, algorithm, cbc.data());
+    const std::vector<unsigned char> lastcbc(cbc);
+
+    std::vector<unsigned char> file(static_cast<size_t>(ftell(f)));
+    rewind(f);
+    ASSERT_EQ(file.size(), fread(file.data(), 1, file.size(), f));
+
+    // from the FILE
+    rewind(f);
+    cbc = iv;
+    for (size_t len : lengths) {
+      unsigned char *buffer = nullptr, type = 0;
+      size_t buffer_len = 0;
+      EXPECT_NE(0U, _readcbc(f, buffer, buffer_len, type, algorithm, cbc.data()));
+      ASSERT_EQ(len, buffer_len) << "block size " << BS;
+      EXPECT_EQ(static_cast<unsigned char>(len), type);
+      if (len > 0) {
+        EXPECT_EQ(0, memcmp(buffer, data.data(), len)) << "block size " << BS << ", length " << len;
+        delete[] buffer;
+      }
+    }
+    std::vector<unsigned char> content(contentLength);
+    EXPECT_EQ(contentLength, _readcbc(f, content.data(), contentLength, algorithm, cbc.data()));
+    EXPECT_EQ(0, memcmp(content.data(), data.data(), contentLength));
+    EXPECT_TRUE(cbc == lastcbc);
+    fclose(f);
+
+    // from memory
+    const unsigned char *in = file.data(), *const end = in + file.size();
+    unsigned char *buffer = nullptr;
+    size_t buffer_cap = 0;
+    cbc = iv;
+    for (size_t len : lengths) {
+      unsigned char type = 0;
+      size_t buffer_len = 0;
+      EXPECT_NE(0U, _readcbc(in, end, buffer, buffer_cap, buffer_len, type, algorithm, cbc.data()));
+      ASSERT_EQ(len, buffer_len);
+      EXPECT_EQ(0, memcmp(buffer, data.data(), len)) << "block size " << BS << ", length " << len;
+    }
+    delete[] buffer;
+    std::fill(content.begin(), content.end(), 0);
+    EXPECT_EQ(contentLength, _readcbc(in, end, content.data(), contentLength, algorithm, cbc.data()));
+    EXPECT_EQ(0, memcmp(content.data(), data.data(), contentLength));
+    EXPECT_TRUE(in == end);
+    EXPECT_TRUE(cbc == lastcbc);
+  }
+}
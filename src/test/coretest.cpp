@@ -16,6 +16,55 @@
 
 #include "gtest/gtest.h"
 
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Heap allocations made through operator new, for the PerfTests that
+// report them. Only counted while one of them asks (nAllocCounters != 0);
+// otherwise this is just malloc() and free(). Every form replaced here
+// allocates with malloc() and frees with free(); the aligned forms
+// aren't replaced, so still pair up with each other.
+std::atomic<int> nAllocCounters(0);
+std::atomic<size_t> nAllocs(0);
+
+static void *CountedAlloc(size_t size) noexcept
+{
+  if (nAllocCounters.load(std::memory_order_relaxed) != 0)
+    nAllocs++;
+  return std::malloc(size != 0 ? size : 1);
+}
+
+void *operator new(size_t size)
+{
+  void *p = CountedAlloc(size);
+  if (p == nullptr)
+    throw std::bad_alloc();
+  return p;
+}
+
+void *operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  return CountedAlloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+  return CountedAlloc(size);
+}
+
+void operator delete(void *p) noexcept {std::free(p);}
+void operator delete[](void *p) noexcept {std::free(p);}
+void operator delete(void *p, size_t) noexcept {std::free(p);}
+void operator delete[](void *p, size_t) noexcept {std::free(p);}
+void operator delete(void *p, const std::nothrow_t &) noexcept {std::free(p);}
+void operator delete[](void *p, const std::nothrow_t &) noexcept {std::free(p);}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
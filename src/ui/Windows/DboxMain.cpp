@@ -2953,6 +2953,7 @@ void DboxMain::UpdateAccessTime(const pws_os::CUUID &uuid)
       return;
     CItemData &item = iter->second;
     item.SetATime();
+    m_core.AddChangedEntry(uuid);
     SetEntryTimestampsChanged(true);
 
     if (!IsGUIEmpty() &&
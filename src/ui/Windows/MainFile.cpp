@@ -562,6 +562,7 @@ int DboxMain::Close(const bool bTrySave)
   // No need to check expired passwords
   KillTimer(TIMER_LOCKDBONIDLETIMEOUT);
   KillTimer(TIMER_EXPENT);
+  KillTimer(TIMER_DISPLAYCACHE);
   RegisterSessionNotification(false);
 
   // Update Minidump user streams
@@ -940,6 +941,9 @@ void DboxMain::PostOpenProcessing()
   CheckExpireList(true);
   TellUserAboutExpiredPasswords();
 
+  const UINT MINUTE = 60000; // in millisecs
+  SetTimer(TIMER_DISPLAYCACHE, MINUTE, NULL);
+
   m_RUEList.SetRUEList(m_core.GetRUEList());
 
   // Set timer for user-defined idle lockout, if selected (DB preference)
@@ -1012,41 +1016,30 @@ int DboxMain::CheckEmergencyBackupFiles(StringX sx_Filename, StringX &passkey)
     return IDOK;
 
   std::vector<st_recfile> vValidEBackupfiles;
-  PWSAuxCore othercore; // Leaves DB prefs untouched!
 
-  // Get currently selected database's information
-  // No Report or MAXCHARS value, implies no validation of the file
-  // except the mandatory UUID uniqueness
+  // Get currently selected database's information.
+  // PeekFile only reads the header and counts the records, so neither
+  // m_core nor the database preferences are touched. It cannot tell
+  // the number of groups or unknown fields, which show as unknown.
   st_DBProperties st_dbpcore;
-  othercore.ReadFile(sx_Filename, passkey);
-  othercore.GetDBProperties(st_dbpcore);
+  PWScore::PeekFile(sx_Filename, passkey, st_dbpcore);
   st_dbpcore.database = wsDBName.c_str();
 
   for (size_t i = 0; i < vrecoveryfiles.size(); i++) {
     st_recfile st_rf;
     st_DBProperties st_dbp;
-    othercore.ReInit();
     st_rf.filename = vrecoveryfiles[i];
 
-    // First check passphrase the same.
+    // Only a backup with the same passphrase can be peeked into
     sx_fullfilename = StringX(wsDBPath.c_str()) + vrecoveryfiles[i];
-    rc = othercore.CheckPasskey(sx_fullfilename, passkey);
-
-    // If it is, try to open database (i.e. same passphrase) and get
-    // the header record but not change anything in m_core related to
-    // current open database (hence saving the database preferences for later)
+    rc = PWScore::PeekFile(sx_fullfilename, passkey, st_dbp);
     if (rc == PWScore::SUCCESS) {
-      rc = othercore.ReadFile(sx_fullfilename, passkey);
-      if (rc == PWScore::SUCCESS) {
-        othercore.GetDBProperties(st_dbp);
-        st_dbp.database = sx_fullfilename;
-        st_rf.dbp = st_dbp;
-      }
+      st_dbp.database = sx_fullfilename;
+      st_rf.dbp = st_dbp;
     }
     st_rf.rc = rc;
     vValidEBackupfiles.push_back(st_rf);
   }
-  othercore.ReInit();
 
   vrecoveryfiles.clear();
   if (vValidEBackupfiles.empty())
@@ -1597,6 +1597,7 @@ void DboxMain::OnSize(UINT nType, int cx, int cy)
         }
       }
 
+      m_core.ClearDisplayCache();
       m_ctlItemList.DeleteAllItems();
       m_mapGroupToTreeItem.clear();
       m_mapTreeItemToGroup.clear();
@@ -2607,6 +2608,10 @@ void DboxMain::OnTimer(UINT_PTR nIDEvent)
   } else if (nIDEvent == TIMER_EXPENT) {
     // once a day, we want to check the expired entries list
     CheckExpireList();
+  } else if (nIDEvent == TIMER_DISPLAYCACHE) {
+    // decrypted fields shouldn't outlive their TTL just because
+    // nothing's asked for them since
+    m_core.PurgeDisplayCache();
   } else if (nIDEvent == TIMER_FORCE_ALLOW_CAPTURE_BITMAP_BLINK) {
 
     UINT nId;
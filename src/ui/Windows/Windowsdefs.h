@@ -97,6 +97,8 @@ Timer related values (note - all documented her but some defined only where need
 #define TIMER_TWO_FACTOR_AUTH_CODE_COUNTDOWN 0x21
 // Timer used to repeatedly update the clipboard with an entry's current auth code.
 #define TIMER_TWO_FACTOR_AUTH_CODE_UPDATE_CLIPBOARD 0x22
+// Timer to drop expired display fields (see DisplayFieldCache)
+#define TIMER_DISPLAYCACHE        0x23
 
 /*
 HOVER_TIME_ND       The length of time the pointer must remain stationary
@@ -65,6 +65,7 @@ int SaveCore(PWScore &core, const UserArgs &);
 
 // These are the new operations. Each returns the code to exit with
 static int CreateNewSafe(PWScore &core, const StringX &filename, const StringX &passphrase, bool);
+static int ShowInfo(PWScore &core, const StringX &filename, const StringX &passphrase, bool);
 static int Sync(PWScore &core, const UserArgs &ua);
 static int Merge(PWScore &core, const UserArgs &ua);
 
@@ -92,6 +93,7 @@ const map<UserArgs::OpType, pws_op> pws_ops = {
   { UserArgs::Diff,       {OpenCore,        Diff,       null_op}},
   { UserArgs::Sync,       {OpenCore,        Sync,       SaveCore}},
   { UserArgs::Merge,      {OpenCore,        Merge,      SaveCore}},
+  { UserArgs::Info,       {ShowInfo,        null_op,    null_op}},
 };
 
 
@@ -119,6 +121,8 @@ Usage: %PROGNAME% safe --imp[=file] --text|--xml
 
        %PROGNAME% safe --merge=<other-safe> [ --subset=<Field><OP><Value>[/iI] ] [--yes]
 
+       %PROGNAME% safe --info
+
                         where OP is one of ==, !==, ^= !^=, $=, !$=, ~=, !~=
                          = => exactly similar
                          ^ => begins with
@@ -215,6 +219,7 @@ bool parseArgs(int argc, char *argv[], UserArgs &ua)
                     {"passphrase2", required_argument,  0, 'Q'},
                     {"generate-totp", no_argument,      0, 'G'},
                     {"verbose",     no_argument,        0, 'V'},
+                    {"info",        no_argument,        0, 'I'},
                     {0, 0, 0, 0}
           };
 
@@ -222,7 +227,7 @@ bool parseArgs(int argc, char *argv[], UserArgs &ua)
           static_assert(no_dup_short_option(long_options), "Short option used twice");
 #endif
 
-          int c = getopt_long(argc - 1, argv + 1, "i::e::txcs:b:f:oa:u:pryd:gjknz:m:P:Q:GV",
+          int c = getopt_long(argc - 1, argv + 1, "i::e::txcs:b:f:oa:u:pryd:gjknz:m:P:Q:GVI",
               long_options, &option_index);
           if (c == -1)
               break;
@@ -358,6 +363,10 @@ bool parseArgs(int argc, char *argv[], UserArgs &ua)
               ua.verbosity_level++;
               break;
 
+          case 'I':
+              ua.SetMainOp(UserArgs::Info);
+              break;
+
           default:
               wcerr << L"Unknown option: " << static_cast<wchar_t>(c) << endl;
               return false;
@@ -418,6 +427,7 @@ int main(int argc, char *argv[])
 
   if (itr != pws_ops.end()) {
     const bool openReadOnly = ua.Operation == UserArgs::Export || ua.Operation == UserArgs::Diff ||
+                              ua.Operation == UserArgs::Info ||
                               (ua.Operation == UserArgs::Search && (ua.SearchAction == UserArgs::Print || ua.SearchAction == UserArgs::GenerateTotpCode));
     PWScore core;
     try {
@@ -455,6 +465,38 @@ static int CreateNewSafe(PWScore &core, const StringX &filename, const StringX &
     return PWScore::SUCCESS;
 }
 
+// Just the header and a count of the records, without reading them all
+static int ShowInfo(PWScore &core, const StringX &filename, const StringX &passphrase, bool)
+{
+  if (!pws_os::FileExists(filename.c_str())) {
+    wcerr << filename << L" - file not found" << endl;
+    return 2;
+  }
+
+  const StringX pk = passphrase.empty() ? GetPassphrase(L"Enter Password [" + stringx2std(filename) + L"]: ") : passphrase;
+
+  st_DBProperties dbp;
+  const int status = core.PeekFile(filename, pk, dbp);
+  if (status != PWScore::SUCCESS) {
+    cout << "PeekFile returned: " << status_text(status) << endl;
+    return status;
+  }
+
+  wcout << L"Database:         " << dbp.database << endl
+        << L"Format:           " << dbp.databaseformat << endl
+        << L"Name:             " << dbp.db_name << endl
+        << L"Description:      " << dbp.db_description << endl
+        << L"Entries:          " << dbp.numentries << endl
+        << L"Attachments:      " << dbp.numattachments << endl
+        << L"Empty groups:     " << dbp.numemptygroups << endl
+        << L"Last saved:       " << dbp.whenlastsaved << endl
+        << L"Last saved by:    " << dbp.wholastsaved << endl
+        << L"Last saved with:  " << dbp.whatlastsaved << endl
+        << L"Passphrase set:   " << dbp.whenpwdlastchanged << endl
+        << L"File UUID:        " << dbp.file_uuid << endl;
+  return PWScore::SUCCESS;
+}
+
 int SaveCore(PWScore &core, const UserArgs &ua)
 {
   if (!ua.dry_run)
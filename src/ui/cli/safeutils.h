@@ -17,6 +17,7 @@ struct PWPolicy;
 
 int OpenCore(PWScore &core, const StringX &safe, const StringX &passphrase, bool openReadOnly = false);
 StringX GetNewPassphrase();
+StringX GetPassphrase(const std::wstring& prompt);
 
 int AddEntry(PWScore &core, const UserArgs &ua);
 int InitPWPolicy(PWPolicy &pwp, PWScore &core);
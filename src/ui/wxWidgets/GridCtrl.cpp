@@ -519,6 +519,14 @@ CItemData *GridCtrl::GetItem(int row) const
   return nullptr;
 }
 
+wxString GridCtrl::GetDisplayField(int row, CItemData::FieldType ft) const
+{
+  auto iter = m_row_map.find(row);
+  if (iter == m_row_map.end())
+    return wxEmptyString;
+  return towxstring(m_core.GetDisplayField(iter->second, ft));
+}
+
 /*!
  * wxEVT_GRID_CELL_LEFT_DCLICK event handler for ID_LISTBOX
  */
@@ -29,6 +29,7 @@
 
 #include <functional>
 #include <map>
+#include <unordered_map>
 #include <tuple>
 
 /*!
@@ -52,7 +53,7 @@ class GridCtrl;
 ////@end control identifiers
 
 typedef std::map<int, pws_os::CUUID> RowUUIDMapT;
-typedef std::map<pws_os::CUUID, int, std::less<pws_os::CUUID> > UUIDRowMapT;
+typedef std::unordered_map<pws_os::CUUID, int> UUIDRowMapT;
 
 /*!
  * GridCtrl class declaration
@@ -147,6 +148,9 @@ public:
 
   CItemData *GetItem(int row) const;
 
+  // Group, title or user at row, without decrypting each time it's redrawn
+  wxString GetDisplayField(int row, CItemData::FieldType ft) const;
+
   void SelectItem(const pws_os::CUUID& uuid);
 
   int  FindItemRow(const pws_os::CUUID& uu);
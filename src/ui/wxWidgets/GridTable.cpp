@@ -123,10 +123,14 @@ wxString GridTable::GetValue(int row, int col)
 {
   if (size_t(row) < m_pwsgrid->GetNumItems() &&
       size_t(col) < NumberOf(PWSGridCellData)) {
+    const CItemData::FieldType ft = PWSGridCellData[col].ft;
+    // Redrawing and sorting call here a lot
+    if (DisplayFieldCache::IsCached(ft))
+      return m_pwsgrid->GetDisplayField(row, ft);
     const CItemData *pItem = m_pwsgrid->GetItem(row);
     if (pItem != nullptr) {
-      if (PWSGridCellData[col].ft != CItemData::POLICY) {
-        return towxstring(pItem->GetFieldValue(PWSGridCellData[col].ft));
+      if (ft != CItemData::POLICY) {
+        return towxstring(pItem->GetFieldValue(ft));
       } else {
         PWPolicy pwp;
         pItem->GetPWPolicy(pwp);
@@ -298,10 +298,31 @@ void PasswordSafeFrame::OnSaveAsClick(wxCommandEvent& evt)
 
 int PasswordSafeFrame::SaveImmediately()
 {
+  // If only entries changed, appending them to the journal will do
+  if (PWSprefs::GetInstance()->GetPref(PWSprefs::UseChangeJournal) &&
+      m_core.WriteJournal() == PWScore::SUCCESS) {
+    UpdateStatusBar();
+    return PWScore::SUCCESS;
+  }
+
+  // A save's under way, this gets the changes into the one after it
+  if (m_core.IsSaving())
+    return m_core.WriteCurFileAsync();
+
   // Get normal save to do this (code already there for intermediate backups)
   return Save(SaveType::IMMEDIATELY);
 }
 
+void PasswordSafeFrame::OnAsyncSaveFinished()
+{
+  // A failed save left the database as it was, so there's no backup to
+  // restore, and one that was queued behind it isn't started
+  const int rc = m_core.FinishAsyncSave(); // may start a queued one
+  if (rc != PWScore::SUCCESS)
+    DisplayFileWriteError(rc, m_core.GetCurFile());
+  UpdateStatusBar();
+}
+
 int PasswordSafeFrame::Save(SaveType savetype /* = SaveType::INVALID*/)
 {
   stringT bu_fname; // used to undo backup if save failed
@@ -319,6 +340,15 @@ int PasswordSafeFrame::Save(SaveType savetype /* = SaveType::INVALID*/)
   if (!m_core.IsDbOpen())
     return SaveAs();
 
+  // Don't quietly overwrite what another program wrote
+  if (m_core.HasFileChangedExternally()) {
+    wxString msg(wxString::Format(_("The database \"%ls\" has been changed by another program since it was opened or last saved.\n\nSave anyway, replacing those changes?"),
+                                  m_core.GetCurFile().c_str()));
+    if (wxMessageBox(msg, _("File changed"), wxYES_NO | wxICON_EXCLAMATION, this) != wxYES)
+      return PWScore::USER_CANCEL;
+    m_core.AcceptFileChanges();
+  }
+
   switch (m_core.GetReadFileVersion()) {
     case PWSfile::VCURRENT:
     case PWSfile::V40:
@@ -327,8 +357,10 @@ int PasswordSafeFrame::Save(SaveType savetype /* = SaveType::INVALID*/)
         int backupSuffix = prefs->GetPref(PWSprefs::BackupSuffix);
         std::wstring userBackupPrefix = prefs->GetPref(PWSprefs::BackupPrefixValue).c_str();
         std::wstring userBackupDir = prefs->GetPref(PWSprefs::BackupDir).c_str();
+        // Saving in the background leaves the database in place meanwhile
         if (!m_core.BackupCurFile(maxNumIncBackups, backupSuffix,
-                                  userBackupPrefix, userBackupDir, bu_fname)) {
+                                  userBackupPrefix, userBackupDir, bu_fname,
+                                  savetype == SaveType::IMMEDIATELY)) {
           switch (savetype) {
             case SaveType::NORMALEXIT:
               if (wxMessageBox(_("Unable to create intermediate backup.  Save database elsewhere or with another name?\n\nClick 'No' to exit without saving."),
@@ -389,8 +421,16 @@ int PasswordSafeFrame::Save(SaveType savetype /* = SaveType::INVALID*/)
 
   // Note: Writing out in in V4 DB format if the DB is already V4,
   // otherwise as V3 (this include saving pre-3.0 DBs as a V3 DB!
-  auto rc = m_core.WriteFile(m_core.GetCurFile(),
-                             m_core.GetReadFileVersion() == PWSfile::V40 ? PWSfile::V40 : PWSfile::V30);
+  const PWSfile::VERSION version = m_core.GetReadFileVersion() == PWSfile::V40 ? PWSfile::V40 : PWSfile::V30;
+
+  // Saving after each change shouldn't hold up the next one, so that's
+  // done on another thread, and finished by OnAsyncSaveFinished()
+  if (savetype == SaveType::IMMEDIATELY &&
+      m_core.WriteFileAsync(m_core.GetCurFile(), version) == PWScore::SUCCESS) {
+    return PWScore::SUCCESS;
+  }
+
+  auto rc = m_core.WriteFile(m_core.GetCurFile(), version);
 
   if (rc != PWScore::SUCCESS) { // Save failed!
     // Restore backup, if we have one
@@ -557,6 +597,10 @@ int PasswordSafeFrame::SaveIfChanged()
   if (m_core.IsReadOnly())
     return PWScore::SUCCESS;
 
+  // Journaled changes are already saved, but belong in the database proper
+  if (m_core.HasJournaledChanges() && Save() != PWScore::SUCCESS)
+    return PWScore::CANT_OPEN_FILE;
+
   // Offer to save existing database if it was modified.
   //
   // Note: RUE list saved here via time stamp being updated.
@@ -87,6 +87,7 @@ BEGIN_EVENT_TABLE( PasswordSafeFrame, wxFrame )
   EVT_CHAR_HOOK(                        PasswordSafeFrame::OnChar                        )
   EVT_CLOSE(                            PasswordSafeFrame::OnCloseWindow                 )
   EVT_ICONIZE(                          PasswordSafeFrame::OnIconize                     )
+  EVT_TIMER( DISPLAY_CACHE_TIMER_ID,    PasswordSafeFrame::OnDisplayCacheTimer           )
 
   ////////////////////////////////////////////////////////////////////////////////////////
   // Menu: "File"
@@ -415,6 +416,9 @@ PasswordSafeFrame::~PasswordSafeFrame()
   delete m_guiInfo;
   m_guiInfo = nullptr;
 
+  delete m_displayCacheTimer;
+  m_displayCacheTimer = nullptr;
+
   m_core.ClearDBData();
   m_core.UnregisterObserver(this);
 }
@@ -436,6 +440,9 @@ void PasswordSafeFrame::Init()
   }
 
   m_RUEList.SetMax(PWSprefs::GetInstance()->PWSprefs::MaxREItems);
+
+  m_displayCacheTimer = new wxTimer(this, DISPLAY_CACHE_TIMER_ID);
+  m_displayCacheTimer->Start(60 * 1000, wxTIMER_CONTINUOUS);
 ////@begin PasswordSafeFrame member initialisation
   m_Toolbar = nullptr;
   m_Dragbar = nullptr;
@@ -1652,6 +1659,7 @@ void PasswordSafeFrame::UpdateAccessTime(CItemData &ci)
 
   if (!m_core.IsReadOnly() && bMaintainDateTimeStamps) {
     ci.SetATime();
+    m_core.AddChangedEntry(ci.GetUUID());
     UpdateStatusBar();
   }
 }
@@ -2302,6 +2310,15 @@ void PasswordSafeFrame::DatabaseModified(bool modified)
   }
 }
 
+/**
+ * Implements Observer::AsyncSaveFinished()
+ */
+void PasswordSafeFrame::AsyncSaveFinished()
+{
+  // Called on the thread that saved
+  CallAfter(&PasswordSafeFrame::OnAsyncSaveFinished);
+}
+
 /**
  * Implements Observer::UpdateGUI(UpdateGUICommand::GUI_Action, const pws_os::CUUID&, CItemData::FieldType)
  */
@@ -2543,12 +2560,21 @@ void PasswordSafeFrame::OnIconize(wxIconizeEvent& evt) {
     if (PWSprefs::GetInstance()->GetPref(PWSprefs::ClearClipboardOnMinimize)) {
       Clipboard::GetInstance()->ClearCBData();
     }
+    // Nothing to display, so no reason to keep decrypted fields around
+    m_core.ClearDisplayCache();
   }
   else{
       CallAfter(&PasswordSafeFrame::UnlockSafe, true, true);
   }
 }
 
+void PasswordSafeFrame::OnDisplayCacheTimer(wxTimerEvent& WXUNUSED(evt))
+{
+  // Decrypted fields shouldn't outlive their TTL just because
+  // nothing's asked for them since
+  m_core.PurgeDisplayCache();
+}
+
 void PasswordSafeFrame::TryIconize(int attempts)
 {
   while ( !IsIconized() && attempts-- ) {
@@ -2573,6 +2599,7 @@ void PasswordSafeFrame::HideUI(bool lock)
   if (PWSprefs::GetInstance()->GetPref(PWSprefs::ClearClipboardOnMinimize)) {
     Clipboard::GetInstance()->ClearCBData();
   }
+  m_core.ClearDisplayCache();
 
   m_guiInfo->Save(this);
   wxGetApp().SaveFrameCoords();
@@ -2627,6 +2654,7 @@ void PasswordSafeFrame::LockDb()
   }
 
   m_guiInfo->Save(this);
+  m_core.ClearDisplayCache();
   if (SaveAndClearDatabaseOnLock()) {
     m_sysTray->SetTrayStatus(SystemTray::TrayStatus::LOCKED);
 
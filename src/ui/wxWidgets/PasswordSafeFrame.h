@@ -26,6 +26,7 @@
 #include <wx/treebase.h> // for wxTreeItemId
 #include <wx/settings.h>
 #include <wx/modalhook.h>
+#include <wx/timer.h>
 
 #include "core/PWScore.h"
 #include "core/PWSFilters.h"
@@ -241,6 +242,9 @@ public:
   /// Implements Observer::UpdateGUI(UpdateGUICommand::GUI_Action, const pws_os::CUUID&, CItemData::FieldType)
   void UpdateGUI(UpdateGUICommand::GUI_Action ga, const pws_os::CUUID &entry_uuid, CItemData::FieldType ft = CItemData::START) override;
 
+  /// Implements Observer::AsyncSaveFinished()
+  void AsyncSaveFinished() override;
+
 ////@begin PasswordSafeFrame event handler declarations
 
   /// wxEVT_CHAR_HOOK event handler for WXK_ESCAPE
@@ -432,6 +436,9 @@ public:
   /// wxEVT_ICONIZE event handler
   void OnIconize(wxIconizeEvent& evt);
 
+  /// wxEVT_TIMER event handler for DISPLAY_CACHE_TIMER_ID
+  void OnDisplayCacheTimer(wxTimerEvent& evt);
+
   /// wxEVT_COMMAND_MENU_SELECTED event handler for ID_LOCK_SAFE
   void OnLockSafe(wxCommandEvent& evt);
 
@@ -644,6 +651,7 @@ private:
   int SaveAs(void);
   int Save(SaveType savetype = SaveType::INVALID);
   int SaveImmediately();
+  void OnAsyncSaveFinished();
   void ShowGrid(bool show = true);
   void ShowTree(bool show = true);
   void ClearAppData();
@@ -816,6 +824,13 @@ private:
   wxString m_LastClipboardAction;
   CItem::FieldType m_LastAction;  // TODO: Check how this is used by Windows version
 
+  // Drops expired display fields (see DisplayFieldCache)
+  wxTimer *m_displayCacheTimer;
+  enum
+  {
+    DISPLAY_CACHE_TIMER_ID = 34
+  };
+
   friend class DnDFile;
   friend class TreeCtrl;
   friend class PWSafeApp;
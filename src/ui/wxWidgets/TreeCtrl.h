@@ -30,6 +30,7 @@
 #include "os/UUID.h"
 
 #include <map>
+#include <unordered_map>
 
 #include "DnDSupport.h"
 ////@end includes
@@ -56,7 +57,7 @@ class SelectTreeCtrl;
 #define SYMBOL_PWSTREECTRL_POSITION wxDefaultPosition
 ////@end control identifiers
 
-typedef std::map<pws_os::CUUID, wxTreeItemId, std::less<pws_os::CUUID> > UUIDTIMapT;
+typedef std::unordered_map<pws_os::CUUID, wxTreeItemId> UUIDTIMapT;
 
 class TreeCtrl;
 